@@ -18,8 +18,11 @@
 
 #include "attribute.h"
 
+#include "shared/graph/igraph.h"
 #include "shared/utils/container.h"
 
+#include <algorithm>
+
 #include <QDebug>
 
 void Attribute::clearValueFunctions()
@@ -35,6 +38,8 @@ void Attribute::clearValueFunctions()
     _.stringNodeIdFn = nullptr;
     _.stringEdgeIdFn = nullptr;
     _.stringComponentFn = nullptr;
+
+    dematerialise();
 }
 
 void Attribute::clearMissingFunctions()
@@ -42,37 +47,111 @@ void Attribute::clearMissingFunctions()
     _.valueMissingNodeIdFn = nullptr;
     _.valueMissingEdgeIdFn = nullptr;
     _.valueMissingComponentFn = nullptr;
+
+    dematerialise();
+}
+
+int Attribute::valueOf(Helper<int>, NodeId nodeId) const
+{
+    return withColumn([&](const AttributeColumn* column)
+    {
+        if(column != nullptr && column->covers<int>(nodeId))
+            return column->intValueOf(nodeId);
+
+        return callValueFn(_.intNodeIdFn, nodeId);
+    });
+}
+
+int Attribute::valueOf(Helper<int>, EdgeId edgeId) const
+{
+    return withColumn([&](const AttributeColumn* column)
+    {
+        if(column != nullptr && column->covers<int>(edgeId))
+            return column->intValueOf(edgeId);
+
+        return callValueFn(_.intEdgeIdFn, edgeId);
+    });
 }
 
-int Attribute::valueOf(Helper<int>, NodeId nodeId) const { return callValueFn(_.intNodeIdFn, nodeId); }
-int Attribute::valueOf(Helper<int>, EdgeId edgeId) const { return callValueFn(_.intEdgeIdFn, edgeId); }
 int Attribute::valueOf(Helper<int>, const IGraphComponent& component) const
 { return callValueFn<int, const IGraphComponent&>(_.intComponentFn, component); }
 
-double Attribute::valueOf(Helper<double>, NodeId nodeId) const { return callValueFn(_.floatNodeIdFn, nodeId); }
-double Attribute::valueOf(Helper<double>, EdgeId edgeId) const { return callValueFn(_.floatEdgeIdFn, edgeId); }
+double Attribute::valueOf(Helper<double>, NodeId nodeId) const
+{
+    return withColumn([&](const AttributeColumn* column)
+    {
+        if(column != nullptr && column->covers<double>(nodeId))
+            return column->floatValueOf(nodeId);
+
+        return callValueFn(_.floatNodeIdFn, nodeId);
+    });
+}
+
+double Attribute::valueOf(Helper<double>, EdgeId edgeId) const
+{
+    return withColumn([&](const AttributeColumn* column)
+    {
+        if(column != nullptr && column->covers<double>(edgeId))
+            return column->floatValueOf(edgeId);
+
+        return callValueFn(_.floatEdgeIdFn, edgeId);
+    });
+}
+
 double Attribute::valueOf(Helper<double>, const IGraphComponent& component) const
 { return callValueFn<double, const IGraphComponent&>(_.floatComponentFn, component); }
 
-QString Attribute::valueOf(Helper<QString>, NodeId nodeId) const { return callValueFn(_.stringNodeIdFn, nodeId); }
-QString Attribute::valueOf(Helper<QString>, EdgeId edgeId) const { return callValueFn(_.stringEdgeIdFn, edgeId); }
+QString Attribute::valueOf(Helper<QString>, NodeId nodeId) const
+{
+    return withColumn([&](const AttributeColumn* column)
+    {
+        if(column != nullptr && column->covers<QString>(nodeId))
+            return column->stringValueOf(nodeId);
+
+        return callValueFn(_.stringNodeIdFn, nodeId);
+    });
+}
+
+QString Attribute::valueOf(Helper<QString>, EdgeId edgeId) const
+{
+    return withColumn([&](const AttributeColumn* column)
+    {
+        if(column != nullptr && column->covers<QString>(edgeId))
+            return column->stringValueOf(edgeId);
+
+        return callValueFn(_.stringEdgeIdFn, edgeId);
+    });
+}
+
 QString Attribute::valueOf(Helper<QString>, const IGraphComponent& component) const
 { return callValueFn<QString, const IGraphComponent&>(_.stringComponentFn, component); }
 
 bool Attribute::valueMissingOf(NodeId nodeId) const
 {
-    if(valueFnIsSet(_.valueMissingNodeIdFn))
-        return callValueFn(_.valueMissingNodeIdFn, nodeId);
+    return withColumn([&](const AttributeColumn* column)
+    {
+        if(column != nullptr && column->covers(nodeId))
+            return column->valueMissingOf(nodeId);
 
-    return false;
+        if(valueFnIsSet(_.valueMissingNodeIdFn))
+            return callValueFn(_.valueMissingNodeIdFn, nodeId);
+
+        return false;
+    });
 }
 
 bool Attribute::valueMissingOf(EdgeId edgeId) const
 {
-    if(valueFnIsSet(_.valueMissingEdgeIdFn))
-        return callValueFn(_.valueMissingEdgeIdFn, edgeId);
+    return withColumn([&](const AttributeColumn* column)
+    {
+        if(column != nullptr && column->covers(edgeId))
+            return column->valueMissingOf(edgeId);
 
-    return false;
+        if(valueFnIsSet(_.valueMissingEdgeIdFn))
+            return callValueFn(_.valueMissingEdgeIdFn, edgeId);
+
+        return false;
+    });
 }
 
 bool Attribute::valueMissingOf(const IGraphComponent& component) const
@@ -83,6 +162,95 @@ bool Attribute::valueMissingOf(const IGraphComponent& component) const
     return false;
 }
 
+template<typename E>
+std::unique_ptr<const AttributeColumn> Attribute::makeColumn(const std::vector<E>& elementIds) const
+{
+    if(elementIds.empty())
+        return nullptr;
+
+    auto maxElementId = *std::max_element(elementIds.begin(), elementIds.end());
+    auto column = std::make_unique<AttributeColumn>(elementType(), valueType(),
+        static_cast<size_t>(static_cast<int>(maxElementId)) + 1);
+    bool missingValues = hasMissingValues();
+
+    for(auto elementId : elementIds)
+    {
+        switch(valueType())
+        {
+        case ValueType::Int:    column->setValue(elementId, valueOf<int>(elementId)); break;
+        case ValueType::Float:  column->setValue(elementId, valueOf<double>(elementId)); break;
+        case ValueType::String: column->setValue(elementId, valueOf<QString>(elementId)); break;
+        default: return nullptr;
+        }
+
+        if(missingValues && valueMissingOf(elementId))
+            column->setValueMissing(elementId);
+    }
+
+    column->finalise();
+    return column;
+}
+
+void Attribute::setMaterialisable(const IGraph& graph)
+{
+    dematerialise();
+
+    // The values of a parameterised attribute depend on the parameter, so there is no single snapshot
+    if(hasParameter() || (elementType() != ElementType::Node && elementType() != ElementType::Edge))
+        return;
+
+    auto lazyColumn = std::make_shared<LazyColumn>();
+    lazyColumn->_graph = &graph;
+    _.lazyColumn.store(std::move(lazyColumn));
+}
+
+void Attribute::dematerialise()
+{
+    // Copies that don't hold a snapshot may be read concurrently, so only those that do are written
+    if(_.heldColumn != nullptr)
+        _.heldColumn = nullptr;
+
+    _.lazyColumn.store(nullptr);
+}
+
+std::shared_ptr<const AttributeColumn> Attribute::materialise() const
+{
+    if(_.heldColumn != nullptr)
+        return _.heldColumn;
+
+    // Keep hold of it, in case this attribute is dematerialised concurrently
+    auto lazyColumn = _.lazyColumn.load();
+
+    if(lazyColumn == nullptr)
+        return nullptr;
+
+    const auto* completeColumn = lazyColumn->_completeColumn.load();
+
+    if(completeColumn == nullptr)
+    {
+        std::unique_lock<std::mutex> lock(lazyColumn->_mutex);
+
+        // Another copy of the attribute may have taken the snapshot while we waited
+        if(lazyColumn->_column == nullptr)
+        {
+            if(elementType() == ElementType::Node)
+                lazyColumn->_column = makeColumn(lazyColumn->_graph->nodeIds());
+            else
+                lazyColumn->_column = makeColumn(lazyColumn->_graph->edgeIds());
+
+            lazyColumn->_completeColumn = lazyColumn->_column.get();
+        }
+
+        completeColumn = lazyColumn->_column.get();
+    }
+
+    if(completeColumn == nullptr)
+        return nullptr;
+
+    // Shares ownership of the snapshot, so remains valid even if it's discarded meanwhile
+    return {lazyColumn, completeColumn};
+}
+
 Attribute& Attribute::setIntValueFn(ValueFn<int, NodeId> valueFn) { clearValueFunctions(); _.intNodeIdFn = valueFn; return *this; }
 Attribute& Attribute::setIntValueFn(ValueFn<int, EdgeId> valueFn) { clearValueFunctions(); _.intEdgeIdFn = valueFn; return *this; }
 Attribute& Attribute::setIntValueFn(ValueFn<int, const IGraphComponent&> valueFn) { clearValueFunctions(); _.intComponentFn = valueFn; return *this; }
@@ -226,6 +394,10 @@ bool Attribute::setParameterValue(const QString& value)
         return false;
 
     _.parameterIndex = u::indexOf(_.validParameterValues, value);
+
+    // The values depend on the parameter
+    dematerialise();
+
     return true;
 }
 
@@ -27,8 +27,13 @@
 
 #include "shared/attributes/valuetype.h"
 
+#include "shared/attributes/attributecolumn.h"
+
+#include <atomic>
 #include <functional>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <tuple>
 #include <map>
@@ -37,6 +42,7 @@
 #include <QCollator>
 
 class Attribute;
+class IGraph;
 
 template<typename T> class AttributeRange
 {};
@@ -111,6 +117,42 @@ class Attribute : public IAttribute
     friend class AttributeNumericRange;
 
 private:
+    // A snapshot of the values, which isn't taken until first requested
+    struct LazyColumn
+    {
+        const IGraph* _graph = nullptr;
+
+        std::mutex _mutex;
+        std::unique_ptr<const AttributeColumn> _column;
+
+        // Set once _column is complete, so that reading it needn't lock
+        std::atomic<const AttributeColumn*> _completeColumn{nullptr};
+    };
+
+    // The snapshot may be discarded or replaced by one thread while another reads it, so the
+    // pointer that owns it is only ever accessed atomically, and a reader takes ownership of
+    // the snapshot it reads, keeping it valid for however long the read takes
+    class SharedLazyColumn
+    {
+    private:
+        std::shared_ptr<LazyColumn> _lazyColumn;
+
+    public:
+        SharedLazyColumn() = default;
+        SharedLazyColumn(const SharedLazyColumn& other) :
+            _lazyColumn(other.load())
+        {}
+
+        SharedLazyColumn& operator=(const SharedLazyColumn& other)
+        {
+            store(other.load());
+            return *this;
+        }
+
+        std::shared_ptr<LazyColumn> load() const { return std::atomic_load(&_lazyColumn); }
+        void store(std::shared_ptr<LazyColumn> lazyColumn) { std::atomic_store(&_lazyColumn, std::move(lazyColumn)); }
+    };
+
     // Wrap most of the data members in a struct to make it easier to
     // write/maintain a copy constructor
     struct
@@ -147,6 +189,12 @@ private:
         QStringList validParameterValues;
 
         QString description;
+
+        // Shared between copies, so that a snapshot taken through one is used by all
+        SharedLazyColumn lazyColumn;
+
+        // Set by holdColumn(), in a copy that only one thread reads
+        std::shared_ptr<const AttributeColumn> heldColumn;
     } _;
 
     AttributeRange<int> _intRange;
@@ -156,6 +204,24 @@ private:
     void clearValueFunctions();
     void clearMissingFunctions();
 
+    // Calls fn with the snapshot that reading a single value checks, or nullptr if there is none;
+    // unless this copy holds it already, the snapshot is loaded and owned for the duration of the
+    // call, so a reader of many values should hold it instead, by holdColumn(), to load it once
+    template<typename Fn>
+    auto withColumn(Fn&& fn) const
+    {
+        if(_.heldColumn != nullptr)
+            return fn(_.heldColumn.get());
+
+        auto lazyColumn = _.lazyColumn.load();
+        const AttributeColumn* column = lazyColumn != nullptr ?
+            lazyColumn->_completeColumn.load(std::memory_order_acquire) : nullptr;
+
+        return fn(column);
+    }
+
+    template<typename E> std::unique_ptr<const AttributeColumn> makeColumn(const std::vector<E>& elementIds) const;
+
     template<typename T, typename E>
     bool valueFnIsSet(const ValueFn<T, E>& valueFn) const
     {
@@ -324,6 +390,19 @@ public:
 
     bool hasMissingValues() const;
 
+    // Allows a snapshot to be taken of the values of graph's elements, by materialise(), after
+    // which they are read from it rather than by calling the value functions; any snapshot
+    // must be discarded, by dematerialise(), whenever the values might change
+    void setMaterialisable(const IGraph& graph);
+    std::shared_ptr<const AttributeColumn> materialise() const override;
+    void dematerialise();
+    bool isMaterialised() const { return withColumn([](const AttributeColumn* column) { return column != nullptr; }); }
+
+    // Takes the snapshot, and holds it in this copy of the attribute, so that it stays valid for as
+    // long as the copy is read from, whatever happens to the original; for example, a copy captured
+    // by a condition function that is evaluated for every element
+    void holdColumn() { _.heldColumn = materialise(); }
+
     template<typename T, typename E>
     using ValueOfFn = T(Attribute::*)(E&) const;
 
@@ -0,0 +1,631 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONDITIONEVALUATOR_H
+#define CONDITIONEVALUATOR_H
+
+#include "conditionfncreator.h"
+#include "attribute.h"
+
+#include "shared/graph/igraph.h"
+#include "shared/utils/stringdictionary.h"
+#include "shared/utils/threadpool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <QRegularExpression>
+#include <QString>
+
+// Evaluates a condition for a whole set of elements at once, as opposed to one element at a time as
+// the functions made by CreateConditionFnFor do. The values of each attribute in the condition are
+// gathered into a column, each terminal condition is then computed over its columns concurrently,
+// producing a bitmap, and compound conditions combine these bitmaps. Strings are dictionary encoded,
+// so comparing strings for equality is a comparison of codes, and string operations are applied once
+// per distinct value. Conditions that have no column based equivalent fall back to CreateConditionFnFor.
+template<typename E>
+class ConditionEvaluator
+{
+private:
+    using Bitmap = std::vector<uint64_t>;
+
+    static constexpr size_t BitsPerWord = 64;
+
+    // Blocks are whole words, so that no two threads ever write the same word
+    static constexpr size_t BlockSize = BitsPerWord * 64;
+
+    struct Column
+    {
+        ValueType _valueType = ValueType::Unknown;
+
+        std::vector<int> _intValues;
+        std::vector<double> _floatValues;
+        std::vector<StringDictionary::Code> _stringCodes;
+
+        // Empty when the attribute has no missing values
+        std::vector<char> _missing;
+
+        void resize(size_t size, bool hasMissingValues)
+        {
+            switch(_valueType)
+            {
+            case ValueType::Int:    _intValues.resize(size); break;
+            case ValueType::Float:  _floatValues.resize(size); break;
+            case ValueType::String: _stringCodes.resize(size); break;
+            default: break;
+            }
+
+            if(hasMissingValues)
+                _missing.resize(size, 0);
+        }
+
+        void copy(size_t to, const Column& other, size_t from)
+        {
+            switch(_valueType)
+            {
+            case ValueType::Int:    _intValues[to] = other._intValues[from]; break;
+            case ValueType::Float:  _floatValues[to] = other._floatValues[from]; break;
+            case ValueType::String: _stringCodes[to] = other._stringCodes[from]; break;
+            default: break;
+            }
+
+            if(!_missing.empty())
+                _missing[to] = other._missing[from];
+        }
+    };
+
+    const IAttributeProvider* _attributeProvider;
+    const IGraph* _graph;
+    const std::vector<E>* _elementIds;
+
+    // Shared by every column, so that equal strings always have equal codes
+    StringDictionary _strings;
+
+    // Keyed by attribute name, and empty when the attribute can't be put in a column
+    std::map<QString, std::optional<Column>> _columns;
+
+    Bitmap _selection;
+
+    // Value functions aren't necessarily thread safe, so this is only ever called serially
+    template<typename ElementId>
+    void setValue(Column& column, size_t index, const Attribute& attribute, ElementId elementId)
+    {
+        switch(column._valueType)
+        {
+        case ValueType::Int:    column._intValues[index] = attribute.valueOf<int>(elementId); break;
+        case ValueType::Float:  column._floatValues[index] = attribute.valueOf<double>(elementId); break;
+        case ValueType::String: column._stringCodes[index] = _strings.add(attribute.valueOf<QString>(elementId)); break;
+        default: break;
+        }
+
+        if(!column._missing.empty())
+            column._missing[index] = attribute.valueMissingOf(elementId) ? 1 : 0;
+    }
+
+    // Sets column[indexOf(i)] to the value of elementIds[i], for every i; the values are copied from the
+    // attribute's snapshot where it has one, concurrently, other than strings, which are added to the
+    // shared dictionary and so are copied serially; the value functions are only called for elements
+    // the snapshot doesn't cover, or for every element if the attribute can't be materialised
+    template<typename ElementId, typename IndexFn>
+    void gather(Column& column, const Attribute& attribute,
+        const std::vector<ElementId>& elementIds, IndexFn&& indexOf)
+    {
+        auto attributeColumn = attribute.materialise();
+
+        if(attributeColumn == nullptr)
+        {
+            for(size_t i = 0; i < elementIds.size(); i++)
+                setValue(column, indexOf(i), attribute, elementIds[i]);
+
+            return;
+        }
+
+        std::vector<char> uncovered(elementIds.size(), 0);
+
+        auto copyValue = [&](size_t i)
+        {
+            auto elementId = elementIds[i];
+            auto index = indexOf(i);
+
+            if(!attributeColumn->covers(elementId))
+            {
+                uncovered[i] = 1;
+                return;
+            }
+
+            switch(column._valueType)
+            {
+            case ValueType::Int:    column._intValues[index] = attributeColumn->intValueOf(elementId); break;
+            case ValueType::Float:  column._floatValues[index] = attributeColumn->floatValueOf(elementId); break;
+            case ValueType::String: column._stringCodes[index] = _strings.add(attributeColumn->stringValueOf(elementId)); break;
+            default: break;
+            }
+
+            if(!column._missing.empty())
+                column._missing[index] = attributeColumn->valueMissingOf(elementId) ? 1 : 0;
+        };
+
+        if(column._valueType == ValueType::String)
+        {
+            for(size_t i = 0; i < elementIds.size(); i++)
+                copyValue(i);
+        }
+        else
+        {
+            forEachBlock(elementIds.size(), [&](size_t begin, size_t end)
+            {
+                for(size_t i = begin; i < end; i++)
+                    copyValue(i);
+            });
+        }
+
+        for(size_t i = 0; i < elementIds.size(); i++)
+        {
+            if(uncovered[i] != 0)
+                setValue(column, indexOf(i), attribute, elementIds[i]);
+        }
+    }
+
+    std::optional<Column> makeColumn(const QString& name)
+    {
+        auto attributeName = Attribute::parseAttributeName(name);
+
+        const auto* baseAttribute = _attributeProvider->attributeByName(attributeName._name);
+        if(baseAttribute == nullptr)
+            return std::nullopt;
+
+        auto attribute = *baseAttribute;
+        if(!attributeName._parameter.isEmpty())
+            attribute.setParameterValue(attributeName._parameter);
+
+        Column column;
+        column._valueType = attribute.valueType();
+
+        if(attributeName._type == Attribute::EdgeNodeType::None)
+        {
+            if(!attribute.template isOfElementType<E>())
+                return std::nullopt;
+
+            column.resize(_elementIds->size(), attribute.hasMissingValues());
+
+            gather(column, attribute, *_elementIds, [](size_t i) { return i; });
+
+            return column;
+        }
+
+        if constexpr(std::is_same_v<E, EdgeId>)
+        {
+            if(attribute.elementType() != ElementType::Node)
+                return std::nullopt;
+
+            // As with Attribute::edgeNodesAttribute, the edges don't inherit the nodes' missing values
+            column.resize(_elementIds->size(), false);
+
+            // Gather the value of each node once, rather than once per edge it's incident to
+            const auto& nodeIds = _graph->nodeIds();
+            if(nodeIds.empty())
+                return column;
+
+            auto maxNodeId = *std::max_element(nodeIds.begin(), nodeIds.end());
+
+            Column nodeColumn;
+            nodeColumn._valueType = column._valueType;
+            nodeColumn.resize(static_cast<size_t>(static_cast<int>(maxNodeId)) + 1, !column._missing.empty());
+
+            gather(nodeColumn, attribute, nodeIds,
+                [&nodeIds](size_t i) { return static_cast<size_t>(static_cast<int>(nodeIds[i])); });
+
+            bool source = attributeName._type == Attribute::EdgeNodeType::Source;
+
+            forEachBlock([&](size_t begin, size_t end)
+            {
+                for(size_t i = begin; i < end; i++)
+                {
+                    const auto& edge = _graph->edgeById((*_elementIds)[i]);
+                    auto nodeId = source ? edge.sourceId() : edge.targetId();
+
+                    column.copy(i, nodeColumn, static_cast<size_t>(static_cast<int>(nodeId)));
+                }
+            });
+
+            return column;
+        }
+
+        return std::nullopt;
+    }
+
+    const Column* column(const QString& name)
+    {
+        auto it = _columns.find(name);
+        if(it == _columns.end())
+            it = _columns.emplace(name, makeColumn(name)).first;
+
+        return it->second ? &(*it->second) : nullptr;
+    }
+
+    static QString attributeNameOf(const GraphTransformConfig::TerminalValue& terminalValue)
+    {
+        const auto* value = std::get_if<QString>(&terminalValue);
+
+        if(value != nullptr && GraphTransformConfigParser::isAttributeName(*value))
+            return *value;
+
+        return {};
+    }
+
+    // Calls fn(begin, end) concurrently, for blocks of positions in [0, size)
+    template<typename Fn>
+    static void forEachBlock(size_t size, Fn&& fn)
+    {
+        std::vector<size_t> blockBegins;
+        for(size_t begin = 0; begin < size; begin += BlockSize)
+            blockBegins.push_back(begin);
+
+        if(blockBegins.empty())
+            return;
+
+        concurrent_for(blockBegins.begin(), blockBegins.end(), [&](size_t begin)
+        {
+            fn(begin, std::min(begin + BlockSize, size));
+        });
+    }
+
+    // Calls fn(begin, end) concurrently, for blocks of element positions
+    template<typename Fn>
+    void forEachBlock(Fn&& fn) const
+    {
+        forEachBlock(_elementIds->size(), std::forward<Fn>(fn));
+    }
+
+    template<typename Predicate>
+    Bitmap select(Predicate&& predicate) const
+    {
+        Bitmap bitmap((_elementIds->size() + BitsPerWord - 1) / BitsPerWord, 0);
+
+        forEachBlock([&](size_t begin, size_t end)
+        {
+            for(size_t i = begin; i < end; i++)
+            {
+                if(predicate(i))
+                    bitmap[i / BitsPerWord] |= uint64_t{1} << (i % BitsPerWord);
+            }
+        });
+
+        return bitmap;
+    }
+
+    Bitmap selectSerially(const ElementConditionFn<E>& conditionFn) const
+    {
+        Bitmap bitmap((_elementIds->size() + BitsPerWord - 1) / BitsPerWord, 0);
+
+        for(size_t i = 0; i < _elementIds->size(); i++)
+        {
+            if(conditionFn((*_elementIds)[i]))
+                bitmap[i / BitsPerWord] |= uint64_t{1} << (i % BitsPerWord);
+        }
+
+        return bitmap;
+    }
+
+    template<typename Lhs, typename Rhs>
+    Bitmap compare(ConditionFnOp::Equality op, Lhs lhs, Rhs rhs) const
+    {
+        if(op == ConditionFnOp::Equality::Equal)
+            return select([&](size_t i) { return lhs(i) == rhs(i); });
+
+        return select([&](size_t i) { return lhs(i) != rhs(i); });
+    }
+
+    template<typename Lhs, typename Rhs>
+    Bitmap compare(ConditionFnOp::Numerical op, Lhs lhs, Rhs rhs) const
+    {
+        switch(op)
+        {
+        case ConditionFnOp::Numerical::LessThan:            return select([&](size_t i) { return lhs(i) < rhs(i); });
+        case ConditionFnOp::Numerical::GreaterThan:         return select([&](size_t i) { return lhs(i) > rhs(i); });
+        case ConditionFnOp::Numerical::LessThanOrEqual:     return select([&](size_t i) { return lhs(i) <= rhs(i); });
+        case ConditionFnOp::Numerical::GreaterThanOrEqual:  return select([&](size_t i) { return lhs(i) >= rhs(i); });
+        }
+
+        return {};
+    }
+
+    template<typename T>
+    static auto valuesOf(const std::vector<T>& values)
+    {
+        return [data = values.data()](size_t i) { return data[i]; };
+    }
+
+    template<typename T>
+    static auto constant(T value)
+    {
+        return [value](size_t) { return value; };
+    }
+
+    // Calls fn with an accessor for the values of a numeric column
+    template<typename Fn>
+    static auto withNumericValues(const Column& column, Fn&& fn)
+    {
+        if(column._valueType == ValueType::Float)
+            return fn(valuesOf(column._floatValues));
+
+        return fn(valuesOf(column._intValues));
+    }
+
+    std::optional<Bitmap> attributesSelection(const Column& lhs,
+        const GraphTransformConfig::TerminalOp& terminalOp, const Column& rhs) const
+    {
+        if(const auto* op = std::get_if<ConditionFnOp::Equality>(&terminalOp))
+        {
+            if(lhs._valueType != rhs._valueType)
+                return std::nullopt;
+
+            switch(lhs._valueType)
+            {
+            case ValueType::Int:    return compare(*op, valuesOf(lhs._intValues), valuesOf(rhs._intValues));
+            case ValueType::Float:  return compare(*op, valuesOf(lhs._floatValues), valuesOf(rhs._floatValues));
+            case ValueType::String: return compare(*op, valuesOf(lhs._stringCodes), valuesOf(rhs._stringCodes));
+            default: return std::nullopt;
+            }
+        }
+
+        if(const auto* op = std::get_if<ConditionFnOp::Numerical>(&terminalOp))
+        {
+            if(!(lhs._valueType & ValueType::Numerical) || !(rhs._valueType & ValueType::Numerical))
+                return std::nullopt;
+
+            return withNumericValues(lhs, [&](auto lhsValues)
+            {
+                return withNumericValues(rhs, [&](auto rhsValues)
+                {
+                    return compare(*op, lhsValues, rhsValues);
+                });
+            });
+        }
+
+        return std::nullopt;
+    }
+
+    std::optional<Bitmap> attributeValueSelection(const Column& column,
+        const GraphTransformConfig::TerminalOp& terminalOp,
+        const GraphTransformConfig::TerminalValue& value, bool operandsAreSwitched)
+    {
+        if(const auto* op = std::get_if<ConditionFnOp::Equality>(&terminalOp))
+        {
+            if(const auto* intValue = std::get_if<int>(&value); intValue != nullptr && column._valueType == ValueType::Int)
+                return compare(*op, valuesOf(column._intValues), constant(*intValue));
+
+            if(const auto* floatValue = std::get_if<double>(&value); floatValue != nullptr && column._valueType == ValueType::Float)
+                return compare(*op, valuesOf(column._floatValues), constant(*floatValue));
+
+            if(const auto* stringValue = std::get_if<QString>(&value); stringValue != nullptr && column._valueType == ValueType::String)
+            {
+                // A value that doesn't appear in any column gets a code that nothing has
+                return compare(*op, valuesOf(column._stringCodes), constant(_strings.add(*stringValue)));
+            }
+
+            return std::nullopt;
+        }
+
+        if(const auto* op = std::get_if<ConditionFnOp::Numerical>(&terminalOp))
+        {
+            if(!(column._valueType & ValueType::Numerical))
+                return std::nullopt;
+
+            // Convert the value in the same way as CreateConditionFnFor
+            auto doubleValue = std::visit([](const auto& v)
+            {
+                if constexpr(std::is_same_v<std::decay_t<decltype(v)>, QString>)
+                    return v.toDouble();
+                else
+                    return static_cast<double>(v);
+            }, value);
+
+            auto compareWith = [&](auto values, auto valueConstant)
+            {
+                return operandsAreSwitched ?
+                    compare(*op, valueConstant, values) :
+                    compare(*op, values, valueConstant);
+            };
+
+            if(column._valueType == ValueType::Float)
+                return compareWith(valuesOf(column._floatValues), constant(doubleValue));
+
+            if(const auto* intValue = std::get_if<int>(&value))
+                return compareWith(valuesOf(column._intValues), constant(*intValue));
+
+            return compareWith(valuesOf(column._intValues), constant(static_cast<int>(doubleValue)));
+        }
+
+        if(const auto* op = std::get_if<ConditionFnOp::String>(&terminalOp))
+        {
+            if(column._valueType != ValueType::String)
+                return std::nullopt;
+
+            auto term = std::visit([](const auto& v)
+            {
+                if constexpr(std::is_same_v<std::decay_t<decltype(v)>, QString>)
+                    return v;
+                else
+                    return QString::number(v);
+            }, value);
+
+            std::function<bool(const QString&)> matchFn;
+
+            switch(*op)
+            {
+            case ConditionFnOp::String::Includes:   matchFn = [&term](const QString& s) { return s.contains(term); }; break;
+            case ConditionFnOp::String::Excludes:   matchFn = [&term](const QString& s) { return !s.contains(term); }; break;
+            case ConditionFnOp::String::Starts:     matchFn = [&term](const QString& s) { return s.startsWith(term); }; break;
+            case ConditionFnOp::String::Ends:       matchFn = [&term](const QString& s) { return s.endsWith(term); }; break;
+            case ConditionFnOp::String::MatchesRegex:
+            case ConditionFnOp::String::MatchesRegexCaseInsensitive:
+            {
+                auto reOption = *op == ConditionFnOp::String::MatchesRegexCaseInsensitive ?
+                    QRegularExpression::CaseInsensitiveOption :
+                    QRegularExpression::NoPatternOption;
+
+                QRegularExpression re(term, reOption);
+                if(!re.isValid())
+                    return std::nullopt;
+
+                matchFn = [re](const QString& s) { return re.match(s).hasMatch(); };
+                break;
+            }
+            }
+
+            // Each distinct string is only tested once
+            std::vector<char> matches(_strings.size(), 0);
+            for(size_t code = 0; code < _strings.size(); code++)
+                matches[code] = matchFn(_strings.valueOf(static_cast<StringDictionary::Code>(code))) ? 1 : 0;
+
+            const auto* codes = column._stringCodes.data();
+            return select([&](size_t i) { return matches[codes[i]] != 0; });
+        }
+
+        return std::nullopt;
+    }
+
+    std::optional<Bitmap> terminalSelection(const GraphTransformConfig::TerminalCondition& terminalCondition)
+    {
+        auto lhsName = attributeNameOf(terminalCondition._lhs);
+        auto rhsName = attributeNameOf(terminalCondition._rhs);
+
+        if(!lhsName.isEmpty() && !rhsName.isEmpty())
+        {
+            const auto* lhs = column(lhsName);
+            const auto* rhs = column(rhsName);
+
+            if(lhs == nullptr || rhs == nullptr)
+                return std::nullopt;
+
+            return attributesSelection(*lhs, terminalCondition._op, *rhs);
+        }
+
+        if(!lhsName.isEmpty())
+        {
+            const auto* lhs = column(lhsName);
+            if(lhs == nullptr)
+                return std::nullopt;
+
+            return attributeValueSelection(*lhs, terminalCondition._op, terminalCondition._rhs, false);
+        }
+
+        if(!rhsName.isEmpty())
+        {
+            const auto* rhs = column(rhsName);
+            if(rhs == nullptr)
+                return std::nullopt;
+
+            return attributeValueSelection(*rhs, terminalCondition._op, terminalCondition._lhs, true);
+        }
+
+        return std::nullopt;
+    }
+
+    std::optional<Bitmap> unarySelection(const GraphTransformConfig::UnaryCondition& unaryCondition)
+    {
+        auto name = attributeNameOf(unaryCondition._lhs);
+        if(name.isEmpty() || unaryCondition._op != ConditionFnOp::Unary::HasValue)
+            return std::nullopt;
+
+        const auto* lhs = column(name);
+        if(lhs == nullptr)
+            return std::nullopt;
+
+        if(lhs->_missing.empty())
+            return select(constant(true));
+
+        const auto* missing = lhs->_missing.data();
+        return select([missing](size_t i) { return missing[i] == 0; });
+    }
+
+    std::optional<Bitmap> selection(const GraphTransformConfig::Condition& condition)
+    {
+        if(const auto* compoundCondition = boost::get<GraphTransformConfig::CompoundCondition>(&condition))
+        {
+            auto lhs = selection(compoundCondition->_lhs);
+            auto rhs = selection(compoundCondition->_rhs);
+
+            if(!lhs || !rhs)
+                return std::nullopt;
+
+            for(size_t i = 0; i < lhs->size(); i++)
+            {
+                if(compoundCondition->_op == ConditionFnOp::Logical::And)
+                    (*lhs)[i] &= (*rhs)[i];
+                else
+                    (*lhs)[i] |= (*rhs)[i];
+            }
+
+            return lhs;
+        }
+
+        // CreateConditionFnFor is the arbiter of what is valid, and the fallback when there's no column equivalent
+        auto conditionFn = CreateConditionFnFor::elementType<E>(*_attributeProvider, condition);
+        if(conditionFn == nullptr)
+            return std::nullopt;
+
+        std::optional<Bitmap> bitmap;
+
+        if(const auto* terminalCondition = boost::get<GraphTransformConfig::TerminalCondition>(&condition))
+            bitmap = terminalSelection(*terminalCondition);
+        else if(const auto* unaryCondition = boost::get<GraphTransformConfig::UnaryCondition>(&condition))
+            bitmap = unarySelection(*unaryCondition);
+
+        if(!bitmap)
+            bitmap = selectSerially(conditionFn);
+
+        return bitmap;
+    }
+
+public:
+    ConditionEvaluator(const IAttributeProvider& attributeProvider, const IGraph& graph, const std::vector<E>& elementIds) :
+        _attributeProvider(&attributeProvider), _graph(&graph), _elementIds(&elementIds)
+    {}
+
+    // Returns false if the condition is invalid
+    bool evaluate(const GraphTransformConfig::Condition& condition)
+    {
+        auto bitmap = selection(condition);
+
+        _columns.clear();
+        _strings.clear();
+
+        if(!bitmap)
+            return false;
+
+        _selection = std::move(*bitmap);
+        return true;
+    }
+
+    // Whether or not the condition holds for the element at position in elementIds
+    bool selected(size_t position) const
+    {
+        return ((_selection[position / BitsPerWord] >> (position % BitsPerWord)) & 1u) != 0;
+    }
+};
+
+#endif // CONDITIONEVALUATOR_H
@@ -18,14 +18,14 @@
 
 #include "conditionfncreator.h"
 
-bool conditionIsValid(ElementType elementType, const GraphModel& graphModel,
+bool conditionIsValid(ElementType elementType, const IAttributeProvider& attributeProvider,
                       const GraphTransformConfig::Condition& condition)
 {
     switch(elementType)
     {
-    case ElementType::Node:         return CreateConditionFnFor::node(graphModel, condition)      != nullptr;
-    case ElementType::Edge:         return CreateConditionFnFor::edge(graphModel, condition)      != nullptr;
-    case ElementType::Component:    return CreateConditionFnFor::component(graphModel, condition) != nullptr;
+    case ElementType::Node:         return CreateConditionFnFor::node(attributeProvider, condition)      != nullptr;
+    case ElementType::Edge:         return CreateConditionFnFor::edge(attributeProvider, condition)      != nullptr;
+    case ElementType::Component:    return CreateConditionFnFor::component(attributeProvider, condition) != nullptr;
     default:                        return false;
     }
 
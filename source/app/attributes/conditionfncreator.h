@@ -25,11 +25,10 @@
 #include "shared/graph/igraphcomponent.h"
 #include "shared/graph/elementid_containers.h"
 
-#include "graph/graphmodel.h"
-
 #include "transform/graphtransformconfig.h"
 #include "transform/graphtransformconfigparser.h"
 #include "attribute.h"
+#include "iattributeprovider.h"
 
 #include <boost/variant/static_visitor.hpp>
 
@@ -269,14 +268,15 @@ private:
             if(_lhs.valueType() == ValueType::String)
                 return nullptr; // Can't compare a string attribute with a number
 
+            // "value < $x" is "$x > value", not the negation "$x >= value"
             if(_operandsAreSwitched)
             {
                 switch(op)
                 {
-                case ConditionFnOp::Numerical::LessThan:            op = ConditionFnOp::Numerical::GreaterThanOrEqual; break;
-                case ConditionFnOp::Numerical::GreaterThan:         op = ConditionFnOp::Numerical::LessThanOrEqual; break;
-                case ConditionFnOp::Numerical::LessThanOrEqual:     op = ConditionFnOp::Numerical::GreaterThan; break;
-                case ConditionFnOp::Numerical::GreaterThanOrEqual:  op = ConditionFnOp::Numerical::LessThan; break;
+                case ConditionFnOp::Numerical::LessThan:            op = ConditionFnOp::Numerical::GreaterThan; break;
+                case ConditionFnOp::Numerical::GreaterThan:         op = ConditionFnOp::Numerical::LessThan; break;
+                case ConditionFnOp::Numerical::LessThanOrEqual:     op = ConditionFnOp::Numerical::GreaterThanOrEqual; break;
+                case ConditionFnOp::Numerical::GreaterThanOrEqual:  op = ConditionFnOp::Numerical::LessThanOrEqual; break;
                 }
             }
 
@@ -453,12 +453,12 @@ private:
     struct ConditionVisitor : public boost::static_visitor<ElementConditionFn<E>>
     {
         ElementType _elementType;
-        const GraphModel* _graphModel;
+        const IAttributeProvider* _attributeProvider;
         bool _strictTyping = false;
 
-        ConditionVisitor(ElementType elementType, const GraphModel& graphModel, bool strictTyping = false) :
+        ConditionVisitor(ElementType elementType, const IAttributeProvider& attributeProvider, bool strictTyping = false) :
             _elementType(elementType),
-            _graphModel(&graphModel),
+            _attributeProvider(&attributeProvider),
             _strictTyping(strictTyping)
         {}
 
@@ -474,10 +474,10 @@ private:
         {
             struct Visitor
             {
-                const GraphModel* _graphModel;
+                const IAttributeProvider* _attributeProvider;
 
-                explicit Visitor(const GraphModel* graphModel) :
-                    _graphModel(graphModel)
+                explicit Visitor(const IAttributeProvider* attributeProvider) :
+                    _attributeProvider(attributeProvider)
                 {}
 
                 ResolvedTerminalValue operator()(double v) const { return v; }
@@ -485,13 +485,20 @@ private:
                 ResolvedTerminalValue operator()(const QString& v) const
                 {
                     if(GraphTransformConfigParser::isAttributeName(v))
-                        return _graphModel->attributeValueByName(v);
+                    {
+                        // The condition will likely be evaluated for every element, so
+                        // the copy it captures reads the snapshot directly
+                        auto attribute = _attributeProvider->attributeValueByName(v);
+                        attribute.holdColumn();
+
+                        return attribute;
+                    }
 
                     return v;
                 }
             };
 
-            return std::visit(Visitor(_graphModel), terminalValue);
+            return std::visit(Visitor(_attributeProvider), terminalValue);
         }
 
         Attribute attributeFromValue(const ResolvedTerminalValue& resolvedTerminalValue) const
@@ -508,10 +515,10 @@ private:
         {
             struct Visitor
             {
-                const GraphModel* _graphModel;
+                const IAttributeProvider* _attributeProvider;
 
-                explicit Visitor(const GraphModel* graphModel) :
-                    _graphModel(graphModel)
+                explicit Visitor(const IAttributeProvider* attributeProvider) :
+                    _attributeProvider(attributeProvider)
                 {}
 
                 ValueType operator()(double) const          { return ValueType::Float; }
@@ -524,7 +531,7 @@ private:
                 }
             };
 
-            return std::visit(Visitor(_graphModel), resolvedTerminalValue);
+            return std::visit(Visitor(_attributeProvider), resolvedTerminalValue);
         }
 
         bool isUnknownAttribute(const ResolvedTerminalValue& resolvedTerminalValue) const
@@ -631,8 +638,8 @@ private:
 
         ElementConditionFn<E> operator()(const GraphTransformConfig::CompoundCondition& compoundCondition) const
         {
-            auto lhs = boost::apply_visitor(ConditionVisitor<E>(_elementType, *_graphModel), compoundCondition._lhs);
-            auto rhs = boost::apply_visitor(ConditionVisitor<E>(_elementType, *_graphModel), compoundCondition._rhs);
+            auto lhs = boost::apply_visitor(ConditionVisitor<E>(_elementType, *_attributeProvider), compoundCondition._lhs);
+            auto rhs = boost::apply_visitor(ConditionVisitor<E>(_elementType, *_attributeProvider), compoundCondition._rhs);
 
             if(lhs == nullptr || rhs == nullptr)
                 return nullptr;
@@ -653,36 +660,36 @@ private:
     };
 
 public:
-    static auto node(const GraphModel& graphModel,
+    static auto node(const IAttributeProvider& attributeProvider,
                      const GraphTransformConfig::Condition& condition)
     {
-        return boost::apply_visitor(ConditionVisitor<NodeId>(ElementType::Node, graphModel), condition);
+        return boost::apply_visitor(ConditionVisitor<NodeId>(ElementType::Node, attributeProvider), condition);
     }
 
-    static auto edge(const GraphModel& graphModel,
+    static auto edge(const IAttributeProvider& attributeProvider,
                      const GraphTransformConfig::Condition& condition)
     {
-        return boost::apply_visitor(ConditionVisitor<EdgeId>(ElementType::Edge, graphModel), condition);
+        return boost::apply_visitor(ConditionVisitor<EdgeId>(ElementType::Edge, attributeProvider), condition);
     }
 
-    static auto component(const GraphModel& graphModel,
+    static auto component(const IAttributeProvider& attributeProvider,
                           const GraphTransformConfig::Condition& condition)
     {
-        return boost::apply_visitor(ConditionVisitor<const IGraphComponent&>(ElementType::Component, graphModel), condition);
+        return boost::apply_visitor(ConditionVisitor<const IGraphComponent&>(ElementType::Component, attributeProvider), condition);
     }
 
     template<typename E>
-    static auto elementType(const GraphModel& graphModel,
+    static auto elementType(const IAttributeProvider& attributeProvider,
                             const GraphTransformConfig::Condition& condition)
     {
         if constexpr(std::is_same_v<E, NodeId>)
-            return node(graphModel, condition);
+            return node(attributeProvider, condition);
 
         if constexpr(std::is_same_v<E, EdgeId>)
-            return edge(graphModel, condition);
+            return edge(attributeProvider, condition);
 
         if constexpr(std::is_same_v<E, const IGraphComponent&>)
-            return component(graphModel, condition);
+            return component(attributeProvider, condition);
     }
 
     template<typename Op, typename Value>
@@ -723,7 +730,7 @@ public:
     }
 };
 
-bool conditionIsValid(ElementType elementType, const GraphModel& graphModel,
+bool conditionIsValid(ElementType elementType, const IAttributeProvider& attributeProvider,
                       const GraphTransformConfig::Condition& condition);
 
 #endif // CONDITIONFNCREATOR_H
@@ -0,0 +1,38 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IATTRIBUTEPROVIDER_H
+#define IATTRIBUTEPROVIDER_H
+
+#include <QString>
+
+class Attribute;
+
+class IAttributeProvider
+{
+public:
+    virtual ~IAttributeProvider() = default;
+
+    virtual const Attribute* attributeByName(const QString& name) const = 0;
+
+    // The attribute, with any parameter in name applied, or for $source.X and
+    // $target.X, the edge attribute that refers to the node attribute X
+    virtual Attribute attributeValueByName(const QString& name) const = 0;
+};
+
+#endif // IATTRIBUTEPROVIDER_H
@@ -0,0 +1,107 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "adjacencysnapshot.h"
+
+#include "shared/graph/igraph.h"
+#include "shared/utils/threadpool.h"
+
+#include <algorithm>
+
+AdjacencySnapshot::AdjacencySnapshot(const IGraph& graph) :
+    _numEdges(static_cast<size_t>(graph.numEdges())),
+    _nodeIds(graph.nodeIds())
+{
+    const auto numNodes = _nodeIds.size();
+
+    _offsets.resize(numNodes + 1);
+    _outOffsets.resize(numNodes);
+
+    if(numNodes == 0)
+        return;
+
+    auto maxNodeId = *std::max_element(_nodeIds.begin(), _nodeIds.end());
+    _indices.assign(static_cast<size_t>(static_cast<int>(maxNodeId)) + 1, NullIndex);
+
+    for(size_t i = 0; i < numNodes; i++)
+    {
+        const auto& node = graph.nodeById(_nodeIds[i]);
+
+        _indices[static_cast<size_t>(static_cast<int>(_nodeIds[i]))] = static_cast<Index>(i);
+        _outOffsets[i] = _offsets[i] + static_cast<size_t>(node.inDegree());
+        _offsets[i + 1] = _outOffsets[i] + static_cast<size_t>(node.outDegree());
+    }
+
+    _neighbours.resize(_offsets.back());
+    _edgeIds.resize(_offsets.back());
+
+    // Each node only writes its own range, so the nodes can be filled independently
+    concurrent_for(_nodeIds.cbegin(), _nodeIds.cend(),
+    [this, &graph](std::vector<NodeId>::const_iterator it)
+    {
+        auto nodeId = *it;
+        auto i = static_cast<size_t>(std::distance(_nodeIds.cbegin(), it));
+        auto offset = _offsets[i];
+
+        for(auto edgeId : graph.nodeById(nodeId).edgeIds())
+        {
+            _neighbours[offset] = indexOf(graph.edgeById(edgeId).oppositeId(nodeId));
+            _edgeIds[offset] = edgeId;
+            offset++;
+        }
+
+        Q_ASSERT(offset == _offsets[i + 1]);
+    });
+}
+
+std::vector<std::vector<AdjacencySnapshot::Index>> AdjacencySnapshot::components() const
+{
+    std::vector<std::vector<Index>> components;
+
+    const auto numNodes = _nodeIds.size();
+    std::vector<bool> visited(numNodes, false);
+    std::vector<Index> queue;
+    queue.reserve(numNodes);
+
+    for(Index root = 0; root < numNodes; root++)
+    {
+        if(visited[root])
+            continue;
+
+        queue.clear();
+        queue.push_back(root);
+        visited[root] = true;
+
+        for(size_t head = 0; head < queue.size(); head++)
+        {
+            for(auto neighbour : neighbours(queue[head]))
+            {
+                if(!visited[neighbour])
+                {
+                    visited[neighbour] = true;
+                    queue.push_back(neighbour);
+                }
+            }
+        }
+
+        components.emplace_back(queue);
+    }
+
+    return components;
+}
@@ -0,0 +1,102 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ADJACENCYSNAPSHOT_H
+#define ADJACENCYSNAPSHOT_H
+
+#include "shared/graph/elementid.h"
+#include "shared/utils/iterator_range.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+
+class IGraph;
+
+// An immutable compressed sparse row copy of the adjacency of a graph; nodes are densely
+// indexed 0..numNodes()-1 in the order of IGraph::nodeIds(), and the edges of each node are
+// stored contiguously, in edges before out edges, in the same order as INode::edgeIds()
+class AdjacencySnapshot
+{
+public:
+    using Index = uint32_t;
+    static constexpr Index NullIndex = std::numeric_limits<Index>::max();
+
+    template<typename T> using Range = iterator_range<const T*, const T*>;
+
+    explicit AdjacencySnapshot(const IGraph& graph);
+
+    size_t numNodes() const { return _nodeIds.size(); }
+    size_t numEdges() const { return _numEdges; }
+
+    const std::vector<NodeId>& nodeIds() const { return _nodeIds; }
+    NodeId nodeIdAt(Index index) const { return _nodeIds[index]; }
+
+    Index indexOf(NodeId nodeId) const
+    {
+        auto i = static_cast<size_t>(static_cast<int>(nodeId));
+        return i < _indices.size() ? _indices[i] : NullIndex;
+    }
+
+    bool contains(NodeId nodeId) const { return indexOf(nodeId) != NullIndex; }
+
+    size_t degree(Index index) const { return _offsets[index + 1] - _offsets[index]; }
+    size_t inDegree(Index index) const { return _outOffsets[index] - _offsets[index]; }
+    size_t outDegree(Index index) const { return _offsets[index + 1] - _outOffsets[index]; }
+
+    // The node at the other end of each edge, for loops this is the node itself
+    Range<Index> neighbours(Index index) const { return range(_neighbours, _offsets[index], _offsets[index + 1]); }
+    Range<Index> sources(Index index) const { return range(_neighbours, _offsets[index], _outOffsets[index]); }
+    Range<Index> targets(Index index) const { return range(_neighbours, _outOffsets[index], _offsets[index + 1]); }
+
+    // Parallel to neighbours(...), sources(...) and targets(...) respectively
+    Range<EdgeId> edgeIds(Index index) const { return range(_edgeIds, _offsets[index], _offsets[index + 1]); }
+    Range<EdgeId> inEdgeIds(Index index) const { return range(_edgeIds, _offsets[index], _outOffsets[index]); }
+    Range<EdgeId> outEdgeIds(Index index) const { return range(_edgeIds, _outOffsets[index], _offsets[index + 1]); }
+
+    // The position of the first entry of a node, within the arrays that
+    // neighbours(...) and edgeIds(...) index, for building parallel arrays
+    size_t offsetOf(Index index) const { return _offsets[index]; }
+    size_t numEntries() const { return _neighbours.size(); }
+
+    // The indices of the nodes in each connected component, treating the edges as undirected
+    std::vector<std::vector<Index>> components() const;
+
+private:
+    size_t _numEdges = 0;
+
+    std::vector<NodeId> _nodeIds;
+
+    // Indexed by NodeId
+    std::vector<Index> _indices;
+
+    std::vector<size_t> _offsets;
+    std::vector<size_t> _outOffsets;
+    std::vector<Index> _neighbours;
+    std::vector<EdgeId> _edgeIds;
+
+    template<typename T>
+    static Range<T> range(const std::vector<T>& v, size_t begin, size_t end)
+    {
+        return {v.data() + begin, v.data() + end};
+    }
+};
+
+#endif // ADJACENCYSNAPSHOT_H
@@ -19,6 +19,7 @@
 #include "componentmanager.h"
 
 #include "shared/utils/thread.h"
+#include "shared/utils/threadpool.h"
 #include "shared/utils/container.h"
 #include "shared/graph/elementid_debug.h"
 
@@ -27,13 +28,17 @@
 
 #include <map>
 #include <queue>
+#include <atomic>
+#include <algorithm>
 
 ComponentManager::ComponentManager(Graph& graph,
                                    const NodeConditionFn& nodeFilter,
                                    const EdgeConditionFn& edgeFilter) :
     _nextComponentId(0),
     _nodesComponentId(graph),
-    _edgesComponentId(graph)
+    _edgesComponentId(graph),
+    _incremental(!nodeFilter && !edgeFilter),
+    _nodeIndices(graph, -1)
 {
     // Ignore all multi-elements
     addNodeFilter([&graph](NodeId nodeId) { return graph.typeOf(nodeId) == MultiElementType::Tail; });
@@ -45,6 +50,29 @@ ComponentManager::ComponentManager(Graph& graph,
     if(edgeFilter)
         addEdgeFilter(edgeFilter);
 
+    if(_incremental)
+    {
+        auto recordNodeId = [this](const Graph*, NodeId nodeId) { _changedNodeIds.push_back(nodeId); };
+        auto recordEdgeId = [this](const Graph*, EdgeId edgeId) { _changedEdgeIds.push_back(edgeId); };
+        auto recordNodeIds = [this](const Graph*, const std::vector<NodeId>& nodeIds)
+        {
+            _changedNodeIds.insert(_changedNodeIds.end(), nodeIds.begin(), nodeIds.end());
+        };
+        auto recordEdgeIds = [this](const Graph*, const std::vector<EdgeId>& edgeIds)
+        {
+            _changedEdgeIds.insert(_changedEdgeIds.end(), edgeIds.begin(), edgeIds.end());
+        };
+
+        connect(&graph, &Graph::nodeAdded,   this, recordNodeId, Qt::DirectConnection);
+        connect(&graph, &Graph::nodeRemoved, this, recordNodeId, Qt::DirectConnection);
+        connect(&graph, &Graph::nodesRemoved, this, recordNodeIds, Qt::DirectConnection);
+        connect(&graph, &Graph::nodeChanged, this, recordNodeId, Qt::DirectConnection);
+        connect(&graph, &Graph::edgeAdded,   this, recordEdgeId, Qt::DirectConnection);
+        connect(&graph, &Graph::edgeRemoved, this, recordEdgeId, Qt::DirectConnection);
+        connect(&graph, &Graph::edgesRemoved, this, recordEdgeIds, Qt::DirectConnection);
+        connect(&graph, &Graph::edgeChanged, this, recordEdgeId, Qt::DirectConnection);
+    }
+
     connect(&graph, &Graph::graphChanged, this, &ComponentManager::onGraphChanged, Qt::DirectConnection);
 
     graph.update();
@@ -113,16 +141,102 @@ void ComponentManager::eraseComponentArray(IGraphArray* componentArray)
     _componentArrays.erase(componentArray);
 }
 
+// A lock free disjoint set forest; sets are always linked to the lower of their two
+// roots, so concurrent unions can't form cycles, and a set's root is its minimum element
+class ConcurrentDisjointSets
+{
+private:
+    std::vector<std::atomic<size_t>> _parents;
+
+public:
+    explicit ConcurrentDisjointSets(size_t size) :
+        _parents(size)
+    {
+        for(size_t i = 0; i < size; i++)
+            _parents[i] = i;
+    }
+
+    size_t find(size_t x)
+    {
+        while(true)
+        {
+            auto parent = _parents[x].load();
+            if(parent == x)
+                return x;
+
+            // Path halving
+            auto grandParent = _parents[parent].load();
+            if(grandParent != parent)
+                _parents[x].compare_exchange_weak(parent, grandParent);
+
+            x = grandParent;
+        }
+    }
+
+    void unite(size_t a, size_t b)
+    {
+        while(true)
+        {
+            a = find(a);
+            b = find(b);
+
+            if(a == b)
+                return;
+
+            if(a < b)
+                std::swap(a, b);
+
+            // Fails if a has been linked elsewhere in the meantime, in which case try again
+            auto expected = a;
+            if(_parents[a].compare_exchange_strong(expected, b))
+                return;
+        }
+    }
+};
+
 void ComponentManager::update(const Graph* graph)
 {
     if(_debug) qDebug() << "ComponentManager::update begins" << this;
 
     std::unique_lock<std::recursive_mutex> lock(_updateMutex);
 
-    std::map<ComponentId, ComponentIdSet> splitComponents;
-    ComponentIdSet splitComponentIds;
-    std::map<ComponentId, ComponentIdSet> mergedComponents;
-    ComponentIdSet mergedComponentIds;
+    ComponentChanges changes;
+
+    if(_incremental)
+        updateIncrementally(graph, changes);
+    else
+        updateFully(graph, changes);
+
+    _updatesRequired.clear();
+
+    std::copy(changes._componentIdsToBeAdded.begin(), changes._componentIdsToBeAdded.end(),
+        std::back_inserter(_componentIds));
+
+    std::stable_sort(_componentIds.begin(), _componentIds.end(),
+    [this](auto a, auto b)
+    {
+        auto componentA = this->componentById(a);
+        auto componentB = this->componentById(b);
+
+        if(componentA->numNodes() == componentB->numNodes())
+            return a < b;
+
+        return componentA->numNodes() > componentB->numNodes();
+    });
+
+    lock.unlock();
+
+    notifyComponentsChanged(graph, changes);
+
+    if(_debug) qDebug() << "ComponentManager::update ends" << this;
+}
+
+void ComponentManager::updateFully(const Graph* graph, ComponentChanges& changes)
+{
+    auto& splitComponents = changes._splitComponents;
+    auto& splitComponentIds = changes._splitComponentIds;
+    auto& mergedComponents = changes._mergedComponents;
+    auto& mergedComponentIds = changes._mergedComponentIds;
     ComponentIdSet componentIds;
 
     NodeArray<ComponentId> newNodesComponentId(*graph);
@@ -191,130 +305,610 @@ void ComponentManager::update(const Graph* graph)
         componentArray->resize(componentArrayCapacity());
 
     // Search for added or removed components
-    auto componentIdsToBeAdded = u::setDifference(componentIds, _componentIds);
-    auto componentIdsToBeRemoved = u::setDifference(_componentIds, componentIds);
+    changes._componentIdsToBeAdded = u::setDifference(componentIds, _componentIds);
+    changes._componentIdsToBeRemoved = u::setDifference(_componentIds, componentIds);
 
     // Find nodes and edges that have been added or removed
-    std::map<ComponentId, std::vector<NodeId>> nodeIdAdds;
-    std::map<ComponentId, std::vector<EdgeId>> edgeIdAdds;
-    std::map<ComponentId, std::vector<NodeId>> nodeIdRemoves;
-    std::map<ComponentId, std::vector<EdgeId>> edgeIdRemoves;
-
     auto maxNumNodes = std::max(_nodesComponentId.size(), newNodesComponentId.size());
     for(NodeId nodeId(0); nodeId < maxNumNodes; ++nodeId)
     {
         if(_nodesComponentId[nodeId].isNull() && !newNodesComponentId[nodeId].isNull())
-            nodeIdAdds[newNodesComponentId[nodeId]].emplace_back(nodeId);
+            changes._nodeIdAdds[newNodesComponentId[nodeId]].emplace_back(nodeId);
         else if(!_nodesComponentId[nodeId].isNull() && newNodesComponentId[nodeId].isNull())
-            nodeIdRemoves[_nodesComponentId[nodeId]].emplace_back(nodeId);
+            changes._nodeIdRemoves[_nodesComponentId[nodeId]].emplace_back(nodeId);
     }
 
     auto maxNumEdges = std::max(_edgesComponentId.size(), newEdgesComponentId.size());
     for(EdgeId edgeId(0); edgeId < maxNumEdges; ++edgeId)
     {
         if(_edgesComponentId[edgeId].isNull() && !newEdgesComponentId[edgeId].isNull())
-            edgeIdAdds[newEdgesComponentId[edgeId]].emplace_back(edgeId);
+            changes._edgeIdAdds[newEdgesComponentId[edgeId]].emplace_back(edgeId);
         else if(!_edgesComponentId[edgeId].isNull() && newEdgesComponentId[edgeId].isNull())
-            edgeIdRemoves[_edgesComponentId[edgeId]].emplace_back(edgeId);
+            changes._edgeIdRemoves[_edgesComponentId[edgeId]].emplace_back(edgeId);
     }
 
-    // Notify all the merges
-    for(auto& mergee : mergedComponents)
+    notifyComponentsWillChange(graph, changes);
+
+    _nodesComponentId = std::move(newNodesComponentId);
+    _edgesComponentId = std::move(newEdgesComponentId);
+
+    updateGraphComponents(graph);
+}
+
+// The ids that have been signalled, without duplicates, followed by those beyond any seen before
+template<typename T> static std::vector<T> takeChangedIds(std::vector<T>& changedIds, T& firstUnseenId, T endId)
+{
+    std::vector<T> ids;
+    std::swap(ids, changedIds);
+
+    ids.erase(std::remove_if(ids.begin(), ids.end(), [&](auto id) { return id >= firstUnseenId; }), ids.end());
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    for(auto id = firstUnseenId; id < endId; ++id)
+        ids.push_back(id);
+
+    firstUnseenId = endId;
+
+    return ids;
+}
+
+void ComponentManager::updateIncrementally(const Graph* graph, ComponentChanges& changes)
+{
+    auto isTail = [graph](NodeId nodeId) { return graph->typeOf(nodeId) == MultiElementType::Tail; };
+
+    // Find what has changed since the last update; an element that has changed
+    // without being added or removed is treated as removed and re-added
+    ComponentIdSet affectedComponentIds;
+    std::vector<NodeId> addedNodeIds;
+    std::vector<NodeId> removedNodeIds;
+    std::vector<EdgeId> addedEdgeIds;
+    std::vector<EdgeId> removedEdgeIds;
+
+    for(auto nodeId : takeChangedIds(_changedNodeIds, _firstUnseenNodeId, NodeId(_nodesComponentId.size())))
     {
-        if(_debug) qDebug() << "componentsWillMerge" << mergee.second << "->" << mergee.first;
-        emit componentsWillMerge(graph, ComponentMergeSet(std::move(mergee.second), mergee.first));
+        auto oldComponentId = _nodesComponentId[nodeId];
+        bool present = graph->containsNodeId(nodeId);
+
+        if(!oldComponentId.isNull())
+        {
+            affectedComponentIds.insert(oldComponentId);
+
+            if(!present)
+                removedNodeIds.push_back(nodeId);
+        }
+
+        if(present)
+            addedNodeIds.push_back(nodeId);
     }
 
-    // Removed components
-    for(auto componentId : componentIdsToBeRemoved)
+    for(auto edgeId : takeChangedIds(_changedEdgeIds, _firstUnseenEdgeId, EdgeId(_edgesComponentId.size())))
     {
-        Q_ASSERT(!componentId.isNull());
-        if(_debug) qDebug() << "componentWillBeRemoved" << componentId;
-        bool hasMerged = u::contains(mergedComponentIds, componentId);
-        emit componentWillBeRemoved(graph, componentId, hasMerged);
+        auto oldComponentId = _edgesComponentId[edgeId];
+        bool present = graph->containsEdgeId(edgeId);
 
-        if(!hasMerged)
+        // A tail edge doesn't connect anything itself, but its head must be reconsidered
+        if(present && graph->typeOf(edgeId) == MultiElementType::Tail)
         {
-            nodeIdRemoves.erase(componentId);
-            edgeIdRemoves.erase(componentId);
+            auto sourceComponentId = _nodesComponentId[graph->edgeById(edgeId).sourceId()];
+            if(!sourceComponentId.isNull())
+                affectedComponentIds.insert(sourceComponentId);
         }
 
-        u::removeByValue(_componentIds, componentId);
-        removeGraphComponent(componentId);
+        if(!oldComponentId.isNull())
+        {
+            affectedComponentIds.insert(oldComponentId);
+
+            if(!present)
+                removedEdgeIds.push_back(edgeId);
+        }
+
+        if(present)
+            addedEdgeIds.push_back(edgeId);
     }
 
-    _nodesComponentId = std::move(newNodesComponentId);
-    _edgesComponentId = std::move(newEdgesComponentId);
+    if(affectedComponentIds.empty() && addedNodeIds.empty() && addedEdgeIds.empty())
+        return;
 
-    updateGraphComponents(graph);
+    // The nodes whose component must be (re)determined: those that are new, and those
+    // which remain in components that have changed; all other components are unaffected,
+    // so can each be treated as a single unit, represented by its first node. Every node
+    // that takes part is given a dense index, dirty nodes first, so that the work done is
+    // proportional to the size of the change, rather than the size of the graph
+    std::vector<NodeId> elementNodeIds;
 
-    _updatesRequired.clear();
+    auto addDirtyNodeId = [&](NodeId nodeId)
+    {
+        if(_nodeIndices[nodeId] < 0 && graph->containsNodeId(nodeId))
+        {
+            _nodeIndices[nodeId] = static_cast<int>(elementNodeIds.size());
+            elementNodeIds.push_back(nodeId);
+        }
+    };
 
-    std::copy(componentIdsToBeAdded.begin(), componentIdsToBeAdded.end(),
-        std::back_inserter(_componentIds));
+    for(auto nodeId : addedNodeIds)
+        addDirtyNodeId(nodeId);
 
-    std::stable_sort(_componentIds.begin(), _componentIds.end(),
-    [this](auto a, auto b)
+    for(auto componentId : affectedComponentIds)
     {
-        auto componentA = this->componentById(a);
-        auto componentB = this->componentById(b);
+        const auto* component = _componentsMap.at(componentId).get();
 
-        if(componentA->numNodes() == componentB->numNodes())
-            return a < b;
+        for(auto nodeId : component->_nodeIds)
+            addDirtyNodeId(nodeId);
 
-        return componentA->numNodes() > componentB->numNodes();
+        // The edges that remain in an affected component must be reconsidered
+        for(auto edgeId : component->_edgeIds)
+        {
+            if(graph->containsEdgeId(edgeId) && _edgesComponentId[edgeId] == componentId)
+                addedEdgeIds.push_back(edgeId);
+        }
+    }
+
+    // Multi-element tail nodes have no edges, but belong to the component of their head, so
+    // they are (re)determined along with it; whenever a node joins or leaves a multi-element,
+    // its head is signalled too, so a dirty tail's head is always dirty itself
+    for(size_t i = 0; i < elementNodeIds.size(); i++)
+    {
+        auto nodeId = elementNodeIds[i];
+        if(graph->typeOf(nodeId) != MultiElementType::Head)
+            continue;
+
+        for(auto mergedNodeId : graph->mergedNodeIdsForNodeId(nodeId))
+            addDirtyNodeId(mergedNodeId);
+    }
+
+    std::sort(addedEdgeIds.begin(), addedEdgeIds.end());
+    addedEdgeIds.erase(std::unique(addedEdgeIds.begin(), addedEdgeIds.end()), addedEdgeIds.end());
+
+    const auto numDirtyNodeIds = elementNodeIds.size();
+    std::vector<NodeId> dirtyNodeIds(elementNodeIds.begin(), elementNodeIds.end());
+
+    auto isDirty = [&](NodeId nodeId)
+    {
+        auto index = _nodeIndices[nodeId];
+        return index >= 0 && static_cast<size_t>(index) < numDirtyNodeIds;
+    };
+
+    auto elementFor = [&](NodeId nodeId)
+    {
+        if(!isDirty(nodeId))
+        {
+            nodeId = _componentsMap.at(_nodesComponentId[nodeId])->_nodeIds.front();
+
+            if(_nodeIndices[nodeId] < 0)
+            {
+                _nodeIndices[nodeId] = static_cast<int>(elementNodeIds.size());
+                elementNodeIds.push_back(nodeId);
+            }
+        }
+
+        return static_cast<size_t>(_nodeIndices[nodeId]);
+    };
+
+    std::vector<std::pair<size_t, size_t>> unions;
+    unions.reserve(addedEdgeIds.size());
+
+    for(auto edgeId : addedEdgeIds)
+    {
+        // Multi-element tail edges always connect the same nodes as their head
+        if(graph->typeOf(edgeId) == MultiElementType::Tail)
+            continue;
+
+        const auto& edge = graph->edgeById(edgeId);
+        unions.emplace_back(elementFor(edge.sourceId()), elementFor(edge.targetId()));
+    }
+
+    for(auto nodeId : dirtyNodeIds)
+    {
+        if(graph->typeOf(nodeId) != MultiElementType::Head)
+            continue;
+
+        for(auto mergedNodeId : graph->mergedNodeIdsForNodeId(nodeId))
+            unions.emplace_back(elementFor(nodeId), elementFor(mergedNodeId));
+    }
+
+    ConcurrentDisjointSets sets(elementNodeIds.size());
+
+    // Mostly relevant when the graph is first loaded, when everything is new
+    const size_t MinimumConcurrentUnions = 1U << 16U;
+    if(unions.size() >= MinimumConcurrentUnions)
+    {
+        concurrent_for(unions.begin(), unions.end(),
+        [&sets](const std::pair<size_t, size_t>& elementPair)
+        {
+            sets.unite(elementPair.first, elementPair.second);
+        });
+    }
+    else
+    {
+        for(const auto& elementPair : unions)
+            sets.unite(elementPair.first, elementPair.second);
+    }
+
+    // Gather the resultant sets, each of which is a new or changed component
+    struct Set
+    {
+        std::vector<NodeId> _dirtyNodeIds;
+        std::vector<ComponentId> _cleanComponentIds;
+        ComponentIdSet _oldComponentIds;
+
+        // The first node of the set that will be encountered in a full update, and
+        // the first such node that was previously in a component
+        NodeId _firstNodeId;
+        NodeId _firstOldNodeId;
+
+        ComponentId _componentId;
+    };
+
+    std::vector<Set> newSets;
+    std::vector<int> setIndices(elementNodeIds.size(), -1);
+
+    auto setIndexFor = [&](size_t element)
+    {
+        auto root = sets.find(element);
+        if(setIndices[root] < 0)
+        {
+            setIndices[root] = static_cast<int>(newSets.size());
+            newSets.emplace_back();
+        }
+
+        return static_cast<size_t>(setIndices[root]);
+    };
+
+    auto updateFirstNodeIds = [](Set& set, NodeId nodeId, bool previouslyAssigned)
+    {
+        if(set._firstNodeId.isNull() || nodeId < set._firstNodeId)
+            set._firstNodeId = nodeId;
+
+        if(previouslyAssigned && (set._firstOldNodeId.isNull() || nodeId < set._firstOldNodeId))
+            set._firstOldNodeId = nodeId;
+    };
+
+    std::sort(dirtyNodeIds.begin(), dirtyNodeIds.end());
+    for(auto nodeId : dirtyNodeIds)
+    {
+        auto& set = newSets.at(setIndexFor(elementFor(nodeId)));
+        auto oldComponentId = _nodesComponentId[nodeId];
+
+        set._dirtyNodeIds.push_back(nodeId);
+
+        // As in a full update, a tail doesn't take its old component with it when it joins
+        // a multi-element; if nothing else remains of that component, it's simply removed
+        if(isTail(nodeId))
+            continue;
+
+        if(!oldComponentId.isNull())
+            set._oldComponentIds.insert(oldComponentId);
+
+        updateFirstNodeIds(set, nodeId, !oldComponentId.isNull());
+    }
+
+    // The remaining elements each represent a distinct clean component
+    for(auto element = numDirtyNodeIds; element < elementNodeIds.size(); element++)
+    {
+        auto nodeId = elementNodeIds[element];
+        auto componentId = _nodesComponentId[nodeId];
+        auto& set = newSets.at(setIndexFor(element));
+
+        set._cleanComponentIds.push_back(componentId);
+        set._oldComponentIds.insert(componentId);
+        updateFirstNodeIds(set, nodeId, true);
+    }
+
+    // Assign component IDs in the same way, and in the same order, as a full update would
+    std::vector<Set*> orderedSets;
+    orderedSets.reserve(newSets.size());
+    for(auto& set : newSets)
+        orderedSets.push_back(&set);
+
+    std::sort(orderedSets.begin(), orderedSets.end(), [](const auto* a, const auto* b)
+    {
+        // Sets that contain previously assigned nodes come first
+        if(a->_firstOldNodeId.isNull() != b->_firstOldNodeId.isNull())
+            return !a->_firstOldNodeId.isNull();
+
+        if(!a->_firstOldNodeId.isNull())
+            return a->_firstOldNodeId < b->_firstOldNodeId;
+
+        return a->_firstNodeId < b->_firstNodeId;
     });
 
-    lock.unlock();
+    ComponentIdSet componentIds;
+
+    for(auto* set : orderedSets)
+    {
+        if(set->_firstNodeId.isNull())
+            continue;
+
+        if(set->_firstOldNodeId.isNull())
+        {
+            // Entirely new component
+            set->_componentId = generateComponentId();
+            componentIds.insert(set->_componentId);
+            changes._componentIdsToBeAdded.push_back(set->_componentId);
+            queueGraphComponentUpdate(graph, set->_componentId);
+            continue;
+        }
+
+        auto oldComponentId = _nodesComponentId[set->_firstOldNodeId];
+
+        if(u::contains(componentIds, oldComponentId))
+        {
+            // We have already used this ID so this is a component that has split
+            set->_componentId = generateComponentId();
+            componentIds.insert(set->_componentId);
+            changes._componentIdsToBeAdded.push_back(set->_componentId);
+
+            queueGraphComponentUpdate(graph, oldComponentId);
+            queueGraphComponentUpdate(graph, set->_componentId);
+
+            changes._splitComponents[oldComponentId].insert(oldComponentId);
+            changes._splitComponents[oldComponentId].insert(set->_componentId);
+            changes._splitComponentIds.insert(set->_componentId);
+        }
+        else
+        {
+            set->_componentId = oldComponentId;
+            componentIds.insert(oldComponentId);
+            queueGraphComponentUpdate(graph, oldComponentId);
+
+            if(set->_oldComponentIds.size() > 1)
+            {
+                // More than one old component IDs were observed so components have merged
+                changes._mergedComponents[oldComponentId] = set->_oldComponentIds;
+                auto mergerIds = set->_oldComponentIds;
+                mergerIds.erase(oldComponentId);
+                changes._mergedComponentIds.insert(mergerIds.begin(), mergerIds.end());
+            }
+        }
+    }
+
+    // Resize the component arrays
+    for(auto* componentArray : _componentArrays)
+        componentArray->resize(componentArrayCapacity());
+
+    // Components that were involved in the update, but whose IDs are no longer in use
+    ComponentIdSet involvedComponentIds = affectedComponentIds;
+    for(const auto& set : newSets)
+        involvedComponentIds.insert(set._oldComponentIds.begin(), set._oldComponentIds.end());
+
+    bool anyRemoved = std::any_of(involvedComponentIds.begin(), involvedComponentIds.end(),
+        [&componentIds](auto componentId) { return !u::contains(componentIds, componentId); });
+
+    // Removed IDs are vacated for reuse in the order they're removed, so this must match a full update
+    if(anyRemoved)
+    {
+        for(auto componentId : _componentIds)
+        {
+            if(u::contains(involvedComponentIds, componentId) && !u::contains(componentIds, componentId))
+                changes._componentIdsToBeRemoved.push_back(componentId);
+        }
+    }
+
+    std::sort(changes._componentIdsToBeAdded.begin(), changes._componentIdsToBeAdded.end());
+
+    // Determine the new contents of each set's component
+    struct Contents
+    {
+        std::vector<NodeId> _nodeIds;
+        std::vector<EdgeId> _edgeIds;
+    };
+
+    std::vector<Contents> newContents(newSets.size());
+
+    for(size_t i = 0; i < newSets.size(); i++)
+    {
+        const auto& set = newSets[i];
+        auto& contents = newContents[i];
+
+        if(set._componentId.isNull())
+            continue;
+
+        for(auto nodeId : set._dirtyNodeIds)
+        {
+            if(!isTail(nodeId))
+                contents._nodeIds.push_back(nodeId);
+
+            for(auto edgeId : graph->edgeIdsForNodeId(nodeId))
+            {
+                if(graph->typeOf(edgeId) != MultiElementType::Tail)
+                    contents._edgeIds.push_back(edgeId);
+            }
+        }
+
+        for(auto componentId : set._cleanComponentIds)
+        {
+            const auto* component = _componentsMap.at(componentId).get();
+            contents._nodeIds.insert(contents._nodeIds.end(),
+                component->_nodeIds.begin(), component->_nodeIds.end());
+            contents._edgeIds.insert(contents._edgeIds.end(),
+                component->_edgeIds.begin(), component->_edgeIds.end());
+        }
+    }
 
+    // Edges between clean components aren't incident to any dirty node
+    for(auto edgeId : addedEdgeIds)
+    {
+        if(graph->typeOf(edgeId) == MultiElementType::Tail)
+            continue;
+
+        auto nodeId = graph->edgeById(edgeId).sourceId();
+        if(!isDirty(nodeId))
+            newContents[setIndexFor(elementFor(nodeId))]._edgeIds.push_back(edgeId);
+    }
+
+    for(auto& contents : newContents)
+    {
+        std::sort(contents._nodeIds.begin(), contents._nodeIds.end());
+        std::sort(contents._edgeIds.begin(), contents._edgeIds.end());
+        contents._edgeIds.erase(std::unique(contents._edgeIds.begin(), contents._edgeIds.end()),
+            contents._edgeIds.end());
+    }
+
+    // The dense indices are no longer needed
+    for(auto nodeId : elementNodeIds)
+        _nodeIndices[nodeId] = -1;
+
+    // Find nodes and edges that have been added or removed
+    for(const auto& set : newSets)
+    {
+        for(auto nodeId : set._dirtyNodeIds)
+        {
+            if(_nodesComponentId[nodeId].isNull() && !set._componentId.isNull())
+                changes._nodeIdAdds[set._componentId].emplace_back(nodeId);
+            else if(!_nodesComponentId[nodeId].isNull() && set._componentId.isNull())
+                changes._nodeIdRemoves[_nodesComponentId[nodeId]].emplace_back(nodeId);
+        }
+    }
+
+    for(auto nodeId : removedNodeIds)
+        changes._nodeIdRemoves[_nodesComponentId[nodeId]].emplace_back(nodeId);
+
+    for(size_t i = 0; i < newSets.size(); i++)
+    {
+        if(newSets[i]._componentId.isNull())
+            continue;
+
+        for(auto edgeId : newContents[i]._edgeIds)
+        {
+            for(auto mergedEdgeId : graph->mergedEdgeIdsForEdgeId(edgeId))
+            {
+                if(_edgesComponentId[mergedEdgeId].isNull())
+                    changes._edgeIdAdds[newSets[i]._componentId].emplace_back(mergedEdgeId);
+            }
+        }
+    }
+
+    for(auto edgeId : removedEdgeIds)
+        changes._edgeIdRemoves[_edgesComponentId[edgeId]].emplace_back(edgeId);
+
+    for(auto* idsMap : {&changes._nodeIdAdds, &changes._nodeIdRemoves})
+    {
+        for(auto& ids : *idsMap)
+            std::sort(ids.second.begin(), ids.second.end());
+    }
+
+    for(auto* idsMap : {&changes._edgeIdAdds, &changes._edgeIdRemoves})
+    {
+        for(auto& ids : *idsMap)
+            std::sort(ids.second.begin(), ids.second.end());
+    }
+
+    notifyComponentsWillChange(graph, changes);
+
+    // Commit the changes
+    for(auto nodeId : removedNodeIds)
+        _nodesComponentId[nodeId] = {};
+
+    for(auto edgeId : removedEdgeIds)
+        _edgesComponentId[edgeId] = {};
+
+    for(size_t i = 0; i < newSets.size(); i++)
+    {
+        const auto& set = newSets[i];
+        auto& contents = newContents[i];
+
+        for(auto nodeId : set._dirtyNodeIds)
+            _nodesComponentId[nodeId] = set._componentId;
+
+        if(set._componentId.isNull())
+            continue;
+
+        // Any clean components that have merged are relabelled here too
+        for(auto nodeId : contents._nodeIds)
+        {
+            for(auto mergedNodeId : graph->mergedNodeIdsForNodeId(nodeId))
+                _nodesComponentId[mergedNodeId] = set._componentId;
+        }
+
+        for(auto edgeId : contents._edgeIds)
+        {
+            for(auto mergedEdgeId : graph->mergedEdgeIdsForEdgeId(edgeId))
+                _edgesComponentId[mergedEdgeId] = set._componentId;
+        }
+
+        auto& component = _componentsMap.at(set._componentId);
+        component->_nodeIds = std::move(contents._nodeIds);
+        component->_edgeIds = std::move(contents._edgeIds);
+    }
+}
+
+void ComponentManager::notifyComponentsWillChange(const Graph* graph, ComponentChanges& changes)
+{
+    // Notify all the merges
+    for(auto& mergee : changes._mergedComponents)
+    {
+        if(_debug) qDebug() << "componentsWillMerge" << mergee.second << "->" << mergee.first;
+        emit componentsWillMerge(graph, ComponentMergeSet(std::move(mergee.second), mergee.first));
+    }
+
+    // Removed components
+    for(auto componentId : changes._componentIdsToBeRemoved)
+    {
+        Q_ASSERT(!componentId.isNull());
+        if(_debug) qDebug() << "componentWillBeRemoved" << componentId;
+        bool hasMerged = u::contains(changes._mergedComponentIds, componentId);
+        emit componentWillBeRemoved(graph, componentId, hasMerged);
+
+        if(!hasMerged)
+        {
+            changes._nodeIdRemoves.erase(componentId);
+            changes._edgeIdRemoves.erase(componentId);
+        }
+
+        u::removeByValue(_componentIds, componentId);
+        removeGraphComponent(componentId);
+    }
+}
+
+void ComponentManager::notifyComponentsChanged(const Graph* graph, ComponentChanges& changes)
+{
     // Notify all the new components
-    for(auto componentId : componentIdsToBeAdded)
+    for(auto componentId : changes._componentIdsToBeAdded)
     {
         Q_ASSERT(!componentId.isNull());
         if(_debug) qDebug() << "componentAdded" << componentId;
-        bool hasSplit = u::contains(splitComponentIds, componentId);
+        bool hasSplit = u::contains(changes._splitComponentIds, componentId);
         emit componentAdded(graph, componentId, hasSplit);
 
         if(!hasSplit)
         {
-            nodeIdAdds.erase(componentId);
-            edgeIdAdds.erase(componentId);
+            changes._nodeIdAdds.erase(componentId);
+            changes._edgeIdAdds.erase(componentId);
         }
     }
 
     // Notify all the splits
-    for(auto& splitee : splitComponents)
+    for(auto& splitee : changes._splitComponents)
     {
         if(_debug) qDebug() << "componentSplit" << splitee.first << "->" << splitee.second;
         emit componentSplit(graph, ComponentSplitSet(splitee.first, std::move(splitee.second)));
     }
 
     // Notify node adds and removes
-    for(auto& nodeIdAdd : nodeIdAdds)
+    for(auto& nodeIdAdd : changes._nodeIdAdds)
     {
         for(auto nodeId : nodeIdAdd.second)
             emit nodeAddedToComponent(graph, nodeId, nodeIdAdd.first);
     }
 
-    for(auto& edgeIdAdd : edgeIdAdds)
+    for(auto& edgeIdAdd : changes._edgeIdAdds)
     {
         for(auto edgeId : edgeIdAdd.second)
             emit edgeAddedToComponent(graph, edgeId, edgeIdAdd.first);
     }
 
-    for(auto& nodeIdRemove : nodeIdRemoves)
+    for(auto& nodeIdRemove : changes._nodeIdRemoves)
     {
         for(auto nodeId : nodeIdRemove.second)
             emit nodeRemovedFromComponent(graph, nodeId, nodeIdRemove.first);
     }
 
-    for(auto& edgeIdRemove : edgeIdRemoves)
+    for(auto& edgeIdRemove : changes._edgeIdRemoves)
     {
         for(auto edgeId : edgeIdRemove.second)
             emit edgeRemovedFromComponent(graph, edgeId, edgeIdRemove.first);
     }
-
-    if(_debug) qDebug() << "ComponentManager::update ends" << this;
 }
 
 ComponentId ComponentManager::generateComponentId()
@@ -22,6 +22,7 @@
 #include "shared/graph/grapharray.h"
 
 #include "graphfilter.h"
+#include "graph.h"
 
 #include <map>
 #include <queue>
@@ -34,7 +35,6 @@
 #include <QObject>
 #include <QtGlobal>
 
-class Graph;
 class GraphComponent;
 
 class ComponentSplitSet
@@ -87,6 +87,23 @@ public:
     ~ComponentManager() override;
 
 private:
+    // Everything that an update needs to notify
+    struct ComponentChanges
+    {
+        std::map<ComponentId, ComponentIdSet> _splitComponents;
+        ComponentIdSet _splitComponentIds;
+        std::map<ComponentId, ComponentIdSet> _mergedComponents;
+        ComponentIdSet _mergedComponentIds;
+
+        std::vector<ComponentId> _componentIdsToBeAdded;
+        std::vector<ComponentId> _componentIdsToBeRemoved;
+
+        std::map<ComponentId, std::vector<NodeId>> _nodeIdAdds;
+        std::map<ComponentId, std::vector<EdgeId>> _edgeIdAdds;
+        std::map<ComponentId, std::vector<NodeId>> _nodeIdRemoves;
+        std::map<ComponentId, std::vector<EdgeId>> _edgeIdRemoves;
+    };
+
     std::vector<ComponentId> _componentIds;
     ComponentId _nextComponentId;
     std::queue<ComponentId> _vacatedComponentIdQueue;
@@ -95,6 +112,21 @@ private:
     NodeArray<ComponentId> _nodesComponentId;
     EdgeArray<ComponentId> _edgesComponentId;
 
+    // Without any user supplied filters, the only elements that are filtered are
+    // multi-element tails, so changes can be determined without a full traversal
+    bool _incremental = false;
+
+    // The elements that have been signalled as added, removed or changed since the last
+    // update; elements added in bulk aren't signalled, but their ids are always beyond
+    // those seen by the last update, so they are found from where the ids ended
+    std::vector<NodeId> _changedNodeIds;
+    std::vector<EdgeId> _changedEdgeIds;
+    NodeId _firstUnseenNodeId = 0;
+    EdgeId _firstUnseenEdgeId = 0;
+
+    // Scratch space for updates, so that they don't need to allocate per node
+    NodeArray<int> _nodeIndices;
+
     mutable std::recursive_mutex _updateMutex;
 
     std::mutex _componentArraysMutex;
@@ -109,6 +141,10 @@ private:
     void removeGraphComponent(ComponentId componentId);
 
     void update(const Graph* graph);
+    void updateFully(const Graph* graph, ComponentChanges& changes);
+    void updateIncrementally(const Graph* graph, ComponentChanges& changes);
+    void notifyComponentsWillChange(const Graph* graph, ComponentChanges& changes);
+    void notifyComponentsChanged(const Graph* graph, ComponentChanges& changes);
     int componentArrayCapacity() const { return static_cast<int>(_nextComponentId); }
     ComponentIdSet assignConnectedElementsComponentId(const Graph* graph, NodeId rootId, ComponentId componentId,
                                                       NodeArray<ComponentId>& nodesComponentId,
@@ -0,0 +1,211 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef CONNECTIONINDEX_H
+#define CONNECTIONINDEX_H
+
+#include "shared/graph/elementid.h"
+
+#include <QtGlobal>
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+// Maps each unordered pair of nodes to the head of the set of edges that connect them;
+// an open addressing hash table with linear probing, keyed on the packed pair of NodeIds
+class ConnectionIndex
+{
+public:
+    using Key = uint64_t;
+
+    static Key keyFor(NodeId nodeIdA, NodeId nodeIdB)
+    {
+        auto a = static_cast<uint32_t>(static_cast<int>(nodeIdA));
+        auto b = static_cast<uint32_t>(static_cast<int>(nodeIdB));
+        auto [lo, hi] = std::minmax(a, b);
+
+        return (static_cast<Key>(lo) << 32) | hi;
+    }
+
+private:
+    // NodeIds are never negative, so no pair of them packs to this
+    static constexpr Key EmptyKey = ~Key{0};
+    static constexpr size_t MinimumCapacity = 16;
+
+    struct Slot
+    {
+        std::atomic<Key> _key{EmptyKey};
+        EdgeId _head;
+
+        Slot() = default;
+        Slot(const Slot& other) : _key(other.key()), _head(other._head) {}
+
+        Slot& operator=(const Slot& other)
+        {
+            _key.store(other.key(), std::memory_order_relaxed);
+            _head = other._head;
+            return *this;
+        }
+
+        Key key() const { return _key.load(std::memory_order_relaxed); }
+    };
+
+    std::vector<Slot> _slots;
+    std::atomic<size_t> _size{0};
+
+    size_t mask() const { return _slots.size() - 1; }
+
+    static size_t hash(Key key)
+    {
+        // The splitmix64 finaliser; pairs of small sequential ids need thorough mixing
+        key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+        return static_cast<size_t>(key ^ (key >> 31));
+    }
+
+    // The slot containing key, or if it's not present, the empty slot that ends its probe
+    size_t probe(Key key) const
+    {
+        auto i = hash(key) & mask();
+        for(auto k = _slots[i].key(); k != key && k != EmptyKey; k = _slots[i].key())
+            i = (i + 1) & mask();
+
+        return i;
+    }
+
+    void rehash(size_t capacity)
+    {
+        std::vector<Slot> oldSlots(capacity);
+        std::swap(_slots, oldSlots);
+
+        for(const auto& slot : oldSlots)
+        {
+            if(slot.key() != EmptyKey)
+                _slots[probe(slot.key())] = slot;
+        }
+    }
+
+public:
+    ConnectionIndex() = default;
+    ConnectionIndex(const ConnectionIndex& other) :
+        _slots(other._slots), _size(other.size())
+    {}
+
+    ConnectionIndex& operator=(const ConnectionIndex& other)
+    {
+        if(&other == this)
+            return *this;
+
+        _slots = other._slots;
+        _size = other.size();
+
+        return *this;
+    }
+
+    size_t size() const { return _size.load(std::memory_order_relaxed); }
+
+    void clear()
+    {
+        _slots.clear();
+        _size = 0;
+    }
+
+    // Ensures that n more keys can be inserted without the table growing; this
+    // must be called before insert, and so before any concurrent insertions
+    void reserve(size_t n)
+    {
+        // Keep the load factor at most ½, so that probes stay short
+        auto required = (size() + n) * 2;
+        if(required <= _slots.size())
+            return;
+
+        auto capacity = std::max(MinimumCapacity, _slots.size());
+        while(capacity < required)
+            capacity *= 2;
+
+        rehash(capacity);
+    }
+
+    EdgeId find(Key key) const
+    {
+        if(_slots.empty())
+            return {};
+
+        const auto& slot = _slots[probe(key)];
+        return slot.key() == key ? slot._head : EdgeId();
+    }
+
+    // Returns the slot of key, first inserting it with a null head if it's not present;
+    // this may be called concurrently, provided no heads are accessed in the meantime
+    size_t insert(Key key)
+    {
+        Q_ASSERT(size() < _slots.size());
+
+        auto i = hash(key) & mask();
+        while(true)
+        {
+            auto k = _slots[i].key();
+            if(k == EmptyKey && _slots[i]._key.compare_exchange_strong(k, key))
+            {
+                _size.fetch_add(1, std::memory_order_relaxed);
+                return i;
+            }
+
+            // If the exchange failed, k is now whatever beat us to the slot
+            if(k == key)
+                return i;
+
+            i = (i + 1) & mask();
+        }
+    }
+
+    EdgeId& head(size_t slot) { return _slots[slot]._head; }
+
+    void erase(Key key)
+    {
+        if(_slots.empty())
+            return;
+
+        auto i = probe(key);
+        if(_slots[i].key() != key)
+            return;
+
+        // Shift back any subsequent entries in the cluster that would otherwise
+        // become unreachable, so that no tombstones are required
+        for(auto j = (i + 1) & mask(); _slots[j].key() != EmptyKey; j = (j + 1) & mask())
+        {
+            auto home = hash(_slots[j].key()) & mask();
+            bool reachable = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+
+            if(!reachable)
+            {
+                _slots[i] = _slots[j];
+                i = j;
+            }
+        }
+
+        _slots[i] = Slot();
+        _size.fetch_sub(1, std::memory_order_relaxed);
+    }
+};
+
+#endif // CONNECTIONINDEX_H
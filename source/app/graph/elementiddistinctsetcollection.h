@@ -295,6 +295,56 @@ public:
         return setId;
     }
 
+    // Links the elements of the set setId in other into this collection, in the same order, except
+    // those for which excluded returns true; the result is the same as removing them, so a set
+    // can be rebuilt in time proportional to its size, instead of the number of removals
+    template<typename Fn> SetId copyFrom(const ElementIdDistinctSetCollection& other, SetId setId, const Fn& excluded)
+    {
+        SetId headId;
+        T tailId;
+
+        for(auto elementId = setId; !elementId.isNull();)
+        {
+            const auto& otherListNode = other.listNodeFor(elementId);
+            auto nextElementId = otherListNode.hasNext(elementId) ? otherListNode._next : T();
+
+            if(!excluded(elementId))
+            {
+                auto& listNode = listNodeFor(elementId);
+
+                if(headId.isNull())
+                {
+                    listNode.setToSingleton(elementId);
+                    headId = elementId;
+                }
+                else
+                {
+                    // Adding to the tail
+                    auto& headListNode = listNodeFor(headId);
+                    auto& tailListNode = listNodeFor(tailId);
+
+                    if(headId == tailId)
+                        headListNode._prev.setToNull();
+                    else
+                        tailListNode._opposite.setToNull();
+
+                    tailListNode._next = elementId;
+                    headListNode._opposite = elementId;
+
+                    listNode._prev = tailId;
+                    listNode._next = elementId;
+                    listNode._opposite = headId;
+                }
+
+                tailId = elementId;
+            }
+
+            elementId = nextElementId;
+        }
+
+        return headId;
+    }
+
     MultiElementType typeOf(T elementId) const
     {
         assert(!elementId.isNull());
@@ -370,6 +420,23 @@ public:
             _size--;
     }
 
+    // Relinks the set into its collection, from the collection from that it was previously
+    // linked in, without the elements for which excluded returns true
+    template<typename Fn> void rebuild(const std::remove_const_t<C>& from, const Fn& excluded)
+    {
+        int size = 0;
+        _head = _collection->copyFrom(from, _head, [&](T elementId)
+        {
+            if(excluded(elementId))
+                return true;
+
+            size++;
+            return false;
+        });
+
+        _size = size;
+    }
+
     class iterator_base
     {
     public:
@@ -18,6 +18,7 @@
 
 #include "graph.h"
 #include "graphcomponent.h"
+#include "adjacencysnapshot.h"
 
 #include "elementiddistinctsetcollection_debug.h"
 #include "shared/graph/igrapharray.h"
@@ -275,10 +276,18 @@ void Graph::reserveEdgeId(EdgeId edgeId)
         edgeArray->resize(static_cast<int>(_nextEdgeId));
 }
 
+void Graph::invalidateAdjacencySnapshot()
+{
+    std::unique_lock<std::mutex> lock(_adjacencySnapshotMutex);
+    _adjacencySnapshot.reset();
+}
+
 void Graph::clear()
 {
     _nextNodeId = 0;
     _nextEdgeId = 0;
+
+    invalidateAdjacencySnapshot();
 }
 
 const std::vector<ComponentId>& Graph::componentIds() const
@@ -399,6 +408,16 @@ std::vector<NodeId> Graph::neighboursOf(NodeId nodeId) const
     return nodeIds;
 }
 
+std::shared_ptr<const AdjacencySnapshot> Graph::adjacencySnapshot()
+{
+    std::unique_lock<std::mutex> lock(_adjacencySnapshotMutex);
+
+    if(_adjacencySnapshot == nullptr)
+        _adjacencySnapshot = std::make_shared<const AdjacencySnapshot>(*this);
+
+    return _adjacencySnapshot;
+}
+
 void Graph::setPhase(const QString& phase) const
 {
     std::unique_lock<std::recursive_mutex> lock(_phaseMutex);
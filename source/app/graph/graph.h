@@ -34,6 +34,7 @@
 #include <algorithm>
 
 class GraphComponent;
+class AdjacencySnapshot;
 class ComponentManager;
 class ComponentSplitSet;
 class ComponentMergeSet;
@@ -235,6 +236,11 @@ public:
     std::vector<NodeId> targetsOf(NodeId nodeId) const override;
     std::vector<NodeId> neighboursOf(NodeId nodeId) const override;
 
+    // A read only CSR copy of the adjacency, for traversals that would otherwise
+    // make many calls to the above; it is built on first use, and shared until
+    // the graph next changes, at which point existing copies remain valid but stale
+    virtual std::shared_ptr<const AdjacencySnapshot> adjacencySnapshot();
+
     // Call this to ensure the Graph is in a consistent state
     // Usually it is called automatically and is generally only
     // necessary when accessing the Graph before changes have
@@ -266,6 +272,9 @@ private:
 
     std::unique_ptr<ComponentManager> _componentManager;
 
+    std::mutex _adjacencySnapshotMutex;
+    std::shared_ptr<const AdjacencySnapshot> _adjacencySnapshot;
+
     mutable std::recursive_mutex _phaseMutex;
     mutable QString _phase;
     mutable QString _subPhase;
@@ -293,6 +302,8 @@ protected:
     EdgeId largestEdgeId() const { return nextEdgeId() - 1; }
     virtual void reserveEdgeId(EdgeId edgeId);
 
+    void invalidateAdjacencySnapshot();
+
     void clear();
 
 signals:
@@ -304,6 +315,15 @@ signals:
     void edgeAdded(const Graph*, EdgeId) const;
     void edgeRemoved(const Graph*, EdgeId) const;
 
+    // Bulk removals signal all of their elements at once, instead of using the above
+    void nodesRemoved(const Graph*, const std::vector<NodeId>&) const;
+    void edgesRemoved(const Graph*, const std::vector<EdgeId>&) const;
+
+    // For elements that remain in the graph, but whose connectivity may have changed;
+    // edges that have moved, and elements that have joined or left a multi-element
+    void nodeChanged(const Graph*, NodeId) const;
+    void edgeChanged(const Graph*, EdgeId) const;
+
     void componentsWillMerge(const Graph*, const ComponentMergeSet&) const;
     void componentWillBeRemoved(const Graph*, ComponentId, bool) const;
     void componentAdded(const Graph*, ComponentId, bool) const;
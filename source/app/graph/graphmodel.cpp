@@ -842,6 +842,22 @@ static void findSharedAttributeValues(const Graph* graph,
     }
 }
 
+// Allow the values of node and edge attributes to be snapshotted, so that, until the graph
+// next changes, reading them doesn't involve calling their value functions; the snapshots
+// are only taken when first needed, so attributes that are never read in bulk cost nothing
+static void materialiseAttributes(const Graph* graph,
+    std::map<QString, Attribute>& attributes)
+{
+    for(auto& attribute : make_value_wrapper(attributes))
+        attribute.setMaterialisable(*graph);
+}
+
+static void dematerialiseAttributes(std::map<QString, Attribute>& attributes)
+{
+    for(auto& attribute : make_value_wrapper(attributes))
+        attribute.dematerialise();
+}
+
 void GraphModel::initialiseUniqueAttributeValues()
 {
     findSharedAttributeValues(&graph(), _->_attributes);
@@ -1034,6 +1050,7 @@ void GraphModel::onPreferenceChanged(const QString& name, const QVariant&)
 
 void GraphModel::onMutableGraphChanged(const Graph* graph)
 {
+    dematerialiseAttributes(_->_attributes);
     calculateAttributeRanges(graph, _->_attributes);
 }
 
@@ -1047,6 +1064,9 @@ void GraphModel::onTransformedGraphWillChange(const Graph*)
 
     removeDynamicAttributes();
 
+    // Values may change while the transforms are applied
+    dematerialiseAttributes(_->_attributes);
+
     _transformedGraphIsChanging = true;
 }
 
@@ -1054,6 +1074,7 @@ void GraphModel::onTransformedGraphChanged(const Graph* graph)
 {
     _transformedGraphIsChanging = false;
 
+    materialiseAttributes(graph, _->_attributes);
     findSharedAttributeValues(graph, _->_attributes);
 
     // Compare with previous Dynamic attributes
@@ -26,6 +26,7 @@
 #include "shared/utils/preferenceswatcher.h"
 
 #include "attributes/attribute.h"
+#include "attributes/iattributeprovider.h"
 
 #include <QString>
 #include <QStringList>
@@ -54,7 +55,7 @@ class VisualisationInfo;
 
 class GraphTransformFactory;
 
-class GraphModel : public QObject, public IGraphModel
+class GraphModel : public QObject, public IGraphModel, public IAttributeProvider
 {
     Q_OBJECT
 public:
@@ -146,7 +147,7 @@ public:
     const Attribute* attributeByName(const QString& name) const override;
     bool attributeExists(const QString& name) const override;
     bool attributeIsValid(const QString& name) const;
-    Attribute attributeValueByName(const QString& name) const;
+    Attribute attributeValueByName(const QString& name) const override;
 
     void initialiseAttributeRanges();
     void initialiseUniqueAttributeValues();
@@ -22,6 +22,7 @@
 #include "componentmanager.h"
 
 #include "shared/utils/container.h"
+#include "shared/utils/threadpool.h"
 
 MutableGraph::MutableGraph(const MutableGraph& other)
 {
@@ -37,6 +38,7 @@ MutableGraph::~MutableGraph()
 void MutableGraph::clear()
 {
     beginTransaction();
+    _recordedRemovals.reset();
 
     bool changed = numNodes() > 0;
 
@@ -98,10 +100,10 @@ std::vector<EdgeId> MutableGraph::edgeIdsBetween(NodeId nodeIdA, NodeId nodeIdB)
 {
     std::vector<EdgeId> edgeIds;
 
-    auto undirectedEdge = UndirectedEdge(nodeIdA, nodeIdB);
-    if(u::contains(_e._connections, undirectedEdge))
+    auto headEdgeId = firstEdgeIdBetween(nodeIdA, nodeIdB);
+    if(!headEdgeId.isNull())
     {
-        const auto& edgeIdDistinctSet = _e._connections.at(undirectedEdge);
+        const auto edgeIdDistinctSet = mergedEdgeIdsForEdgeId(headEdgeId);
         std::copy(edgeIdDistinctSet.begin(), edgeIdDistinctSet.end(), std::back_inserter(edgeIds));
     }
 
@@ -110,21 +112,7 @@ std::vector<EdgeId> MutableGraph::edgeIdsBetween(NodeId nodeIdA, NodeId nodeIdB)
 
 EdgeId MutableGraph::firstEdgeIdBetween(NodeId nodeIdA, NodeId nodeIdB) const
 {
-    const auto& nodeA = nodeById(nodeIdA);
-
-    for(auto edgeId : nodeA._outEdgeIds)
-    {
-        if(edgeById(edgeId).targetId() == nodeIdB)
-            return edgeId;
-    }
-
-    for(auto edgeId : nodeA._inEdgeIds)
-    {
-        if(edgeById(edgeId).sourceId() == nodeIdB)
-            return edgeId;
-    }
-
-    return {};
+    return _e._connections.find(ConnectionIndex::keyFor(nodeIdA, nodeIdB));
 }
 
 bool MutableGraph::edgeExistsBetween(NodeId nodeIdA, NodeId nodeIdB) const
@@ -213,6 +201,8 @@ NodeId MutableGraph::addNode(NodeId nodeId)
     }
 
     claimNodeId(nodeId);
+    _recordedRemovals.reset();
+
     auto& node = nodeBy(nodeId);
     node._id = nodeId;
     node._inEdgeIds.setCollection(&_e._inEdgeIdsCollection);
@@ -244,12 +234,20 @@ void MutableGraph::removeNode(NodeId nodeId)
     for(auto edgeId : outEdgeIdsForNodeId(nodeId).copy())
         removeEdge(edgeId);
 
-    _n._mergedNodeIds.remove({}, nodeId);
+    bool wasHead = typeOf(nodeId) == MultiElementType::Head;
+    auto headNodeId = _n._mergedNodeIds.remove({}, nodeId);
 
     releaseNodeId(nodeId);
     _unusedNodeIds.push_back(nodeId);
 
+    if(_recordedRemovals != nullptr)
+        _recordedRemovals->_nodeIds.push_back(nodeId);
+
     emit nodeRemoved(this, nodeId);
+
+    // The next node of a multi-node takes the place of its head
+    if(wasHead && !headNodeId.isNull())
+        emit nodeChanged(this, headNodeId);
     _updateRequired = true;
     endTransaction();
 }
@@ -339,14 +337,98 @@ void MutableGraph::reserveEdgeId(EdgeId edgeId)
         _unusedEdgeIds.push_back(unusedEdgeId++);
 }
 
+void MutableGraph::indexEdge(EdgeId edgeId)
+{
+    const auto& edge = edgeBy(edgeId);
+    auto& connections = _e._connections;
+
+    connections.reserve(1);
+    auto& headEdgeId = connections.head(connections.insert(
+        ConnectionIndex::keyFor(edge.sourceId(), edge.targetId())));
+    auto previousHeadEdgeId = headEdgeId;
+    headEdgeId = _e._mergedEdgeIds.add(headEdgeId, edgeId);
+
+    // The previous head of a multi-edge may have become a tail
+    if(!previousHeadEdgeId.isNull() && headEdgeId != previousHeadEdgeId)
+        emit edgeChanged(this, previousHeadEdgeId);
+}
+
+void MutableGraph::indexEdges(EdgeId firstEdgeId, EdgeId lastEdgeId)
+{
+    auto numEdges = static_cast<size_t>(static_cast<int>(lastEdgeId) - static_cast<int>(firstEdgeId) + 1);
+    const size_t MinimumConcurrentEdges = 1u << 16;
+
+    if(numEdges < MinimumConcurrentEdges)
+    {
+        for(auto edgeId = firstEdgeId; edgeId <= lastEdgeId; ++edgeId)
+            indexEdge(edgeId);
+
+        return;
+    }
+
+    auto& connections = _e._connections;
+    connections.reserve(numEdges);
+
+    // Finding the slots is the bulk of the work, and can be done concurrently...
+    std::vector<size_t> slotIndices(numEdges);
+    concurrent_for(slotIndices.begin(), slotIndices.end(),
+    [&](std::vector<size_t>::iterator it)
+    {
+        auto index = static_cast<size_t>(std::distance(slotIndices.begin(), it));
+        const auto& edge = edgeBy(firstEdgeId + static_cast<int>(index));
+        *it = connections.insert(ConnectionIndex::keyFor(edge.sourceId(), edge.targetId()));
+    });
+
+    // ...whereas parallel edges must be linked together sequentially
+    for(size_t i = 0; i < numEdges; i++)
+    {
+        auto& headEdgeId = connections.head(slotIndices[i]);
+        auto previousHeadEdgeId = headEdgeId;
+        headEdgeId = _e._mergedEdgeIds.add(headEdgeId, firstEdgeId + static_cast<int>(i));
+
+        if(!previousHeadEdgeId.isNull() && headEdgeId != previousHeadEdgeId)
+            emit edgeChanged(this, previousHeadEdgeId);
+    }
+}
+
+// Returns the edge that has replaced edgeId as the head of its multi-edge, if any
+EdgeId MutableGraph::unindexEdge(EdgeId edgeId)
+{
+    const auto& edge = edgeBy(edgeId);
+
+    auto key = ConnectionIndex::keyFor(edge.sourceId(), edge.targetId());
+    auto previousHeadEdgeId = _e._connections.find(key);
+    Q_ASSERT(!previousHeadEdgeId.isNull());
+    auto headEdgeId = _e._mergedEdgeIds.remove(previousHeadEdgeId, edgeId);
+
+    if(headEdgeId.isNull())
+    {
+        _e._connections.erase(key);
+        return {};
+    }
+
+    _e._connections.head(_e._connections.insert(key)) = headEdgeId;
+    return previousHeadEdgeId == edgeId ? headEdgeId : EdgeId();
+}
+
 NodeId MutableGraph::mergeNodes(NodeId nodeIdA, NodeId nodeIdB)
 {
-    return _n._mergedNodeIds.add(nodeIdA, nodeIdB);
+    auto setId = _n._mergedNodeIds.add(nodeIdA, nodeIdB);
+
+    emit nodeChanged(this, nodeIdA);
+    emit nodeChanged(this, nodeIdB);
+
+    return setId;
 }
 
 EdgeId MutableGraph::mergeEdges(EdgeId edgeIdA, EdgeId edgeIdB)
 {
-    return _e._mergedEdgeIds.add(edgeIdA, edgeIdB);
+    auto setId = _e._mergedEdgeIds.add(edgeIdA, edgeIdB);
+
+    emit edgeChanged(this, edgeIdA);
+    emit edgeChanged(this, edgeIdB);
+
+    return setId;
 }
 
 NodeId MutableGraph::mergeNodes(const std::vector<NodeId>& nodeIds)
@@ -356,6 +438,9 @@ NodeId MutableGraph::mergeNodes(const std::vector<NodeId>& nodeIds)
     for(auto nodeId : nodeIds)
         _n._mergedNodeIds.add(setId, nodeId);
 
+    for(auto nodeId : nodeIds)
+        emit nodeChanged(this, nodeId);
+
     return setId;
 }
 
@@ -366,6 +451,9 @@ EdgeId MutableGraph::mergeEdges(const std::vector<EdgeId>& edgeIds)
     for(auto edgeId : edgeIds)
         _e._mergedEdgeIds.add(setId, edgeId);
 
+    for(auto edgeId : edgeIds)
+        emit edgeChanged(this, edgeId);
+
     return setId;
 }
 
@@ -385,6 +473,8 @@ EdgeId MutableGraph::addEdge(EdgeId edgeId, NodeId sourceId, NodeId targetId)
     }
 
     claimEdgeId(edgeId);
+    _recordedRemovals.reset();
+
     auto& edge = edgeBy(edgeId);
     edge._id = edgeId;
     edge._sourceId = sourceId;
@@ -392,12 +482,7 @@ EdgeId MutableGraph::addEdge(EdgeId edgeId, NodeId sourceId, NodeId targetId)
 
     nodeBy(sourceId)._outEdgeIds.add(edgeId);
     nodeBy(targetId)._inEdgeIds.add(edgeId);
-
-    auto undirectedEdge = UndirectedEdge(sourceId, targetId);
-    if(!u::contains(_e._connections, undirectedEdge))
-        _e._connections.emplace(undirectedEdge, EdgeIdDistinctSet(&_e._mergedEdgeIds));
-
-    _e._connections[undirectedEdge].add(edgeId);
+    indexEdge(edgeId);
 
     emit edgeAdded(this, edgeId);
     _updateRequired = true;
@@ -422,29 +507,355 @@ void MutableGraph::removeEdge(EdgeId edgeId)
 
     nodeBy(edge.sourceId())._outEdgeIds.remove(edgeId);
     nodeBy(edge.targetId())._inEdgeIds.remove(edgeId);
-
-    auto undirectedEdge = UndirectedEdge(edge.sourceId(), edge.targetId());
-    auto& connection = _e._connections[undirectedEdge];
-    Q_ASSERT(!connection.empty());
-    connection.remove(edgeId);
-
-    if(connection.empty())
-        _e._connections.erase(undirectedEdge);
+    auto headEdgeId = unindexEdge(edgeId);
 
     releaseEdgeId(edgeId);
     _unusedEdgeIds.push_back(edgeId);
 
+    if(_recordedRemovals != nullptr)
+        _recordedRemovals->_edgeIds.push_back(edgeId);
+
     emit edgeRemoved(this, edgeId);
+
+    if(!headEdgeId.isNull())
+        emit edgeChanged(this, headEdgeId);
     _updateRequired = true;
     endTransaction();
 }
 
+NodeId MutableGraph::bulkAddNodes(size_t numNodes)
+{
+    if(numNodes == 0)
+        return {};
+
+    beginTransaction();
+    _recordedRemovals.reset();
+
+    auto firstNodeId = nextNodeId();
+    auto lastNodeId = firstNodeId + static_cast<int>(numNodes - 1);
+
+    // Resize everything once, rather than once per node
+    Graph::reserveNodeId(lastNodeId);
+    _n.resize(static_cast<int>(nextNodeId()));
+
+    for(auto nodeId = firstNodeId; nodeId <= lastNodeId; ++nodeId)
+    {
+        claimNodeId(nodeId);
+
+        auto& node = nodeBy(nodeId);
+        node._id = nodeId;
+        node._inEdgeIds.setCollection(&_e._inEdgeIdsCollection);
+        node._outEdgeIds.setCollection(&_e._outEdgeIdsCollection);
+    }
+
+    _updateRequired = true;
+    endTransaction();
+
+    return firstNodeId;
+}
+
+EdgeId MutableGraph::bulkAddEdges(const std::vector<std::pair<NodeId, NodeId>>& edges)
+{
+    if(edges.empty())
+        return {};
+
+    beginTransaction();
+    _recordedRemovals.reset();
+
+    auto firstEdgeId = nextEdgeId();
+    auto lastEdgeId = firstEdgeId + static_cast<int>(edges.size() - 1);
+
+    Graph::reserveEdgeId(lastEdgeId);
+    _e.resize(static_cast<int>(nextEdgeId()));
+
+    auto edgesBegin = _e._edges.begin() + static_cast<int>(firstEdgeId);
+    auto edgesEnd = edgesBegin + static_cast<int>(edges.size());
+
+    concurrent_for(edgesBegin, edgesEnd,
+    [&](std::vector<Edge>::iterator it)
+    {
+        auto index = static_cast<size_t>(std::distance(edgesBegin, it));
+        const auto& [sourceId, targetId] = edges[index];
+
+        Q_ASSERT(_n._nodeIdsInUse[static_cast<int>(sourceId)]);
+        Q_ASSERT(_n._nodeIdsInUse[static_cast<int>(targetId)]);
+
+        it->_id = firstEdgeId + static_cast<int>(index);
+        it->_sourceId = sourceId;
+        it->_targetId = targetId;
+    });
+
+    for(auto edgeId = firstEdgeId; edgeId <= lastEdgeId; ++edgeId)
+        claimEdgeId(edgeId);
+
+    // The in and out edge sets are in separate collections, so can be built concurrently,
+    // but each in the order of the edges, so that the result is the same as adding them singly
+    const std::vector<bool> directions = {true, false};
+    concurrent_for(directions.begin(), directions.end(),
+    [&](bool in)
+    {
+        for(auto edgeId = firstEdgeId; edgeId <= lastEdgeId; ++edgeId)
+        {
+            const auto& edge = edgeBy(edgeId);
+
+            if(in)
+                nodeBy(edge.targetId())._inEdgeIds.add(edgeId);
+            else
+                nodeBy(edge.sourceId())._outEdgeIds.add(edgeId);
+        }
+    });
+
+    // Index the edges before anything can look them up, so that lookups need never modify the graph
+    indexEdges(firstEdgeId, lastEdgeId);
+
+    _updateRequired = true;
+    endTransaction();
+
+    return firstEdgeId;
+}
+
+void MutableGraph::removeNodesInOrder(const std::vector<NodeId>& nodeIds)
+{
+    if(nodeIds.empty())
+        return;
+
+    beginTransaction();
+
+    std::vector<NodeId> headNodeIds;
+
+    for(auto nodeId : nodeIds)
+    {
+        Q_ASSERT(containsNodeId(nodeId));
+        Q_ASSERT(nodeBy(nodeId).degree() == 0);
+
+        bool wasHead = typeOf(nodeId) == MultiElementType::Head;
+        auto headNodeId = _n._mergedNodeIds.remove({}, nodeId);
+
+        releaseNodeId(nodeId);
+        _unusedNodeIds.push_back(nodeId);
+
+        if(wasHead && !headNodeId.isNull())
+            headNodeIds.push_back(headNodeId);
+    }
+
+    if(_recordedRemovals != nullptr)
+    {
+        _recordedRemovals->_nodeIds.insert(_recordedRemovals->_nodeIds.end(),
+            nodeIds.begin(), nodeIds.end());
+    }
+
+    emit nodesRemoved(this, nodeIds);
+
+    for(auto headNodeId : headNodeIds)
+    {
+        if(containsNodeId(headNodeId))
+            emit nodeChanged(this, headNodeId);
+    }
+
+    _updateRequired = true;
+    endTransaction();
+}
+
+// Relinks the edge sets, multi-edges and connections from scratch, leaving out the removed
+// edges; the order of every set is preserved, so the result is the same as unlinking them
+// one by one, but the cost depends on what remains, rather than on how much is removed
+std::vector<EdgeId> MutableGraph::relinkEdgesWithout(const std::vector<bool>& removed)
+{
+    auto isRemoved = [&removed](EdgeId edgeId) { return removed[static_cast<size_t>(static_cast<int>(edgeId))]; };
+    auto size = static_cast<size_t>(static_cast<int>(nextEdgeId()));
+
+    auto inEdgeIdsCollection = std::move(_e._inEdgeIdsCollection);
+    auto outEdgeIdsCollection = std::move(_e._outEdgeIdsCollection);
+    _e._inEdgeIdsCollection = {};
+    _e._outEdgeIdsCollection = {};
+    _e._inEdgeIdsCollection.resize(size);
+    _e._outEdgeIdsCollection.resize(size);
+
+    // Each edge is in the sets of only its own source and target, so nodes can be relinked concurrently
+    concurrent_for(_n._nodes.begin(), _n._nodes.end(),
+    [&](std::vector<Node>::iterator it)
+    {
+        auto index = static_cast<size_t>(std::distance(_n._nodes.begin(), it));
+        if(!_n._nodeIdsInUse[index])
+            return;
+
+        it->_inEdgeIds.rebuild(inEdgeIdsCollection, isRemoved);
+        it->_outEdgeIds.rebuild(outEdgeIdsCollection, isRemoved);
+    });
+
+    auto mergedEdgeIds = std::move(_e._mergedEdgeIds);
+    _e._mergedEdgeIds = {};
+    _e._mergedEdgeIds.resize(size);
+
+    // There are no more connections than there were, so the index need never grow
+    auto numConnections = _e._connections.size();
+    _e._connections.clear();
+    _e._connections.reserve(numConnections);
+
+    std::vector<EdgeId> headEdgeIds;
+    for(EdgeId edgeId(0); edgeId < nextEdgeId(); ++edgeId)
+    {
+        // Every multi-edge is found through its current head
+        if(!containsEdgeId(edgeId) || mergedEdgeIds.typeOf(edgeId) == MultiElementType::Tail)
+            continue;
+
+        auto headEdgeId = _e._mergedEdgeIds.copyFrom(mergedEdgeIds, edgeId, isRemoved);
+        if(headEdgeId.isNull())
+            continue;
+
+        const auto& edge = edgeBy(headEdgeId);
+        _e._connections.head(_e._connections.insert(
+            ConnectionIndex::keyFor(edge.sourceId(), edge.targetId()))) = headEdgeId;
+
+        if(headEdgeId != edgeId)
+            headEdgeIds.push_back(headEdgeId);
+    }
+
+    return headEdgeIds;
+}
+
+void MutableGraph::removeEdgesInOrder(const std::vector<EdgeId>& edgeIds)
+{
+    if(edgeIds.empty())
+        return;
+
+    beginTransaction();
+
+    std::vector<EdgeId> headEdgeIds;
+
+    // When most of the edges are going, it's cheaper to relink those that remain
+    if(edgeIds.size() * 2 >= static_cast<size_t>(static_cast<int>(nextEdgeId())))
+    {
+        std::vector<bool> removed(static_cast<size_t>(static_cast<int>(nextEdgeId())), false);
+        for(auto edgeId : edgeIds)
+        {
+            Q_ASSERT(containsEdgeId(edgeId));
+            removed[static_cast<size_t>(static_cast<int>(edgeId))] = true;
+        }
+
+        headEdgeIds = relinkEdgesWithout(removed);
+    }
+    else
+    {
+        // The out edge sets, in edge sets and connections are each independent of the others,
+        // so they can be unlinked from concurrently; within each the edges are unlinked in
+        // order, so that the result is the same as having removed the edges singly
+        auto unlink = [&](int part)
+        {
+            for(auto edgeId : edgeIds)
+            {
+                Q_ASSERT(containsEdgeId(edgeId));
+                const auto& edge = edgeBy(edgeId);
+
+                switch(part)
+                {
+                case 0:  nodeBy(edge.sourceId())._outEdgeIds.remove(edgeId); break;
+                case 1:  nodeBy(edge.targetId())._inEdgeIds.remove(edgeId); break;
+                default:
+                {
+                    auto headEdgeId = unindexEdge(edgeId);
+                    if(!headEdgeId.isNull())
+                        headEdgeIds.push_back(headEdgeId);
+                    break;
+                }
+                }
+            }
+        };
+
+        const std::vector<int> parts = {0, 1, 2};
+        const size_t MinimumConcurrentEdges = 1u << 12;
+
+        if(edgeIds.size() >= MinimumConcurrentEdges)
+            concurrent_for(parts.begin(), parts.end(), unlink);
+        else
+            std::for_each(parts.begin(), parts.end(), unlink);
+    }
+
+    for(auto edgeId : edgeIds)
+    {
+        releaseEdgeId(edgeId);
+        _unusedEdgeIds.push_back(edgeId);
+    }
+
+    if(_recordedRemovals != nullptr)
+    {
+        _recordedRemovals->_edgeIds.insert(_recordedRemovals->_edgeIds.end(),
+            edgeIds.begin(), edgeIds.end());
+    }
+
+    emit edgesRemoved(this, edgeIds);
+
+    // Edges that have become the heads of multi-edges, and haven't themselves been removed since
+    for(auto headEdgeId : headEdgeIds)
+    {
+        if(containsEdgeId(headEdgeId))
+            emit edgeChanged(this, headEdgeId);
+    }
+
+    _updateRequired = true;
+    endTransaction();
+}
+
+void MutableGraph::bulkRemoveNodes(const NodeArray<bool>& removees)
+{
+    std::vector<NodeId> nodeIds;
+    std::vector<EdgeId> edgeIds;
+    std::vector<bool> edgeIdsToRemove(static_cast<size_t>(static_cast<int>(nextEdgeId())), false);
+
+    auto addEdgeId = [&](EdgeId edgeId)
+    {
+        auto index = static_cast<size_t>(static_cast<int>(edgeId));
+        if(!edgeIdsToRemove[index])
+        {
+            edgeIdsToRemove[index] = true;
+            edgeIds.push_back(edgeId);
+        }
+    };
+
+    auto lastNodeId = std::min(nextNodeId(), NodeId(removees.size()));
+    for(NodeId nodeId(0); nodeId < lastNodeId; ++nodeId)
+    {
+        if(!containsNodeId(nodeId) || !removees.get(nodeId))
+            continue;
+
+        nodeIds.push_back(nodeId);
+
+        // The edges are removed in the same order as removeNode would remove them
+        for(auto edgeId : inEdgeIdsForNodeId(nodeId))
+            addEdgeId(edgeId);
+
+        for(auto edgeId : outEdgeIdsForNodeId(nodeId))
+            addEdgeId(edgeId);
+    }
+
+    beginTransaction();
+    removeEdgesInOrder(edgeIds);
+    removeNodesInOrder(nodeIds);
+    endTransaction(!nodeIds.empty());
+}
+
+void MutableGraph::bulkRemoveEdges(const EdgeArray<bool>& removees)
+{
+    std::vector<EdgeId> edgeIds;
+
+    auto lastEdgeId = std::min(nextEdgeId(), EdgeId(removees.size()));
+    for(EdgeId edgeId(0); edgeId < lastEdgeId; ++edgeId)
+    {
+        if(containsEdgeId(edgeId) && removees.get(edgeId))
+            edgeIds.push_back(edgeId);
+    }
+
+    beginTransaction();
+    removeEdgesInOrder(edgeIds);
+    endTransaction(!edgeIds.empty());
+}
+
 // Move the edges to connect to nodeId
 template<typename C> static void moveEdgesTo(MutableGraph& graph, NodeId nodeId,
                                              const C& inEdgeIds,
                                              const C& outEdgeIds)
 {
-    // Don't bother emitting signals for edges that are moving
+    // Don't bother emitting signals for edges that are moving; they are signalled as changed instead
     bool wasBlocked = graph.blockSignals(true);
 
     for(auto edgeIdToMove : inEdgeIds)
@@ -462,6 +873,11 @@ template<typename C> static void moveEdgesTo(MutableGraph& graph, NodeId nodeId,
     }
 
     graph.blockSignals(wasBlocked);
+
+    // Any multi-edges the moved edges have joined may have changed too, all of which are now
+    // incident to nodeId; the moved edges may be tails, so their heads can't be found directly
+    for(auto edgeId : graph.edgeIdsForNodeId(nodeId))
+        emit graph.edgeChanged(&graph, edgeId);
 }
 
 void MutableGraph::contractEdge(EdgeId edgeId)
@@ -473,9 +889,11 @@ void MutableGraph::contractEdge(EdgeId edgeId)
     beginTransaction();
 
     const auto& edge = edgeById(edgeId);
-    auto [nodeId, nodeIdToMerge] = std::minmax(edge.sourceId(), edge.targetId());
+    auto [nodeId, nodeIdToMerge] = std::minmax({edge.sourceId(), edge.targetId()});
 
     removeEdge(edgeId);
+    _recordedRemovals.reset();
+
     moveEdgesTo(*this, nodeId,
         inEdgeIdsForNodeId(nodeIdToMerge).copy(),
         outEdgeIdsForNodeId(nodeIdToMerge).copy());
@@ -501,6 +919,7 @@ void MutableGraph::contractEdges(const EdgeIdSet& edgeIds)
     });
 
     removeEdges(edgeIds);
+    _recordedRemovals.reset();
 
     for(auto componentId : componentManager.componentIds())
     {
@@ -531,6 +950,8 @@ MutableGraph& MutableGraph::clone(const MutableGraph& other)
     // Store the differences between the graphs
     auto diff = diffTo(other);
 
+    _recordedRemovals.reset();
+
     _n             = other._n;
     _nodeIds       = other._nodeIds;
     _unusedNodeIds = other._unusedNodeIds;
@@ -550,9 +971,6 @@ MutableGraph& MutableGraph::clone(const MutableGraph& other)
         node._outEdgeIds.setCollection(&_e._outEdgeIdsCollection);
     }
 
-    for(auto& connection : _e._connections)
-        connection.second.setCollection(&_e._mergedEdgeIds);
-
     // Signal all the changes based on the diff before we cloned
     for(NodeId nodeId : diff._nodesAdded)
         emit nodeAdded(this, nodeId);
@@ -560,6 +978,12 @@ MutableGraph& MutableGraph::clone(const MutableGraph& other)
     for(EdgeId edgeId : diff._edgesAdded)
         emit edgeAdded(this, edgeId);
 
+    for(NodeId nodeId : diff._nodesChanged)
+        emit nodeChanged(this, nodeId);
+
+    for(EdgeId edgeId : diff._edgesChanged)
+        emit edgeChanged(this, edgeId);
+
     for(EdgeId edgeId : diff._edgesRemoved)
         emit edgeRemoved(this, edgeId);
 
@@ -586,21 +1010,55 @@ MutableGraph::Diff MutableGraph::diffTo(const MutableGraph& other)
     MutableGraph::Diff diff;
 
     auto maxNodeId = std::max(nextNodeId(), other.nextNodeId());
-    for(NodeId nodeId(0); nodeId < maxNodeId; ++nodeId)
+
+    // The head of the multi-element that each node belongs to, so that nodes which have
+    // moved between multi-elements are found, even if their type is the same in both
+    auto headNodeIds = [maxNodeId](const MutableGraph& graph)
     {
-        if(nodeId < nextNodeId() && nodeId < other.nextNodeId())
+        std::vector<NodeId> nodeIds(static_cast<int>(maxNodeId));
+
+        for(NodeId nodeId(0); nodeId < graph.nextNodeId(); ++nodeId)
         {
-            if(containsNodeId(nodeId) && !other.containsNodeId(nodeId))
-                diff._nodesRemoved.push_back(nodeId);
-            else if(!containsNodeId(nodeId) && other.containsNodeId(nodeId))
-                diff._nodesAdded.push_back(nodeId);
+            if(!graph.containsNodeId(nodeId) || graph.typeOf(nodeId) == MultiElementType::Tail)
+                continue;
+
+            for(auto mergedNodeId : graph.mergedNodeIdsForNodeId(nodeId))
+                nodeIds[static_cast<int>(mergedNodeId)] = nodeId;
         }
-        else if(nodeId < nextNodeId() && containsNodeId(nodeId))
-            diff._nodesRemoved.push_back(nodeId);
-        else if(nodeId < other.nextNodeId() && other.containsNodeId(nodeId))
+
+        return nodeIds;
+    };
+
+    auto headNodeIdsBefore = headNodeIds(*this);
+    auto headNodeIdsAfter = headNodeIds(other);
+
+    for(NodeId nodeId(0); nodeId < maxNodeId; ++nodeId)
+    {
+        auto headNodeIdBefore = headNodeIdsBefore[static_cast<int>(nodeId)];
+        auto headNodeIdAfter = headNodeIdsAfter[static_cast<int>(nodeId)];
+
+        if(headNodeIdBefore.isNull() && !headNodeIdAfter.isNull())
             diff._nodesAdded.push_back(nodeId);
+        else if(!headNodeIdBefore.isNull() && headNodeIdAfter.isNull())
+            diff._nodesRemoved.push_back(nodeId);
+        else if(!headNodeIdBefore.isNull() && (headNodeIdBefore != headNodeIdAfter ||
+            typeOf(nodeId) != other.typeOf(nodeId)))
+        {
+            diff._nodesChanged.push_back(nodeId);
+        }
+
+        // A multi-element whose membership has changed is signalled through its head too
+        if(!headNodeIdAfter.isNull() && headNodeIdAfter != nodeId && headNodeIdBefore != headNodeIdAfter &&
+            !headNodeIdsBefore[static_cast<int>(headNodeIdAfter)].isNull())
+        {
+            diff._nodesChanged.push_back(headNodeIdAfter);
+        }
     }
 
+    std::sort(diff._nodesChanged.begin(), diff._nodesChanged.end());
+    diff._nodesChanged.erase(std::unique(diff._nodesChanged.begin(), diff._nodesChanged.end()),
+        diff._nodesChanged.end());
+
     auto maxEdgeId = std::max(nextEdgeId(), other.nextEdgeId());
     for(EdgeId edgeId(0); edgeId < maxEdgeId; ++edgeId)
     {
@@ -610,6 +1068,17 @@ MutableGraph::Diff MutableGraph::diffTo(const MutableGraph& other)
                 diff._edgesRemoved.push_back(edgeId);
             else if(!containsEdgeId(edgeId) && other.containsEdgeId(edgeId))
                 diff._edgesAdded.push_back(edgeId);
+            else if(containsEdgeId(edgeId))
+            {
+                const auto& edge = edgeBy(edgeId);
+                const auto& otherEdge = other.edgeBy(edgeId);
+
+                if(edge.sourceId() != otherEdge.sourceId() || edge.targetId() != otherEdge.targetId() ||
+                    typeOf(edgeId) != other.typeOf(edgeId))
+                {
+                    diff._edgesChanged.push_back(edgeId);
+                }
+            }
         }
         else if(edgeId < nextEdgeId() && containsEdgeId(edgeId))
             diff._edgesRemoved.push_back(edgeId);
@@ -620,6 +1089,27 @@ MutableGraph::Diff MutableGraph::diffTo(const MutableGraph& other)
     return diff;
 }
 
+void MutableGraph::beginRecordingRemovals()
+{
+    _recordedRemovals = std::make_unique<Removals>();
+}
+
+std::unique_ptr<MutableGraph::Removals> MutableGraph::endRecordingRemovals()
+{
+    return std::move(_recordedRemovals);
+}
+
+void MutableGraph::applyRemovals(const Removals& removals)
+{
+    beginTransaction();
+
+    // Edges first, as removing a node would otherwise remove its edges in a different order
+    removeEdgesInOrder(removals._edgeIds);
+    removeNodesInOrder(removals._nodeIds);
+
+    endTransaction(!removals._nodeIds.empty() || !removals._edgeIds.empty());
+}
+
 void MutableGraph::beginTransaction()
 {
     if(_graphChangeDepth++ <= 0)
@@ -644,6 +1134,14 @@ void MutableGraph::endTransaction(bool graphChangeOccurred)
     }
 }
 
+std::shared_ptr<const AdjacencySnapshot> MutableGraph::adjacencySnapshot()
+{
+    // This invalidates the cached snapshot if there are changes pending
+    update();
+
+    return Graph::adjacencySnapshot();
+}
+
 bool MutableGraph::update()
 {
     if(!_updateRequired)
@@ -651,6 +1149,8 @@ bool MutableGraph::update()
 
     _updateRequired = false;
 
+    invalidateAdjacencySnapshot();
+
     _nodeIds.clear();
     _unusedNodeIds.clear();
     std::fill(_n._multiplicities.begin(), _n._multiplicities.end(), 0);
@@ -20,33 +20,13 @@
 #define MUTABLEGRAPH_H
 
 #include "graph.h"
+#include "connectionindex.h"
 #include "shared/graph/imutablegraph.h"
 
 #include <deque>
+#include <memory>
 #include <mutex>
 #include <vector>
-#include <map>
-
-class UndirectedEdge
-{
-private:
-    NodeId lo;
-    NodeId hi;
-
-public:
-    UndirectedEdge(NodeId a, NodeId b)
-    {
-        std::tie(lo, hi) = std::minmax(a, b);
-    }
-
-    bool operator<(const UndirectedEdge& other) const
-    {
-        if(lo == other.lo)
-            return hi < other.hi;
-
-        return lo < other.lo;
-    }
-};
 
 class MutableGraph : public Graph, public virtual IMutableGraph
 {
@@ -96,7 +76,8 @@ private:
         EdgeIdDistinctSetCollection _inEdgeIdsCollection;
         EdgeIdDistinctSetCollection _outEdgeIdsCollection;
 
-        std::map<UndirectedEdge, EdgeIdDistinctSet> _connections;
+        // The sets of parallel edges are linked through _mergedEdgeIds; this indexes their heads
+        ConnectionIndex _connections;
 
         void resize(std::size_t size)
         {
@@ -125,6 +106,19 @@ private:
 
     bool _updateRequired = false;
 
+public:
+    // The elements removed from a graph, in the order they were removed, such
+    // that they can be replayed over another instance of the same graph
+    struct Removals
+    {
+        std::vector<NodeId> _nodeIds;
+        std::vector<EdgeId> _edgeIds;
+    };
+
+private:
+    // Non-null while recording, unless something other than a removal has occurred
+    std::unique_ptr<Removals> _recordedRemovals;
+
     Node& nodeBy(NodeId nodeId);
     const Node& nodeBy(NodeId nodeId) const;
     void claimNodeId(NodeId nodeId);
@@ -134,6 +128,14 @@ private:
     void claimEdgeId(EdgeId edgeId);
     void releaseEdgeId(EdgeId edgeId);
 
+    void indexEdge(EdgeId edgeId);
+    void indexEdges(EdgeId firstEdgeId, EdgeId lastEdgeId);
+    EdgeId unindexEdge(EdgeId edgeId);
+    std::vector<EdgeId> relinkEdgesWithout(const std::vector<bool>& removed);
+
+    void removeNodesInOrder(const std::vector<NodeId>& nodeIds);
+    void removeEdgesInOrder(const std::vector<EdgeId>& edgeIds);
+
     NodeId mergeNodes(NodeId nodeIdA, NodeId nodeIdB);
     EdgeId mergeEdges(EdgeId edgeIdA, EdgeId edgeIdB);
 
@@ -202,6 +204,11 @@ public:
     EdgeId addEdge(const IEdge& edge) override;
     void removeEdge(EdgeId edgeId) override;
 
+    NodeId bulkAddNodes(size_t numNodes) override;
+    EdgeId bulkAddEdges(const std::vector<std::pair<NodeId, NodeId>>& edges) override;
+    void bulkRemoveNodes(const NodeArray<bool>& removees) override;
+    void bulkRemoveEdges(const EdgeArray<bool>& removees) override;
+
     void contractEdge(EdgeId edgeId) override;
     void contractEdges(const EdgeIdSet& edgeIds) override;
 
@@ -214,18 +221,33 @@ public:
         std::vector<EdgeId> _edgesAdded;
         std::vector<EdgeId> _edgesRemoved;
 
+        // Elements in both graphs, whose multi-element type or endpoints differ
+        std::vector<NodeId> _nodesChanged;
+        std::vector<EdgeId> _edgesChanged;
+
         bool empty() const
         {
             return
                 _nodesAdded.empty() &&
                 _nodesRemoved.empty() &&
                 _edgesAdded.empty() &&
-                _edgesRemoved.empty();
+                _edgesRemoved.empty() &&
+                _nodesChanged.empty() &&
+                _edgesChanged.empty();
         }
     };
 
     Diff diffTo(const MutableGraph& other);
 
+    // If only elements are removed while recording, the removals are returned,
+    // otherwise nullptr is, as they aren't a sufficient description of the changes
+    void beginRecordingRemovals();
+    std::unique_ptr<Removals> endRecordingRemovals();
+    void applyRemovals(const Removals& removals);
+
+    // Any pending changes are applied first, so the snapshot is never built from a stale graph
+    std::shared_ptr<const AdjacencySnapshot> adjacencySnapshot() override;
+
     bool update() override;
 
 private:
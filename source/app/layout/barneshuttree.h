@@ -16,153 +16,365 @@
  * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+
 #ifndef BARNESHUTTREE_H
 #define BARNESHUTTREE_H
 
 #include "spatialtree.h"
-#include "shared/utils/fixedsizestack.h"
-
-#include <QVector3D>
-
-#include <functional>
 
-class AbstractBarnesHutTree : virtual public AbstractSpatialTree
-{
-public:
-    virtual QVector3D evaluateKernel(const NodeLayoutPositions& nodePositions, NodeId nodeId,
-        const std::function<QVector3D(int, const QVector3D&, float)>& kernel) const = 0;
-};
+#include "shared/graph/igraphcomponent.h"
+#include "shared/utils/cancellable.h"
+#include "shared/utils/threadpool.h"
 
-template<size_t NumDimensions>
-class BarnesHutTree;
+#include <QVector3D>
 
-template<size_t NumDimensions>
-struct BarnesHutSubVolume : SubVolume<BarnesHutTree<NumDimensions>, NumDimensions> { float _sSq = 0.0f; };
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <tuple>
 
 template<size_t NumDimensions>
-class BarnesHutTree :
-    public SpatialTree<BarnesHutTree<NumDimensions>, NumDimensions, BarnesHutSubVolume<NumDimensions>>,
-    public AbstractBarnesHutTree
+class BarnesHutTree : public SpatialTree<NumDimensions>
 {
 private:
     static constexpr float E = 0.0001f;
     static constexpr float E2 = E * E;
 
-    // Cycle through different epsilon vectors so that there is enough
-    // variation that the forces don't get stuck in 2 or fewer dimensions
-    mutable size_t _di = 0;
-    QVector3D differenceEpsilon() const
+    // Small leaves are cheaper to evaluate directly than they are to subdivide further
+    static constexpr size_t MaxPositionsPerLeaf = 4;
+
+    // Nearby positions share their interactions with the tree
+    static constexpr size_t MaxPositionsPerGroup = 32;
+
+    // The width of the (auto-vectorised) loop that evaluates the interactions
+    static constexpr size_t NumLanes = 8;
+
+    struct Cell
+    {
+        QVector3D _centreOfMass;
+        float _mass = 0.0f;
+        float _sSq = 0.0f;
+    };
+
+    // The cells and positions that a group of positions interact with, as structure of arrays
+    struct InteractionList
     {
-        if constexpr(NumDimensions == 3)
+        std::vector<float> _x;
+        std::vector<float> _y;
+        std::vector<float> _z;
+        std::vector<float> _mass;
+
+        std::vector<uint32_t> _stack;
+
+        void clear()
         {
-            static std::array<QVector3D, 6> vs =
-            {{
-                {   E, 0.0f, 0.0f},
-                {0.0f,    E, 0.0f},
-                {0.0f, 0.0f,    E},
-                {  -E, 0.0f, 0.0f},
-                {0.0f,   -E, 0.0f},
-                {0.0f, 0.0f,   -E},
-            }};
-
-            _di = (_di + 1) % vs.size();
-            return vs.at(_di);
+            _x.clear();
+            _y.clear();
+            _z.clear();
+            _mass.clear();
         }
-        else if constexpr(NumDimensions == 2)
+
+        void add(float x, float y, float z, float mass)
         {
-            static std::array<QVector3D, 4> vs =
-            {{
-                {   E, 0.0f, 0.0f},
-                {0.0f,    E, 0.0f},
-                {  -E, 0.0f, 0.0f},
-                {0.0f,   -E, 0.0f},
-            }};
-
-            _di = (_di + 1) % vs.size();
-            return vs.at(_di);
+            _x.push_back(x);
+            _y.push_back(y);
+            _z.push_back(z);
+            _mass.push_back(mass);
         }
-    }
+    };
+
+    struct Group
+    {
+        size_t _begin = 0;
+        size_t _end = 0;
+
+        uint64_t computeCostHint() const { return _end - _begin; }
+    };
 
     float _theta = 0.8f;
-    int _mass = 0;
-    QVector3D _centreOfMass;
 
-    void initialise(const NodeLayoutPositions& nodePositions, const std::vector<NodeId>& nodeIds) override
+    // Parallel to the nodes of the SpatialTree
+    std::vector<Cell> _cells;
+
+    // Parallel to the positions; the number of other positions that exactly coincide with each
+    std::vector<uint32_t> _numCoincident;
+    std::vector<uint32_t> _sortedIndices;
+
+    std::vector<InteractionList> _interactionLists;
+    std::vector<Group> _groups;
+
+    void computeCells()
     {
-        _mass = static_cast<int>(nodeIds.size());
-        _centreOfMass = nodePositions.centreOfMass(nodeIds);
+        const auto& nodes = this->_nodes;
+        _cells.resize(nodes.size());
 
-        for(auto& subVolume : this->_subVolumes)
-            subVolume._sSq = subVolume._boundingBox.maxLength() * subVolume._boundingBox.maxLength();
+        // Children always follow their parents, so in reverse the children are complete first
+        for(auto nodeIndex = nodes.size(); nodeIndex-- > 0;)
+        {
+            const auto& node = nodes[nodeIndex];
+            auto& cell = _cells[nodeIndex];
+            QVector3D sum;
+
+            if(node.leaf())
+            {
+                for(auto i = node._begin; i < node._end; i++)
+                    sum += QVector3D(this->_x[i], this->_y[i], this->_z[i]);
+            }
+            else
+            {
+                for(auto child = node._firstChild; child < node._firstChild + node._numChildren; child++)
+                    sum += _cells[child]._centreOfMass * _cells[child]._mass;
+            }
+
+            cell._mass = static_cast<float>(node._end - node._begin);
+            cell._centreOfMass = sum / cell._mass;
+            cell._sSq = node._length * node._length;
+        }
     }
 
-public:
-    BarnesHutTree()
+    // Cycle through different epsilon vectors so that there is enough
+    // variation that the forces don't get stuck in 2 or fewer dimensions
+    static QVector3D differenceEpsilon(size_t index)
     {
-        this->setMaxNodesPerLeaf(1);
+        switch(index % (2 * NumDimensions))
+        {
+        default:
+        case 0: return {   E, 0.0f, 0.0f};
+        case 1: return {0.0f,    E, 0.0f};
+        case 2: return {  -E, 0.0f, 0.0f};
+        case 3: return {0.0f,   -E, 0.0f};
+        case 4: return {0.0f, 0.0f,    E};
+        case 5: return {0.0f, 0.0f,   -E};
+        }
     }
 
-    void setTheta(float theta) { _theta = theta; }
-
-    QVector3D evaluateKernel(const NodeLayoutPositions& nodePositions, NodeId nodeId,
-        const std::function<QVector3D(int, const QVector3D&, float)>& kernel) const override
+    // Accumulates the cells and positions that the positions of group interact with; the
+    // interactions are shared by the whole group, so the opening criterion is applied using the
+    // distance to the group's bounding box, rather than to any one position within it
+    void gatherInteractions(const Group& group, InteractionList& list) const
     {
-        const QVector3D& nodePosition = nodePositions.get(nodeId);
-        QVector3D result;
-        FixedSizeStack<const BarnesHutTree*> stack(this->_depthFirstTraversalStackSizeRequirement);
+        const auto& nodes = this->_nodes;
 
-        stack.push(this);
+        QVector3D min(this->_x[group._begin], this->_y[group._begin], this->_z[group._begin]);
+        QVector3D max = min;
+        for(auto i = group._begin + 1; i < group._end; i++)
+        {
+            const QVector3D position(this->_x[i], this->_y[i], this->_z[i]);
+            for(int axis = 0; axis < 3; axis++)
+            {
+                min[axis] = std::min(min[axis], position[axis]);
+                max[axis] = std::max(max[axis], position[axis]);
+            }
+        }
 
-        while(!stack.empty())
+        list.clear();
+        list._stack.clear();
+        list._stack.push_back(0);
+
+        while(!list._stack.empty())
         {
-            const BarnesHutTree* subTree = stack.pop();
+            const auto& node = nodes[list._stack.back()];
+            list._stack.pop_back();
 
-            for(int i = 0; i < subTree->_numInternalNodes; i++)
+            if(node.leaf())
             {
-                auto subVolume = subTree->_internalNodes.at(i);
+                // This includes the group's own positions; as they have no displacement
+                // from themselves, they don't contribute to their own result
+                for(auto i = node._begin; i < node._end; i++)
+                    list.add(this->_x[i], this->_y[i], this->_z[i], 1.0f);
+
+                continue;
+            }
 
-                const QVector3D& centreOfMass = subVolume->_subTree->_centreOfMass;
-                QVector3D difference = (centreOfMass - nodePosition);
-                float distanceSq = difference.lengthSquared();
+            for(auto child = node._firstChild; child < node._firstChild + node._numChildren; child++)
+            {
+                const auto& childNode = nodes[child];
+                const auto& cell = _cells[child];
 
-                if(distanceSq == 0.0f)
+                float distanceSq = 0.0f;
+                for(int axis = 0; axis < 3; axis++)
                 {
-                    difference = differenceEpsilon();
-                    distanceSq = E2;
+                    const float c = cell._centreOfMass[axis];
+                    const float d = c < min[axis] ? min[axis] - c : (c > max[axis] ? c - max[axis] : 0.0f);
+                    distanceSq += d * d;
                 }
 
-                const float sOverD = subVolume->_sSq / distanceSq;
-
-                if(sOverD > _theta)
-                    stack.push(subVolume->_subTree.get());
+                // Cells containing any of the group are always opened, so that positions never
+                // interact with themselves; other cells are opened when they are large compared
+                // to their distance, i.e. s²/d² > θ, which includes when d is 0
+                const bool overlapsGroup = childNode._begin < group._end && group._begin < childNode._end;
+                if(overlapsGroup || cell._sSq > _theta * distanceSq)
+                    list._stack.push_back(child);
                 else
-                    result += kernel(subVolume->_subTree->_mass, difference, distanceSq);
+                    list.add(cell._centreOfMass.x(), cell._centreOfMass.y(), cell._centreOfMass.z(), cell._mass);
             }
+        }
 
-            for(int i = 0; i < subTree->_numNonEmptyLeaves; i++)
+        // Pad to a whole number of lanes with massless entries
+        while(list._mass.size() % NumLanes != 0)
+            list.add(0.0f, 0.0f, 0.0f, 0.0f);
+    }
+
+    // Positions that coincide exactly necessarily have the same Morton code, so always share a
+    // leaf, but they aren't necessarily adjacent within it, as positions that are merely close
+    // may also have the same code; hence each leaf's positions are sorted by coordinate instead
+    void computeCoincident()
+    {
+        _numCoincident.assign(this->size(), 0);
+
+        for(const auto& node : this->_nodes)
+        {
+            if(!node.leaf() || node._end - node._begin < 2)
+                continue;
+
+            _sortedIndices.resize(node._end - node._begin);
+            std::iota(_sortedIndices.begin(), _sortedIndices.end(), node._begin);
+
+            std::sort(_sortedIndices.begin(), _sortedIndices.end(), [this](auto a, auto b)
             {
-                auto subVolume = subTree->_nonEmptyLeaves.at(i);
+                return std::make_tuple(this->_x[a], this->_y[a], this->_z[a]) <
+                    std::make_tuple(this->_x[b], this->_y[b], this->_z[b]);
+            });
 
-                NodeId otherNodeId = subVolume->_nodeIds.front();
-                if(otherNodeId != nodeId)
-                {
-                    const QVector3D& otherNodePosition = nodePositions.get(otherNodeId);
-                    QVector3D difference = otherNodePosition - nodePosition;
-                    float distanceSq = difference.lengthSquared();
+            auto coincident = [this](size_t a, size_t b)
+            {
+                return this->_x[a] == this->_x[b] &&
+                    this->_y[a] == this->_y[b] &&
+                    this->_z[a] == this->_z[b];
+            };
 
-                    if(distanceSq == 0.0f)
-                    {
-                        difference = differenceEpsilon();
-                        distanceSq = E2;
-                    }
+            for(size_t runBegin = 0; runBegin < _sortedIndices.size();)
+            {
+                auto runEnd = runBegin + 1;
+                while(runEnd < _sortedIndices.size() && coincident(_sortedIndices[runBegin], _sortedIndices[runEnd]))
+                    runEnd++;
 
-                    result += kernel(1, difference, distanceSq);
-                }
+                for(auto i = runBegin; i < runEnd; i++)
+                    _numCoincident[_sortedIndices[i]] = static_cast<uint32_t>(runEnd - runBegin - 1);
+
+                runBegin = runEnd;
             }
         }
+    }
+
+    template<typename Kernel>
+    QVector3D evaluateInteractions(size_t index, const InteractionList& list, const Kernel& kernel) const
+    {
+        const float px = this->_x[index];
+        const float py = this->_y[index];
+        const float pz = this->_z[index];
+
+        const auto* x = list._x.data();
+        const auto* y = list._y.data();
+        const auto* z = list._z.data();
+        const auto* mass = list._mass.data();
+
+        std::array<float, NumLanes> rx{};
+        std::array<float, NumLanes> ry{};
+        std::array<float, NumLanes> rz{};
+
+        // The loop must not contain any control flow (including selects), or it won't vectorise
+        for(size_t i = 0; i < list._mass.size(); i += NumLanes)
+        {
+            for(size_t lane = 0; lane < NumLanes; lane++)
+            {
+                const auto j = i + lane;
+                const float dx = x[j] - px;
+                const float dy = y[j] - py;
+                const float dz = z[j] - pz;
+                const float distanceSq = (dx * dx) + (dy * dy) + (dz * dz);
+                const float f = mass[j] * kernel(distanceSq);
+
+                rx[lane] += dx * f;
+                ry[lane] += dy * f;
+                rz[lane] += dz * f;
+            }
+        }
+
+        QVector3D result;
+        for(size_t lane = 0; lane < NumLanes; lane++)
+            result += QVector3D(rx[lane], ry[lane], rz[lane]);
+
+        // Positions that coincide exactly have no direction between them, so nudge them apart
+        auto coincidentMass = static_cast<float>(_numCoincident[index]);
+        if(coincidentMass > 0.0f)
+            result += differenceEpsilon(index) * (coincidentMass * kernel(E2));
 
         return result;
     }
+
+    // Divides the positions into groups, each of which is the subtree of a node that has
+    // no more than MaxPositionsPerGroup positions
+    void computeGroups()
+    {
+        const auto& nodes = this->_nodes;
+        _groups.clear();
+
+        if(nodes.empty())
+            return;
+
+        auto& stack = _interactionLists.front()._stack;
+        stack.clear();
+        stack.push_back(0);
+
+        while(!stack.empty())
+        {
+            const auto& node = nodes[stack.back()];
+            stack.pop_back();
+
+            if(node.leaf() || node._end - node._begin <= MaxPositionsPerGroup)
+            {
+                _groups.push_back({node._begin, node._end});
+                continue;
+            }
+
+            // In reverse, so that the groups end up in Morton order
+            for(auto child = node._firstChild + node._numChildren; child-- > node._firstChild;)
+                stack.push_back(child);
+        }
+    }
+
+public:
+    void setTheta(float theta) { _theta = theta; }
+
+    void build(const IGraphComponent& graphComponent, const NodeLayoutPositions& nodePositions)
+    {
+        SpatialTree<NumDimensions>::build(graphComponent.nodeIds(), nodePositions, MaxPositionsPerLeaf);
+        computeCells();
+        computeCoincident();
+    }
+
+    // For each position, computes the sum over every other position of
+    // difference * kernel(distanceSq), where difference is the vector from the former to
+    // the latter, approximating distant groups of positions by their centre of mass; the
+    // kernel is a function float(float distanceSq), which must be finite for a distanceSq
+    // of 0 and should be cheap enough to inline; fn(nodeId, result) is called with each
+    // result, concurrently
+    template<typename Kernel, typename Fn>
+    void evaluateKernel(const Kernel& kernel, Fn&& fn, const Cancellable* cancellable = nullptr)
+    {
+        _interactionLists.resize(concurrent_for_num_threads());
+
+        computeGroups();
+
+        if(_groups.empty())
+            return;
+
+        concurrent_for(_groups.begin(), _groups.end(),
+        [this, &kernel, &fn, cancellable](const Group& group, size_t threadIndex)
+        {
+            if(cancellable != nullptr && cancellable->cancelled())
+                return;
+
+            auto& list = _interactionLists.at(threadIndex);
+            gatherInteractions(group, list);
+
+            for(auto index = group._begin; index < group._end; index++)
+                fn(this->nodeIdAt(index), evaluateInteractions(index, list, kernel));
+        });
+    }
 };
 
 using BarnesHutTree2D = BarnesHutTree<2>;
@@ -27,6 +27,8 @@
 #include "shared/utils/preferences.h"
 #include "shared/utils/scopetimer.h"
 
+#include <algorithm>
+#include <numeric>
 #include <cmath>
 
 template<typename T> float meanWeightedAvgBuffer(int start, int end, const T& buffer)
@@ -115,8 +117,6 @@ void ForceDirectedLayout::execute(bool firstIteration, Dimensionality dimensiona
             _displacements->at(nodeId)._previous = {};
     }
 
-    std::unique_ptr<AbstractBarnesHutTree> barnesHutTree;
-
     if(dimensionality == Dimensionality::ThreeDee)
     {
         if(_hasBeenFlattened)
@@ -139,68 +139,88 @@ void ForceDirectedLayout::execute(bool firstIteration, Dimensionality dimensiona
 
             _hasBeenFlattened = false;
         }
-
-        barnesHutTree = std::make_unique<BarnesHutTree3D>();
     }
     else if(dimensionality == Dimensionality::TwoDee)
-    {
         _hasBeenFlattened = true;
-        barnesHutTree = std::make_unique<BarnesHutTree2D>();
-    }
-
-    barnesHutTree->build(graphComponent(), positions());
 
     const float SHORT_RANGE = _settings->value(QStringLiteral("ShortRangeRepulseTerm"));
     const float LONG_RANGE = 0.01f + _settings->value(QStringLiteral("LongRangeRepulseTerm"));
 
-    // Repulsive forces
-    auto repulsiveResults = concurrent_for(nodeIds().begin(), nodeIds().end(),
-    [this, &barnesHutTree, SHORT_RANGE, LONG_RANGE](NodeId nodeId)
-    {
-        if(cancelled())
-            return;
-
-        _displacements->at(nodeId)._repulsive -= barnesHutTree->evaluateKernel(positions(), nodeId,
-        [SHORT_RANGE, LONG_RANGE](int mass, const QVector3D& difference, float distanceSq)
-        {
-            return difference * (static_cast<float>(mass) * repulse(distanceSq, SHORT_RANGE, LONG_RANGE));
-        });
-    }, ThreadPool::NonBlocking);
+    if(_adjacencyChanged.exchange(false))
+        buildAdjacency();
 
     // Attractive forces
-    auto attractiveResults = concurrent_for(edgeIds().begin(), edgeIds().end(),
-    [this](EdgeId edgeId)
+    auto attractiveResults = concurrent_for(_nodeBlocks.begin(), _nodeBlocks.end(),
+    [this](const NodeBlock& block)
     {
         if(cancelled())
             return;
 
-        const IEdge& edge = graphComponent().graph().edgeById(edgeId);
-        if(!edge.isLoop())
+        for(auto i = block._begin; i < block._end; i++)
         {
-            const QVector3D difference = positions().get(edge.targetId()) - positions().get(edge.sourceId());
-            float distanceSq = difference.lengthSquared();
-            const float force = distanceSq * 0.001f;
+            auto nodeId = nodeIds()[i];
+            const auto& position = positions().get(nodeId);
+            QVector3D attractive;
+
+            for(auto j = _adjacencyOffsets[i]; j < _adjacencyOffsets[i + 1]; j++)
+            {
+                const QVector3D difference = positions().get(_adjacency[j]) - position;
+                float distanceSq = difference.lengthSquared();
+                const float force = distanceSq * 0.001f;
 
-            _displacements->at(edge.targetId())._attractive -= (force * difference);
-            _displacements->at(edge.sourceId())._attractive += (force * difference);
+                attractive += (force * difference);
+            }
+
+            _displacements->at(nodeId)._attractive = attractive;
         }
     }, ThreadPool::NonBlocking);
 
-    repulsiveResults.wait();
+    // Repulsive forces
+    auto computeRepulsiveForces = [this, SHORT_RANGE, LONG_RANGE](auto& barnesHutTree)
+    {
+        barnesHutTree.build(graphComponent(), positions());
+        barnesHutTree.evaluateKernel(
+        [SHORT_RANGE, LONG_RANGE](float distanceSq)
+        {
+            return repulse(distanceSq, SHORT_RANGE, LONG_RANGE);
+        },
+        [this](NodeId nodeId, const QVector3D& result)
+        {
+            _displacements->at(nodeId)._repulsive -= result;
+        }, this);
+    };
+
+    if(dimensionality == Dimensionality::ThreeDee)
+        computeRepulsiveForces(_barnesHutTree3D);
+    else
+        computeRepulsiveForces(_barnesHutTree2D);
+
     attractiveResults.wait();
 
     if(cancelled())
         return;
 
-    concurrent_for(nodeIds().begin(), nodeIds().end(),
-    [this](NodeId nodeId)
+    // Apply the forces, and sum their lengths per block, so that the
+    // totals don't depend on how the blocks are scheduled
+    concurrent_for(_nodeBlocks.begin(), _nodeBlocks.end(),
+    [this](NodeBlock& block)
     {
-        _displacements->at(nodeId).computeAndDamp();
-    });
+        block._lengthSum = 0.0;
+        block._lengthSumSq = 0.0;
+
+        for(auto i = block._begin; i < block._end; i++)
+        {
+            auto nodeId = nodeIds()[i];
+            auto& displacement = _displacements->at(nodeId);
 
-    // Apply the forces
-    for(auto nodeId : nodeIds())
-        positions().set(nodeId, positions().get(nodeId) + _displacements->at(nodeId)._next);
+            displacement.computeAndDamp();
+            positions().set(nodeId, positions().get(nodeId) + displacement._next);
+
+            auto length = static_cast<double>(displacement._nextLength);
+            block._lengthSum += length;
+            block._lengthSumSq += (length * length);
+        }
+    });
 
     // There are three main phases which decide when to stop the layout.
     // The phases operate primarily on the stddev of the forces within the graph
@@ -217,22 +237,22 @@ void ForceDirectedLayout::execute(bool firstIteration, Dimensionality dimensiona
     // Finished  - Finish layout
     //
 
-    // Calculate force averages
-    float deltaForceTotal = 0.0f;
-    for(auto nodeId : nodeIds())
-        deltaForceTotal += _displacements->at(nodeId)._nextLength;
-
-    _forceMean = deltaForceTotal / nodeIds().size();
-
-    // Calculate Standard Deviation
-    float variance = 0.0f;
-    for(auto nodeId : nodeIds())
+    // Calculate force average and standard deviation
+    double lengthSum = 0.0;
+    double lengthSumSq = 0.0;
+    for(const auto& block : _nodeBlocks)
     {
-        float d = _displacements->at(nodeId)._nextLength - _forceMean;
-        variance += (d * d);
+        lengthSum += block._lengthSum;
+        lengthSumSq += block._lengthSumSq;
     }
 
-    _forceStdDeviation = std::sqrt(variance / nodeIds().size());
+    auto numNodes = static_cast<double>(nodeIds().size());
+    auto mean = lengthSum / numNodes;
+    auto variance = std::max((lengthSumSq / numNodes) - (mean * mean), 0.0);
+
+    _forceMean = static_cast<float>(mean);
+    _forceStdDeviation = static_cast<float>(std::sqrt(variance));
+
     switch(_changeDetectionPhase)
     {
         case ChangeDetectionPhase::Initial:
@@ -257,6 +277,72 @@ void ForceDirectedLayout::execute(bool firstIteration, Dimensionality dimensiona
     _prevCaptureStdDevs.push_back(_forceStdDeviation);
 }
 
+void ForceDirectedLayout::buildAdjacency()
+{
+    // Big enough to amortise the scheduling overhead, small
+    // enough that hubs can still be balanced across threads
+    const uint64_t BlockCost = 4096;
+
+    std::vector<std::pair<NodeId, size_t>> indices;
+    indices.reserve(nodeIds().size());
+    for(size_t i = 0; i < nodeIds().size(); i++)
+        indices.emplace_back(nodeIds()[i], i);
+
+    std::sort(indices.begin(), indices.end());
+
+    auto indexOf = [&indices](NodeId nodeId)
+    {
+        auto it = std::lower_bound(indices.begin(), indices.end(), std::make_pair(nodeId, size_t{0}));
+        Q_ASSERT(it != indices.end() && it->first == nodeId);
+        return it->second;
+    };
+
+    std::vector<std::pair<size_t, size_t>> edges;
+    edges.reserve(edgeIds().size());
+    for(auto edgeId : edgeIds())
+    {
+        const IEdge& edge = graphComponent().graph().edgeById(edgeId);
+        if(!edge.isLoop())
+            edges.emplace_back(indexOf(edge.sourceId()), indexOf(edge.targetId()));
+    }
+
+    _adjacencyOffsets.assign(nodeIds().size() + 1, 0);
+    for(const auto& [source, target] : edges)
+    {
+        _adjacencyOffsets[source + 1]++;
+        _adjacencyOffsets[target + 1]++;
+    }
+
+    std::partial_sum(_adjacencyOffsets.begin(), _adjacencyOffsets.end(), _adjacencyOffsets.begin());
+
+    // Filled in edgeIds() order, which fixes the order in which each node's forces are summed
+    std::vector<size_t> next(_adjacencyOffsets.begin(), _adjacencyOffsets.end() - 1);
+    _adjacency.resize(_adjacencyOffsets.back());
+    for(const auto& [source, target] : edges)
+    {
+        _adjacency[next[source]++] = nodeIds()[target];
+        _adjacency[next[target]++] = nodeIds()[source];
+    }
+
+    _nodeBlocks.clear();
+    for(size_t begin = 0; begin < nodeIds().size();)
+    {
+        NodeBlock block;
+        block._begin = begin;
+        block._end = begin;
+
+        do
+        {
+            block._cost += 1 + (_adjacencyOffsets[block._end + 1] - _adjacencyOffsets[block._end]);
+            block._end++;
+        }
+        while(block._end < nodeIds().size() && block._cost < BlockCost);
+
+        _nodeBlocks.push_back(block);
+        begin = block._end;
+    }
+}
+
 // Initial phase. If the std dev drops below MINIMUM_STDDEV_THRESHOLD this will move the phase onto
 // FineTune. If the std dev oscillates enough, will move the phase onto Oscillate
 void ForceDirectedLayout::initialChangeDetection()
@@ -364,6 +450,12 @@ std::unique_ptr<Layout> ForceDirectedLayoutFactory::create(ComponentId component
     NodeLayoutPositions& nodePositions, Layout::Dimensionality dimensionalityMode)
 {
     const auto* component = _graphModel->graph().componentById(componentId);
-    return std::make_unique<ForceDirectedLayout>(*component, _displacements,
+    auto layout = std::make_unique<ForceDirectedLayout>(*component, _displacements,
         nodePositions, dimensionalityMode, &_layoutSettings);
+
+    auto* layoutPtr = layout.get();
+    QObject::connect(&_graphModel->graph(), &Graph::graphChanged, layoutPtr,
+        [layoutPtr] { layoutPtr->invalidateAdjacency(); }, Qt::DirectConnection);
+
+    return layout;
 }
@@ -20,11 +20,13 @@
 #define FORCEDIRECTEDLAYOUT_H
 
 #include "layout.h"
+#include "barneshuttree.h"
 #include "graph/componentmanager.h"
 #include "shared/utils/circularbuffer.h"
 
 #include <QVector3D>
 
+#include <atomic>
 #include <vector>
 
 struct ForceDirectedDisplacement
@@ -76,6 +78,33 @@ private:
 
     bool _hasBeenFlattened = false;
 
+    // Retained between iterations, so that their storage is reused
+    BarnesHutTree2D _barnesHutTree2D;
+    BarnesHutTree3D _barnesHutTree3D;
+
+    // A contiguous range of nodeIds(), and the partial sums of its displacement lengths
+    struct NodeBlock
+    {
+        size_t _begin = 0;
+        size_t _end = 0;
+        uint64_t _cost = 0;
+
+        double _lengthSum = 0.0;
+        double _lengthSumSq = 0.0;
+
+        uint64_t computeCostHint() const { return _cost; }
+    };
+
+    // The neighbours of each node in nodeIds(), in CSR form, so that the attractive forces
+    // can be gathered per node; each displacement is then only written by one thread, and
+    // always summed in the same order, making the layout reproducible
+    std::atomic<bool> _adjacencyChanged = true;
+    std::vector<size_t> _adjacencyOffsets;
+    std::vector<NodeId> _adjacency;
+    std::vector<NodeBlock> _nodeBlocks;
+
+    void buildAdjacency();
+
     void fineTuneChangeDetection();
     void oscillateChangeDetection();
     void initialChangeDetection();
@@ -96,6 +125,9 @@ public:
     bool finished() const override { return _changeDetectionPhase == ChangeDetectionPhase::Finished; }
     void unfinish() override;
 
+    // Must be called when the edges of the component change
+    void invalidateAdjacency() { _adjacencyChanged = true; }
+
     void execute(bool firstIteration, Dimensionality dimensionality) override;
 };
 
@@ -19,6 +19,7 @@
 #include "layout.h"
 #include "shared/utils/thread.h"
 #include "shared/utils/container.h"
+#include "shared/utils/threadpool.h"
 
 #include "graph/graph.h"
 #include "graph/graphmodel.h"
@@ -26,6 +27,8 @@
 
 #include <QDebug>
 
+#include <vector>
+
 template<> constexpr bool EnableBitMaskOperators<Layout::Dimensionality> = true;
 
 static bool layoutIsFinished(const Layout& layout)
@@ -33,6 +36,42 @@ static bool layoutIsFinished(const Layout& layout)
     return layout.finished() || layout.graphComponent().numNodes() == 1;
 }
 
+// A rough measure of how much work a single iteration of a layout is
+static uint64_t layoutCost(const Layout& layout)
+{
+    return layout.nodeIds().size() + layout.edgeIds().size();
+}
+
+// Layouts that are cheaper than this are executed concurrently with each other, rather
+// than each parallelising internally, which for small components costs far more in
+// synchronisation than it gains
+static const uint64_t MaximumConcurrentLayoutCost = 2000;
+
+// Cheap layouts are given a budget of several iterations per pass, so that they don't
+// take (far) longer to converge than they would if they were executed alone
+static const uint64_t ConcurrentLayoutCostPerPass = 1000;
+static const uint64_t MaximumIterationsPerPass = 8;
+
+struct LayoutExecution
+{
+    Layout* _layout = nullptr;
+    bool _firstIteration = false;
+    uint64_t _iterations = 1;
+
+    uint64_t computeCostHint() const { return layoutCost(*_layout) * _iterations; }
+
+    void execute(Layout::Dimensionality dimensionalityMode)
+    {
+        for(uint64_t iteration = 0; iteration < _iterations; iteration++)
+        {
+            if(_layout->cancelled() || (iteration > 0 && layoutIsFinished(*_layout)))
+                break;
+
+            _layout->execute(_firstIteration && iteration == 0, dimensionalityMode);
+        }
+    }
+};
+
 LayoutThread::LayoutThread(GraphModel& graphModel,
                            std::unique_ptr<LayoutFactory>&& layoutFactory,
                            bool repeating) :
@@ -200,22 +239,61 @@ void LayoutThread::run()
     {
         u::setCurrentThreadName(QStringLiteral("Layout >"));
 
+        std::vector<LayoutExecution> concurrentExecutions;
+        std::vector<LayoutExecution> sequentialExecutions;
+        std::vector<ComponentId> executedComponentIds;
+        bool flatten = false;
+
         for(auto& [componentId, layout] : _layouts)
         {
             if(layoutIsFinished(*layout))
                 continue;
 
+            // If we're in 2D mode and the layout can handle it, flatten the positions
             if(_dimensionalityMode == Layout::Dimensionality::TwoDee &&
                (layout->dimensionality() & _dimensionalityMode))
             {
-                // If we're in 2D mode and the layout can handle it, flatten the positions
-                _nodeLayoutPositions.flatten();
+                flatten = true;
             }
 
-            layout->execute(!_executedAtLeastOnce.get(componentId), _dimensionalityMode);
-            _executedAtLeastOnce.set(componentId, true);
+            LayoutExecution execution;
+            execution._layout = layout.get();
+            execution._firstIteration = !_executedAtLeastOnce.get(componentId);
+
+            auto cost = layoutCost(*layout);
+            if(cost < MaximumConcurrentLayoutCost && layout->iterative())
+            {
+                execution._iterations = std::clamp(ConcurrentLayoutCostPerPass / std::max(cost, uint64_t{1}),
+                    uint64_t{1}, MaximumIterationsPerPass);
+                concurrentExecutions.push_back(execution);
+            }
+            else
+                sequentialExecutions.push_back(execution);
+
+            executedComponentIds.push_back(componentId);
+        }
+
+        if(flatten)
+            _nodeLayoutPositions.flatten();
+
+        // Each component's nodes are disjoint, so the layouts can't interfere with each other;
+        // any concurrent_for within the layouts themselves runs inline on the worker
+        if(!concurrentExecutions.empty())
+        {
+            concurrent_for(concurrentExecutions.begin(), concurrentExecutions.end(),
+            [dimensionalityMode = _dimensionalityMode](LayoutExecution& execution)
+            {
+                execution.execute(dimensionalityMode);
+            }, ThreadPool::Blocking, ThreadPool::NestedInline);
         }
 
+        // Larger layouts are executed one at a time, each parallelising internally
+        for(auto& execution : sequentialExecutions)
+            execution.execute(_dimensionalityMode);
+
+        for(auto componentId : executedComponentIds)
+            _executedAtLeastOnce.set(componentId, true);
+
         {
             std::unique_lock<NodePositions> lock(_graphModel->nodePositions());
             _graphModel->nodePositions().update(_nodeLayoutPositions);
@@ -16,318 +16,267 @@
  * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+
 #ifndef SPATIALTREE_H
 #define SPATIALTREE_H
 
-#include "shared/graph/igraphcomponent.h"
-#include "maths/boundingbox.h"
+#include "shared/graph/elementid.h"
 #include "nodepositions.h"
-#include "shared/utils/scopetimer.h"
-#include "shared/utils/threadpool.h"
 
 #include <QVector3D>
-#include <QColor>
+#include <QtGlobal>
 
-#include <functional>
 #include <vector>
-#include <memory>
-#include <stack>
 #include <array>
-#include <cstdlib>
-
-class AbstractSpatialTree
-{
-public:
-    virtual ~AbstractSpatialTree() = default;
-    virtual void build(const IGraphComponent& graph, const NodeLayoutPositions& nodePositions) = 0;
-};
-
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+
+// A linearised quadtree (NumDimensions == 2) or octree (NumDimensions == 3); the positions are
+// sorted along a Morton (Z-order) curve such that every node of the tree covers a contiguous
+// range of them, and the nodes themselves are stored contiguously, breadth first, with the
+// children of each node adjacent to each other. All storage is retained between builds, so
+// that rebuilding the tree on every iteration of a layout doesn't continually allocate
 template<size_t NumDimensions>
-using BoundingBox = typename std::conditional_t<NumDimensions == 3,
-    BoundingBox3D, typename std::conditional_t<NumDimensions == 2,
-    BoundingBox2D, void>>;
-
-template<typename TreeType, size_t NumDimensions>
-struct SubVolume
+class SpatialTree
 {
-    BoundingBox<NumDimensions> _boundingBox;
-    std::vector<NodeId> _nodeIds;
-    std::unique_ptr<TreeType> _subTree;
-    bool _leaf = true;
-    bool _empty = true;
-
-    // Floating point precision means that it becomes impossible to
-    // divide a bounding box beyond a certain minimum size. We don't
-    // want to allow that to happen, obviously, so this is a means
-    // to detect whether it would and avoid subdivision if so
-    bool divisible() const
-    {
-        const auto cx = _boundingBox.centre().x();
-        const auto xh = _boundingBox.xLength() * 0.5f;
-
-        if(cx + xh == cx || cx - xh == cx)
-            return false;
-
-        const auto cy = _boundingBox.centre().y();
-        const auto yh = _boundingBox.yLength() * 0.5f;
+    static_assert(NumDimensions == 2 || NumDimensions == 3);
 
-        if(cy + yh == cy || cy - yh == cy)
-            return false;
-
-        if constexpr(NumDimensions == 3)
-        {
-            const auto cz = _boundingBox.centre().z();
-            const auto zh = _boundingBox.zLength() * 0.5f;
-
-            if(cz + zh == cz || cz - zh == cz)
-                return false; // NOLINT
-        }
-
-        return true;
-    }
-};
+public:
+    // The number of levels that the Morton codes can distinguish
+    static constexpr size_t MaxDepth = 21;
+    static constexpr size_t NumCodeBits = MaxDepth * NumDimensions;
 
-// Use the CRT pattern so we can create instances of subclasses by default constructor
-template<typename TreeType, size_t NumDimensions, typename SubVolumeType = SubVolume<TreeType, NumDimensions>>
-class SpatialTree : virtual public AbstractSpatialTree
-{
-private:
-    static constexpr size_t NumSubVolumes()
+    struct Node
     {
-        size_t v = 1;
+        // The range of (sorted) positions covered by the node
+        uint32_t _begin = 0;
+        uint32_t _end = 0;
 
-        for(auto i = 0ul; i < NumDimensions; i++)
-            v *= 2;
+        uint32_t _firstChild = 0;
+        uint32_t _numChildren = 0;
 
-        return v;
-    }
+        // The edge length of the smallest cell that contains all of the node's positions
+        float _length = 0.0f;
 
-    BoundingBox<NumDimensions> _boundingBox;
+        bool leaf() const { return _numChildren == 0; }
+        bool contains(size_t index) const { return index >= _begin && index < _end; }
+    };
 
 protected:
-    size_t _depthFirstTraversalStackSizeRequirement = 0; // NOLINT cppcoreguidelines-non-private-member-variables-in-classes
-    std::array<SubVolumeType, NumSubVolumes()> _subVolumes = {}; // NOLINT cppcoreguidelines-non-private-member-variables-in-classes
-
-    std::array<const SubVolumeType*, NumSubVolumes()> _nonEmptyLeaves = {}; // NOLINT cppcoreguidelines-non-private-member-variables-in-classes
-    int _numNonEmptyLeaves = 0; // NOLINT cppcoreguidelines-non-private-member-variables-in-classes
+    // The positions, in Morton order, in structure of arrays form, and the NodeIds they belong to
+    std::vector<float> _x; // NOLINT cppcoreguidelines-non-private-member-variables-in-classes
+    std::vector<float> _y; // NOLINT cppcoreguidelines-non-private-member-variables-in-classes
+    std::vector<float> _z; // NOLINT cppcoreguidelines-non-private-member-variables-in-classes
+    std::vector<NodeId> _nodeIds; // NOLINT cppcoreguidelines-non-private-member-variables-in-classes
 
-    std::array<const SubVolumeType*, NumSubVolumes()> _internalNodes = {}; // NOLINT cppcoreguidelines-non-private-member-variables-in-classes
-    int _numInternalNodes = 0; // NOLINT cppcoreguidelines-non-private-member-variables-in-classes
+    // The root is the first node
+    std::vector<Node> _nodes; // NOLINT cppcoreguidelines-non-private-member-variables-in-classes
 
 private:
-    unsigned int _maxNodesPerLeaf = 1;
-
-    // Temporary data structure used in the creation of the tree
-    struct NewTree
+    std::vector<QVector3D> _unsortedPositions;
+    std::vector<uint64_t> _codes;
+    std::vector<uint32_t> _indices;
+    std::vector<uint64_t> _sortBufferCodes;
+    std::vector<uint32_t> _sortBufferIndices;
+
+    // Spreads the bits of value out such that there are NumDimensions - 1 zeros between each
+    static uint64_t spread(uint64_t value)
     {
-        SpatialTree* _tree;
-        std::vector<NodeId> _nodeIds;
-
-        NewTree(SpatialTree* tree, const std::vector<NodeId>& nodeIds) noexcept : // NOLINT
-            _tree(tree), _nodeIds(nodeIds)
-        {}
-
-        NewTree(SpatialTree* tree, std::vector<NodeId>&& nodeIds) noexcept :
-            _tree(tree), _nodeIds(std::move(nodeIds))
-        {}
-
-        NewTree(const NewTree& other) = default;
-        NewTree& operator=(const NewTree& other) = default;
-        NewTree(NewTree&& other) = default; // NOLINT
-        NewTree& operator=(NewTree&& other) = default; // NOLINT
-    };
-
-    void initialiseSubVolumes()
-    {
-        const auto cx = _boundingBox.centre().x();
-        const auto cy = _boundingBox.centre().y();
-        const auto xh = _boundingBox.xLength() * 0.5f;
-        const auto yh = _boundingBox.yLength() * 0.5f;
-
         if constexpr(NumDimensions == 3)
         {
-            const auto cz = _boundingBox.centre().z();
-            const auto zh = _boundingBox.zLength() * 0.5f;
-
-            // clang-format off
-            _subVolumes[0]._boundingBox = {{cx - xh, cy - yh, cz - zh}, {cx,      cy,      cz     }};
-            _subVolumes[1]._boundingBox = {{cx,      cy - yh, cz - zh}, {cx + xh, cy,      cz     }};
-            _subVolumes[2]._boundingBox = {{cx - xh, cy,      cz - zh}, {cx,      cy + yh, cz     }};
-            _subVolumes[3]._boundingBox = {{cx,      cy,      cz - zh}, {cx + xh, cy + yh, cz     }};
-
-            _subVolumes[4]._boundingBox = {{cx - xh, cy - yh, cz     }, {cx,      cy,      cz + zh}};
-            _subVolumes[5]._boundingBox = {{cx,      cy - yh, cz     }, {cx + xh, cy,      cz + zh}};
-            _subVolumes[6]._boundingBox = {{cx - xh, cy,      cz     }, {cx,      cy + yh, cz + zh}};
-            _subVolumes[7]._boundingBox = {{cx,      cy,      cz     }, {cx + xh, cy + yh, cz + zh}};
-            // clang-format on
+            value &= 0x1fffffULL;
+            value = (value | (value << 32U)) & 0x1f00000000ffffULL;
+            value = (value | (value << 16U)) & 0x1f0000ff0000ffULL;
+            value = (value | (value << 8U)) & 0x100f00f00f00f00fULL;
+            value = (value | (value << 4U)) & 0x10c30c30c30c30c3ULL;
+            value = (value | (value << 2U)) & 0x1249249249249249ULL;
         }
-        else if constexpr(NumDimensions == 2)
+        else
         {
-            // clang-format off
-            _subVolumes[0]._boundingBox = {{cx - xh, cy - yh}, {cx,      cy,    }};
-            _subVolumes[1]._boundingBox = {{cx,      cy - yh}, {cx + xh, cy,    }};
-            _subVolumes[2]._boundingBox = {{cx - xh, cy,    }, {cx,      cy + yh}};
-            _subVolumes[3]._boundingBox = {{cx,      cy,    }, {cx + xh, cy + yh}};
-            // clang-format on
+            value &= 0x1fffffULL;
+            value = (value | (value << 16U)) & 0x0000ffff0000ffffULL;
+            value = (value | (value << 8U)) & 0x00ff00ff00ff00ffULL;
+            value = (value | (value << 4U)) & 0x0f0f0f0f0f0f0f0fULL;
+            value = (value | (value << 2U)) & 0x3333333333333333ULL;
+            value = (value | (value << 1U)) & 0x5555555555555555ULL;
         }
 
-        for(auto& subVolume : _subVolumes)
-            Q_ASSERT(subVolume._boundingBox.valid());
+        return value;
     }
 
-    void distributeNodesOverSubVolumes(const NodeLayoutPositions& nodePositions, const std::vector<NodeId>& nodeIds)
+    // LSD radix sort of _indices by _codes
+    void sortByCode()
     {
-        initialiseSubVolumes();
+        const size_t DigitBits = 11;
+        const size_t Radix = size_t{1} << DigitBits;
+        const uint64_t DigitMask = Radix - 1;
 
-        bool distinctPositions = false;
-        QVector3D lastPosition = nodePositions.get(nodeIds[0]);
-
-        // Distribute NodeIds over SubVolumes
-        for(NodeId nodeId : nodeIds)
-        {
-            const QVector3D& nodePosition = nodePositions.get(nodeId);
-            SubVolumeType& subVolume = subVolumeForPoint(nodePosition);
+        const auto n = _codes.size();
+        _sortBufferCodes.resize(n);
+        _sortBufferIndices.resize(n);
 
-            subVolume._nodeIds.push_back(nodeId);
-
-            if(!distinctPositions)
-            {
-                if(nodePosition != lastPosition)
-                    distinctPositions = true;
-                else
-                    lastPosition = nodePosition;
-            }
-        }
+        std::array<uint32_t, Radix> offsets{};
 
-        // Decide if the SubVolumes need further sub-division
-        for(auto& subVolume : _subVolumes)
+        for(size_t shift = 0; shift < NumCodeBits; shift += DigitBits)
         {
-            if(subVolume._nodeIds.empty())
+            offsets.fill(0);
+            for(auto code : _codes)
+                offsets[(code >> shift) & DigitMask]++;
+
+            // This digit is the same for every code, so there is nothing to do
+            if(std::any_of(offsets.begin(), offsets.end(), [n](auto count) { return count == n; }))
                 continue;
 
-            if(subVolume._nodeIds.size() > _maxNodesPerLeaf &&
-               subVolume.divisible() && distinctPositions)
+            uint32_t total = 0;
+            for(auto& offset : offsets)
             {
-                // Subdivide
-                subVolume._subTree = std::make_unique<TreeType>();
-                subVolume._subTree->_boundingBox = subVolume._boundingBox;
-
-                subVolume._leaf = false;
-                _internalNodes.at(_numInternalNodes++) = &subVolume;
+                auto count = offset;
+                offset = total;
+                total += count;
             }
-            else
+
+            for(size_t i = 0; i < n; i++)
             {
-                subVolume._empty = false;
-                _nonEmptyLeaves.at(_numNonEmptyLeaves++) = &subVolume;
+                auto destination = offsets[(_codes[i] >> shift) & DigitMask]++;
+                _sortBufferCodes[destination] = _codes[i];
+                _sortBufferIndices[destination] = _indices[i];
             }
+
+            std::swap(_codes, _sortBufferCodes);
+            std::swap(_indices, _sortBufferIndices);
         }
     }
 
-    // The second parameter and superset of _subVolumes[x]._nodeIds are the
-    // same, at the point when this is called
-    virtual void initialise(const NodeLayoutPositions&, const std::vector<NodeId>&) {}
+    // The level of the smallest cell that contains both codes
+    static size_t commonLevel(uint64_t a, uint64_t b)
+    {
+        auto difference = a ^ b;
+        size_t level = MaxDepth;
+
+        while(difference != 0)
+        {
+            difference >>= NumDimensions;
+            level--;
+        }
+
+        return level;
+    }
 
-    void build(const std::vector<NodeId>& nodeIds, const NodeLayoutPositions& nodePositions)
+public:
+    size_t size() const { return _nodeIds.size(); }
+    const std::vector<Node>& nodes() const { return _nodes; }
+    NodeId nodeIdAt(size_t index) const { return _nodeIds[index]; }
+
+    void build(const std::vector<NodeId>& nodeIds, const NodeLayoutPositions& nodePositions,
+        size_t maxPositionsPerLeaf = 1)
     {
-        SCOPE_TIMER_MULTISAMPLES(50)
+        const auto n = nodeIds.size();
+        Q_ASSERT(n < std::numeric_limits<uint32_t>::max());
+
+        _nodes.clear();
+        _nodeIds.resize(n);
+        _x.resize(n);
+        _y.resize(n);
+        _z.resize(n);
 
-        std::vector<NewTree> newTrees;
-        newTrees.emplace_back(this, nodeIds);
+        if(n == 0)
+            return;
 
-        while(!newTrees.empty())
+        _unsortedPositions.resize(n);
+        QVector3D min(std::numeric_limits<float>::max(),
+            std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+        QVector3D max(std::numeric_limits<float>::lowest(),
+            std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest());
+
+        for(size_t i = 0; i < n; i++)
         {
-            auto results = concurrent_for(newTrees.begin(), newTrees.end(),
-            [&nodePositions](typename std::vector<NewTree>::iterator it)
-            {
-                auto* subTree = it->_tree;
-                const auto& nodeIdsToDistribute = it->_nodeIds;
+            const auto& position = nodePositions.get(nodeIds[i]);
+            _unsortedPositions[i] = position;
 
-                subTree->distributeNodesOverSubVolumes(nodePositions, nodeIdsToDistribute);
+            for(int axis = 0; axis < static_cast<int>(NumDimensions); axis++)
+            {
+                min[axis] = std::min(min[axis], position[axis]);
+                max[axis] = std::max(max[axis], position[axis]);
+            }
+        }
 
-                std::vector<NewTree> newChildTrees;
-                for(int i = 0; i < subTree->_numInternalNodes; i++)
-                {
-                    const auto* subVolume = subTree->_internalNodes.at(i);
-                    newChildTrees.emplace_back(subVolume->_subTree.get(),
-                        std::move(subVolume->_nodeIds));
-                }
+        // The root cell is a square/cube
+        float rootLength = 0.0f;
+        for(int axis = 0; axis < static_cast<int>(NumDimensions); axis++)
+            rootLength = std::max(rootLength, max[axis] - min[axis]);
 
-                subTree->initialise(nodePositions, nodeIdsToDistribute);
+        if(rootLength <= 0.0f)
+            rootLength = 1.0f;
 
-                return newChildTrees;
-            });
+        const auto MaxCoordinate = static_cast<float>((uint64_t{1} << MaxDepth) - 1);
+        const float scale = MaxCoordinate / rootLength;
 
-            // subTrees has now been processsed, but may have resulted in more subTrees
-            newTrees.clear();
-            newTrees.insert(newTrees.end(), std::make_move_iterator(results.begin()),
-                std::make_move_iterator(results.end()));
-        }
+        _codes.resize(n);
+        _indices.resize(n);
 
-        std::stack<const SpatialTree*> stack;
-        stack.push(this);
-        _depthFirstTraversalStackSizeRequirement = 1;
-        while(!stack.empty())
+        for(size_t i = 0; i < n; i++)
         {
-            const SpatialTree* subTree = stack.top();
-            stack.pop();
-
-            for(int i = 0; i < subTree->_numInternalNodes; i++)
+            uint64_t code = 0;
+            for(int axis = 0; axis < static_cast<int>(NumDimensions); axis++)
             {
-                const auto* subVolume = subTree->_internalNodes.at(i);
-                stack.push(subVolume->_subTree.get());
-                _depthFirstTraversalStackSizeRequirement =
-                    std::max(_depthFirstTraversalStackSizeRequirement, stack.size());
+                auto coordinate = std::clamp((_unsortedPositions[i][axis] - min[axis]) * scale, 0.0f, MaxCoordinate);
+                code |= spread(static_cast<uint64_t>(coordinate)) << static_cast<uint64_t>(axis);
             }
+
+            _codes[i] = code;
+            _indices[i] = static_cast<uint32_t>(i);
         }
-    }
 
-    SubVolumeType& subVolumeForPoint(const QVector3D& point)
-    {
-        size_t i = 0;
-        QVector3D diff = point - _boundingBox.centre();
+        sortByCode();
 
-        if constexpr(NumDimensions == 3)
+        for(size_t i = 0; i < n; i++)
         {
-            if(diff.z() >= 0.0f)
-                i += 4;
+            const auto index = _indices[i];
+            const auto& position = _unsortedPositions[index];
+
+            _x[i] = position.x();
+            _y[i] = position.y();
+            _z[i] = position.z();
+            _nodeIds[i] = nodeIds[index];
         }
 
-        if(diff.y() >= 0.0f)
-            i += 2;
+        // Subdivide breadth first, such that the children of each node are contiguous
+        _nodes.push_back({0, static_cast<uint32_t>(n), 0, 0, 0.0f});
+        for(size_t nodeIndex = 0; nodeIndex < _nodes.size(); nodeIndex++)
+        {
+            auto begin = _nodes[nodeIndex]._begin;
+            auto end = _nodes[nodeIndex]._end;
 
-        if(diff.x() >= 0.0f)
-            i += 1;
+            // Skip straight to the level where the positions diverge, rather than
+            // creating a chain of nodes each with a single child
+            auto level = commonLevel(_codes[begin], _codes[end - 1]);
+            _nodes[nodeIndex]._length = rootLength / static_cast<float>(uint64_t{1} << level);
 
-        Q_ASSERT(i < NumSubVolumes());
-        SubVolumeType& subVolume = _subVolumes.at(i);
+            if(end - begin <= maxPositionsPerLeaf || level == MaxDepth)
+                continue;
 
-        if(!subVolume._leaf)
-            return subVolume._subTree->subVolumeForPoint(point);
+            const auto shift = (MaxDepth - level - 1) * NumDimensions;
+            const auto firstChild = static_cast<uint32_t>(_nodes.size());
+            uint32_t numChildren = 0;
 
-        return subVolume;
-    }
+            for(auto childBegin = begin; childBegin < end;)
+            {
+                auto prefix = _codes[childBegin] >> shift;
+                auto childEnd = static_cast<uint32_t>(std::upper_bound(
+                    _codes.begin() + childBegin, _codes.begin() + end, prefix,
+                    [shift](uint64_t value, uint64_t code) { return value < (code >> shift); }) - _codes.begin());
 
-    const SubVolumeType& subVolumeForPoint(const QVector3D& point) const
-    {
-        return subVolumeForPoint(point);
-    }
+                _nodes.push_back({childBegin, childEnd, 0, 0, 0.0f});
+                numChildren++;
 
-protected:
-    void setMaxNodesPerLeaf(unsigned int maxNodesPerLeaf) { _maxNodesPerLeaf = maxNodesPerLeaf; }
+                childBegin = childEnd;
+            }
 
-public:
-    void build(const IGraphComponent& graph, const NodeLayoutPositions& nodePositions) override
-    {
-        if constexpr(NumDimensions == 2)
-        {
-            auto boundingBox3D = nodePositions.boundingBox(graph.nodeIds());
-            _boundingBox = {boundingBox3D.min().toVector2D(), boundingBox3D.max().toVector2D()};
+            _nodes[nodeIndex]._firstChild = firstChild;
+            _nodes[nodeIndex]._numChildren = numChildren;
         }
-        else if constexpr(NumDimensions == 3)
-            _boundingBox = nodePositions.boundingBox(graph.nodeIds());
-
-        Q_ASSERT(_boundingBox.valid());
-        build(graph.nodeIds(), nodePositions);
     }
 };
 
@@ -0,0 +1,583 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "nativeformat.h"
+
+#include "shared/graph/imutablegraph.h"
+#include "shared/utils/container.h"
+#include "shared/utils/threadpool.h"
+
+#include <QFile>
+#include <QObject>
+#include <QtEndian>
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <utility>
+
+#include <zlib.h>
+
+const int NativeFormat::Version = 6;
+const QByteArray NativeFormat::Magic = QByteArrayLiteral("GRAPHIA\x01");
+const int NativeFormat::ChunkSize = 1 << 22;
+const std::string NativeFormat::PluginSectionPrefix = "plugin.";
+
+namespace
+{
+// The header follows the sections, so its offset is written after Magic once it's known
+using HeaderOffset = quint64;
+const qint64 HeaderOffsetSize = static_cast<qint64>(sizeof(HeaderOffset));
+
+// Headers list the sizes of the chunks, so are small; anything larger is corrupt
+const qint64 MaxHeaderSize = 1 << 24;
+
+// Deflate can't do better than this, so a chunk that claims to is corrupt
+const qint64 MaxCompressionRatio = 1032;
+
+// Chunks are compressed and decompressed in batches that keep every thread busy,
+// without holding any more of them in memory than that
+size_t chunksPerBatch()
+{
+    return std::max<size_t>(1, 2 * concurrent_for_num_threads());
+}
+
+struct CompressedChunk
+{
+    const char* _data = nullptr;
+    int _size = 0;
+    QByteArray _compressed;
+};
+
+struct DecompressedChunk
+{
+    QByteArray _compressed;
+    char* _data = nullptr;
+    int _size = 0;
+};
+
+// Returns the offset of the header, or -1 if it doesn't lie between the data and the end of file
+qint64 readHeaderOffset(QFile& file)
+{
+    if(!file.seek(0) || file.read(NativeFormat::Magic.size()) != NativeFormat::Magic)
+        return -1;
+
+    HeaderOffset headerOffset = 0;
+    if(file.read(reinterpret_cast<char*>(&headerOffset), HeaderOffsetSize) != HeaderOffsetSize) // NOLINT
+        return -1;
+
+    headerOffset = qFromLittleEndian(headerOffset);
+
+    if(headerOffset < static_cast<HeaderOffset>(file.pos()) ||
+        headerOffset > static_cast<HeaderOffset>(file.size()))
+    {
+        return -1;
+    }
+
+    return static_cast<qint64>(headerOffset);
+}
+} // namespace
+
+NativeFormat::Writer::Writer(const QString& filePath, Progressable& progressable) :
+    _file(filePath), _progressable(&progressable)
+{
+    if(!_file.open(QIODevice::WriteOnly))
+        return;
+
+    // Patched by finish
+    HeaderOffset headerOffset = 0;
+
+    _ok = _file.write(Magic) == Magic.size() &&
+        _file.write(reinterpret_cast<const char*>(&headerOffset), HeaderOffsetSize) == HeaderOffsetSize; // NOLINT
+}
+
+bool NativeFormat::Writer::addSection(const std::string& name, const QByteArray& data)
+{
+    if(!_ok)
+        return false;
+
+    _ok = false;
+
+    json compressedSizes = json::array();
+    const auto numChunks = static_cast<size_t>((static_cast<qint64>(data.size()) + ChunkSize - 1) / ChunkSize);
+
+    std::vector<CompressedChunk> chunks;
+    chunks.reserve(std::min(numChunks, chunksPerBatch()));
+
+    auto writeChunks = [&]
+    {
+        std::atomic<bool> failed{false};
+
+        concurrent_for(chunks.begin(), chunks.end(),
+        [&failed](std::vector<CompressedChunk>::iterator chunk)
+        {
+            auto compressedSize = compressBound(static_cast<uLong>(chunk->_size));
+            chunk->_compressed.resize(static_cast<int>(compressedSize));
+
+            auto ret = compress2(reinterpret_cast<Bytef*>(chunk->_compressed.data()), &compressedSize, // NOLINT
+                reinterpret_cast<const Bytef*>(chunk->_data), static_cast<uLong>(chunk->_size), // NOLINT
+                Z_DEFAULT_COMPRESSION);
+
+            if(ret != Z_OK)
+                failed = true;
+
+            chunk->_compressed.resize(static_cast<int>(compressedSize));
+        });
+
+        if(failed)
+            return false;
+
+        for(const auto& chunk : chunks)
+        {
+            if(_file.write(chunk._compressed) != chunk._compressed.size())
+                return false;
+
+            compressedSizes.push_back(chunk._compressed.size());
+        }
+
+        chunks.clear();
+        _progressable->setProgress(static_cast<int>((compressedSizes.size() * 100) / numChunks));
+
+        return true;
+    };
+
+    for(int offset = 0; offset < data.size(); offset += std::min(ChunkSize, data.size() - offset))
+    {
+        CompressedChunk chunk;
+        chunk._data = data.constData() + offset;
+        chunk._size = std::min(ChunkSize, data.size() - offset);
+        chunks.push_back(chunk);
+
+        if(chunks.size() == chunksPerBatch() && !writeChunks())
+            return false;
+    }
+
+    if(!chunks.empty() && !writeChunks())
+        return false;
+
+    _progressable->setProgress(-1);
+
+    json jsonSection;
+    jsonSection["name"] = name;
+    jsonSection["size"] = data.size();
+    jsonSection["chunks"] = compressedSizes;
+    _sections.push_back(jsonSection);
+
+    _ok = true;
+    return true;
+}
+
+bool NativeFormat::Writer::finish(json header)
+{
+    if(!_ok)
+        return false;
+
+    _ok = false;
+
+    header["compression"] = "zlib";
+    header["chunkSize"] = ChunkSize;
+    header["sections"] = _sections;
+
+    auto headerOffset = qToLittleEndian(static_cast<HeaderOffset>(_file.pos()));
+    auto headerByteArray = QByteArray::fromStdString(header.dump());
+
+    if(_file.write(headerByteArray) != headerByteArray.size())
+        return false;
+
+    if(!_file.seek(Magic.size()))
+        return false;
+
+    if(_file.write(reinterpret_cast<const char*>(&headerOffset), HeaderOffsetSize) != HeaderOffsetSize) // NOLINT
+        return false;
+
+    if(!_file.flush())
+        return false;
+
+    _file.close();
+
+    return true;
+}
+
+bool NativeFormat::write(const QString& filePath, json header, const std::vector<Section>& sections,
+    Progressable& progressable)
+{
+    Writer writer(filePath, progressable);
+
+    for(const auto& section : sections)
+    {
+        if(!writer.addSection(section._name, section._data))
+            return false;
+    }
+
+    return writer.finish(std::move(header));
+}
+
+json NativeFormat::readHeader(const QString& filePath, qint64& dataOffset)
+{
+    QFile file(filePath);
+
+    if(!file.open(QIODevice::ReadOnly))
+        return {};
+
+    auto headerOffset = readHeaderOffset(file);
+    if(headerOffset < 0)
+        return {};
+
+    auto headerSize = file.size() - headerOffset;
+    if(headerSize > MaxHeaderSize)
+        return {};
+
+    dataOffset = file.pos();
+
+    if(!file.seek(headerOffset))
+        return {};
+
+    auto headerByteArray = file.read(headerSize);
+    if(headerByteArray.size() != headerSize)
+        return {};
+
+    return json::parse(headerByteArray.begin(), headerByteArray.end(), nullptr, false);
+}
+
+// Checks that the chunks the header describes exactly fill the data, then reads each
+// section a batch of chunks at a time, decompressing each batch concurrently
+bool NativeFormat::readSections(const QString& filePath, const json& jsonHeader, qint64 dataOffset,
+    const SectionFn& sectionFn, Progressable& progressable)
+{
+    if(!u::contains(jsonHeader, "compression") || jsonHeader["compression"] != "zlib")
+        return false;
+
+    if(!u::contains(jsonHeader, "chunkSize") || !jsonHeader["chunkSize"].is_number_integer())
+        return false;
+
+    if(!u::contains(jsonHeader, "sections") || !jsonHeader["sections"].is_array())
+        return false;
+
+    auto chunkSize = jsonHeader["chunkSize"].get<int64_t>();
+    if(chunkSize <= 0 || chunkSize > std::numeric_limits<int>::max())
+        return false;
+
+    QFile file(filePath);
+
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+
+    auto dataEnd = readHeaderOffset(file);
+    if(dataEnd < 0 || dataOffset != file.pos())
+        return false;
+
+    struct SectionLayout
+    {
+        std::string _name;
+        int _size = 0;
+        std::vector<int> _compressedSizes;
+    };
+
+    std::vector<SectionLayout> layouts;
+    qint64 totalCompressedSize = 0;
+
+    for(const auto& jsonSection : jsonHeader["sections"])
+    {
+        if(!u::contains(jsonSection, "name") || !jsonSection["name"].is_string() ||
+            !u::contains(jsonSection, "size") || !jsonSection["size"].is_number_integer() ||
+            !u::contains(jsonSection, "chunks") || !jsonSection["chunks"].is_array())
+        {
+            return false;
+        }
+
+        auto size = jsonSection["size"].get<int64_t>();
+        const auto& compressedSizes = jsonSection["chunks"];
+
+        if(size < 0 || size > std::numeric_limits<int>::max() ||
+            compressedSizes.size() != static_cast<size_t>((size + chunkSize - 1) / chunkSize))
+        {
+            return false;
+        }
+
+        SectionLayout layout;
+        layout._name = jsonSection["name"].get<std::string>();
+        layout._size = static_cast<int>(size);
+
+        if(std::any_of(layouts.begin(), layouts.end(),
+            [&layout](const auto& other) { return other._name == layout._name; }))
+        {
+            return false;
+        }
+
+        auto remaining = size;
+        for(const auto& jsonCompressedSize : compressedSizes)
+        {
+            if(!jsonCompressedSize.is_number_integer())
+                return false;
+
+            auto compressedSize = jsonCompressedSize.get<int64_t>();
+            auto chunkDataSize = std::min(chunkSize, remaining);
+
+            if(compressedSize <= 0 || compressedSize > (dataEnd - dataOffset) - totalCompressedSize ||
+                chunkDataSize > compressedSize * MaxCompressionRatio)
+            {
+                return false;
+            }
+
+            totalCompressedSize += compressedSize;
+            remaining -= chunkDataSize;
+            layout._compressedSizes.push_back(static_cast<int>(compressedSize));
+        }
+
+        layouts.push_back(std::move(layout));
+    }
+
+    // Nothing has been allocated yet, so a header that describes more (or less)
+    // than the file contains costs nothing
+    if(dataOffset + totalCompressedSize != dataEnd || !file.seek(dataOffset))
+        return false;
+
+    std::vector<DecompressedChunk> chunks;
+    chunks.reserve(chunksPerBatch());
+
+    auto readChunks = [&]
+    {
+        std::atomic<bool> failed{false};
+
+        concurrent_for(chunks.begin(), chunks.end(),
+        [&failed](std::vector<DecompressedChunk>::iterator chunk)
+        {
+            auto size = static_cast<uLongf>(chunk->_size);
+            auto ret = uncompress(reinterpret_cast<Bytef*>(chunk->_data), &size, // NOLINT
+                reinterpret_cast<const Bytef*>(chunk->_compressed.constData()), // NOLINT
+                static_cast<uLong>(chunk->_compressed.size()));
+
+            if(ret != Z_OK || size != static_cast<uLongf>(chunk->_size))
+                failed = true;
+        });
+
+        chunks.clear();
+        progressable.setProgress(static_cast<int>(((file.pos() - dataOffset) * 100) /
+            std::max<qint64>(1, totalCompressedSize)));
+
+        return !failed;
+    };
+
+    for(const auto& layout : layouts)
+    {
+        QByteArray section(layout._size, '\0');
+
+        int offset = 0;
+        for(auto compressedSize : layout._compressedSizes)
+        {
+            DecompressedChunk chunk;
+            chunk._compressed = file.read(compressedSize);
+            chunk._data = section.data() + offset;
+            chunk._size = static_cast<int>(std::min<int64_t>(chunkSize, layout._size - offset));
+
+            if(chunk._compressed.size() != compressedSize)
+                return false;
+
+            offset += chunk._size;
+            chunks.push_back(std::move(chunk));
+
+            if(chunks.size() == chunksPerBatch() && !readChunks())
+                return false;
+        }
+
+        if(!chunks.empty() && !readChunks())
+            return false;
+
+        if(!sectionFn(layout._name, section))
+            return false;
+    }
+
+    progressable.setProgress(-1);
+
+    return true;
+}
+
+bool NativeFormat::readSections(const QString& filePath, const json& jsonHeader, qint64 dataOffset,
+    Sections& sections, Progressable& progressable)
+{
+    return readSections(filePath, jsonHeader, dataOffset,
+    [&sections](const std::string& name, QByteArray& data)
+    {
+        sections.emplace(name, std::move(data));
+        return true;
+    }, progressable);
+}
+
+QByteArray NativeFormat::graphAsBinary(const IGraph& graph, Progressable& progressable)
+{
+    QByteArray byteArray;
+    QDataStream stream(&byteArray, QIODevice::WriteOnly);
+    initialiseStream(stream);
+
+    graph.setPhase(QObject::tr("Nodes"));
+    stream << static_cast<qint32>(graph.nextNodeId()) << static_cast<qint32>(graph.numNodes());
+
+    int i = 0;
+    for(auto nodeId : graph.nodeIds())
+    {
+        stream << static_cast<qint32>(nodeId);
+        progressable.setProgress((i++ * 100) / graph.numNodes());
+    }
+
+    progressable.setProgress(-1);
+
+    graph.setPhase(QObject::tr("Edges"));
+    stream << static_cast<qint32>(graph.nextEdgeId()) << static_cast<qint32>(graph.numEdges());
+
+    i = 0;
+    for(auto edgeId : graph.edgeIds())
+    {
+        const auto& edge = graph.edgeById(edgeId);
+
+        stream << static_cast<qint32>(edgeId) <<
+            static_cast<qint32>(edge.sourceId()) <<
+            static_cast<qint32>(edge.targetId());
+
+        progressable.setProgress((i++ * 100) / graph.numEdges());
+    }
+
+    progressable.setProgress(-1);
+
+    return byteArray;
+}
+
+bool NativeFormat::parseGraph(const QByteArray& byteArray, IMutableGraph& graph, IParser& parser)
+{
+    QDataStream stream(byteArray);
+    initialiseStream(stream);
+
+    // Each element count is preceded by the number of ids that had been allocated when the
+    // graph was saved, including those of elements deleted since, so that every id can be
+    // checked against it before anything is allocated for it; the ids are checked with a
+    // bitmap, which, small graphs aside, mustn't be any bigger than the section itself
+    const qint64 maxIdCount = std::max(static_cast<qint64>(byteArray.size()) * 8, qint64{1} << 16);
+    auto validIdCount = [&byteArray, maxIdCount](qint32 idCount, qint32 count)
+    {
+        return count >= 0 && count <= byteArray.size() && idCount >= count && idCount <= maxIdCount;
+    };
+
+    qint32 nodeIdCount = 0;
+    qint32 numNodes = 0;
+    stream >> nodeIdCount >> numNodes;
+
+    if(stream.status() != QDataStream::Ok || !validIdCount(nodeIdCount, numNodes))
+        return false;
+
+    std::vector<NodeId> nodeIds;
+    nodeIds.reserve(static_cast<size_t>(numNodes));
+    std::vector<bool> nodeIdExists(static_cast<size_t>(nodeIdCount), false);
+    bool contiguousNodeIds = true;
+
+    for(qint32 i = 0; i < numNodes; i++)
+    {
+        qint32 nodeId = -1;
+        stream >> nodeId;
+
+        if(stream.status() != QDataStream::Ok || nodeId < 0 || nodeId >= nodeIdCount)
+            return false;
+
+        // Duplicates
+        if(nodeIdExists[static_cast<size_t>(nodeId)])
+            return false;
+
+        nodeIdExists[static_cast<size_t>(nodeId)] = true;
+        contiguousNodeIds = contiguousNodeIds && nodeId == i;
+        nodeIds.emplace_back(nodeId);
+    }
+
+    qint32 edgeIdCount = 0;
+    qint32 numEdges = 0;
+    stream >> edgeIdCount >> numEdges;
+
+    if(stream.status() != QDataStream::Ok || !validIdCount(edgeIdCount, numEdges))
+        return false;
+
+    std::vector<EdgeId> edgeIds;
+    edgeIds.reserve(static_cast<size_t>(numEdges));
+    std::vector<std::pair<NodeId, NodeId>> edges;
+    edges.reserve(static_cast<size_t>(numEdges));
+    std::vector<bool> edgeIdExists(static_cast<size_t>(edgeIdCount), false);
+    bool contiguousEdgeIds = true;
+
+    auto isNodeId = [&nodeIdExists](qint32 nodeId)
+    {
+        return nodeId >= 0 && static_cast<size_t>(nodeId) < nodeIdExists.size() &&
+            nodeIdExists[static_cast<size_t>(nodeId)];
+    };
+
+    for(qint32 i = 0; i < numEdges; i++)
+    {
+        qint32 edgeId = -1;
+        qint32 sourceId = -1;
+        qint32 targetId = -1;
+        stream >> edgeId >> sourceId >> targetId;
+
+        if(stream.status() != QDataStream::Ok || edgeId < 0 || edgeId >= edgeIdCount ||
+            !isNodeId(sourceId) || !isNodeId(targetId))
+        {
+            return false;
+        }
+
+        if(edgeIdExists[static_cast<size_t>(edgeId)])
+            return false;
+
+        edgeIdExists[static_cast<size_t>(edgeId)] = true;
+        contiguousEdgeIds = contiguousEdgeIds && edgeId == i;
+        edgeIds.emplace_back(edgeId);
+        edges.emplace_back(sourceId, targetId);
+    }
+
+    graph.setPhase(QObject::tr("Nodes"));
+
+    // When the ids have no gaps, which is the case unless elements were deleted before saving,
+    // the graph can be built in bulk, which gives the same ids as adding each individually
+    if(contiguousNodeIds)
+    {
+        if(numNodes > 0 && graph.bulkAddNodes(nodeIds.size()) != NodeId(0))
+            return false;
+    }
+    else if(numNodes > 0)
+    {
+        graph.reserveNodeId(*std::max_element(nodeIds.begin(), nodeIds.end()));
+        graph.addNodes(nodeIds);
+    }
+
+    if(parser.cancelled())
+        return false;
+
+    graph.setPhase(QObject::tr("Edges"));
+
+    if(contiguousEdgeIds)
+    {
+        if(numEdges > 0 && graph.bulkAddEdges(edges) != EdgeId(0))
+            return false;
+    }
+    else if(numEdges > 0)
+    {
+        graph.reserveEdgeId(*std::max_element(edgeIds.begin(), edgeIds.end()));
+
+        for(size_t i = 0; i < edgeIds.size(); i++)
+        {
+            graph.addEdge(edgeIds[i], edges[i].first, edges[i].second);
+            parser.setProgress(static_cast<int>((i * 100) / edgeIds.size()));
+        }
+
+        parser.setProgress(-1);
+    }
+
+    return true;
+}
@@ -0,0 +1,105 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NATIVEFORMAT_H
+#define NATIVEFORMAT_H
+
+#include "shared/graph/igraph.h"
+#include "shared/graph/grapharray_binary.h"
+#include "shared/loading/iparser.h"
+#include "shared/utils/progressable.h"
+
+#include <json_helper.h>
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QFile>
+#include <QString>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+class IMutableGraph;
+
+// From version 6, native files start with Magic, followed by the offset of a JSON header, which
+// is at the end of the file; before it are the compressed chunks of each of the sections that
+// the header describes, so that each section can be written as soon as it's ready
+namespace NativeFormat
+{
+// The version of the files that are written
+extern const int Version;
+
+extern const QByteArray Magic;
+extern const int ChunkSize;
+
+// The sections a plugin saves for itself are named with this prefix
+extern const std::string PluginSectionPrefix;
+
+struct Section
+{
+    std::string _name;
+    QByteArray _data;
+};
+
+using Sections = std::map<std::string, QByteArray>;
+
+// Given each section as soon as it's been read, after which it's discarded, unless it's moved
+// from; returning false stops the reading, which then fails
+using SectionFn = std::function<bool(const std::string& name, QByteArray& data)>;
+
+// Each section is split into chunks, which are compressed independently, and concurrently, then
+// written before the next section is added, so only one need be held in memory at a time
+class Writer
+{
+private:
+    QFile _file;
+    Progressable* _progressable = nullptr;
+    json _sections = json::array();
+    bool _ok = false;
+
+public:
+    Writer(const QString& filePath, Progressable& progressable);
+
+    bool addSection(const std::string& name, const QByteArray& data);
+
+    // Writes the header, which is given the details of the sections
+    bool finish(json header);
+};
+
+bool write(const QString& filePath, json header, const std::vector<Section>& sections,
+    Progressable& progressable);
+
+// Returns something other than an object if filePath isn't a chunked file
+json readHeader(const QString& filePath, qint64& dataOffset);
+
+// Each section is read and decompressed in turn, once the header has been checked against the
+// file, so a corrupt header can't cause anything to be allocated that the file couldn't fill
+bool readSections(const QString& filePath, const json& header, qint64 dataOffset,
+    const SectionFn& sectionFn, Progressable& progressable);
+
+// Reads every section, keeping them all
+bool readSections(const QString& filePath, const json& header, qint64 dataOffset,
+    Sections& sections, Progressable& progressable);
+
+QByteArray graphAsBinary(const IGraph& graph, Progressable& progressable);
+bool parseGraph(const QByteArray& byteArray, IMutableGraph& graph, IParser& parser);
+} // namespace NativeFormat
+
+#endif // NATIVEFORMAT_H
@@ -17,7 +17,7 @@
  */
 
 #include "nativeloader.h"
-#include "nativesaver.h"
+#include "nativeformat.h"
 
 #include "application.h"
 
@@ -31,10 +31,14 @@
 #include "shared/loading/jsongraphparser.h"
 
 #include <QString>
+#include <QFile>
 #include <QFileInfo>
 #include <QDataStream>
 #include <QRegularExpression>
+#include <QVector3D>
 
+#include <algorithm>
+#include <map>
 #include <vector>
 
 #include <json_helper.h>
@@ -187,14 +191,22 @@ struct Header
     int _version = -1;
     QString _pluginName;
     int _pluginDataVersion = -1;
+
+    // Chunked files have the details of their sections in the header
+    bool _chunked = false;
+    json _json;
+    qint64 _dataOffset = 0;
 };
 
-static bool parseHeader(const QUrl& url, Header* header = nullptr)
+static json parseLegacyHeader(const QString& filePath)
 {
+    // Before version 6 the header was at the start of the file, and never longer than this
+    const int MaxHeaderSize = 1 << 12;
+
     QByteArray byteArray;
 
-    if(!load(url.toLocalFile(), byteArray, NativeSaver::MaxHeaderSize))
-        return false;
+    if(!load(filePath, byteArray, MaxHeaderSize))
+        return {};
 
     // byteArray now has a JSON fragment that hopefully includes the header
     QString fragment(byteArray);
@@ -230,7 +242,18 @@ static bool parseHeader(const QUrl& url, Header* header = nullptr)
 
     QString headerString = fragment.left(position);
     auto headerByteArray = headerString.toUtf8();
-    json jsonHeader = json::parse(headerByteArray.begin(), headerByteArray.end(), nullptr, false);
+
+    return json::parse(headerByteArray.begin(), headerByteArray.end(), nullptr, false);
+}
+
+static bool parseHeader(const QUrl& url, Header* header = nullptr)
+{
+    qint64 dataOffset = 0;
+    auto jsonHeader = NativeFormat::readHeader(url.toLocalFile(), dataOffset);
+    bool chunked = jsonHeader.is_object();
+
+    if(!chunked)
+        jsonHeader = parseLegacyHeader(url.toLocalFile());
 
     if(jsonHeader.is_discarded() || jsonHeader.is_null() || !jsonHeader.is_object())
         return false;
@@ -249,6 +272,9 @@ static bool parseHeader(const QUrl& url, Header* header = nullptr)
         header->_version            = jsonHeader["version"];
         header->_pluginName         = QString::fromStdString(jsonHeader["pluginName"]);
         header->_pluginDataVersion  = jsonHeader["pluginDataVersion"];
+        header->_chunked            = chunked;
+        header->_json               = jsonHeader;
+        header->_dataOffset         = dataOffset;
     }
 
     return true;
@@ -266,53 +292,142 @@ bool Loader::parse(const QUrl& url, IGraphModel* graphModel)
 
     auto version = header._version;
 
-    if(version > NativeSaver::Version)
+    if(version > NativeFormat::Version)
     {
         setFailureReason(QObject::tr("Produced using a newer version of %1.")
             .arg(Application::name()));
         return false;
     }
 
-    QByteArray byteArray;
+    json jsonBody;
+    NativeFormat::Sections sections;
+    std::map<QString, QByteArray> pluginSections;
 
-    if(!load(url.toLocalFile(), byteArray, -1, &graphModel->mutableGraph(), this))
-        return false;
+    auto parseNodeNames = [&](const QByteArray& byteArray)
+    {
+        graphModel->mutableGraph().setPhase(QObject::tr("Node Names"));
 
-    setProgress(-1);
+        return NativeFormat::forEachBinaryNodeArray(byteArray, graphModel->mutableGraph(), *this,
+        [&](QDataStream& stream, NodeId nodeId)
+        {
+            QString nodeName;
+            stream >> nodeName;
+            graphModel->setNodeName(nodeId, nodeName);
+        });
+    };
 
-    auto jsonArray = parseJsonFrom(byteArray, this);
+    auto parsePositions = [&](const QByteArray& byteArray)
+    {
+        _nodePositions = std::make_unique<ExactNodePositions>(graphModel->mutableGraph());
 
-    if(cancelled())
-        return false;
+        return NativeFormat::forEachBinaryNodeArray(byteArray, graphModel->mutableGraph(), *this,
+        [&](QDataStream& stream, NodeId nodeId)
+        {
+            float x = 0.0f;
+            float y = 0.0f;
+            float z = 0.0f;
+            stream >> x >> y >> z;
+            _nodePositions->set(nodeId, QVector3D(x, y, z));
+        });
+    };
+
+    if(header._chunked)
+    {
+        graphModel->mutableGraph().setPhase(QObject::tr("Decompressing"));
 
-    if(jsonArray.is_null() || !jsonArray.is_array())
-        return false;
+        bool graphParsed = false;
+        const auto& prefix = NativeFormat::PluginSectionPrefix;
 
-    if(jsonArray.size() != 2)
-        return false;
+        // Each section is parsed as soon as it's been read, and then discarded, so that only one
+        // is held at a time; those that can't be parsed yet, and the plugin's, are kept until they can
+        bool success = NativeFormat::readSections(url.toLocalFile(), header._json, header._dataOffset,
+        [&](const std::string& name, QByteArray& data)
+        {
+            if(cancelled())
+                return false;
 
-    auto allObjects = std::all_of(jsonArray.begin(), jsonArray.end(),
-    [](const auto& i)
+            if(name == "graph")
+            {
+                graphParsed = NativeFormat::parseGraph(data, graphModel->mutableGraph(), *this);
+                return graphParsed;
+            }
+
+            if(name == "content")
+            {
+                jsonBody = json::parse(data.begin(), data.end(), nullptr, false);
+                return jsonBody.is_object();
+            }
+
+            if(graphParsed && name == "nodeNames")
+                return parseNodeNames(data);
+
+            if(graphParsed && name == "positions")
+                return parsePositions(data);
+
+            if(name.compare(0, prefix.size(), prefix) == 0)
+                pluginSections.emplace(QString::fromStdString(name.substr(prefix.size())), std::move(data));
+            else
+                sections.emplace(name, std::move(data));
+
+            return true;
+        }, *this);
+
+        if(!success || cancelled())
+            return false;
+
+        if(!graphParsed || !jsonBody.is_object())
+            return false;
+    }
+    else
     {
-       return i.is_object();
-    });
+        QByteArray byteArray;
 
-    if(!allObjects)
-        return false;
+        if(!load(url.toLocalFile(), byteArray, -1, &graphModel->mutableGraph(), this))
+            return false;
 
-    auto jsonBody = jsonArray.at(1);
+        setProgress(-1);
 
-    if(!u::contains(jsonBody, "graph") || !jsonBody["graph"].is_object())
-        return false;
+        auto jsonArray = parseJsonFrom(byteArray, this);
+
+        if(cancelled())
+            return false;
 
-    const auto& jsonGraph = jsonBody["graph"];
+        if(jsonArray.is_null() || !jsonArray.is_array())
+            return false;
 
-    if(!JsonGraphParser::parseGraphObject(jsonGraph, graphModel, *this, true))
-        return false;
+        if(jsonArray.size() != 2)
+            return false;
+
+        auto allObjects = std::all_of(jsonArray.begin(), jsonArray.end(),
+        [](const auto& i)
+        {
+           return i.is_object();
+        });
+
+        if(!allObjects)
+            return false;
+
+        jsonBody = jsonArray.at(1);
+
+        if(!u::contains(jsonBody, "graph") || !jsonBody["graph"].is_object())
+            return false;
+
+        const auto& jsonGraph = jsonBody["graph"];
+
+        if(!JsonGraphParser::parseGraphObject(jsonGraph, graphModel, *this, true))
+            return false;
+    }
 
     setProgress(-1);
 
-    if(u::contains(jsonBody, "nodeNames"))
+    if(u::contains(sections, "nodeNames"))
+    {
+        if(!parseNodeNames(sections["nodeNames"]))
+            return false;
+
+        sections.erase("nodeNames");
+    }
+    else if(u::contains(jsonBody, "nodeNames"))
     {
         if(version >= 4)
         {
@@ -423,7 +538,14 @@ bool Loader::parse(const QUrl& url, IGraphModel* graphModel)
             }
         }
 
-        if(u::contains(jsonLayout, "positions"))
+        if(u::contains(sections, "positions"))
+        {
+            if(!parsePositions(sections["positions"]))
+                return false;
+
+            sections.erase("positions");
+        }
+        else if(u::contains(jsonLayout, "positions"))
         {
             _nodePositions = std::make_unique<ExactNodePositions>(graphModel->mutableGraph());
 
@@ -472,19 +594,29 @@ bool Loader::parse(const QUrl& url, IGraphModel* graphModel)
             return false;
     }
 
-    if(!u::contains(jsonBody, "pluginData"))
-        return false;
-
-    const auto& pluginDataJsonValue = jsonBody["pluginData"];
-
     QByteArray pluginData;
 
-    if(pluginDataJsonValue.is_object() || pluginDataJsonValue.is_array())
-        pluginData = QByteArray::fromStdString(pluginDataJsonValue.dump());
-    else if(pluginDataJsonValue.is_string())
-        pluginData = QByteArray::fromHex(QByteArray::fromStdString(pluginDataJsonValue));
+    if(header._chunked)
+    {
+        if(!u::contains(sections, "pluginData"))
+            return false;
+
+        pluginData = std::move(sections["pluginData"]);
+    }
     else
-        return false;
+    {
+        if(!u::contains(jsonBody, "pluginData"))
+            return false;
+
+        const auto& pluginDataJsonValue = jsonBody["pluginData"];
+
+        if(pluginDataJsonValue.is_object() || pluginDataJsonValue.is_array())
+            pluginData = QByteArray::fromStdString(pluginDataJsonValue.dump());
+        else if(pluginDataJsonValue.is_string())
+            pluginData = QByteArray::fromHex(QByteArray::fromStdString(pluginDataJsonValue));
+        else
+            return false;
+    }
 
     if(header._pluginDataVersion > _pluginInstance->plugin()->dataVersion())
     {
@@ -493,6 +625,18 @@ bool Loader::parse(const QUrl& url, IGraphModel* graphModel)
         return false;
     }
 
+    if(header._chunked)
+    {
+        if(!_pluginInstance->loadSections(pluginSections, header._pluginDataVersion,
+            graphModel->mutableGraph(), *this))
+        {
+            setFailureReason(_pluginInstance->failureReason());
+            return false;
+        }
+
+        pluginSections.clear();
+    }
+
     if(!_pluginInstance->load(pluginData, header._pluginDataVersion, graphModel->mutableGraph(), *this))
     {
         setFailureReason(_pluginInstance->failureReason());
@@ -17,13 +17,9 @@
  */
 
 #include "nativesaver.h"
-#include "jsongraphsaver.h"
-
-#include "shared/graph/grapharray_json.h"
+#include "nativeformat.h"
 
 #include "shared/plugins/iplugin.h"
-#include "shared/utils/iterator_range.h"
-#include "shared/utils/scope_exit.h"
 #include "shared/utils/string.h"
 
 #include "graph/graphmodel.h"
@@ -32,78 +28,12 @@
 #include "ui/document.h"
 
 #include <QDataStream>
-#include <QFile>
 #include <QStringList>
+#include <QVector3D>
 
+#include <algorithm>
 #include <vector>
 
-#include <zlib.h>
-
-const int NativeSaver::Version = 5;
-const int NativeSaver::MaxHeaderSize = 1 << 12;
-
-static bool compress(const QByteArray& byteArray, const QString& filePath, Progressable& progressable)
-{
-    QFile file(filePath);
-
-    if(!file.open(QIODevice::WriteOnly))
-        return false;
-
-    uint64_t totalBytes = byteArray.size();
-    uint64_t bytePosition = 0;
-    QDataStream input(byteArray);
-    QDataStream output(&file);
-
-    z_stream zstream = {};
-    auto ret = deflateInit2(&zstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
-                            MAX_WBITS + 16, // 16 means write gzip header/trailer
-                            8, Z_DEFAULT_STRATEGY);
-    if(ret != Z_OK)
-        return false;
-
-    auto atExit = std::experimental::make_scope_exit([&zstream] { deflateEnd(&zstream); });
-    Q_UNUSED(atExit);
-
-    int flush = Z_ERRNO;
-
-    do
-    {
-        const int ChunkSize = 1 << 14;
-        std::vector<unsigned char> inBuffer(ChunkSize);
-
-        auto numBytes = input.readRawData(reinterpret_cast<char*>(inBuffer.data()), ChunkSize); // NOLINT
-
-        bytePosition += numBytes;
-        progressable.setProgress(static_cast<int>((bytePosition * 100u) / totalBytes));
-
-        zstream.avail_in = numBytes;
-        zstream.next_in = static_cast<z_const Bytef*>(inBuffer.data());
-        flush = input.atEnd() ? Z_FINISH : Z_NO_FLUSH;
-
-        do
-        {
-            std::vector<unsigned char> outBuffer(ChunkSize);
-            zstream.avail_out = ChunkSize;
-            zstream.next_out = static_cast<Bytef*>(outBuffer.data());
-
-            ret = deflate(&zstream, flush);
-            if(ret == Z_STREAM_ERROR)
-                return false;
-
-            numBytes = ChunkSize - zstream.avail_out;
-            if(output.writeRawData(reinterpret_cast<const char*>(outBuffer.data()), numBytes) !=
-               numBytes) // NOLINT
-                return false;
-
-        } while(zstream.avail_out == 0);
-        Q_ASSERT(zstream.avail_in == 0);
-
-    } while(flush != Z_FINISH);
-    Q_ASSERT(ret == Z_STREAM_END);
-
-    return true;
-}
-
 static json bookmarksAsJson(const Document& document)
 {
     json jsonObject = json::object();
@@ -162,8 +92,6 @@ static json enrichmentTableModelAsJson(const EnrichmentTableModel& table)
 
 bool NativeSaver::save()
 {
-    json jsonArray;
-
     auto* graphModel = dynamic_cast<GraphModel*>(_document->graphModel());
 
     Q_ASSERT(graphModel != nullptr);
@@ -171,31 +99,47 @@ bool NativeSaver::save()
         return false;
 
     json header;
-    header["version"] = NativeSaver::Version;
+    header["version"] = NativeFormat::Version;
     header["pluginName"] = graphModel->pluginName();
     header["pluginDataVersion"] = graphModel->pluginDataVersion();
-    jsonArray.emplace_back(header);
 
-    // The header must fit within a certain size, which is the maximum the loader will look at
-    if(json({header}).dump().size() > MaxHeaderSize)
+    const auto& mutableGraph = graphModel->mutableGraph();
+
+    // The bulk of the data is stored in binary sections, leaving only the small stuff to be
+    // stored as JSON in the content section; each is written as soon as it's been built
+    NativeFormat::Writer writer(_fileUrl.toLocalFile(), *this);
+
+    if(!writer.addSection("graph", NativeFormat::graphAsBinary(mutableGraph, *this)))
         return false;
 
-    json content;
+    mutableGraph.setPhase(QObject::tr("Node Names"));
+    if(!writer.addSection("nodeNames", NativeFormat::graphArrayAsBinary(graphModel->nodeNames(),
+        mutableGraph.nodeIds(), *this,
+    [](QDataStream& stream, const QString& nodeName)
+    {
+        stream << nodeName;
+    })))
+    {
+        return false;
+    }
 
-    content["graph"] = JSONGraphSaver::graphAsJson(graphModel->mutableGraph(), *this);
-    content["nodeNames"] = u::graphArrayAsJson(graphModel->nodeNames(), graphModel->mutableGraph().nodeIds(), this);
+    mutableGraph.setPhase(QObject::tr("Layout"));
+    if(!writer.addSection("positions", NativeFormat::graphArrayAsBinary(graphModel->nodePositions(),
+        mutableGraph.nodeIds(), *this,
+    [](QDataStream& stream, const QVector3D& position)
+    {
+        stream << position.x() << position.y() << position.z();
+    })))
+    {
+        return false;
+    }
+
+    json content;
 
     json layout;
 
     layout["algorithm"] = _document->layoutName();
     layout["settings"] = layoutSettingsAsJson(*_document);
-
-    layout["positions"] = u::graphArrayAsJson(graphModel->nodePositions(), graphModel->mutableGraph().nodeIds(), this,
-    [](const auto& v)
-    {
-        return json({v.x(), v.y(), v.z()});
-    });
-
     layout["paused"] = _document->layoutPauseState() == LayoutPauseState::Paused;
     content["layout"] = layout;
 
@@ -216,20 +160,6 @@ bool NativeSaver::save()
     if(uiDataJson.is_object() || uiDataJson.is_array())
         content["ui"] = uiDataJson;
 
-    graphModel->mutableGraph().setPhase(graphModel->pluginName());
-    auto pluginData = _pluginInstance->save(graphModel->mutableGraph(), *this);
-
-    setProgress(-1);
-
-    auto pluginDataJson = json::parse(pluginData.begin(), pluginData.end(), nullptr, false);
-
-    // If the plugin data is itself JSON, just whack it in
-    // as is, but if it's not, hex encode it
-    if(!pluginDataJson.is_discarded() && (pluginDataJson.is_object() || pluginDataJson.is_array()))
-        content["pluginData"] = pluginDataJson;
-    else
-        content["pluginData"] = QString(pluginData.toHex());
-
     auto pluginUiDataJson = json::parse(_pluginUiData.begin(), _pluginUiData.end(), nullptr, false);
 
     if(!pluginUiDataJson.is_discarded() && (pluginUiDataJson.is_object() || pluginUiDataJson.is_array()))
@@ -237,10 +167,27 @@ bool NativeSaver::save()
     else
         content["pluginUiData"] = QString(_pluginUiData.toHex());
 
-    jsonArray.emplace_back(content);
+    if(!writer.addSection("content", QByteArray::fromStdString(content.dump())))
+        return false;
+
+    // Sections the plugin saves for itself are prefixed, so that they can't clash with ours
+    if(!_pluginInstance->saveSections(graphModel->mutableGraph(), *this,
+    [&writer](const QString& name, const QByteArray& data)
+    {
+        return writer.addSection(NativeFormat::PluginSectionPrefix + name.toStdString(), data);
+    }))
+    {
+        return false;
+    }
+
+    // The plugin data is stored verbatim, whatever its format
+    mutableGraph.setPhase(graphModel->pluginName());
+    if(!writer.addSection("pluginData", _pluginInstance->save(graphModel->mutableGraph(), *this)))
+        return false;
+
+    setProgress(-1);
 
-    graphModel->mutableGraph().setPhase(QObject::tr("Compressing"));
-    return compress(QByteArray::fromStdString(jsonArray.dump()), _fileUrl.toLocalFile(), *this);
+    return writer.finish(header);
 }
 
 std::unique_ptr<ISaver> NativeSaverFactory::create(const QUrl& url, Document* document,
@@ -49,9 +49,6 @@ private:
     QByteArray _pluginUiData;
 
 public:
-    static const int Version;
-    static const int MaxHeaderSize;
-
     NativeSaver(QUrl fileUrl, Document* document, const IPluginInstance* pluginInstance, QByteArray uiData,
                 QByteArray pluginUiData) :
         _fileUrl(std::move(fileUrl)),
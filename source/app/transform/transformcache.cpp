@@ -42,7 +42,7 @@ bool TransformCache::lastResultChangesGraph() const
 {
     return std::any_of(_cache.back().begin(), _cache.back().end(), [](const auto& result)
     {
-        return result._graph != nullptr;
+        return result.changesGraph();
     });
 }
 
@@ -110,6 +110,19 @@ void TransformCache::attributeAdded(const QString& attributeName)
     }
 }
 
+void TransformCache::applyGraphChanges(const Result& result, TransformedGraph& graph)
+{
+    if(result._graph != nullptr)
+        graph = *(result._graph);
+    else if(result._removals != nullptr)
+    {
+        graph.mutableGraph().applyRemovals(*result._removals);
+
+        // Subsequent transforms expect the graph to be up to date
+        graph.update();
+    }
+}
+
 TransformCache::Result TransformCache::apply(const GraphTransformConfig& config, TransformedGraph& graph)
 {
     TransformCache::Result result;
@@ -132,12 +145,11 @@ TransformCache::Result TransformCache::apply(const GraphTransformConfig& config,
 
         // Apply the cached result
         _graphModel->addAttributes(cachedResult._newAttributes);
-        if(cachedResult._graph != nullptr)
-            graph = *(cachedResult._graph);
+        applyGraphChanges(cachedResult, graph);
 
         result = std::move(cachedResult);
 
-        if(result._graph != nullptr)
+        if(result.changesGraph())
         {
             // If the graph was changed, remove the entire set...
             _cache.erase(_cache.begin());
@@ -156,23 +168,26 @@ TransformCache::Result TransformCache::apply(const GraphTransformConfig& config,
     return result;
 }
 
-const MutableGraph* TransformCache::graph() const
+void TransformCache::restoreGraph(TransformedGraph& graph, const MutableGraph& source) const
 {
-    // Return the last graph in the cache
-    for(const auto& resultSet : make_iterator_range(_cache.rbegin(), _cache.rend()))
+    std::vector<const Result*> results;
+    for(const auto& resultSet : _cache)
     {
-        const auto& cachedResults = make_iterator_range(resultSet.rbegin(), resultSet.rend());
-        auto it = std::find_if(cachedResults.begin(), cachedResults.end(),
-        [](const auto& cachedResult)
-        {
-            return cachedResult._graph != nullptr;
-        });
-
-        if(it != cachedResults.end())
-            return it->_graph.get();
+        for(const auto& cachedResult : resultSet)
+            results.push_back(&cachedResult);
     }
 
-    return nullptr;
+    // Start from the last copy of the graph, then replay any subsequent removals over it
+    auto it = std::find_if(results.rbegin(), results.rend(),
+    [](const auto* cachedResult)
+    {
+        return cachedResult->_graph != nullptr;
+    });
+
+    graph = (it != results.rend() ? *(*it)->_graph : source);
+
+    for(const auto* cachedResult : make_iterator_range(it.base(), results.end()))
+        applyGraphChanges(*cachedResult, graph);
 }
 
 std::map<QString, Attribute> TransformCache::attributes() const
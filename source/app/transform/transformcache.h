@@ -21,10 +21,11 @@
 
 #include "graphtransformconfig.h"
 #include "attributes/attribute.h"
+#include "graph/mutablegraph.h"
 
 #include <vector>
+#include <memory>
 
-class MutableGraph;
 class TransformedGraph;
 class GraphModel;
 
@@ -33,30 +34,7 @@ class TransformCache
 public:
     struct Result
     {
-        Result() = default;
-
-        Result(const Result& other) :
-            _config(other._config),
-            _graph(other._graph ? std::make_unique<MutableGraph>(*other._graph) : nullptr),
-            _newAttributes(other._newAttributes)
-        {}
-
-        Result(Result&& other) noexcept :
-            _config(std::move(other._config)),
-            _graph(std::move(other._graph)),
-            _newAttributes(std::move(other._newAttributes))
-        {}
-
-        Result& operator=(Result&& other) noexcept
-        {
-            _config = std::move(other._config);
-            _graph = std::move(other._graph);
-            _newAttributes = std::move(other._newAttributes);
-
-            return *this;
-        }
-
-        bool changesGraph() const { return _graph != nullptr; }
+        bool changesGraph() const { return _graph != nullptr || _removals != nullptr; }
         bool isApplicable() const { return changesGraph() || !_newAttributes.empty(); }
 
         std::vector<QString> referencedAttributeNames() const
@@ -65,7 +43,13 @@ public:
         }
 
         GraphTransformConfig _config;
-        std::unique_ptr<MutableGraph> _graph;
+
+        // When a transform only removes elements, the removals are stored rather than
+        // a copy of the graph, and replayed over the graph the transform was applied to;
+        // both are immutable once cached, so copying a Result shares rather than copies them
+        std::shared_ptr<const MutableGraph> _graph;
+        std::shared_ptr<const MutableGraph::Removals> _removals;
+
         std::map<QString, Attribute> _newAttributes;
     };
 
@@ -76,6 +60,8 @@ private:
     bool lastResultCreatedAnyOf(const std::vector<QString>& attributeNames) const;
     std::vector<QString> attributesCreatedByLastResult() const;
 
+    static void applyGraphChanges(const Result& result, TransformedGraph& graph);
+
     GraphModel* _graphModel;
     std::vector<ResultSet> _cache;
 
@@ -91,7 +77,8 @@ public:
     void attributeAdded(const QString& attributeName);
     Result apply(const GraphTransformConfig& config, TransformedGraph& graph);
 
-    const MutableGraph* graph() const;
+    // Sets graph to the state it was in after the last cached change to it
+    void restoreGraph(TransformedGraph& graph, const MutableGraph& source) const;
     std::map<QString, Attribute> attributes() const;
 };
 
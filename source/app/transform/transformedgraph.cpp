@@ -52,11 +52,17 @@ TransformedGraph::TransformedGraph(GraphModel& graphModel, const MutableGraph& s
     connect(_source, &Graph::nodeAdded,    [this](const Graph*, NodeId nodeId) { _nodesState[nodeId].add(); });
     connect(_source, &Graph::edgeRemoved,  [this](const Graph*, EdgeId edgeId) { _edgesState[edgeId].remove(); });
     connect(_source, &Graph::edgeAdded,    [this](const Graph*, EdgeId edgeId) { _edgesState[edgeId].add(); });
+    connect(_source, &Graph::nodesRemoved, [this](const Graph*, const std::vector<NodeId>& nodeIds) { onNodesRemoved(nodeIds); });
+    connect(_source, &Graph::edgesRemoved, [this](const Graph*, const std::vector<EdgeId>& edgeIds) { onEdgesRemoved(edgeIds); });
 
     connect(&_target, &Graph::nodeRemoved, [this](const Graph*, NodeId nodeId) { _nodesState[nodeId].remove(); });
     connect(&_target, &Graph::nodeAdded,   [this](const Graph*, NodeId nodeId) { _nodesState[nodeId].add(); });
     connect(&_target, &Graph::edgeRemoved, [this](const Graph*, EdgeId edgeId) { _edgesState[edgeId].remove(); });
     connect(&_target, &Graph::edgeAdded,   [this](const Graph*, EdgeId edgeId) { _edgesState[edgeId].add(); });
+    connect(&_target, &Graph::nodeChanged, [this](const Graph*, NodeId nodeId) { _nodesState[nodeId].change(); });
+    connect(&_target, &Graph::edgeChanged, [this](const Graph*, EdgeId edgeId) { _edgesState[edgeId].change(); });
+    connect(&_target, &Graph::nodesRemoved, [this](const Graph*, const std::vector<NodeId>& nodeIds) { onNodesRemoved(nodeIds); });
+    connect(&_target, &Graph::edgesRemoved, [this](const Graph*, const std::vector<EdgeId>& edgeIds) { onEdgesRemoved(edgeIds); });
 
     addTransform(std::make_unique<IdentityTransform>());
 }
@@ -158,9 +164,17 @@ void TransformedGraph::rebuild()
             setCurrentTransform(transform.get());
             transform->uncancel();
 
-            if(transform->applyAndUpdate(*this, *_graphModel))
+            _target.beginRecordingRemovals();
+            bool changed = transform->applyAndUpdate(*this, *_graphModel);
+            auto removals = _target.endRecordingRemovals();
+
+            if(changed)
             {
-                result._graph = std::make_unique<MutableGraph>(_target);
+                // Where the transform has only removed elements, cache those rather than a copy of the graph
+                if(removals != nullptr)
+                    result._removals = std::move(removals);
+                else
+                    result._graph = std::make_shared<MutableGraph>(_target);
 
                 // Graph has changed, so the cache is now invalid
                 _cache.clear();
@@ -191,8 +205,7 @@ void TransformedGraph::rebuild()
             // We've been cancelled so rollback to our previous state
             _cache = std::move(oldCache);
             _createdAttributeNames = std::move(oldCreatedAttributeNames);
-            const auto* cachedGraph = _cache.graph();
-            *this = (cachedGraph != nullptr ? *cachedGraph : *_source);
+            _cache.restoreGraph(*this, *_source);
 
             // Remove any attributes that were added before the cancel occurred
             for(const auto& attributeName : u::setDifference(_graphModel->attributeNames(), fixedAttributeNames))
@@ -225,6 +238,18 @@ void TransformedGraph::setCurrentTransform(GraphTransform* currentTransform)
     _currentTransform = currentTransform;
 }
 
+void TransformedGraph::onNodesRemoved(const std::vector<NodeId>& nodeIds)
+{
+    for(auto nodeId : nodeIds)
+        _nodesState[nodeId].remove();
+}
+
+void TransformedGraph::onEdgesRemoved(const std::vector<EdgeId>& edgeIds)
+{
+    for(auto edgeId : edgeIds)
+        _edgesState[edgeId].remove();
+}
+
 void TransformedGraph::onTargetGraphChanged(const Graph*)
 {
     // Let everything know what changed; note the signals won't necessarily happen in the order
@@ -237,6 +262,11 @@ void TransformedGraph::onTargetGraphChanged(const Graph*)
             emit nodeAdded(this, nodeId);
             _changeSignalsEmitted = true;
         }
+        else if(_nodesState[nodeId].changed() && containsNodeId(nodeId))
+        {
+            emit nodeChanged(this, nodeId);
+            _changeSignalsEmitted = true;
+        }
     }
 
     for(EdgeId edgeId(0); edgeId < _edgesState.size(); ++edgeId)
@@ -251,6 +281,11 @@ void TransformedGraph::onTargetGraphChanged(const Graph*)
             emit edgeRemoved(this, edgeId);
             _changeSignalsEmitted = true;
         }
+        else if(_edgesState[edgeId].changed() && containsEdgeId(edgeId))
+        {
+            emit edgeChanged(this, edgeId);
+            _changeSignalsEmitted = true;
+        }
     }
 
     for(NodeId nodeId(0); nodeId < _nodesState.size(); ++nodeId)
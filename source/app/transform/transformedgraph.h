@@ -78,6 +78,8 @@ public:
     EdgeId firstEdgeIdBetween(NodeId nodeIdA, NodeId nodeIdB) const override { return _target.firstEdgeIdBetween(nodeIdA, nodeIdB); }
     bool edgeExistsBetween(NodeId nodeIdA, NodeId nodeIdB) const override { return _target.edgeExistsBetween(nodeIdA, nodeIdB); }
 
+    std::shared_ptr<const AdjacencySnapshot> adjacencySnapshot() override { return _target.adjacencySnapshot(); }
+
     void setPhase(const QString& phase) const override { _source->setPhase(phase); }
     void clearPhase() const override { _source->clearPhase(); }
     QString phase() const override { return _source->phase(); }
@@ -130,13 +132,24 @@ private:
     private:
         enum class Value { Removed, Unchanged, Added };
         Value state = Value::Unchanged;
+        bool _changed = false;
 
     public:
-        void add()     { state = state == Value::Removed ? Value::Unchanged : Value::Added; }
+        void add()
+        {
+            // Something that is removed then added again may not be connected as it was
+            _changed = _changed || state == Value::Removed;
+            state = state == Value::Removed ? Value::Unchanged : Value::Added;
+        }
+
         void remove()  { state = state == Value::Added ?   Value::Unchanged : Value::Removed; }
+        void change()  { _changed = true; }
 
         bool added() const   { return state == Value::Added; }
         bool removed() const { return state == Value::Removed; }
+
+        // Still present, but possibly no longer connected in the same way
+        bool changed() const { return _changed && state == Value::Unchanged; }
     };
 
     NodeArray<State> _nodesState;
@@ -148,6 +161,9 @@ private:
 
     void setCurrentTransform(GraphTransform* currentTransform);
 
+    void onNodesRemoved(const std::vector<NodeId>& nodeIds);
+    void onEdgesRemoved(const std::vector<EdgeId>& edgeIds);
+
 private slots:
     void onTargetGraphChanged(const Graph* graph);
 
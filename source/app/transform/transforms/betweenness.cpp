@@ -0,0 +1,205 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "betweenness.h"
+
+#include "graph/adjacencysnapshot.h"
+
+#include "shared/utils/cancellable.h"
+#include "shared/utils/threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <numeric>
+#include <random>
+
+BetweennessResult computeBetweenness(const AdjacencySnapshot& adjacency, size_t numEdgeIds,
+    size_t sampleSize, const Cancellable& cancellable, const std::function<void(int)>& progressFn)
+{
+    using Index = AdjacencySnapshot::Index;
+
+    const auto numNodes = adjacency.numNodes();
+    const bool sampled = sampleSize > 0 && sampleSize < numNodes;
+
+    std::vector<Index> sources(numNodes);
+    std::iota(sources.begin(), sources.end(), 0);
+
+    if(sampled)
+    {
+        // Seeded, so that the same graph always gives the same result
+        std::mt19937 generator(0);
+
+        for(size_t i = 0; i < sampleSize; i++)
+        {
+            std::uniform_int_distribution<size_t> distribution(i, numNodes - 1);
+            std::swap(sources[i], sources[distribution(generator)]);
+        }
+
+        sources.resize(sampleSize);
+    }
+
+    // Working storage for each thread, allocated when the thread first needs it, then
+    // reused for each subsequent source; after each source only what was touched is reset
+    struct Scratch
+    {
+        Scratch(size_t nodeCount, size_t edgeIdCount) :
+            _sigma(nodeCount, 0.0), _delta(nodeCount, 0.0), _distance(nodeCount, -1),
+            _nodeBetweenness(nodeCount, 0.0), _edgeBetweenness(edgeIdCount, 0.0)
+        {
+            _order.reserve(nodeCount);
+        }
+
+        std::vector<double> _sigma;
+        std::vector<double> _delta;
+        std::vector<int> _distance;
+
+        // The order in which nodes are visited; doubles as both the queue and the stack
+        std::vector<Index> _order;
+
+        std::vector<double> _nodeBetweenness;
+        std::vector<double> _edgeBetweenness;
+    };
+
+    std::vector<std::unique_ptr<Scratch>> scratches(concurrent_for_num_threads());
+    std::atomic_int progress(0);
+
+    auto computeForSource = [&](Index source, size_t threadIndex)
+    {
+        if(cancellable.cancelled())
+            return;
+
+        auto& scratch = scratches.at(threadIndex);
+        if(scratch == nullptr)
+            scratch = std::make_unique<Scratch>(numNodes, numEdgeIds);
+
+        auto& sigma = scratch->_sigma;
+        auto& delta = scratch->_delta;
+        auto& distance = scratch->_distance;
+        auto& order = scratch->_order;
+
+        // Brandes algorithm
+        sigma[source] = 1.0;
+        distance[source] = 0;
+        order.push_back(source);
+
+        for(size_t head = 0; head < order.size(); head++)
+        {
+            auto other = order[head];
+
+            for(auto neighbour : adjacency.neighbours(other))
+            {
+                if(distance[neighbour] < 0)
+                {
+                    distance[neighbour] = distance[other] + 1;
+                    order.push_back(neighbour);
+                }
+
+                if(distance[neighbour] == distance[other] + 1)
+                    sigma[neighbour] += sigma[other];
+            }
+        }
+
+        // Rather than recording the predecessors of each node during the search, they
+        // are found again here, as the neighbours one step closer to the source
+        for(auto it = order.rbegin(); it != order.rend(); ++it)
+        {
+            auto other = *it;
+            auto coefficient = (1.0 + delta[other]) / sigma[other];
+
+            const auto* neighbours = adjacency.neighbours(other).begin();
+            const auto* edgeIds = adjacency.edgeIds(other).begin();
+            for(size_t i = 0; i < adjacency.degree(other); i++)
+            {
+                auto neighbour = neighbours[i];
+
+                if(distance[neighbour] != distance[other] - 1)
+                    continue;
+
+                // Shortest paths through parallel edges are distinct paths, so
+                // each edge is only credited with those that pass through it
+                auto d = sigma[neighbour] * coefficient;
+                scratch->_edgeBetweenness[static_cast<size_t>(static_cast<int>(edgeIds[i]))] += d;
+                delta[neighbour] += d;
+            }
+
+            if(other != source)
+                scratch->_nodeBetweenness[other] += delta[other];
+        }
+
+        for(auto index : order)
+        {
+            sigma[index] = 0.0;
+            delta[index] = 0.0;
+            distance[index] = -1;
+        }
+
+        order.clear();
+
+        progressFn(++progress * 100 / static_cast<int>(sources.size()));
+    };
+
+    if(!sources.empty())
+        concurrent_for(sources.begin(), sources.end(), computeForSource);
+
+    BetweennessResult result;
+    result._nodeBetweenness.assign(numNodes, 0.0);
+    result._edgeBetweenness.assign(numEdgeIds, 0.0);
+    result._sampled = sampled;
+
+    if(cancellable.cancelled())
+        return result;
+
+    // When sampling, each source stands in for numNodes / sampleSize sources
+    const double scale = sampled ? static_cast<double>(numNodes) / static_cast<double>(sampleSize) : 1.0;
+
+    for(const auto& scratch : scratches)
+    {
+        if(scratch == nullptr)
+            continue;
+
+        for(size_t index = 0; index < numNodes; index++)
+            result._nodeBetweenness[index] += scale * scratch->_nodeBetweenness[index];
+
+        for(size_t edgeId = 0; edgeId < numEdgeIds; edgeId++)
+            result._edgeBetweenness[edgeId] += scale * scratch->_edgeBetweenness[edgeId];
+    }
+
+    return result;
+}
+
+double betweennessErrorBound(size_t numNodes, size_t numEdges, size_t sampleSize, double confidence)
+{
+    if(numNodes < 3 || sampleSize == 0 || sampleSize >= numNodes)
+        return 0.0;
+
+    // Each sampled source s contributes a value in [0, n - 2] to a node's betweenness and in
+    // [0, n - 1] to an edge's, and the estimate is n times their mean; by Hoeffding's inequality,
+    // which also holds when sampling without replacement, the mean of k sources is within
+    // t * range of the mean over every source with probability 1 - 2exp(-2kt^2). A union bound
+    // over the nodes and edges gives t for every estimate at once, and dividing n * t * range by
+    // the largest possible value, (n - 1)(n - 2) or n(n - 1), leaves n / (n - 1) * t at most
+    auto n = static_cast<double>(numNodes);
+    auto k = static_cast<double>(sampleSize);
+    auto numEstimates = n + static_cast<double>(numEdges);
+
+    auto t = std::sqrt(std::log(2.0 * numEstimates / (1.0 - confidence)) / (2.0 * k));
+
+    return (n / (n - 1.0)) * t;
+}
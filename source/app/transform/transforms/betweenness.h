@@ -0,0 +1,53 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BETWEENNESS_H
+#define BETWEENNESS_H
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+class AdjacencySnapshot;
+class Cancellable;
+
+struct BetweennessResult
+{
+    // Indexed by the snapshot
+    std::vector<double> _nodeBetweenness;
+
+    // Indexed by EdgeId
+    std::vector<double> _edgeBetweenness;
+
+    bool _sampled = false;
+};
+
+// Computes the betweenness of each node and edge from the shortest paths from every node or, when
+// sampleSize is less than the number of nodes, from sampleSize nodes chosen uniformly at random,
+// scaled to estimate the exact values; a sampleSize of 0 means every node. progressFn is called
+// with the percentage of the sources that are complete
+BetweennessResult computeBetweenness(const AdjacencySnapshot& adjacency, size_t numEdgeIds,
+    size_t sampleSize, const Cancellable& cancellable,
+    const std::function<void(int)>& progressFn = [](int) {});
+
+// With probability at least confidence, every estimate computeBetweenness makes from sampleSize of
+// numNodes nodes is within this of its exact value, as a fraction of the largest possible value;
+// (numNodes - 1)(numNodes - 2) for nodes and numNodes(numNodes - 1) for edges
+double betweennessErrorBound(size_t numNodes, size_t numEdges, size_t sampleSize, double confidence);
+
+#endif // BETWEENNESS_H
@@ -17,112 +17,36 @@
  */
 
 #include "betweennesstransform.h"
+#include "betweenness.h"
 
 #include "transform/transformedgraph.h"
 #include "graph/graphmodel.h"
+#include "graph/adjacencysnapshot.h"
 
 #include "shared/graph/grapharray.h"
-#include "shared/utils/threadpool.h"
 
-#include <cstdint>
-#include <stack>
-#include <queue>
-#include <map>
-#include <thread>
+#include <QObject>
+
+#include <algorithm>
 
 void BetweennessTransform::apply(TransformedGraph& target) const
 {
     target.setPhase(QStringLiteral("Betweenness"));
     target.setProgress(0);
 
-    const auto& nodeIds = target.nodeIds();
-    const auto& edegIds = target.edgeIds();
-    std::atomic_int progress(0);
-
-    struct BetweennessArrays
-    {
-        explicit BetweennessArrays(TransformedGraph& graph) :
-            nodeBetweenness(graph, 0.0),
-            edgeBetweenness(graph, 0.0)
-        {}
+    auto adjacency = target.adjacencySnapshot();
+    using Index = AdjacencySnapshot::Index;
 
-        NodeArray<double> nodeBetweenness;
-        EdgeArray<double> edgeBetweenness;
-    };
+    const auto numNodes = adjacency->numNodes();
+    const auto numEdgeIds = static_cast<size_t>(static_cast<int>(target.nextEdgeId()));
 
-    std::vector<BetweennessArrays> betweennessArrays(
-        std::thread::hardware_concurrency(),
-        BetweennessArrays{target});
+    size_t sampleSize = 0;
+    const auto* sampleSizeParameter = config().parameterByName(QStringLiteral("Sample Size"));
+    if(sampleSizeParameter != nullptr)
+        sampleSize = static_cast<size_t>(std::max(std::get<int>(sampleSizeParameter->_value), 0));
 
-    concurrent_for(nodeIds.begin(), nodeIds.end(),
-    [&](const NodeId nodeId, size_t threadIndex)
-    {
-        auto& arrays = betweennessArrays.at(threadIndex);
-        auto& _nodeBetweenness = arrays.nodeBetweenness;
-        auto& _edgeBetweenness = arrays.edgeBetweenness;
-
-        // Brandes algorithm
-        NodeArray<std::vector<NodeId>> predecessors(target);
-        NodeArray<int64_t> sigma(target, 0);
-        NodeArray<int64_t> distance(target, -1);
-        NodeArray<double> delta(target, 0.0);
-
-        std::stack<NodeId> stack;
-        std::queue<NodeId> queue;
-
-        sigma[nodeId] = 1.0;
-        distance[nodeId] = 0;
-        queue.push(nodeId);
-
-        while(!queue.empty() && !cancelled())
-        {
-            auto other = queue.front();
-            queue.pop();
-            stack.push(other);
-
-            for(auto neighbour : target.neighboursOf(other))
-            {
-                if(distance[neighbour] < 0)
-                {
-                    queue.push(neighbour);
-                    distance[neighbour] = distance[other] + 1;
-                }
-
-                if(distance[neighbour] == distance[other] + 1)
-                {
-                    sigma[neighbour] += sigma[other];
-                    predecessors[neighbour].push_back(other);
-                }
-            }
-        }
-
-        while(!stack.empty() && !cancelled())
-        {
-            auto other = stack.top();
-            stack.pop();
-
-            for(auto predecessor : predecessors[other])
-            {
-                auto d = (static_cast<double>(sigma[predecessor]) /
-                    static_cast<double>(sigma[other])) * (1.0 + delta[other]);
-
-                auto edgeIds = target.edgeIdsBetween(predecessor, other);
-                for(auto edgeId : edgeIds)
-                    _edgeBetweenness[edgeId] += d;
-
-                delta[predecessor] += d;
-            }
-
-            if(other != nodeId)
-                _nodeBetweenness[other] += delta[other];
-        }
-
-        progress++;
-        target.setProgress(progress.load() * 100 / static_cast<int>(target.numNodes()));
-
-        if(cancelled())
-            return;
-    });
+    auto result = computeBetweenness(*adjacency, numEdgeIds, sampleSize, *this,
+        [&target](int percentage) { target.setProgress(percentage); });
 
     target.setProgress(-1);
 
@@ -131,13 +55,22 @@ void BetweennessTransform::apply(TransformedGraph& target) const
 
     NodeArray<double> nodeBetweenness(target, 0.0);
     EdgeArray<double> edgeBetweenness(target, 0.0);
-    for(const auto& arrays : betweennessArrays)
+
+    for(Index index = 0; index < numNodes; index++)
+        nodeBetweenness[adjacency->nodeIdAt(index)] = result._nodeBetweenness[index];
+
+    for(auto edgeId : target.edgeIds())
+        edgeBetweenness[edgeId] = result._edgeBetweenness[static_cast<size_t>(static_cast<int>(edgeId))];
+
+    if(result._sampled)
     {
-        for(auto nodeId : nodeIds)
-            nodeBetweenness[nodeId] += arrays.nodeBetweenness[nodeId];
+        const double Confidence = 0.9;
+        auto errorBound = betweennessErrorBound(numNodes, static_cast<size_t>(target.numEdges()),
+            sampleSize, Confidence);
 
-        for(auto edgeId : edegIds)
-            edgeBetweenness[edgeId] += arrays.edgeBetweenness[edgeId];
+        addAlert(AlertType::Warning, QObject::tr("Approximated from the shortest paths of %1 of %2 nodes; "
+            "with %3% confidence, no value differs from its exact value by more than %4% of the largest possible")
+            .arg(sampleSize).arg(numNodes).arg(Confidence * 100.0).arg(errorBound * 100.0, 0, 'g', 3));
     }
 
     _graphModel->createAttribute(QObject::tr("Node Betweenness"))
@@ -50,6 +50,20 @@ public:
     }
     QString category() const override { return QObject::tr("Metrics"); }
     ElementType elementType() const override { return ElementType::None; }
+
+    GraphTransformParameters parameters() const override
+    {
+        return
+        {
+            {
+                "Sample Size", ValueType::Int,
+                QObject::tr("The number of nodes from which to sample shortest paths, in order to "
+                    "approximate betweenness on large graphs. When 0, betweenness is computed exactly."),
+                0, 0
+            }
+        };
+    }
+
     DefaultVisualisations defaultVisualisations() const override
     {
         return
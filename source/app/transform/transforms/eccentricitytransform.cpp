@@ -19,10 +19,133 @@
 #include "eccentricitytransform.h"
 #include "transform/transformedgraph.h"
 #include "graph/graphmodel.h"
+#include "graph/adjacencysnapshot.h"
 #include "shared/utils/threadpool.h"
 
-#include <map>
-#include <queue>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <thread>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+using Index = AdjacencySnapshot::Index;
+
+// The number of sources searched simultaneously, one per bit of a word
+constexpr size_t BatchSize = 64;
+
+int lowestSetBit(uint64_t word)
+{
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanForward64(&index, word);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(word);
+#endif
+}
+
+struct BfsScratch
+{
+    explicit BfsScratch(size_t numNodes) :
+        _seen(numNodes, 0), _visit(numNodes, 0), _visitNext(numNodes, 0)
+    {}
+
+    // For each node, the sources that have reached it, that reached it
+    // at the current level, and that reach it at the next level
+    std::vector<uint64_t> _seen;
+    std::vector<uint64_t> _visit;
+    std::vector<uint64_t> _visitNext;
+
+    std::vector<Index> _active;
+    std::vector<Index> _nextActive;
+    std::vector<Index> _touched;
+};
+
+// Breadth first search from up to BatchSize distinct sources at once, where each source is a bit of a
+// word, so that each edge is traversed only once per level for all of the sources; visitFn(index, bits,
+// level) is called when index is first reached, at a distance of level, by the sources in bits
+template<typename VisitFn>
+void multiSourceBfs(const AdjacencySnapshot& adjacency, BfsScratch& scratch,
+    const Index* sources, size_t numSources, VisitFn&& visitFn)
+{
+    auto& seen = scratch._seen;
+    auto& visit = scratch._visit;
+    auto& visitNext = scratch._visitNext;
+    auto& active = scratch._active;
+    auto& nextActive = scratch._nextActive;
+    auto& touched = scratch._touched;
+
+    for(size_t i = 0; i < numSources; i++)
+    {
+        auto source = sources[i];
+        auto bit = uint64_t{1} << i;
+
+        seen[source] = bit;
+        visit[source] = bit;
+        active.push_back(source);
+        visitFn(source, bit, 0);
+    }
+
+    touched.insert(touched.end(), active.begin(), active.end());
+
+    for(int level = 1; !active.empty(); level++)
+    {
+        for(auto index : active)
+        {
+            auto bits = visit[index];
+
+            for(auto neighbour : adjacency.neighbours(index))
+            {
+                auto newBits = bits & ~seen[neighbour];
+                if(newBits == 0)
+                    continue;
+
+                if(visitNext[neighbour] == 0)
+                    nextActive.push_back(neighbour);
+
+                visitNext[neighbour] |= newBits;
+            }
+        }
+
+        for(auto index : active)
+            visit[index] = 0;
+
+        for(auto index : nextActive)
+        {
+            auto newBits = visitNext[index];
+            visitNext[index] = 0;
+
+            seen[index] |= newBits;
+            visit[index] = newBits;
+            visitFn(index, newBits, level);
+        }
+
+        touched.insert(touched.end(), nextActive.begin(), nextActive.end());
+        std::swap(active, nextActive);
+        nextActive.clear();
+    }
+
+    for(auto index : touched)
+        seen[index] = 0;
+
+    touched.clear();
+}
+
+struct Batch
+{
+    size_t _begin = 0;
+    size_t _end = 0;
+};
+
+} // namespace
 
 void EccentricityTransform::apply(TransformedGraph& target) const
 {
@@ -32,83 +155,213 @@ void EccentricityTransform::apply(TransformedGraph& target) const
 
 void EccentricityTransform::calculateDistances(TransformedGraph& target) const
 {
-    // Setup the contiguous ids
-    std::map<NodeId, int> nodeIdToMatrixIndex;
-    std::map<int, NodeId> matrixIndexToNodeId;
-    for(auto nodeId : target.nodeIds())
+    auto adjacency = target.adjacencySnapshot();
+    const auto numNodes = adjacency->numNodes();
+
+    target.setProgress(0);
+
+    // The unresolved nodes of each component; the bounds of a
+    // node only ever depend on nodes in the same component
+    auto unresolvedByComponent = adjacency->components();
+
+    // Takes and Kosters: a search from s gives the exact eccentricity e of s, and for every node v in
+    // its component, max(d(s, v), e - d(s, v)) <= ecc(v) <= e + d(s, v), so by searching from carefully
+    // chosen nodes, most eccentricities are pinned down by their bounds without a search of their own
+    std::vector<std::atomic<int>> lowerBounds(numNodes);
+    std::vector<std::atomic<int>> upperBounds(numNodes);
+    for(size_t i = 0; i < numNodes; i++)
     {
-        auto size = static_cast<int>(nodeIdToMatrixIndex.size());
-        nodeIdToMatrixIndex[nodeId] = size;
-        matrixIndexToNodeId[size - 1] = nodeId;
+        lowerBounds[i] = 0;
+        upperBounds[i] = std::numeric_limits<int>::max();
     }
 
-    NodeArray<int> maxDistances(target);
+    auto byLargestUpperBound = [&](Index a, Index b)
+    {
+        auto upperA = upperBounds[a].load();
+        auto upperB = upperBounds[b].load();
 
-    target.setProgress(0);
+        if(upperA != upperB)
+            return upperA > upperB;
+
+        if(adjacency->degree(a) != adjacency->degree(b))
+            return adjacency->degree(a) > adjacency->degree(b);
 
-    const auto& nodeIds = target.nodeIds();
-    std::atomic_int progress(0);
-    concurrent_for(nodeIds.begin(), nodeIds.end(),
-    [this, &maxDistances, &progress, &target](const NodeId source)
+        return a < b;
+    };
+
+    auto bySmallestLowerBound = [&](Index a, Index b)
     {
-        if(cancelled())
-            return;
+        auto lowerA = lowerBounds[a].load();
+        auto lowerB = lowerBounds[b].load();
+
+        if(lowerA != lowerB)
+            return lowerA < lowerB;
+
+        if(adjacency->degree(a) != adjacency->degree(b))
+            return adjacency->degree(a) > adjacency->degree(b);
+
+        return a < b;
+    };
+
+    // Enough sources for every thread to have a batch
+    const auto maxCandidates = BatchSize * concurrent_for_num_threads();
+
+    std::vector<std::unique_ptr<BfsScratch>> scratches(concurrent_for_num_threads());
+    auto scratchFor = [&](size_t threadIndex) -> BfsScratch&
+    {
+        auto& scratch = scratches.at(threadIndex);
+        if(scratch == nullptr)
+            scratch = std::make_unique<BfsScratch>(numNodes);
+
+        return *scratch;
+    };
+
+    size_t numResolved = 0;
+
+    // Once the bounds resolve fewer nodes than it takes searches to compute them, it's
+    // cheaper to just search from everything that remains, in which case they're abandoned
+    bool bounding = true;
+
+    while(!cancelled())
+    {
+        std::vector<Index> candidates;
+        std::vector<bool> candidateNeedsBounds;
+
+        for(auto& unresolved : unresolvedByComponent)
+        {
+            if(unresolved.empty())
+                continue;
+
+            auto numCandidates = std::min(unresolved.size(), maxCandidates);
+            bool exhaustive = !bounding || numCandidates == unresolved.size();
 
-        NodeArray<int> distance(target);
-        NodeArray<bool> visited(target);
+            if(!exhaustive)
+            {
+                // Alternate between peripheral nodes, whose large eccentricities give tight lower
+                // bounds, and central nodes, whose small eccentricities give tight upper bounds
+                auto split = unresolved.begin() + static_cast<ptrdiff_t>(numCandidates / 2);
+                auto end = unresolved.begin() + static_cast<ptrdiff_t>(numCandidates);
 
-        auto comparator = [&distance](NodeId a, NodeId b){ return distance[a] > distance[b]; };
-        std::priority_queue<NodeId, std::vector<NodeId>, decltype(comparator)> queue(comparator);
+                std::nth_element(unresolved.begin(), split, unresolved.end(), byLargestUpperBound);
+                std::nth_element(split, end, unresolved.end(), bySmallestLowerBound);
+            }
 
-        for(auto nodeId : target.nodeIds())
-            distance[nodeId] = std::numeric_limits<int>::max();
+            candidates.insert(candidates.end(), unresolved.begin(),
+                unresolved.begin() + static_cast<ptrdiff_t>(numCandidates));
+            candidateNeedsBounds.resize(candidates.size(), !exhaustive);
+        }
 
-        queue.push(source);
-        distance[source] = 0;
+        if(candidates.empty())
+            break;
 
-        while(!queue.empty())
+        // Batches may span components, since the searches never cross between them
+        std::vector<Batch> batches;
+        std::vector<Batch> boundingBatches;
+        size_t numBoundingSources = 0;
+        for(size_t begin = 0; begin < candidates.size(); begin += BatchSize)
+        {
+            Batch batch{begin, std::min(begin + BatchSize, candidates.size())};
+            batches.push_back(batch);
+
+            if(std::any_of(candidateNeedsBounds.begin() + static_cast<ptrdiff_t>(batch._begin),
+                candidateNeedsBounds.begin() + static_cast<ptrdiff_t>(batch._end), [](bool b) { return b; }))
+            {
+                boundingBatches.push_back(batch);
+                numBoundingSources += batch._end - batch._begin;
+            }
+        }
+
+        std::vector<int> eccentricities(candidates.size(), 0);
+
+        concurrent_for(batches.begin(), batches.end(),
+        [&](const Batch& batch, size_t threadIndex)
         {
             if(cancelled())
                 return;
 
-            auto nodeId = queue.top();
-            queue.pop();
+            multiSourceBfs(*adjacency, scratchFor(threadIndex), candidates.data() + batch._begin,
+                batch._end - batch._begin, [&](Index, uint64_t bits, int level)
+            {
+                // Levels only increase, so the last level at which a source reaches anything is its eccentricity
+                for(; bits != 0; bits &= bits - 1)
+                    eccentricities[batch._begin + static_cast<size_t>(lowestSetBit(bits))] = level;
+            });
+        });
 
-            if(visited.get(nodeId))
-                continue;
+        if(cancelled())
+            break;
 
-            visited.set(nodeId, true);
+        for(size_t i = 0; i < candidates.size(); i++)
+        {
+            lowerBounds[candidates[i]] = eccentricities[i];
+            upperBounds[candidates[i]] = eccentricities[i];
+        }
 
-            auto nodeWeight = distance[nodeId];
-            for(EdgeId edgeId : target.edgeIdsForNodeId(nodeId))
+        // Now that the eccentricities of the sources are known, search again to bound everything else
+        if(!boundingBatches.empty())
+        {
+            concurrent_for(boundingBatches.begin(), boundingBatches.end(),
+            [&](const Batch& batch, size_t threadIndex)
             {
-                NodeId adjacentNodeId = target.edgeById(edgeId).oppositeId(nodeId);
-                const int adjacentNodeWeight = 1;
-                if(!visited.get(adjacentNodeId) && (nodeWeight + adjacentNodeWeight < distance[adjacentNodeId]))
+                if(cancelled())
+                    return;
+
+                const auto* batchEccentricities = eccentricities.data() + batch._begin;
+
+                multiSourceBfs(*adjacency, scratchFor(threadIndex), candidates.data() + batch._begin,
+                    batch._end - batch._begin, [&](Index index, uint64_t bits, int level)
                 {
-                    distance[adjacentNodeId] = nodeWeight + adjacentNodeWeight;
-                    queue.push(adjacentNodeId);
-                }
-            }
+                    int lower = level;
+                    int upper = std::numeric_limits<int>::max();
+
+                    for(; bits != 0; bits &= bits - 1)
+                    {
+                        auto eccentricity = batchEccentricities[lowestSetBit(bits)];
+                        lower = std::max(lower, eccentricity - level);
+                        upper = std::min(upper, eccentricity + level);
+                    }
+
+                    auto& lowerBound = lowerBounds[index];
+                    auto currentLower = lowerBound.load();
+                    while(lower > currentLower && !lowerBound.compare_exchange_weak(currentLower, lower)) {}
+
+                    auto& upperBound = upperBounds[index];
+                    auto currentUpper = upperBound.load();
+                    while(upper < currentUpper && !upperBound.compare_exchange_weak(currentUpper, upper)) {}
+                });
+            });
+
+            if(cancelled())
+                break;
         }
 
-        int maxDistance = 0;
-        for(auto nodeId : target.nodeIds())
+        auto numPreviouslyResolved = numResolved;
+
+        for(auto& unresolved : unresolvedByComponent)
         {
-            if(distance[nodeId] != std::numeric_limits<int>::max())
-                maxDistance = std::max(distance[nodeId], maxDistance);
+            auto resolved = std::remove_if(unresolved.begin(), unresolved.end(),
+                [&](Index index) { return lowerBounds[index].load() == upperBounds[index].load(); });
+
+            numResolved += static_cast<size_t>(std::distance(resolved, unresolved.end()));
+            unresolved.erase(resolved, unresolved.end());
         }
 
-        maxDistances[source] = maxDistance;
-        progress++;
-        target.setProgress(progress.load() * 100 / static_cast<int>(target.numNodes()));
-    });
+        auto numResolvedByBounds = numResolved - numPreviouslyResolved - candidates.size();
+        if(numBoundingSources > 0 && numResolvedByBounds < numBoundingSources)
+            bounding = false;
+
+        target.setProgress(static_cast<int>((numResolved * 100) / numNodes));
+    }
 
     target.setProgress(-1);
 
     if(cancelled())
         return;
 
+    NodeArray<int> maxDistances(target);
+    for(Index index = 0; index < numNodes; index++)
+        maxDistances[adjacency->nodeIdAt(index)] = lowerBounds[index].load();
+
     _graphModel->createAttribute(QObject::tr("Node Eccentricity"))
         .setDescription(QObject::tr("A node's eccentricity is the length of the shortest path to the furthest node."))
         .setIntValueFn([maxDistances](NodeId nodeId) { return maxDistances[nodeId]; })
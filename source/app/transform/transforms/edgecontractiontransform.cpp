@@ -18,7 +18,7 @@
 
 #include "edgecontractiontransform.h"
 #include "transform/transformedgraph.h"
-#include "attributes/conditionfncreator.h"
+#include "attributes/conditionevaluator.h"
 #include "graph/graphmodel.h"
 
 #include "shared/utils/string.h"
@@ -29,8 +29,9 @@ void EdgeContractionTransform::apply(TransformedGraph& target) const
 {
     target.setPhase(QObject::tr("Contracting"));
 
-    auto conditionFn = CreateConditionFnFor::edge(*_graphModel, config()._condition);
-    if(conditionFn == nullptr)
+    const auto& edgeIds = target.edgeIds();
+    ConditionEvaluator<EdgeId> conditionEvaluator(*_graphModel, target, edgeIds);
+    if(!conditionEvaluator.evaluate(config()._condition))
     {
         addAlert(AlertType::Error, QObject::tr("Invalid condition"));
         return;
@@ -38,10 +39,10 @@ void EdgeContractionTransform::apply(TransformedGraph& target) const
 
     EdgeIdSet edgeIdsToContract;
 
-    for(auto edgeId : target.edgeIds())
+    for(size_t i = 0; i < edgeIds.size(); i++)
     {
-        if(conditionFn(edgeId))
-            edgeIdsToContract.insert(edgeId);
+        if(conditionEvaluator.selected(i))
+            edgeIdsToContract.insert(edgeIds[i]);
     }
 
     target.mutableGraph().contractEdges(edgeIdsToContract);
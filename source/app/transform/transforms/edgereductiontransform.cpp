@@ -19,6 +19,7 @@
 #include "edgereductiontransform.h"
 
 #include "transform/transformedgraph.h"
+#include "graph/adjacencysnapshot.h"
 
 #include <memory>
 #include <random>
@@ -34,18 +35,23 @@ void EdgeReductionTransform::apply(TransformedGraph& target) const
 
     EdgeArray<bool> removees(target, true);
 
+    auto adjacency = target.adjacencySnapshot();
+
     uint64_t progress = 0;
     for(auto nodeId : target.nodeIds())
     {
-        auto edgeIds = target.nodeById(nodeId).edgeIds();
+        auto nodeIndex = adjacency->indexOf(nodeId);
+        auto degree = adjacency->degree(nodeIndex);
 
-        if(edgeIds.empty())
+        if(degree == 0)
             continue;
 
+        const auto* edgeIds = adjacency->edgeIds(nodeIndex).begin();
+
         std::mt19937 generator(static_cast<int>(nodeId));
-        std::uniform_int_distribution<size_t> distribution(0, edgeIds.size() - 1);
+        std::uniform_int_distribution<size_t> distribution(0, degree - 1);
 
-        size_t numEdgesToRetain = std::max(minimum, (edgeIds.size() * percentage) / 100);
+        size_t numEdgesToRetain = std::max(minimum, (degree * percentage) / 100);
 
         for(size_t i = 0u; i < numEdgesToRetain; i++)
         {
@@ -57,18 +63,8 @@ void EdgeReductionTransform::apply(TransformedGraph& target) const
             static_cast<uint64_t>(target.numNodes())));
     }
 
-    progress = 0;
-
-    for(const auto& edgeId : target.edgeIds())
-    {
-        if(removees.get(edgeId))
-            target.mutableGraph().removeEdge(edgeId);
-
-        target.setProgress(static_cast<int>((progress++ * 100u) /
-            static_cast<uint64_t>(target.numEdges())));
-    }
-
     target.setProgress(-1);
+    target.mutableGraph().bulkRemoveEdges(removees);
 }
 
 std::unique_ptr<GraphTransform> EdgeReductionTransformFactory::create(const GraphTransformConfig&) const
@@ -19,6 +19,7 @@
 #include "filtertransform.h"
 #include "transform/transformedgraph.h"
 #include "attributes/conditionfncreator.h"
+#include "attributes/conditionevaluator.h"
 
 #include "graph/graphmodel.h"
 #include "graph/graphcomponent.h"
@@ -42,55 +43,45 @@ void FilterTransform::apply(TransformedGraph& target) const
     {
     case ElementType::Node:
     {
-        auto conditionFn = CreateConditionFnFor::node(*_graphModel, config()._condition);
-        if(conditionFn == nullptr)
+        const auto& nodeIds = target.nodeIds();
+        ConditionEvaluator<NodeId> conditionEvaluator(*_graphModel, target, nodeIds);
+        if(!conditionEvaluator.evaluate(config()._condition))
         {
             addAlert(AlertType::Error, QObject::tr("Invalid condition"));
             return;
         }
 
-        std::vector<NodeId> removees;
+        NodeArray<bool> removees(target, false);
 
-        for(auto nodeId : target.nodeIds())
+        for(size_t i = 0; i < nodeIds.size(); i++)
         {
-            if(u::exclusiveOr(conditionFn(nodeId), _invert))
-                removees.push_back(nodeId);
+            if(u::exclusiveOr(conditionEvaluator.selected(i), _invert))
+                removees.set(nodeIds[i], true);
         }
 
-        auto numRemovees = static_cast<uint64_t>(removees.size());
-        uint64_t progress = 0;
-        for(auto nodeId : removees)
-        {
-            target.mutableGraph().removeNode(nodeId);
-            target.setProgress(static_cast<int>((progress++ * 100) / numRemovees));
-        }
+        target.mutableGraph().bulkRemoveNodes(removees);
         break;
     }
 
     case ElementType::Edge:
     {
-        auto conditionFn = CreateConditionFnFor::edge(*_graphModel, config()._condition);
-        if(conditionFn == nullptr)
+        const auto& edgeIds = target.edgeIds();
+        ConditionEvaluator<EdgeId> conditionEvaluator(*_graphModel, target, edgeIds);
+        if(!conditionEvaluator.evaluate(config()._condition))
         {
             addAlert(AlertType::Error, QObject::tr("Invalid condition"));
             return;
         }
 
-        std::vector<EdgeId> removees;
+        EdgeArray<bool> removees(target, false);
 
-        for(auto edgeId : target.edgeIds())
+        for(size_t i = 0; i < edgeIds.size(); i++)
         {
-            if(u::exclusiveOr(conditionFn(edgeId), _invert))
-                removees.push_back(edgeId);
+            if(u::exclusiveOr(conditionEvaluator.selected(i), _invert))
+                removees.set(edgeIds[i], true);
         }
 
-        auto numRemovees = static_cast<uint64_t>(removees.size());
-        uint64_t progress = 0;
-        for(auto edgeId : removees)
-        {
-            target.mutableGraph().removeEdge(edgeId);
-            target.setProgress(static_cast<int>((progress++ * 100) / numRemovees));
-        }
+        target.mutableGraph().bulkRemoveEdges(removees);
         break;
     }
 
@@ -104,25 +95,19 @@ void FilterTransform::apply(TransformedGraph& target) const
         }
 
         ComponentManager componentManager(target);
-        std::vector<NodeId> removees;
+        NodeArray<bool> removees(target, false);
 
         for(auto componentId : componentManager.componentIds())
         {
             const auto* component = componentManager.componentById(componentId);
             if(u::exclusiveOr(conditionFn(*component), _invert))
             {
-                auto nodeIds = target.mutableGraph().mergedNodeIdsForNodeIds(component->nodeIds());
-                removees.insert(removees.end(), nodeIds.begin(), nodeIds.end());
+                for(auto nodeId : target.mutableGraph().mergedNodeIdsForNodeIds(component->nodeIds()))
+                    removees.set(nodeId, true);
             }
         }
 
-        auto numRemovees = static_cast<uint64_t>(removees.size());
-        uint64_t progress = 0;
-        for(auto nodeId : removees)
-        {
-            target.mutableGraph().removeNode(nodeId);
-            target.setProgress(static_cast<int>((progress++ * 100) / numRemovees));
-        }
+        target.mutableGraph().bulkRemoveNodes(removees);
         break;
     }
 
@@ -0,0 +1,421 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "louvain.h"
+
+#include "shared/utils/cancellable.h"
+#include "shared/utils/threadpool.h"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+// https://arxiv.org/abs/0803.0476
+
+namespace
+{
+using Index = LouvainGraph::Index;
+constexpr Index NullIndex = std::numeric_limits<Index>::max();
+
+// Graphs with at least this many nodes have their nodes moved in batches of this size, where the
+// moves within each batch are decided concurrently, based on the communities as they were at the
+// start of the batch; smaller graphs are moved one node at a time. Neither depends on the number
+// of threads, so the result is always the same
+constexpr size_t MoveBatchSize = 4096;
+
+// When moving concurrently, nodes can interfere with each other's moves, so rather than waiting
+// for a sweep in which nothing moves, stop once a sweep no longer meaningfully improves quality
+constexpr double MinimumRelativeQualityGain = 1e-6;
+
+// Sums weights by community, for the neighbourhood of one node or community at a time; the
+// table is kept between uses, so that only the slots that were used need to be cleared
+class CommunityWeights
+{
+private:
+    std::vector<Index> _keys;
+    std::vector<double> _values;
+    std::vector<size_t> _usedSlots;
+    size_t _mask = 0;
+
+public:
+    void reset(size_t maxKeys)
+    {
+        size_t capacity = 16;
+        while(capacity < maxKeys * 2)
+            capacity <<= 1;
+
+        if(capacity > _keys.size())
+        {
+            _keys.assign(capacity, NullIndex);
+            _values.assign(capacity, 0.0);
+            _mask = capacity - 1;
+        }
+        else
+        {
+            for(auto slot : _usedSlots)
+            {
+                _keys[slot] = NullIndex;
+                _values[slot] = 0.0;
+            }
+        }
+
+        _usedSlots.clear();
+    }
+
+    void add(Index community, double weight)
+    {
+        auto slot = (static_cast<size_t>(community) * 0x9E3779B1) & _mask;
+        while(_keys[slot] != community && _keys[slot] != NullIndex)
+            slot = (slot + 1) & _mask;
+
+        if(_keys[slot] == NullIndex)
+        {
+            _keys[slot] = community;
+            _usedSlots.push_back(slot);
+        }
+
+        _values[slot] += weight;
+    }
+
+    size_t size() const { return _usedSlots.size(); }
+
+    // Visits the communities in the order they were first added
+    template<typename Fn>
+    void forEach(Fn&& fn) const
+    {
+        for(auto slot : _usedSlots)
+            fn(_keys[slot], _values[slot]);
+    }
+};
+} // namespace
+
+std::vector<size_t> computeLouvain(LouvainGraph graph, double totalWeight, double resolution,
+    const Cancellable& cancellable,
+    const std::function<void(size_t, size_t)>& iterationFn,
+    const std::function<void(size_t)>& coarseningFn,
+    const std::function<void(int)>& progressFn)
+{
+    const auto numFirstLevelNodes = graph.numNodes();
+
+    std::vector<CommunityWeights> threadCommunityWeights(concurrent_for_num_threads());
+
+    // Moves each node to the neighbouring community that most improves modularity, until
+    // nothing more is to be gained, returning whether anything moved at all
+    auto moveNodes = [&](const LouvainGraph& levelGraph, std::vector<Index>& communities, size_t progressIteration)
+    {
+        const auto numNodes = levelGraph.numNodes();
+        const bool concurrent = numNodes >= MoveBatchSize;
+        const auto batchSize = concurrent ? MoveBatchSize : 1;
+
+        std::vector<double> weightedDegrees(numNodes, 0.0);
+        for(size_t node = 0; node < numNodes; node++)
+        {
+            weightedDegrees[node] = std::accumulate(
+                levelGraph._weights.begin() + static_cast<ptrdiff_t>(levelGraph._offsets[node]),
+                levelGraph._weights.begin() + static_cast<ptrdiff_t>(levelGraph._offsets[node + 1]), 0.0);
+        }
+
+        // Each node starts in a community of its own
+        communities.resize(numNodes);
+        std::iota(communities.begin(), communities.end(), 0);
+        std::vector<double> communityDegrees = weightedDegrees;
+        std::vector<size_t> communitySizes(numNodes, 1);
+
+        auto bestCommunityFor = [&](Index node, CommunityWeights& neighbourCommunityWeights)
+        {
+            const auto first = levelGraph._offsets[node];
+            const auto last = levelGraph._offsets[node + 1];
+
+            neighbourCommunityWeights.reset(last - first);
+            for(auto i = first; i < last; i++)
+            {
+                // Skip loop edges
+                if(levelGraph._neighbours[i] == node)
+                    continue;
+
+                neighbourCommunityWeights.add(communities[levelGraph._neighbours[i]], levelGraph._weights[i]);
+            }
+
+            auto communityId = communities[node];
+            auto nodeWeight = weightedDegrees[node];
+
+            double maxDeltaQ = 0.0;
+            auto newCommunityId = communityId;
+
+            neighbourCommunityWeights.forEach([&](Index neighbourCommunityId, double weight)
+            {
+                // The node is considered to have been removed from its own community
+                auto communityWeight = communityDegrees[neighbourCommunityId];
+                if(neighbourCommunityId == communityId)
+                    communityWeight -= nodeWeight;
+
+                auto deltaQ = (resolution * weight) -
+                    ((communityWeight * nodeWeight) / totalWeight);
+
+                // A move must strictly improve modularity, and ties go to the lowest community,
+                // including the node's own, regardless of visiting order
+                if(deltaQ > maxDeltaQ || (deltaQ == maxDeltaQ && deltaQ > 0.0 &&
+                    neighbourCommunityId < newCommunityId))
+                {
+                    maxDeltaQ = deltaQ;
+                    newCommunityId = neighbourCommunityId;
+                }
+            });
+
+            return newCommunityId;
+        };
+
+        // Exactly what the local moves optimise; only needed to detect convergence when moving concurrently
+        auto quality = [&]
+        {
+            double internalWeight = 0.0;
+            for(Index node = 0; node < numNodes; node++)
+            {
+                for(auto i = levelGraph._offsets[node]; i < levelGraph._offsets[node + 1]; i++)
+                {
+                    auto neighbour = levelGraph._neighbours[i];
+                    if(neighbour != node && communities[neighbour] == communities[node])
+                        internalWeight += levelGraph._weights[i];
+                }
+            }
+
+            double sumOfSquaredDegrees = 0.0;
+            for(auto communityDegree : communityDegrees)
+                sumOfSquaredDegrees += communityDegree * communityDegree;
+
+            // Each internal edge is seen from both ends
+            return (resolution * internalWeight * 0.5) - (sumOfSquaredDegrees / (2.0 * totalWeight));
+        };
+
+        std::vector<Index> nodes(numNodes);
+        std::iota(nodes.begin(), nodes.end(), 0);
+        std::vector<Index> moves(numNodes);
+
+        double previousQuality = concurrent ? quality() : 0.0;
+
+        size_t subProgressIteration = 1;
+        bool modified = false;
+        bool improved = false;
+        do
+        {
+            improved = false;
+            progressFn(0);
+            iterationFn(progressIteration, subProgressIteration++);
+
+            for(size_t begin = 0; begin < numNodes; begin += batchSize)
+            {
+                if(cancellable.cancelled())
+                    return false;
+
+                const auto end = std::min(begin + batchSize, numNodes);
+
+                if(!concurrent)
+                    moves[begin] = bestCommunityFor(static_cast<Index>(begin), threadCommunityWeights.front());
+                else
+                {
+                    concurrent_for(nodes.begin() + static_cast<ptrdiff_t>(begin),
+                        nodes.begin() + static_cast<ptrdiff_t>(end),
+                    [&](Index node, size_t threadIndex)
+                    {
+                        auto newCommunityId = bestCommunityFor(node, threadCommunityWeights.at(threadIndex));
+                        auto communityId = communities[node];
+
+                        // Two singletons could otherwise simply swap communities
+                        if(communitySizes[communityId] == 1 && communitySizes[newCommunityId] == 1 &&
+                            newCommunityId > communityId)
+                        {
+                            newCommunityId = communityId;
+                        }
+
+                        moves[node] = newCommunityId;
+                    });
+                }
+
+                for(auto node = begin; node < end; node++)
+                {
+                    auto communityId = communities[node];
+                    auto newCommunityId = moves[node];
+
+                    if(newCommunityId == communityId)
+                        continue;
+
+                    communityDegrees[communityId] -= weightedDegrees[node];
+                    communitySizes[communityId]--;
+                    communityDegrees[newCommunityId] += weightedDegrees[node];
+                    communitySizes[newCommunityId]++;
+                    communities[node] = newCommunityId;
+
+                    improved = modified = true;
+                }
+
+                progressFn(static_cast<int>((end * 100) / numNodes));
+            }
+
+            if(improved && concurrent)
+            {
+                auto newQuality = quality();
+                improved = (newQuality - previousQuality) > MinimumRelativeQualityGain * std::abs(newQuality);
+                previousQuality = newQuality;
+            }
+
+            progressFn(-1);
+        }
+        while(improved && !cancellable.cancelled());
+
+        return modified;
+    };
+
+    // Builds a graph with a node for each community, relabelling the communities to
+    // match, with the edges between communities combined and weighted accordingly
+    auto coarsen = [&](const LouvainGraph& levelGraph, std::vector<Index>& communities)
+    {
+        const auto numNodes = levelGraph.numNodes();
+
+        std::vector<Index> labels(numNodes, NullIndex);
+        Index numCommunities = 0;
+        for(auto& communityId : communities)
+        {
+            if(labels[communityId] == NullIndex)
+                labels[communityId] = numCommunities++;
+
+            communityId = labels[communityId];
+        }
+
+        // The members of each community, contiguously
+        std::vector<size_t> memberOffsets(numCommunities + 1, 0);
+        for(auto communityId : communities)
+            memberOffsets[communityId + 1]++;
+
+        std::partial_sum(memberOffsets.begin(), memberOffsets.end(), memberOffsets.begin());
+
+        std::vector<Index> members(numNodes);
+        auto memberCursors = memberOffsets;
+        for(Index node = 0; node < numNodes; node++)
+            members[memberCursors[communities[node]]++] = node;
+
+        auto accumulateCommunity = [&](Index communityId, CommunityWeights& communityWeights)
+        {
+            size_t maxKeys = 0;
+            for(auto i = memberOffsets[communityId]; i < memberOffsets[communityId + 1]; i++)
+                maxKeys += levelGraph._offsets[members[i] + 1] - levelGraph._offsets[members[i]];
+
+            communityWeights.reset(std::min(maxKeys, static_cast<size_t>(numCommunities)));
+
+            for(auto i = memberOffsets[communityId]; i < memberOffsets[communityId + 1]; i++)
+            {
+                auto member = members[i];
+                for(auto j = levelGraph._offsets[member]; j < levelGraph._offsets[member + 1]; j++)
+                    communityWeights.add(communities[levelGraph._neighbours[j]], levelGraph._weights[j]);
+            }
+        };
+
+        std::vector<Index> communityIds(numCommunities);
+        std::iota(communityIds.begin(), communityIds.end(), 0);
+
+        LouvainGraph coarseGraph;
+        coarseGraph._offsets.assign(numCommunities + 1, 0);
+
+        // Count the neighbours of each community, then fill them in
+        concurrent_for(communityIds.begin(), communityIds.end(),
+        [&](Index communityId, size_t threadIndex)
+        {
+            auto& communityWeights = threadCommunityWeights.at(threadIndex);
+            accumulateCommunity(communityId, communityWeights);
+            coarseGraph._offsets[communityId + 1] = communityWeights.size();
+        });
+
+        std::partial_sum(coarseGraph._offsets.begin(), coarseGraph._offsets.end(), coarseGraph._offsets.begin());
+        coarseGraph._neighbours.resize(coarseGraph._offsets.back());
+        coarseGraph._weights.resize(coarseGraph._offsets.back());
+
+        concurrent_for(communityIds.begin(), communityIds.end(),
+        [&](Index communityId, size_t threadIndex)
+        {
+            auto& communityWeights = threadCommunityWeights.at(threadIndex);
+            accumulateCommunity(communityId, communityWeights);
+
+            auto offset = coarseGraph._offsets[communityId];
+            communityWeights.forEach([&](Index neighbourCommunityId, double weight)
+            {
+                coarseGraph._neighbours[offset] = neighbourCommunityId;
+                coarseGraph._weights[offset] = weight;
+                offset++;
+            });
+        });
+
+        return coarseGraph;
+    };
+
+    // For each level, the community of each of its nodes, which is also a node of the next level
+    std::vector<std::vector<Index>> levels;
+    size_t progressIteration = 1;
+
+    while(graph.numNodes() > 0 && !cancellable.cancelled())
+    {
+        std::vector<Index> communities;
+        if(!moveNodes(graph, communities, progressIteration) || cancellable.cancelled())
+            break;
+
+        coarseningFn(progressIteration);
+
+        auto coarseGraph = coarsen(graph, communities);
+        bool coarsened = coarseGraph.numNodes() < graph.numNodes();
+
+        levels.emplace_back(std::move(communities));
+        graph = std::move(coarseGraph);
+
+        if(!coarsened)
+            break;
+
+        progressIteration++;
+    }
+
+    if(cancellable.cancelled())
+        return {};
+
+    // Walk back over our levels to build the final communities, which are the nodes of the final graph
+    std::vector<Index> communities(numFirstLevelNodes);
+    std::iota(communities.begin(), communities.end(), 0);
+    for(auto& communityId : communities)
+    {
+        for(const auto& level : levels)
+            communityId = level[communityId];
+    }
+
+    // Sort communities by size
+    std::vector<size_t> communitySizes(graph.numNodes(), 0);
+    for(auto communityId : communities)
+        communitySizes[communityId]++;
+
+    std::vector<Index> sortedCommunityIds(graph.numNodes());
+    std::iota(sortedCommunityIds.begin(), sortedCommunityIds.end(), 0);
+    std::stable_sort(sortedCommunityIds.begin(), sortedCommunityIds.end(),
+        [&](auto a, auto b) { return communitySizes[a] > communitySizes[b]; });
+
+    std::vector<size_t> clusterNumbers(graph.numNodes());
+    for(size_t i = 0; i < sortedCommunityIds.size(); i++)
+        clusterNumbers[sortedCommunityIds[i]] = i;
+
+    std::vector<size_t> clusters(numFirstLevelNodes);
+    for(size_t node = 0; node < numFirstLevelNodes; node++)
+        clusters[node] = clusterNumbers[communities[node]];
+
+    return clusters;
+}
@@ -0,0 +1,54 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOUVAIN_H
+#define LOUVAIN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class Cancellable;
+
+// A weighted graph in compressed sparse row form, where each edge appears in the rows of both of its
+// nodes; loops, including those that represent the edges within a community, have the node itself
+// as the neighbour, and contribute to its degree, but not to the weights between communities
+struct LouvainGraph
+{
+    using Index = uint32_t;
+
+    std::vector<size_t> _offsets = {0};
+    std::vector<Index> _neighbours;
+    std::vector<double> _weights;
+
+    size_t numNodes() const { return _offsets.size() - 1; }
+};
+
+// Finds the communities of graph, whose edges have a total weight of totalWeight, returning the
+// cluster of each node, where clusters are numbered from 0 in order of decreasing size; the result
+// is empty if cancelled. iterationFn is called with the level and sweep as each sweep of local
+// moves starts, coarseningFn with the level as it's coarsened, and progressFn with the percentage
+// of the sweep that's complete
+std::vector<size_t> computeLouvain(LouvainGraph graph, double totalWeight, double resolution,
+    const Cancellable& cancellable,
+    const std::function<void(size_t, size_t)>& iterationFn = [](size_t, size_t) {},
+    const std::function<void(size_t)>& coarseningFn = [](size_t) {},
+    const std::function<void(int)>& progressFn = [](int) {});
+
+#endif // LOUVAIN_H
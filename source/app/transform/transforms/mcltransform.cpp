@@ -19,393 +19,356 @@
 #include "mcltransform.h"
 #include "transform/transformedgraph.h"
 #include "graph/graphmodel.h"
+#include "graph/adjacencysnapshot.h"
 #include "shared/utils/threadpool.h"
-
-#include <blaze/Blaze.h>
+#include "shared/utils/utils.h"
 
 #include <QElapsedTimer>
 #include <QDebug>
 
-#include <map>
 #include <set>
-#include <thread>
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace
+{
+using Index = AdjacencySnapshot::Index;
 
-using MatrixType = blaze::CompressedMatrix<float,blaze::columnMajor>;
-using VectorType = blaze::DynamicVector<float,blaze::columnVector>;
+// Columns are expanded, and stored, in blocks of this many
+constexpr size_t ColumnBlockSize = 1024;
 
-static void normaliseColumnsColumnMajor(MatrixType &mclMatrix)
+// A column major sparse matrix, whose columns are stored in blocks, so
+// that each block can be written independently by whichever thread
+// expands it, without the result then needing to be gathered together
+class MCLMatrix
 {
-    for(size_t column = 0; column<mclMatrix.columns(); column++)
+public:
+    struct Block
     {
-        MatrixType::Iterator lelem=mclMatrix.begin(column);
-        MatrixType::Iterator lend=mclMatrix.end(column);
+        std::vector<size_t> _offsets = {0};
+        std::vector<Index> _rows;
+        std::vector<float> _values;
 
-        if(lelem == lend)
-            continue;
+        void endColumn() { _offsets.push_back(_rows.size()); }
+    };
+
+    struct Column
+    {
+        const Index* _rows = nullptr;
+        const float* _values = nullptr;
+        size_t _size = 0;
+    };
+
+private:
+    size_t _numColumns = 0;
+    std::vector<Block> _blocks;
+
+public:
+    explicit MCLMatrix(size_t numColumns) :
+        _numColumns(numColumns),
+        _blocks((numColumns + ColumnBlockSize - 1) / ColumnBlockSize)
+    {}
 
-        float value = 0.0f;
-        for(lelem=mclMatrix.begin(column); lelem!=lend; ++lelem)
-            value += lelem->value();
+    size_t numColumns() const { return _numColumns; }
+    size_t numBlocks() const { return _blocks.size(); }
 
-        Q_ASSERT(value > 0.0f);
-        value = 1.0f / value;
+    Block& block(size_t index) { return _blocks[index]; }
 
-        for(lelem=mclMatrix.begin(column); lelem!=lend; ++lelem)
-            lelem->value() = lelem->value() * value;
+    size_t firstColumnOf(size_t blockIndex) const { return blockIndex * ColumnBlockSize; }
+    size_t lastColumnOf(size_t blockIndex) const { return std::min(firstColumnOf(blockIndex + 1), _numColumns); }
+
+    Column column(size_t index) const
+    {
+        const auto& block = _blocks[index / ColumnBlockSize];
+        auto i = index % ColumnBlockSize;
+        auto begin = block._offsets[i];
+
+        return {block._rows.data() + begin, block._values.data() + begin, block._offsets[i + 1] - begin};
     }
-}
 
-static void sumColumns(MatrixType &mclMatrix, VectorType &output)
-{
-    for(size_t column = 0; column<mclMatrix.columns(); column++)
+    size_t nonZeros() const
     {
-        MatrixType::ConstIterator lend=mclMatrix.cend(column);
-        for(MatrixType::ConstIterator lelem=mclMatrix.cbegin(column); lelem!=lend; ++lelem)
+        return std::accumulate(_blocks.begin(), _blocks.end(), size_t{0},
+            [](size_t total, const Block& block) { return total + block._rows.size(); });
+    }
+
+    void debugPrint(const QString& title) const
+    {
+        qDebug().noquote() << title;
+        for(size_t k = 0; k < _numColumns; k++)
         {
-            output[column] = output[column] + lelem->value();
+            auto c = column(k);
+            QString text = QStringLiteral("%1:").arg(k);
+            for(size_t i = 0; i < c._size; i++)
+                text += QStringLiteral(" %1=%2").arg(c._rows[i]).arg(static_cast<double>(c._values[i]));
+
+            qDebug().noquote() << text;
         }
     }
-}
+};
 
-struct SparseMatrixEntry
+// The dense accumulator for the expansion of a column, one per thread
+struct MCLScratch
 {
-    size_t _row; size_t _column; float _value;
-    SparseMatrixEntry(size_t row, size_t column, float value)
-        : _row(row), _column(column), _value(value){}
+    explicit MCLScratch(size_t numRows) :
+        _values(numRows, 0.0f), _valid(numRows, 0), _indices(numRows, 0)
+    {}
+
+    std::vector<float> _values;
+    std::vector<char> _valid;
+
+    // The rows that are valid, in the order they became so
+    std::vector<Index> _indices;
 };
 
-struct MCLRowData
+struct MCLPruneCounts
 {
-    std::vector<float> values;
-    std::vector<bool> valid;
-    std::vector<size_t> indices;
-    explicit MCLRowData(size_t columnCount) : values(columnCount, 0.0f),
-        valid(columnCount, false), indices(columnCount, 0UL) {}
+    size_t _selection = 0;
+    size_t _recovery = 0;
 };
 
-template<typename CancelledFn>
-static void expandAndPruneRow(MatrixType& mclMatrix, size_t columnId,
-    std::vector<SparseMatrixEntry>* matrixStorage, MCLRowData& rowData,
-    float minValueCutoff, const CancelledFn& cancelledFn)
+struct MCLColumnParameters
 {
-    const bool DEBUG = false;
+    MCLPruneCounts _pruneCounts;
+    float _pruneLimit = 0.0f;
+    float _inflation = 0.0f;
+    float _convergenceLimit = 0.0f;
+};
 
-    // Perhaps make these changable parameters later
-    const int RECOVERY_COUNT = 1400;
-    const int SELECTION_COUNT = 1100;
+// Expands column columnIndex of matrix, i.e. computes that column of its square, then prunes,
+// inflates and normalises it, appending the result to block; returns whether the column has converged
+template<typename CancelledFn>
+bool expandColumn(const MCLMatrix& matrix, size_t columnIndex, MCLScratch& scratch,
+    const MCLColumnParameters& parameters, MCLMatrix::Block& block, const CancelledFn& cancelledFn)
+{
+    auto& values = scratch._values;
+    auto& valid = scratch._valid;
+    auto& indices = scratch._indices;
 
     size_t nonzeros = 0;
 
-    size_t minIndex = std::numeric_limits<size_t>::infinity();
-    size_t maxIndex = 0UL;
-    const auto* const lend = mclMatrix.cend(columnId);
-
-    // Perform multiply and populate prune dependant data structures
-    for(const auto* lelem = mclMatrix.cbegin(columnId); lelem != lend; ++lelem)
+    // Perform multiply
+    auto column = matrix.column(columnIndex);
+    for(size_t i = 0; i < column._size; i++)
     {
         if(cancelledFn())
             break;
 
-        // For each column (left)
-        const auto* const rend = mclMatrix.cend(lelem->index());
-        for(const auto* relem = mclMatrix.cbegin(lelem->index()); relem != rend; ++relem)
+        auto left = column._values[i];
+        auto inner = matrix.column(column._rows[i]);
+
+        for(size_t j = 0; j < inner._size; j++)
         {
-            // For each column starting at left column index (right)
-            float mult = lelem->value() * relem->value();
+            auto index = inner._rows[j];
+            float mult = left * inner._values[j];
 
-            if(!rowData.valid[relem->index()])
+            if(valid[index] == 0)
             {
-                rowData.values[relem->index()] = mult;
-                rowData.valid[relem->index()] = true;
-                // Position in the rowData.values vector
-                rowData.indices[nonzeros] = relem->index();
-                ++nonzeros;
-
-                if(relem->index() < minIndex) minIndex = relem->index();
-                if(relem->index() > maxIndex) maxIndex = relem->index();
+                values[index] = mult;
+                valid[index] = 1;
+                indices[nonzeros++] = index;
             }
             else
-                rowData.values[relem->index()] += mult;
+                values[index] += mult;
         }
     }
 
-    if(cancelledFn())
-        return;
+    auto* first = indices.data();
+    auto* last = first + nonzeros;
 
-    if(nonzeros > 0UL)
+    auto byValueDescending = [&values](Index a, Index b) { return values[a] > values[b]; };
+
+    // Leaves the count largest values at the front
+    auto selectLargest = [&](size_t count)
     {
-        Q_ASSERT(minIndex <= maxIndex);
+        count = std::min(count, nonzeros);
+        std::nth_element(first, first + count, last, byValueDescending);
 
-        size_t remainCount = nonzeros;
-        float rowPruneSum = 0.0f;
-        // Mass is always normalised!
-        float targetMass = 0.9f;
+        float mass = 0.0f;
+        for(size_t i = 0; i < count; i++)
+            mass += values[first[i]];
 
-        for(size_t i = 0UL; i < nonzeros; ++i)
-        {
-            size_t index = rowData.indices[i];
-            if(std::abs(rowData.values[index]) <= minValueCutoff)
-            {
-                // Remove from the remainCount;
-                remainCount--;
-            }
-            else
-            {
-                // Calculate pruned sum
-                rowPruneSum += rowData.values[index];
-            }
-        }
+        return std::make_pair(count, mass);
+    };
 
-        if(DEBUG)
-            qDebug() << "RowPruneSum (mass?)" << rowPruneSum << "targetmass" << targetMass;
+    // Mass is always normalised!
+    const float TargetMass = 0.9f;
 
-        if(remainCount != nonzeros && rowPruneSum < targetMass && remainCount < RECOVERY_COUNT)
-        {
-            // Recover
-            if(DEBUG)
-                qDebug() << "RECOVERY" << "MASS:" << rowPruneSum;
-            std::nth_element(rowData.indices.begin(), rowData.indices.begin() + RECOVERY_COUNT, rowData.indices.begin() + nonzeros,
-                             [&rowData](size_t i1, size_t i2) {return rowData.values[i1] > rowData.values[i2];});
-            minValueCutoff = rowData.values[rowData.indices[RECOVERY_COUNT]];
-            remainCount = RECOVERY_COUNT;
-            rowPruneSum = 0;
-            for(size_t i = 0UL; i < RECOVERY_COUNT; ++i)
-                rowPruneSum += rowData.values[rowData.indices[i]];
-        }
-        else if(remainCount > SELECTION_COUNT)
-        {
-            // Selection prune
-            // Refine the cutoff so MAXIMUM SELECTION_COUNT elements remain
-            // Should speedtest this vs copy+std::greater<float>
-            std::nth_element(rowData.indices.begin(), rowData.indices.begin() + SELECTION_COUNT, rowData.indices.begin() + nonzeros,
-                             [&rowData](size_t i1, size_t i2) {return rowData.values[i1] > rowData.values[i2];});
+    float mass = 0.0f;
+    auto* remainEnd = std::partition(first, last, [&](Index index)
+    {
+        if(std::abs(values[index]) <= parameters._pruneLimit)
+            return false;
 
-            minValueCutoff = rowData.values[rowData.indices[SELECTION_COUNT]];
+        mass += values[index];
+        return true;
+    });
 
-            if(DEBUG)
-            {
-                qDebug() << "Selection Cutoff" << minValueCutoff;
-                qDebug() << "Pre selection Remain" << remainCount << "mass" << rowPruneSum;
-            }
+    auto remainCount = static_cast<size_t>(remainEnd - first);
+    const auto& counts = parameters._pruneCounts;
 
-            // Recalculate new mass
-            remainCount = SELECTION_COUNT;
-            rowPruneSum = 0;
-            for(size_t i = 0UL; i < SELECTION_COUNT; ++i)
-                rowPruneSum += rowData.values[rowData.indices[i]];
+    if(remainCount != nonzeros && mass < TargetMass && remainCount < counts._recovery)
+    {
+        // Recover
+        std::tie(remainCount, mass) = selectLargest(counts._recovery);
+    }
+    else if(remainCount > counts._selection)
+    {
+        // Selection prune; at most counts._selection elements remain
+        std::tie(remainCount, mass) = selectLargest(counts._selection);
 
-            if(DEBUG)
-                qDebug() << "Post selection Remain" << remainCount << "mass" << rowPruneSum;
+        // Do another recovery if needed
+        if(mass < TargetMass)
+            std::tie(remainCount, mass) = selectLargest(counts._recovery);
+    }
 
-            Q_ASSERT(remainCount < RECOVERY_COUNT);
+    // Inflate what remains, in row order
+    std::sort(first, first + remainCount);
 
-            // Do Another recovery if needed
-            if(remainCount != nonzeros && rowPruneSum < targetMass)
-            {
-                if(DEBUG)
-                    qDebug() << "RECOVERY 2" << "MASS:" << rowPruneSum;
-
-                std::nth_element(rowData.indices.begin(), rowData.indices.begin() + RECOVERY_COUNT, rowData.indices.begin() + nonzeros,
-                                 [&rowData](size_t i1, size_t i2) {return rowData.values[i1] > rowData.values[i2];});
-                minValueCutoff = rowData.values[rowData.indices[RECOVERY_COUNT]];
-                remainCount = RECOVERY_COUNT;
-                rowPruneSum = 0;
-                for(size_t i = 0UL; i < RECOVERY_COUNT; ++i)
-                    rowPruneSum += rowData.values[rowData.indices[i]];
-            }
-        }
+    const float EPSILON = 1e-8f;
+    const auto columnBegin = block._rows.size();
+    float inflatedSum = 0.0f;
+    for(size_t i = 0; i < remainCount; i++)
+    {
+        auto index = first[i];
 
-        // Finally, remove unneeded rowData.indices
-        if(remainCount < nonzeros)
+        // Rescale
+        if(values[index] / mass > EPSILON)
         {
-            if(DEBUG)
-            {
-                qDebug() << "Prune:" << nonzeros - remainCount;
-                qDebug() << "Raw count" << nonzeros;
-                qDebug() << "Remain Count" << remainCount;
-            }
-            for(size_t i = 0UL; i < nonzeros; ++i)
-            {
-                if(std::abs(rowData.values[rowData.indices[i]]) <= minValueCutoff)
-                {
-                    rowData.values[rowData.indices[i]] = 0.0f;
-                    rowData.valid[rowData.indices[i]] = false;
-                }
-                else
-                {
-                    // Rescale
-                    rowData.values[rowData.indices[i]] /= rowPruneSum;
-                }
-            }
+            auto value = std::pow(values[index], parameters._inflation);
+            block._rows.push_back(index);
+            block._values.push_back(value);
+            inflatedSum += value;
         }
+    }
 
-        if(DEBUG)
-        {
-            qDebug() << columnId << "pruned" << nonzeros - remainCount;
-            qDebug() << rowData.values;
-        }
+    for(size_t i = 0; i < nonzeros; i++)
+    {
+        values[first[i]] = 0.0f;
+        valid[first[i]] = 0;
+    }
 
-        // Populate new matrix
-        // If sorting is too big just brute force the whole range
-        // If the range is small just do it contiguously
-        const float EPSILON = 1e-8f;
-        if((nonzeros + nonzeros) < (maxIndex - minIndex))
+    // Normalise, and check whether the column is idempotent
+    float maxValue = 0.0f;
+    float sumOfSquares = 0.0f;
+    if(inflatedSum > 0.0f)
+    {
+        for(auto i = columnBegin; i < block._rows.size(); i++)
         {
-            std::sort(rowData.indices.begin(), rowData.indices.begin() + nonzeros);
+            auto& value = block._values[i];
+            value /= inflatedSum;
 
-            for(size_t j = 0UL; j<nonzeros; ++j)
-            {
-                const size_t index = rowData.indices[j];
-                if(rowData.values[index] > EPSILON)
-                {
-                    matrixStorage->emplace_back(index, columnId, rowData.values[index]);
-                    rowData.values[index] = 0.0f;
-                }
-                rowData.valid[index] = false;
-            }
-        }
-        else
-        {
-            for(size_t j = minIndex; j <= maxIndex; ++j)
-            {
-                if(rowData.values[j] > EPSILON)
-                {
-                    matrixStorage->emplace_back(j, columnId, rowData.values[j]);
-                    rowData.values[j] = 0.0f;
-                }
-                rowData.valid[j] = false;
-            }
+            maxValue = std::max(maxValue, value);
+            sumOfSquares += value * value;
         }
     }
+
+    auto numEntries = static_cast<float>(block._rows.size() - columnBegin);
+    block.endColumn();
+
+    return (maxValue - sumOfSquares) * numEntries <= parameters._convergenceLimit;
 }
+} // namespace
 
 void MCLTransform::apply(TransformedGraph& target) const
 {
     auto granularity = std::get<double>(
                 config().parameterByName(QStringLiteral("Granularity"))->_value);
 
+    size_t memoryBudget = MCL_DEFAULT_MEMORY_BUDGET;
+    const auto* memoryBudgetParameter = config().parameterByName(QStringLiteral("Memory Budget"));
+    if(memoryBudgetParameter != nullptr)
+        memoryBudget = static_cast<size_t>(std::get<int>(memoryBudgetParameter->_value));
+
     if(_debugIteration)
     {
         QElapsedTimer mclTimer;
         mclTimer.start();
-        calculateMCL(granularity, target);
+        calculateMCL(granularity, memoryBudget, target);
         qDebug() << "MCL Elapsed Time" << mclTimer.elapsed();
     }
     else
-        calculateMCL(granularity, target);
+        calculateMCL(granularity, memoryBudget, target);
 }
 
-template<class MatrixType>
-class ColumnsIterator
-{
-public:
-    class iterator
-    {
-    public:
-        using value_type = size_t;
-        using reference = value_type&;
-        using pointer = value_type*;
-        using iterator_category = std::input_iterator_tag;
-        using difference_type = size_t;
-
-    private:
-        size_t _num = 0;
-
-    public:
-        explicit iterator(size_t num = 0) : _num(num) {}
-        iterator& operator++() { _num = _num + 1; return *this; }
-        iterator operator++(int) { iterator retval = *this; ++(*this); return retval; }
-        bool operator==(iterator other) const { return _num == other._num; }
-        bool operator!=(iterator other) const { return !(*this == other); }
-        value_type operator*() const { return _num; }
-    };
-    MatrixType& matrix;
-    explicit ColumnsIterator(MatrixType& _matrix) : matrix(_matrix) {}
-    iterator begin() { return iterator(0); }
-    iterator end() { return iterator(matrix.columns()); }
-};
-
-void MCLTransform::calculateMCL(float inflation, TransformedGraph& target) const
+void MCLTransform::calculateMCL(float inflation, size_t memoryBudget, TransformedGraph& target) const
 {
     target.setPhase(QStringLiteral("MCL Initialising"));
 
-    int nodeCount = target.numNodes();
+    auto adjacency = target.adjacencySnapshot();
+    const auto nodeCount = adjacency->numNodes();
 
-    // Map NodeIds to Matrix index
-    std::map<NodeId, size_t> nodeToIndexMap;
-    std::map<size_t, NodeId> indexToNodeMap;
-    for(NodeId nodeId : target.nodeIds())
-    {
-        auto index = nodeToIndexMap.size();
-        nodeToIndexMap[nodeId] = index;
-        indexToNodeMap[index] = nodeId;
-    }
+    if(nodeCount == 0)
+        return;
 
-    MatrixType clusterMatrix(nodeCount, nodeCount);
-    blaze::setNumThreads(std::thread::hardware_concurrency());
+    const auto numThreads = concurrent_for_num_threads();
 
-    clusterMatrix.reserve((target.numEdges() * 2) + nodeCount);
+    // Each thread has a dense accumulator, in addition to the matrix being expanded and its expansion
+    const auto scratchBytes = numThreads * nodeCount * (sizeof(float) + sizeof(char) + sizeof(Index));
+    const auto entryBytes = sizeof(Index) + sizeof(float);
 
-    // Populate the Matrix
-    for(NodeId nodeId : target.nodeIds())
-    {
-        auto nodeIndex = nodeToIndexMap[nodeId];
-        auto connectedEdgeIds = target.edgeIdsForNodeId(nodeId);
+    // Without an explicit budget, clustering may use up to half of the physical memory
+    uint64_t budgetBytes = static_cast<uint64_t>(memoryBudget) * 1024 * 1024;
+    if(budgetBytes == 0)
+        budgetBytes = u::physicalMemory() / 2;
 
-        // Add all connected node indexes to sorted set
-        std::set<size_t> sortNodeIndexes;
-        for(auto connectEdgeId : connectedEdgeIds)
-        {
-            auto connectedNodeId = target.edgeById(connectEdgeId).oppositeId(nodeId);
-            sortNodeIndexes.insert(nodeToIndexMap[connectedNodeId]);
-        }
-        // Add self loop
-        sortNodeIndexes.insert(nodeIndex);
+    bool pruneCountsReduced = false;
 
-        // Append to Compressed Matrix
-        for(auto sortedConnectIndex : sortNodeIndexes)
-            clusterMatrix.append(sortedConnectIndex, nodeIndex, 1.0f);
+    std::vector<size_t> blockIndices((nodeCount + ColumnBlockSize - 1) / ColumnBlockSize);
+    std::iota(blockIndices.begin(), blockIndices.end(), 0);
 
-        // Finalise the row
-        clusterMatrix.finalize(nodeIndex);
-    }
-    clusterMatrix.trim();
+    MCLMatrix clusterMatrix(nodeCount);
 
-    std::stringstream matrixStream;
-    if(_debugMatrices)
+    // Populate the matrix; each column holds the node itself and its neighbours, normalised
+    concurrent_for(blockIndices.begin(), blockIndices.end(),
+    [&](size_t blockIndex)
     {
-        matrixStream << clusterMatrix;
-        qDebug().noquote() << QString::fromStdString(matrixStream.str());
-    }
-
-    // Normalise the columns
-    normaliseColumnsColumnMajor(clusterMatrix);
-
-    // Pre-inflation
-    clusterMatrix = pow(clusterMatrix, 3.0f);
+        auto& block = clusterMatrix.block(blockIndex);
+        std::vector<Index> rows;
 
-    // Normalise again...
-    normaliseColumnsColumnMajor(clusterMatrix);
-
-    if(_debugIteration)
-        qDebug() << "Pre nnz" << clusterMatrix.nonZeros();
+        for(auto k = clusterMatrix.firstColumnOf(blockIndex); k < clusterMatrix.lastColumnOf(blockIndex); k++)
+        {
+            auto index = static_cast<Index>(k);
+            auto neighbours = adjacency->neighbours(index);
+
+            rows.assign(neighbours.begin(), neighbours.end());
+            rows.push_back(index);
+            std::sort(rows.begin(), rows.end());
+            rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+            // Pre-inflation (cubing then normalising again) leaves a uniform column as it is,
+            // so all that remains is to prune, which for a uniform column is all or nothing
+            auto value = 1.0f / static_cast<float>(rows.size());
+            if(value >= MCL_PRUNE_LIMIT)
+            {
+                block._rows.insert(block._rows.end(), rows.begin(), rows.end());
+                block._values.insert(block._values.end(), rows.size(), value);
+            }
 
-    clusterMatrix.erase([this](float value){ return value < MCL_PRUNE_LIMIT; } );
+            block.endColumn();
+        }
+    });
 
     if(_debugIteration)
         qDebug() << "Pre-prune nnz" << clusterMatrix.nonZeros();
 
     if(_debugMatrices)
-    {
-        matrixStream << "Pre-inflated Matrix \n";
-        matrixStream << clusterMatrix;
-        qDebug().noquote() << QString::fromStdString(matrixStream.str());
-        matrixStream.clear();
-        matrixStream.str(std::string());
-    }
+        clusterMatrix.debugPrint(QStringLiteral("Pre-inflated Matrix"));
+
+    MCLColumnParameters columnParameters{{MCL_SELECTION_COUNT, MCL_RECOVERY_COUNT},
+        MCL_PRUNE_LIMIT, inflation, MCL_CONVERGENCE_LIMIT};
+    std::vector<std::unique_ptr<MCLScratch>> scratches(numThreads);
+
+    // For each column, an upper bound on the number of entries in its next expansion
+    std::vector<size_t> expansionSizes(nodeCount);
 
-    // cppcheck-suppress variableScope
     bool isEquiDistrubuted = true;
     // Start the MCL loop
     int iter = 0;
@@ -415,131 +378,139 @@ void MCLTransform::calculateMCL(float inflation, TransformedGraph& target) const
             return;
 
         target.setPhase(QStringLiteral("MCL Iteration %1").arg(QString::number(iter + 1)));
-        if(_debugMatrices)
-        {
-            matrixStream << "Pre-Expanded Matrix\n";
-            matrixStream << clusterMatrix;
-            qDebug().noquote() << QString::fromStdString(matrixStream.str());
-            matrixStream.clear();
-            matrixStream.str(std::string());
-        }
-
-        isEquiDistrubuted = true;
 
         if(_debugIteration)
             qDebug() << "Iteration" << iter;
 
-        std::vector<std::vector<SparseMatrixEntry>> matrixStorage(clusterMatrix.rows());
+        if(budgetBytes > 0)
+        {
+            // The expansion of a column has no more entries than the sum of the sizes of the columns
+            // it combines, nor than there are rows, and once pruned, no more than the recovery count
+            concurrent_for(blockIndices.begin(), blockIndices.end(),
+            [&](size_t blockIndex)
+            {
+                for(auto k = clusterMatrix.firstColumnOf(blockIndex); k < clusterMatrix.lastColumnOf(blockIndex); k++)
+                {
+                    auto column = clusterMatrix.column(k);
 
-        QElapsedTimer threadedTimer;
-        if(_debugIteration)
-            threadedTimer.start();
+                    size_t size = 0;
+                    for(size_t i = 0; i < column._size; i++)
+                        size += clusterMatrix.column(column._rows[i])._size;
 
-        // Threaded expansion
-        ColumnsIterator<MatrixType> colIterator(clusterMatrix);
+                    expansionSizes[k] = std::min(size, nodeCount);
+                }
+            });
 
-        // To reduce vector allocations for every row we do some magic with rowData
-        MCLRowData rowData(clusterMatrix.columns());
+            auto expansionBytes = [&](size_t recoveryCount)
+            {
+                uint64_t numEntries = 0;
+                for(auto size : expansionSizes)
+                    numEntries += std::min(size, recoveryCount);
 
-        std::atomic<uint64_t> iteration(0);
-        const auto totalIterations = clusterMatrix.columns();
-        target.setProgress(0);
+                return numEntries * entryBytes;
+            };
 
-        // Pass by value rowData, this gives each THREAD a copy of rowData, rather re-allocating vectors per row (slow)
-        concurrent_for(colIterator.begin(), colIterator.end(),
-        [&, rowData, cancelledFn = [this] { return cancelled(); }](const size_t iterator) mutable
-        {
-            expandAndPruneRow(clusterMatrix, iterator, &matrixStorage[iterator],
-                rowData, MCL_PRUNE_LIMIT, cancelledFn);
+            const auto matrixBytes = clusterMatrix.nonZeros() * entryBytes;
+            auto fits = [&](size_t recoveryCount)
+            {
+                return scratchBytes + matrixBytes + expansionBytes(recoveryCount) <= budgetBytes;
+            };
 
-            target.setProgress(static_cast<int>((iteration++ * 100) / totalIterations));
-        });
+            // Retain as many entries per column as possible, without the expansion exceeding the budget
+            size_t recoveryCount = MCL_RECOVERY_COUNT;
+            if(!fits(recoveryCount))
+            {
+                size_t low = MCL_MINIMUM_RECOVERY_COUNT;
+                size_t high = MCL_RECOVERY_COUNT;
 
-        target.setProgress(-1);
+                while(low < high)
+                {
+                    auto middle = (low + high + 1) / 2;
 
-        if(cancelled())
-            return;
+                    if(fits(middle))
+                        low = middle;
+                    else
+                        high = middle - 1;
+                }
 
-        size_t newNNZCount = 0;
-        for(const auto& column : matrixStorage)
-            newNNZCount += column.size();
+                recoveryCount = low;
 
-        MatrixType dstMatrix(clusterMatrix.rows(), clusterMatrix.rows());
-        dstMatrix.reserve(newNNZCount);
-        int row = 0;
-        for(const auto& matrixRow : matrixStorage)
-        {
-            for(auto matrixEntry: matrixRow)
-                dstMatrix.append(matrixEntry._row, matrixEntry._column, matrixEntry._value);
+                if(!pruneCountsReduced)
+                {
+                    addAlert(AlertType::Warning, QObject::tr("To remain within the memory budget, fewer "
+                        "edges than usual have been retained per node, which may affect the clustering"));
+                    pruneCountsReduced = true;
+                }
+            }
+
+            auto& pruneCounts = columnParameters._pruneCounts;
+            pruneCounts._recovery = recoveryCount;
+            pruneCounts._selection = (recoveryCount * MCL_SELECTION_COUNT) / MCL_RECOVERY_COUNT;
 
-            dstMatrix.finalize(row);
-            row++;
+            if(_debugIteration)
+            {
+                qDebug() << "Expansion bounded by" << expansionBytes(recoveryCount) << "bytes; selection count" <<
+                    pruneCounts._selection << "recovery count" << pruneCounts._recovery;
+            }
         }
-        clusterMatrix = dstMatrix;
 
+        QElapsedTimer threadedTimer;
         if(_debugIteration)
-        {
-            int populationTime = threadedTimer.restart();
-            qDebug() << "Threaded Expansion Population time LL ms" << populationTime;
+            threadedTimer.start();
 
-            qDebug() << "Expand nnz" << clusterMatrix.nonZeros();
-        }
+        MCLMatrix expandedMatrix(nodeCount);
+        std::atomic<bool> converged(true);
+        std::atomic<uint64_t> iteration(0);
+        target.setProgress(0);
 
-        if(_debugMatrices)
+        // Threaded expansion, fused with pruning, inflation and normalisation
+        concurrent_for(blockIndices.begin(), blockIndices.end(),
+        [&, cancelledFn = [this] { return cancelled(); }](size_t blockIndex, size_t threadIndex)
         {
-            matrixStream << "Expanded Matrix \n";
-            matrixStream << clusterMatrix;
-            qDebug().noquote() << QString::fromStdString(matrixStream.str());
-            matrixStream.clear();
-            matrixStream.str(std::string());
-        }
+            auto& scratch = scratches.at(threadIndex);
+            if(scratch == nullptr)
+                scratch = std::make_unique<MCLScratch>(nodeCount);
 
-        // Inflate the matrix
-        clusterMatrix = blaze::forEach(clusterMatrix, [&inflation](float d)
-            { return std::pow(d, inflation); });
+            auto& block = expandedMatrix.block(blockIndex);
+            bool blockConverged = true;
 
-        if(_debugMatrices)
-        {
-            matrixStream << "Inflated Expanded Matrix \n";
-            matrixStream << clusterMatrix;
-            qDebug().noquote() << QString::fromStdString(matrixStream.str());
-            matrixStream.clear();
-            matrixStream.str(std::string());
-            qDebug() << "Inflated Expanded nnz" << clusterMatrix.nonZeros();
-        }
+            for(auto k = clusterMatrix.firstColumnOf(blockIndex); k < clusterMatrix.lastColumnOf(blockIndex); k++)
+            {
+                if(cancelledFn())
+                    return;
 
-        // Normalise
-        normaliseColumnsColumnMajor(clusterMatrix);
+                if(!expandColumn(clusterMatrix, k, *scratch, columnParameters, block, cancelledFn))
+                    blockConverged = false;
+            }
 
-        if(_debugMatrices)
-        {
-            matrixStream << "Normalised Inflated Expanded Matrix \n";
-            matrixStream << clusterMatrix;
-            qDebug().noquote() << QString::fromStdString(matrixStream.str());
-            matrixStream.clear();
-            matrixStream.str(std::string());
-            qDebug() << "Normalise nnz" << clusterMatrix.nonZeros();
-        }
+            // The entries are no longer appended to, so spare capacity would only count against the budget
+            block._rows.shrink_to_fit();
+            block._values.shrink_to_fit();
+
+            if(!blockConverged)
+                converged = false;
 
-        // Check if matrix is idempotent
-        MatrixType sqClusterMatrix = blaze::forEach(clusterMatrix, [](float d) { return d * d; });
-        VectorType colSum(nodeCount, 0);
+            iteration += clusterMatrix.lastColumnOf(blockIndex) - clusterMatrix.firstColumnOf(blockIndex);
+            target.setProgress(static_cast<int>((iteration * 100) / nodeCount));
+        });
+
+        target.setProgress(-1);
 
-        sumColumns(sqClusterMatrix, colSum);
-        for(size_t k=0; k<clusterMatrix.columns(); ++k)
+        if(cancelled())
+            return;
+
+        clusterMatrix = std::move(expandedMatrix);
+
+        if(_debugIteration)
         {
-            float max = 0;
-            for(MatrixType::ConstIterator it=clusterMatrix.cbegin(k); it!=clusterMatrix.cend(k); ++it )
-                max = std::max(it->value(),max);
-            if((max - colSum[k]) * clusterMatrix.nonZeros(k) > MCL_CONVERGENCE_LIMIT)
-            {
-                if(_debugIteration)
-                    qDebug() << "No Converge" << (max - colSum[k]) * clusterMatrix.nonZeros(k);
-                isEquiDistrubuted = false;
-                break;
-            }
+            qDebug() << "Threaded Expansion time ms" << threadedTimer.restart();
+            qDebug() << "Expand nnz" << clusterMatrix.nonZeros();
         }
 
+        if(_debugMatrices)
+            clusterMatrix.debugPrint(QStringLiteral("Normalised Inflated Expanded Matrix"));
+
+        isEquiDistrubuted = converged;
         iter++;
     } while(!isEquiDistrubuted);
 
@@ -552,30 +523,32 @@ void MCLTransform::calculateMCL(float inflation, TransformedGraph& target) const
     std::vector<std::set<size_t>> clusters;
     std::vector<size_t> clusterGroups(nodeCount, 0);
     std::vector<bool> clusterGroupAssigned(nodeCount, false);
-    for(size_t k = 0; k < clusterMatrix.columns(); ++k)
+    for(size_t k = 0; k < clusterMatrix.numColumns(); ++k)
     {
-        for(const auto* it = clusterMatrix.cbegin(k); it != clusterMatrix.cend(k); ++it )
+        auto column = clusterMatrix.column(k);
+        for(size_t i = 0; i < column._size; i++)
         {
-            if(it->value() < MCL_PRUNE_LIMIT)
+            if(column._values[i] < MCL_PRUNE_LIMIT)
                 continue;
 
-            auto rowCluster = clusterGroups[it->index()];
+            const size_t row = column._rows[i];
+            auto rowCluster = clusterGroups[row];
             auto columnCluster = clusterGroups[k];
-            auto rowClusterAssigned = clusterGroupAssigned[it->index()];
+            auto rowClusterAssigned = clusterGroupAssigned[row];
             auto columnClusterAssigned = clusterGroupAssigned[k];
 
             // If no cluster exists, make one
             if(!rowClusterAssigned && !columnClusterAssigned)
             {
                 std::set<size_t> newClusterNodeIndex;
-                newClusterNodeIndex.insert(it->index());
+                newClusterNodeIndex.insert(row);
                 newClusterNodeIndex.insert(k);
                 clusters.emplace_back(std::move(newClusterNodeIndex));
 
                 auto index = clusters.size() - 1;
-                clusterGroups[it->index()] = index;
+                clusterGroups[row] = index;
                 clusterGroups[k] = index;
-                clusterGroupAssigned[it->index()] = true;
+                clusterGroupAssigned[row] = true;
                 clusterGroupAssigned[k] = true;
             }
             else if(rowClusterAssigned)
@@ -600,15 +573,15 @@ void MCLTransform::calculateMCL(float inflation, TransformedGraph& target) const
             else if(columnClusterAssigned)
             {
                 // Add to Column Cluster
-                clusterGroups[it->index()] = columnCluster;
-                clusterGroupAssigned[it->index()] = true;
-                clusters[columnCluster].insert(it->index());
+                clusterGroups[row] = columnCluster;
+                clusterGroupAssigned[row] = true;
+                clusters[columnCluster].insert(row);
             }
         }
     }
 
     // Sort clusters descending by size
-    std::sort(clusters.begin(), clusters.end(),
+    std::stable_sort(clusters.begin(), clusters.end(),
         [](const auto& a, const auto& b)
         {
             return a.size() > b.size();
@@ -624,7 +597,7 @@ void MCLTransform::calculateMCL(float inflation, TransformedGraph& target) const
 
         for(auto index : cluster)
         {
-            auto nodeId = indexToNodeMap.at(index);
+            auto nodeId = adjacency->nodeIdAt(static_cast<Index>(index));
             auto clusterName = QString(QObject::tr("Cluster %1")).arg(QString::number(clusterNumber));
 
             clusterNames[nodeId] = clusterName;
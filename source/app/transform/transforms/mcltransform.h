@@ -24,9 +24,14 @@
 #include "shared/utils/flags.h"
 #include "shared/utils/redirects.h"
 
+#include <cstddef>
+
 class MCLTransform : public GraphTransform
 {
 public:
+    // In MiB; 0 is half of the physical memory
+    static constexpr int MCL_DEFAULT_MEMORY_BUDGET = 0;
+
     explicit MCLTransform(GraphModel* graphModel) : _graphModel(graphModel) {}
     void apply(TransformedGraph& target) const override;
 
@@ -40,10 +45,16 @@ private:
     const float MCL_PRUNE_LIMIT = 1e-4f;
     const float MCL_CONVERGENCE_LIMIT = 1e-3f;
 
+    // The number of entries retained per column, after expansion; these are reduced, down to
+    // MCL_MINIMUM_RECOVERY_COUNT, when an expansion could otherwise exceed the memory budget
+    static constexpr size_t MCL_SELECTION_COUNT = 1100;
+    static constexpr size_t MCL_RECOVERY_COUNT = 1400;
+    static constexpr size_t MCL_MINIMUM_RECOVERY_COUNT = 100;
+
     bool _debugIteration = false;
     bool _debugMatrices = false;
 
-    void calculateMCL(float inflation, TransformedGraph& target) const;
+    void calculateMCL(float inflation, size_t memoryBudget, TransformedGraph& target) const;
 
 private:
     GraphModel* _graphModel = nullptr;
@@ -73,6 +84,13 @@ public:
                 QObject::tr("The size of the resultant clusters. "
                     "A larger granularity value results in smaller clusters."),
                 2.0, 1.1, 3.5
+            },
+            {
+                "Memory Budget", ValueType::Int,
+                QObject::tr("The approximate amount of memory, in MiB, that clustering may use. "
+                    "If it would be exceeded, fewer edges per node are retained, so as to stay within it. "
+                    "When 0, half of the physical memory may be used."),
+                MCLTransform::MCL_DEFAULT_MEMORY_BUDGET, 0
             }
         };
     }
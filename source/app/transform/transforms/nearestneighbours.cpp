@@ -0,0 +1,134 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nearestneighbours.h"
+
+#include "transform/transformedgraph.h"
+#include "graph/adjacencysnapshot.h"
+#include "attributes/attribute.h"
+#include "shared/utils/threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+NearestNeighbourRanks rankNearestNeighbours(TransformedGraph& target, const Attribute& attribute,
+    bool ascending, const std::function<size_t(size_t)>& numRetainedFn)
+{
+    using Index = AdjacencySnapshot::Index;
+
+    auto adjacency = target.adjacencySnapshot();
+    const auto numNodes = adjacency->numNodes();
+
+    target.setProgress(0);
+
+    // Evaluating an attribute is relatively expensive, and not necessarily
+    // thread safe, so do it once per edge, before ranking anything
+    EdgeArray<float> values(target);
+    for(auto edgeId : target.edgeIds())
+        values[edgeId] = static_cast<float>(attribute.numericValueOf(edgeId));
+
+    NearestNeighbourRanks ranks(target);
+
+    struct Entry
+    {
+        float _value = 0.0f;
+        uint32_t _position = 0;
+    };
+
+    // Ties are broken by position, so that the ranking is deterministic
+    auto ranksHigher = [ascending](const Entry& a, const Entry& b)
+    {
+        if(a._value != b._value)
+            return ascending ? a._value < b._value : a._value > b._value;
+
+        return a._position < b._position;
+    };
+
+    std::vector<std::unique_ptr<std::vector<Entry>>> scratches(concurrent_for_num_threads());
+    std::atomic<size_t> numNodesComplete(0);
+
+    std::vector<Index> indices(numNodes);
+    std::iota(indices.begin(), indices.end(), 0);
+
+    auto rankNode = [&](Index index, size_t threadIndex)
+    {
+        auto& entries = scratches.at(threadIndex);
+        if(entries == nullptr)
+            entries = std::make_unique<std::vector<Entry>>();
+
+        const auto* edgeIds = adjacency->edgeIds(index).begin();
+        const auto* neighbours = adjacency->neighbours(index).begin();
+        const auto degree = adjacency->degree(index);
+        const auto inDegree = adjacency->inDegree(index);
+        const auto numRetained = std::min(numRetainedFn(degree), degree);
+
+        entries->clear();
+        for(size_t i = 0; i < degree; i++)
+            entries->push_back({values[edgeIds[i]], static_cast<uint32_t>(i)});
+
+        auto retainedEnd = entries->begin() + static_cast<ptrdiff_t>(numRetained);
+        std::partial_sort(entries->begin(), retainedEnd, entries->end(), ranksHigher);
+
+        // Each edge has a source entry and a target entry, which are ranked by different
+        // threads, but only ever written by the one that owns the corresponding node
+        for(size_t rank = 0; rank < numRetained; rank++)
+        {
+            auto position = (*entries)[rank]._position;
+            auto& edgeRank = ranks[edgeIds[position]];
+
+            if(position >= inDegree || neighbours[position] == index)
+                edgeRank._source = rank + 1;
+            else
+                edgeRank._target = rank + 1;
+        }
+
+        target.setProgress(static_cast<int>((++numNodesComplete * 100) / numNodes));
+    };
+
+    if(!indices.empty())
+        concurrent_for(indices.begin(), indices.end(), rankNode);
+
+    EdgeArray<bool> removees(target, true);
+
+    for(auto edgeId : target.edgeIds())
+    {
+        auto& rank = ranks[edgeId];
+
+        if(rank._source == 0 && rank._target == 0)
+            continue;
+
+        removees.set(edgeId, false);
+
+        if(rank._source == 0)
+            rank._mean = static_cast<double>(rank._target);
+        else if(rank._target == 0)
+            rank._mean = static_cast<double>(rank._source);
+        else
+            rank._mean = static_cast<double>(rank._source + rank._target) * 0.5;
+    }
+
+    target.setProgress(-1);
+    target.mutableGraph().bulkRemoveEdges(removees);
+
+    return ranks;
+}
@@ -0,0 +1,44 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NEARESTNEIGHBOURS_H
+#define NEARESTNEIGHBOURS_H
+
+#include "shared/graph/grapharray.h"
+
+#include <cstddef>
+#include <functional>
+
+class TransformedGraph;
+class Attribute;
+
+struct NearestNeighbourRank
+{
+    size_t _source = 0;
+    size_t _target = 0;
+    double _mean = 0.0;
+};
+
+using NearestNeighbourRanks = EdgeArray<NearestNeighbourRank>;
+
+// Ranks the edges of each node by the value of attribute, retaining the first numRetainedFn(degree)
+// of them; edges that are retained by neither of their nodes are removed from target
+NearestNeighbourRanks rankNearestNeighbours(TransformedGraph& target, const Attribute& attribute,
+    bool ascending, const std::function<size_t(size_t)>& numRetainedFn);
+
+#endif // NEARESTNEIGHBOURS_H
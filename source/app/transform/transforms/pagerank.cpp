@@ -0,0 +1,276 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pagerank.h"
+
+#include "graph/adjacencysnapshot.h"
+
+#include "shared/utils/cancellable.h"
+#include "shared/utils/threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <numeric>
+
+namespace
+{
+using Index = AdjacencySnapshot::Index;
+
+constexpr float PAGERANK_DAMPING = 0.8f;
+constexpr float PAGERANK_EPSILON = 1e-6f;
+constexpr float PAGERANK_ACCELERATION_MINIMUM = 1e-10f;
+constexpr int PAGERANK_ITERATION_LIMIT = 1000;
+constexpr int AVG_COUNT = 10;
+
+// Components smaller than this are gathered into batches of roughly this size, each computed
+// on a single thread, whereas larger components are computed one at a time, with each of their
+// iterations split into chunks of ChunkSize nodes, spread over the threads
+constexpr size_t LargeComponentSize = 1 << 14;
+constexpr size_t ChunkSize = 1 << 12;
+
+struct Span
+{
+    size_t _begin = 0;
+    size_t _end = 0;
+};
+
+std::vector<Span> spansOf(size_t size, size_t spanSize)
+{
+    std::vector<Span> spans;
+    for(size_t begin = 0; begin < size; begin += spanSize)
+        spans.push_back({begin, std::min(begin + spanSize, size)});
+
+    return spans;
+}
+
+// Tracks the convergence of the iterations for a single component
+struct Convergence
+{
+    float _change = std::numeric_limits<float>::max();
+    int _iterationCount = 0;
+    std::deque<float> _changeBuffer;
+    float _previousBufferChangeAverage = 0.0f;
+    float _acceleration = std::numeric_limits<float>::max();
+
+    bool finished() const
+    {
+        return _change <= PAGERANK_EPSILON ||
+            _iterationCount >= PAGERANK_ITERATION_LIMIT ||
+            _acceleration <= PAGERANK_ACCELERATION_MINIMUM;
+    }
+
+    void update(float change)
+    {
+        _change = change;
+
+        // Oscillation detection (delta avg)
+        _changeBuffer.push_front(change);
+        if(_changeBuffer.size() >= static_cast<size_t>(AVG_COUNT))
+            _changeBuffer.pop_back();
+
+        // Average the last 10 steps
+        float bufferChangeAverage = 0.0f;
+        for(auto changes : _changeBuffer)
+            bufferChangeAverage += changes;
+        bufferChangeAverage /= static_cast<float>(AVG_COUNT);
+
+        _acceleration = std::abs(_previousBufferChangeAverage - bufferChangeAverage);
+
+        // Only update the previousAvg after AVG_COUNT steps
+        if(_iterationCount % AVG_COUNT == 0)
+            _previousBufferChangeAverage = bufferChangeAverage;
+
+        _iterationCount++;
+    }
+};
+} // namespace
+
+PageRankResult computePageRank(const AdjacencySnapshot& adjacency, const Cancellable& cancellable,
+    const std::function<void(int)>& progressFn, const std::function<void(int)>& iterationFn)
+{
+    // Performs an estimated pagerank calculation optimised to
+    // not use a matrix. This dramatically lowers the memory footprint.
+    // http://www.dcs.bbk.ac.uk/~dell/teaching/cc/book/mmds/mmds_ch5_2.pdf
+    // http://michaelnielsen.org/blog/using-your-laptop-to-compute-pagerank-for-millions-of-webpages/
+    auto components = adjacency.components();
+
+    // All indexed by the snapshot, so that each node's neighbours are gathered from contiguous
+    // arrays; each node's contribution to its neighbours is its rank, damped and divided by its
+    // degree, which is computed once per iteration, rather than once per neighbour
+    const auto numNodes = adjacency.numNodes();
+    std::vector<float> ranks(numNodes);
+    std::vector<float> newRanks(numNodes);
+    std::vector<float> contributions(numNodes);
+    std::vector<float> inverseDegrees(numNodes);
+
+    for(Index index = 0; index < numNodes; index++)
+    {
+        auto degree = adjacency.degree(index);
+        inverseDegrees[index] = degree > 0 ? 1.0f / static_cast<float>(degree) : 0.0f;
+    }
+
+    auto gather = [&](const Index* first, const Index* last, float base)
+    {
+        double sum = 0.0;
+
+        for(const auto* it = first; it != last; ++it)
+        {
+            float prSum = 0.0f;
+            for(auto neighbour : adjacency.neighbours(*it))
+                prSum += contributions[neighbour];
+
+            newRanks[*it] = base + prSum;
+            sum += static_cast<double>(newRanks[*it]);
+        }
+
+        return sum;
+    };
+
+    // Normalises the new ranks, returning how much they've changed
+    auto normalise = [&](const Index* first, const Index* last, float scale)
+    {
+        double change = 0.0;
+
+        for(const auto* it = first; it != last; ++it)
+        {
+            auto rank = newRanks[*it] * scale;
+            change += static_cast<double>(std::abs(rank - ranks[*it]));
+
+            ranks[*it] = rank;
+            contributions[*it] = rank * PAGERANK_DAMPING * inverseDegrees[*it];
+        }
+
+        return change;
+    };
+
+    std::atomic<size_t> numNodesComplete(0);
+    std::atomic_int totalIterationCount(0);
+    std::atomic_bool iterationLimitReached(false);
+
+    auto computeComponent = [&](const std::vector<Index>& indices, bool concurrent)
+    {
+        const auto* first = indices.data();
+        const auto* last = first + indices.size();
+        const auto componentNodeCount = static_cast<float>(indices.size());
+
+        for(auto index : indices)
+        {
+            ranks[index] = 1.0f / componentNodeCount;
+            contributions[index] = ranks[index] * PAGERANK_DAMPING * inverseDegrees[index];
+        }
+
+        const float base = (1.0f - PAGERANK_DAMPING) / componentNodeCount;
+
+        std::vector<Span> chunks;
+        std::vector<double> partials;
+        if(concurrent)
+        {
+            chunks = spansOf(indices.size(), ChunkSize);
+            partials.resize(chunks.size());
+        }
+
+        // Applies fn to the whole component, in chunks concurrently if need be, summing the results
+        auto sumOf = [&](auto&& fn, float parameter)
+        {
+            if(!concurrent)
+                return fn(first, last, parameter);
+
+            concurrent_for(chunks.begin(), chunks.end(), [&](std::vector<Span>::iterator chunk)
+            {
+                auto chunkIndex = static_cast<size_t>(std::distance(chunks.begin(), chunk));
+                partials[chunkIndex] = fn(first + chunk->_begin, first + chunk->_end, parameter);
+            });
+
+            return std::accumulate(partials.begin(), partials.end(), 0.0);
+        };
+
+        Convergence convergence;
+        while(!convergence.finished())
+        {
+            if(cancellable.cancelled())
+                return;
+
+            if(concurrent)
+                iterationFn(totalIterationCount + 1);
+
+            auto sum = sumOf(gather, base);
+            auto change = sumOf(normalise, static_cast<float>(1.0 / sum));
+
+            convergence.update(static_cast<float>(change));
+            totalIterationCount++;
+        }
+
+        if(convergence._iterationCount == PAGERANK_ITERATION_LIMIT)
+            iterationLimitReached = true;
+
+        float maxValue = 0.0f;
+        for(auto index : indices)
+            maxValue = std::max(maxValue, std::abs(ranks[index]));
+
+        for(auto index : indices)
+            ranks[index] /= maxValue;
+
+        numNodesComplete += indices.size();
+        progressFn(static_cast<int>((numNodesComplete * 100) / numNodes));
+    };
+
+    // Gather the small components into batches, so that they're spread over the threads
+    std::vector<std::vector<size_t>> smallComponentBatches;
+    size_t batchNodeCount = LargeComponentSize;
+    for(size_t i = 0; i < components.size(); i++)
+    {
+        if(components[i].size() >= LargeComponentSize)
+            continue;
+
+        if(batchNodeCount >= LargeComponentSize)
+        {
+            smallComponentBatches.emplace_back();
+            batchNodeCount = 0;
+        }
+
+        smallComponentBatches.back().push_back(i);
+        batchNodeCount += components[i].size();
+    }
+
+    if(!smallComponentBatches.empty())
+    {
+        concurrent_for(smallComponentBatches.begin(), smallComponentBatches.end(),
+        [&](const std::vector<size_t>& batch)
+        {
+            for(auto i : batch)
+                computeComponent(components[i], false);
+        });
+    }
+
+    for(const auto& component : components)
+    {
+        if(component.size() >= LargeComponentSize)
+            computeComponent(component, true);
+    }
+
+    PageRankResult result;
+    result._ranks = std::move(ranks);
+    result._numComponents = components.size();
+    result._iterationCount = totalIterationCount;
+    result._iterationLimitReached = iterationLimitReached;
+
+    return result;
+}
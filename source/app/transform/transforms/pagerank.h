@@ -0,0 +1,46 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PAGERANK_H
+#define PAGERANK_H
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+class AdjacencySnapshot;
+class Cancellable;
+
+struct PageRankResult
+{
+    // Indexed by the snapshot; scaled so that the highest rank in each component is 1
+    std::vector<float> _ranks;
+
+    size_t _numComponents = 0;
+    int _iterationCount = 0;
+    bool _iterationLimitReached = false;
+};
+
+// Computes the PageRank of each node, treating each connected component as a separate graph;
+// progressFn is called with the percentage of the nodes that are complete, and iterationFn with
+// the total number of iterations so far, while a large component is being computed
+PageRankResult computePageRank(const AdjacencySnapshot& adjacency, const Cancellable& cancellable,
+    const std::function<void(int)>& progressFn = [](int) {},
+    const std::function<void(int)>& iterationFn = [](int) {});
+
+#endif // PAGERANK_H
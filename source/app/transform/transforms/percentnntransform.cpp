@@ -20,11 +20,11 @@
 
 #include "transform/transformedgraph.h"
 #include "graph/graphmodel.h"
-#include "shared/utils/container.h"
+#include "nearestneighbours.h"
 
 #include <algorithm>
-#include <functional>
 #include <memory>
+#include <vector>
 
 #include <QObject>
 
@@ -44,76 +44,8 @@ void PercentNNTransform::apply(TransformedGraph& target) const
     auto attribute = _graphModel->attributeValueByName(config().attributeNames().front());
     bool ascending = config().parameterHasValue(QStringLiteral("Rank Order"), QStringLiteral("Ascending"));
 
-    struct PercentNNRank
-    {
-        size_t _source = 0;
-        size_t _target = 0;
-        double _mean = 0.0;
-    };
-
-    EdgeArray<PercentNNRank> ranks(target);
-    EdgeArray<bool> removees(target, true);
-
-    uint64_t progress = 0;
-    for(auto nodeId : target.nodeIds())
-    {
-        auto edgeIds = target.nodeById(nodeId).edgeIds();
-
-        auto k = std::max((edgeIds.size() * percent) / 100, minimum);
-        auto kthPlus1 = edgeIds.begin() + std::min(k, edgeIds.size());
-
-        if(ascending)
-        {
-            std::partial_sort(edgeIds.begin(), kthPlus1, edgeIds.end(),
-                [&attribute](auto a, auto b) { return attribute.numericValueOf(a) < attribute.numericValueOf(b); });
-        }
-        else
-        {
-            std::partial_sort(edgeIds.begin(), kthPlus1, edgeIds.end(),
-                [&attribute](auto a, auto b) { return attribute.numericValueOf(a) > attribute.numericValueOf(b); });
-        }
-
-        for(auto it = edgeIds.begin(); it != kthPlus1; ++it)
-        {
-            auto position = std::distance(edgeIds.begin(), it) + 1;
-
-            if(target.edgeById(*it).sourceId() == nodeId)
-                ranks[*it]._source = position;
-            else
-                ranks[*it]._target = position;
-
-            removees.set(*it, false);
-        }
-
-        target.setProgress(static_cast<int>((progress++ * 100u) /
-            static_cast<uint64_t>(target.numNodes())));
-    }
-
-    progress = 0;
-
-    for(const auto& edgeId : target.edgeIds())
-    {
-        if(removees.get(edgeId))
-        {
-            target.mutableGraph().removeEdge(edgeId);
-        }
-        else
-        {
-            auto& rank = ranks[edgeId];
-
-            if(rank._source == 0)
-                rank._mean = rank._target;
-            else if(rank._target == 0)
-                rank._mean = rank._source;
-            else
-                rank._mean = static_cast<double>(rank._source + rank._target) * 0.5;
-        }
-
-        target.setProgress(static_cast<int>((progress++ * 100u) /
-            static_cast<uint64_t>(target.numEdges())));
-    }
-
-    target.setProgress(-1);
+    auto ranks = rankNearestNeighbours(target, attribute, ascending,
+        [percent, minimum](size_t degree) { return std::max((degree * percent) / 100, minimum); });
 
     _graphModel->createAttribute(QObject::tr("%-NN Source Rank"))
         .setDescription(QObject::tr("The ranking given by k-NN, relative to its source node."))
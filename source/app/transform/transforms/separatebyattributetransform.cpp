@@ -18,7 +18,7 @@
 
 #include "separatebyattributetransform.h"
 #include "transform/transformedgraph.h"
-#include "attributes/conditionfncreator.h"
+#include "attributes/conditionevaluator.h"
 #include "graph/graphmodel.h"
 
 #include "shared/utils/string.h"
@@ -44,8 +44,9 @@ void SeparateByAttributeTransform::apply(TransformedGraph& target) const
         QStringLiteral("$target.%1").arg(attributeName),
     };
 
-    auto conditionFn = CreateConditionFnFor::edge(*_graphModel, condition);
-    if(conditionFn == nullptr)
+    const auto& edgeIds = target.edgeIds();
+    ConditionEvaluator<EdgeId> conditionEvaluator(*_graphModel, target, edgeIds);
+    if(!conditionEvaluator.evaluate(condition))
     {
         addAlert(AlertType::Error, QObject::tr("Invalid condition"));
         return;
@@ -53,10 +54,10 @@ void SeparateByAttributeTransform::apply(TransformedGraph& target) const
 
     EdgeIdSet edgeIdsToRemove;
 
-    for(auto edgeId : target.edgeIds())
+    for(size_t i = 0; i < edgeIds.size(); i++)
     {
-        if(conditionFn(edgeId))
-            edgeIdsToRemove.insert(edgeId);
+        if(conditionEvaluator.selected(i))
+            edgeIdsToRemove.insert(edgeIds[i]);
     }
 
     target.mutableGraph().removeEdges(edgeIdsToRemove);
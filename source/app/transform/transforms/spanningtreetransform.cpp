@@ -22,6 +22,7 @@
 
 #include "graph/componentmanager.h"
 #include "graph/graphcomponent.h"
+#include "graph/adjacencysnapshot.h"
 
 #include <memory>
 #include <deque>
@@ -39,6 +40,7 @@ void SpanningTreeTransform::apply(TransformedGraph& target) const
     NodeArray<bool> visitedNodes(target, false);
 
     ComponentManager componentManager(target);
+    auto adjacency = target.adjacencySnapshot();
 
     for(auto componentId : componentManager.componentIds())
     {
@@ -77,28 +79,22 @@ void SpanningTreeTransform::apply(TransformedGraph& target) const
             if(!traversedEdgeId.isNull())
                 removees.set(traversedEdgeId, false);
 
-            for(auto edgeId : target.nodeById(nodeId).edgeIds())
+            auto index = adjacency->indexOf(nodeId);
+            const auto* neighbours = adjacency->neighbours(index).begin();
+            const auto* edgeIds = adjacency->edgeIds(index).begin();
+
+            for(size_t i = 0; i < adjacency->degree(index); i++)
             {
-                auto oppositeId = target.edgeById(edgeId).oppositeId(nodeId);
+                auto oppositeId = adjacency->nodeIdAt(neighbours[i]);
 
                 if(!visitedNodes.get(oppositeId))
-                    deque.push_back({oppositeId, edgeId});
+                    deque.push_back({oppositeId, edgeIds[i]});
             }
         }
     }
 
-    uint64_t progress = 0;
-
-    for(const auto& edgeId : target.edgeIds())
-    {
-        if(removees.get(edgeId))
-            target.mutableGraph().removeEdge(edgeId);
-
-        target.setProgress(static_cast<int>((progress++ * 100u) /
-            static_cast<uint64_t>(target.numEdges())));
-    }
-
     target.setProgress(-1);
+    target.mutableGraph().bulkRemoveEdges(removees);
 }
 
 std::unique_ptr<GraphTransform> SpanningTreeTransformFactory::create(const GraphTransformConfig&) const
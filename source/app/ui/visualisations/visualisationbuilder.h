@@ -155,6 +155,9 @@ public:
             return;
         }
 
+        // Held for the duration, and read directly for the elements it covers
+        auto column = attribute.materialise();
+
         switch(attribute.valueType())
         {
         case ValueType::Int:
@@ -165,6 +168,14 @@ public:
 
             int numApplications = 0;
 
+            auto numericValueOf = [&attribute, column = column.get()](ElementId elementId)
+            {
+                if(column != nullptr && column->covers(elementId))
+                    return column->numericValueOf(elementId);
+
+                return attribute.numericValueOf(elementId);
+            };
+
             auto applyTo = [&](const auto& graph)
             {
                 auto [min, max] = attribute.findRangeforElements(elementIds(graph));
@@ -181,7 +192,7 @@ public:
 
                 for(auto elementId : elementIds(graph))
                 {
-                    double value = attribute.numericValueOf(elementId);
+                    double value = numericValueOf(elementId);
 
                     if(channel.requiresNormalisedValue())
                     {
@@ -233,7 +244,8 @@ public:
         {
             for(auto elementId : elementIds())
             {
-                auto stringValue = attribute.stringValueOf(elementId);
+                auto stringValue = column != nullptr && column->covers(elementId) ?
+                    column->stringValueOf(elementId) : attribute.stringValueOf(elementId);
                 apply(stringValue, channel, elementId, _numAppliedVisualisations);
             }
 
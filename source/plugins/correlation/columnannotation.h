@@ -19,6 +19,8 @@
 #ifndef COLUMNANNOTATION_H
 #define COLUMNANNOTATION_H
 
+#include "shared/utils/stringcolumn.h"
+
 #include <QString>
 
 #include <vector>
@@ -33,7 +35,7 @@ private:
     std::set<QString> _uniqueValues;
 
 public:
-    using Iterator = std::vector<QString>::const_iterator;
+    using Iterator = StringColumn::Iterator;
 
     ColumnAnnotation(QString name, std::vector<QString> values);
     ColumnAnnotation(QString name, const Iterator& begin, const Iterator& end);
@@ -18,14 +18,158 @@
 
 #include "correlation.h"
 
-std::unique_ptr<Correlation> Correlation::create(CorrelationType correlationType)
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+std::unique_ptr<Correlation> Correlation::create(CorrelationType correlationType,
+    CorrelationPrecision precision)
 {
+    std::unique_ptr<Correlation> correlation;
+
     switch(correlationType)
     {
-    case CorrelationType::Pearson:      return std::make_unique<PearsonCorrelation>();
-    case CorrelationType::SpearmanRank: return std::make_unique<SpearmanRankCorrelation>();
+    case CorrelationType::Pearson:      correlation = std::make_unique<PearsonCorrelation>(); break;
+    case CorrelationType::SpearmanRank: correlation = std::make_unique<SpearmanRankCorrelation>(); break;
     default: break;
     }
 
-    return nullptr;
+    if(correlation != nullptr)
+        correlation->setPrecision(precision);
+
+    return correlation;
+}
+
+std::vector<CorrelationEdge> Correlation::process(const std::vector<CorrelationDataRow>& rows,
+    double minimumThreshold, CorrelationPolarity polarity,
+    Cancellable* cancellable, Progressable* progressable) const
+{
+    std::vector<CorrelationEdge> edges;
+
+    streamEdges(rows, minimumThreshold, polarity, 0,
+    [&edges](const auto& batch)
+    {
+        edges.insert(edges.end(), batch.begin(), batch.end());
+        return true;
+    }, cancellable, progressable);
+
+    return edges;
+}
+
+std::vector<double> Correlation::approximateRecall(const std::vector<CorrelationEdge>& exactEdges,
+    const std::vector<double>& thresholds, double minimumThreshold,
+    CorrelationPolarity polarity, size_t numRows, size_t numColumns)
+{
+    auto parameters = CorrelationLshParameters::choose(minimumThreshold,
+        polarity == CorrelationPolarity::Both, numRows, numColumns);
+
+    std::vector<double> strengths;
+    strengths.reserve(exactEdges.size());
+    for(const auto& edge : exactEdges)
+        strengths.push_back(correlationStrength(edge._r, polarity));
+
+    std::sort(strengths.begin(), strengths.end(), std::greater<>());
+
+    // cumulativeRecall[i] is the total expected recall of the i strongest edges
+    std::vector<double> cumulativeRecall(strengths.size() + 1, 0.0);
+    for(size_t i = 0; i < strengths.size(); i++)
+        cumulativeRecall[i + 1] = cumulativeRecall[i] + parameters.recall(strengths[i]);
+
+    std::vector<double> recalls;
+    recalls.reserve(thresholds.size());
+
+    for(auto threshold : thresholds)
+    {
+        auto numEdges = static_cast<size_t>(std::distance(strengths.begin(),
+            std::upper_bound(strengths.begin(), strengths.end(), threshold, std::greater<>())));
+
+        recalls.push_back(numEdges > 0 ? cumulativeRecall[numEdges] / numEdges : 1.0);
+    }
+
+    return recalls;
+}
+
+Correlation::TopNeighbours::TopNeighbours(size_t numRows, size_t k, CorrelationPolarity polarity) :
+    _k(k), _polarity(polarity), _neighbours(numRows * k), _numNeighbours(numRows, 0)
+{}
+
+void Correlation::TopNeighbours::add(size_t row, size_t neighbour, double r)
+{
+    // Ties are broken in favour of the lower row, so that the outcome is independent
+    // of the order in which the neighbours are added
+    auto weaker = [this](const Neighbour& a, const Neighbour& b)
+    {
+        auto strengthA = correlationStrength(a._r, _polarity);
+        auto strengthB = correlationStrength(b._r, _polarity);
+
+        if(strengthA != strengthB)
+            return strengthA > strengthB;
+
+        return a._row < b._row;
+    };
+
+    auto* first = &_neighbours[row * _k];
+    auto& count = _numNeighbours[row];
+
+    if(count < _k)
+    {
+        first[count++] = {neighbour, r};
+        std::push_heap(first, first + count, weaker);
+    }
+    else if(weaker({neighbour, r}, *first))
+    {
+        std::pop_heap(first, first + _k, weaker);
+        first[_k - 1] = {neighbour, r};
+        std::push_heap(first, first + _k, weaker);
+    }
+}
+
+void Correlation::TopNeighbours::sort(size_t row)
+{
+    // Sort the neighbours by row, so they can be searched subsequently
+    auto* first = &_neighbours[row * _k];
+    std::sort(first, first + _numNeighbours[row],
+        [](const auto& a, const auto& b) { return a._row < b._row; });
+}
+
+bool Correlation::TopNeighbours::contains(size_t row, size_t neighbour) const
+{
+    const auto* first = &_neighbours[row * _k];
+    const auto* last = first + _numNeighbours[row];
+
+    return std::binary_search(first, last, Neighbour{neighbour, 0.0},
+        [](const auto& a, const auto& b) { return a._row < b._row; });
+}
+
+bool Correlation::TopNeighbours::streamEdges(const std::vector<CorrelationDataRow>& rows,
+    size_t batchSize, const EdgeBatchFn& edgeBatchFn) const
+{
+    std::vector<CorrelationEdge> batch;
+    batch.reserve(batchSize);
+
+    for(size_t rowA = 0; rowA < rows.size(); rowA++)
+    {
+        const auto* first = &_neighbours[rowA * _k];
+        const auto* last = first + _numNeighbours[rowA];
+
+        for(const auto* neighbour = first; neighbour != last; ++neighbour)
+        {
+            auto rowB = neighbour->_row;
+
+            if(rowA < rowB)
+                batch.push_back({rows[rowA].nodeId(), rows[rowB].nodeId(), neighbour->_r});
+            else if(!contains(rowB, rowA))
+                batch.push_back({rows[rowB].nodeId(), rows[rowA].nodeId(), neighbour->_r});
+        }
+
+        if(batch.size() >= batchSize)
+        {
+            if(!edgeBatchFn(batch))
+                return false;
+
+            batch.clear();
+        }
+    }
+
+    return batch.empty() || edgeBatchFn(batch);
 }
@@ -21,15 +21,28 @@
 
 #include "correlationdatarow.h"
 #include "correlationedge.h"
+#include "correlationkernel.h"
+#include "correlationlsh.h"
+#include "correlationrowmatrix.h"
 
 #include "shared/utils/qmlenum.h"
 #include "shared/utils/progressable.h"
 #include "shared/utils/cancellable.h"
 #include "shared/utils/threadpool.h"
+#include "shared/utils/boundedqueue.h"
 #include "shared/utils/redirects.h"
 
 #include <vector>
 #include <cmath>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <memory>
+#include <tuple>
 
 #include <QObject>
 #include <QString>
@@ -48,19 +61,106 @@ DEFINE_QML_ENUM(
     Negative,
     Both);
 
+// Single stores and computes in single precision; Mixed stores
+// in single precision but accumulates in double precision
+DEFINE_QML_ENUM(
+    Q_GADGET, CorrelationPrecision,
+    Double,
+    Single,
+    Mixed);
+
+// Maps r to a value that is larger the stronger the correlation is, with respect to polarity
+inline double correlationStrength(double r, CorrelationPolarity polarity)
+{
+    switch(polarity)
+    {
+    default:
+    case CorrelationPolarity::Positive: return r;
+    case CorrelationPolarity::Negative: return -r;
+    case CorrelationPolarity::Both:     return std::abs(r);
+    }
+}
+
 class Correlation
 {
+private:
+    CorrelationPrecision _precision = CorrelationPrecision::Double;
+    bool _approximate = false;
+
 public:
+    // Receives edges in batches, as they are produced; returning false stops processing
+    using EdgeBatchFn = std::function<bool(const std::vector<CorrelationEdge>&)>;
+
     virtual ~Correlation() = default;
 
-    virtual std::vector<CorrelationEdge> process(const std::vector<CorrelationDataRow>& rows,
+    // Produces edges in bounded batches, instead of accumulating them all in memory first
+    // When maxEdgesPerNode is non-zero, only those edges which are amongst the strongest
+    // maxEdgesPerNode of either of their nodes are produced, using O(n * maxEdgesPerNode)
+    // memory; returns false if cancelled or stopped by edgeBatchFn
+    virtual bool streamEdges(const std::vector<CorrelationDataRow>& rows,
+        double minimumThreshold, CorrelationPolarity polarity, size_t maxEdgesPerNode,
+        const EdgeBatchFn& edgeBatchFn, Cancellable* cancellable = nullptr,
+        Progressable* progressable = nullptr) const = 0;
+
+    std::vector<CorrelationEdge> process(const std::vector<CorrelationDataRow>& rows,
         double minimumThreshold, CorrelationPolarity polarity = CorrelationPolarity::Positive,
-        Cancellable* cancellable = nullptr, Progressable* progressable = nullptr) const = 0;
+        Cancellable* cancellable = nullptr, Progressable* progressable = nullptr) const;
 
     virtual QString attributeName() const = 0;
     virtual QString attributeDescription() const = 0;
 
-    static std::unique_ptr<Correlation> create(CorrelationType correlationType);
+    CorrelationPrecision precision() const { return _precision; }
+    void setPrecision(CorrelationPrecision precision) { _precision = precision; }
+
+    // When set, only pairs of rows that a locality sensitive hash deems likely to
+    // exceed minimumThreshold are correlated, so some edges may be missed
+    bool approximate() const { return _approximate; }
+    void setApproximate(bool approximate) { _approximate = approximate; }
+
+    static std::unique_ptr<Correlation> create(CorrelationType correlationType,
+        CorrelationPrecision precision = CorrelationPrecision::Double);
+
+    // The expected proportion of the edges in exactEdges that an approximate correlation of
+    // numRows rows would find, for each threshold in thresholds
+    static std::vector<double> approximateRecall(const std::vector<CorrelationEdge>& exactEdges,
+        const std::vector<double>& thresholds, double minimumThreshold,
+        CorrelationPolarity polarity, size_t numRows, size_t numColumns);
+
+protected:
+    // The strongest k neighbours of each row, each maintained as a heap whose front
+    // is the weakest, so that it can be replaced when a stronger one turns up
+    class TopNeighbours
+    {
+    private:
+        struct Neighbour
+        {
+            size_t _row = 0;
+            double _r = 0.0;
+        };
+
+        size_t _k = 0;
+        CorrelationPolarity _polarity = CorrelationPolarity::Positive;
+
+        std::vector<Neighbour> _neighbours;
+        std::vector<size_t> _numNeighbours;
+
+        bool contains(size_t row, size_t neighbour) const;
+
+    public:
+        TopNeighbours(size_t numRows, size_t k, CorrelationPolarity polarity);
+
+        // Concurrent calls must be for different rows; the result doesn't depend
+        // on the order in which neighbours are added
+        void add(size_t row, size_t neighbour, double r);
+
+        // Must be called for every row, once all its neighbours have been added
+        void sort(size_t row);
+
+        // An edge may be amongst the strongest of both its nodes, in which
+        // case it is only produced once, from the lower row
+        bool streamEdges(const std::vector<CorrelationDataRow>& rows,
+            size_t batchSize, const EdgeBatchFn& edgeBatchFn) const;
+    };
 };
 
 enum class RowType
@@ -72,89 +172,344 @@ enum class RowType
 template<typename Algorithm, RowType rowType = RowType::Raw>
 class CovarianceCorrelation : public Correlation
 {
-public:
-    std::vector<CorrelationEdge> process(const std::vector<CorrelationDataRow>& rows,
-        double minimumThreshold, CorrelationPolarity polarity = CorrelationPolarity::Positive,
-        Cancellable* cancellable = nullptr, Progressable* progressable = nullptr) const final
-    {
-        if(rows.empty())
-            return {};
+private:
+    // The maximum number of edge batches that may be waiting to be consumed
+    static constexpr size_t MaxQueuedBatches = 64;
 
-        size_t numColumns = std::distance(rows.front().begin(), rows.front().end());
+    // The number of edges passed to edgeBatchFn at once, when maxEdgesPerNode is set
+    static constexpr size_t TopEdgesBatchSize = 1U << 16U;
+
+    static bool isCancelled(Cancellable* cancellable)
+    {
+        return cancellable != nullptr && cancellable->cancelled();
+    }
 
+    static void updateProgress(Progressable* progressable, uint64_t cost, uint64_t totalCost)
+    {
         if(progressable != nullptr)
-            progressable->setProgress(-1);
+            progressable->setProgress(static_cast<int>((cost * 100) / totalCost));
+    }
+
+    // Pack the (normalised) rows into a contiguous matrix, such that each
+    // correlation value is simply the dot product of two of its rows
+    template<typename T>
+    static CorrelationRowMatrix<T> normalisedMatrix(ThreadPool& threadPool,
+        const std::vector<CorrelationDataRow>& rows, bool doubleAccumulation = false)
+    {
+        size_t numColumns = std::distance(rows.front().begin(), rows.front().end());
 
-        uint64_t totalCost = 0;
-        for(const auto& row : rows)
+        CorrelationRowMatrix<T> matrix(rows.size(), numColumns, doubleAccumulation);
+        threadPool.concurrent_for(rows.begin(), rows.end(),
+        [&](std::vector<CorrelationDataRow>::const_iterator rowIt)
         {
-            totalCost += row.computeCostHint();
+            const auto* row = &(*rowIt);
 
             if constexpr(rowType == RowType::Ranking)
-                row.generateRanking();
-        }
+            {
+                row->generateRanking();
+                row = row->ranking();
+            }
+
+            Algorithm::normalise(*row, matrix.row(std::distance(rows.begin(), rowIt)));
+        });
+
+        return matrix;
+    }
 
+    template<typename Matrix>
+    static bool streamThresholdedEdges(ThreadPool& threadPool, const Matrix& matrix,
+        const std::vector<CorrelationDataRow>& rows, double minimumThreshold,
+        CorrelationPolarity polarity, const EdgeBatchFn& edgeBatchFn,
+        Cancellable* cancellable, Progressable* progressable)
+    {
+        using namespace CorrelationKernel;
+
+        const uint64_t numRows = rows.size();
+        const uint64_t totalCost = std::max(numRows * (numRows - 1) / 2, uint64_t{1});
         std::atomic<uint64_t> cost(0);
 
-        auto results = ThreadPool(QStringLiteral("Correlation")).concurrent_for(rows.begin(), rows.end(),
-        [&](std::vector<CorrelationDataRow>::const_iterator rowAIt)
-        {
-            const auto* rowA = &(*rowAIt);
+        const auto spans = matrix.upperTriangleSpans();
 
-            if constexpr(rowType == RowType::Ranking)
-                rowA = rowA->ranking();
+        // Per thread scratch space for tile results
+        std::vector<std::vector<double>> blocks(threadPool.numThreads(),
+            std::vector<double>(TileSize * TileSize));
+
+        // Each span's edges are handed to the calling thread, which in turn hands them to
+        // edgeBatchFn in the order of the spans, however they finish, so that the edges are
+        // always produced in the same order; no more than MaxQueuedBatches are ever waiting.
+        // Each thread's spans are contiguous and ascending, even when stolen, so the thread
+        // processing the next span to be consumed is never blocked
+        OrderedBoundedQueue<std::vector<CorrelationEdge>> queue(spans.size(), MaxQueuedBatches);
 
+        auto results = threadPool.concurrent_for(spans.begin(), spans.end(),
+        [&](std::vector<CorrelationTileSpan>::const_iterator spanIt, size_t threadIndex)
+        {
+            const auto& span = *spanIt;
             std::vector<CorrelationEdge> edges;
 
-            if(cancellable != nullptr && cancellable->cancelled())
-                return edges;
+            if(!isCancelled(cancellable))
+            {
+                auto& block = blocks.at(threadIndex);
+
+                for(auto tileB = span._firstTileB; tileB < span._lastTileB; tileB++)
+                {
+                    matrix.forEachInTilePair(span._tileA, tileB, block.data(), true,
+                    [&](size_t rowA, size_t rowB, double r)
+                    {
+                        if(correlationStrength(r, polarity) >= minimumThreshold)
+                            edges.push_back({rows[rowA].nodeId(), rows[rowB].nodeId(), r});
+                    });
+                }
+
+                cost += span._numPairs;
+                updateProgress(progressable, cost, totalCost);
+            }
 
-            for(auto rowBIt = rowAIt + 1; rowBIt != rows.end(); ++rowBIt)
+            // Even when empty, so that the spans that follow can be consumed
+            queue.push(static_cast<size_t>(std::distance(spans.begin(), spanIt)), std::move(edges));
+        }, ThreadPool::NonBlocking);
+
+        bool stopped = false;
+        std::vector<CorrelationEdge> batch;
+        while(queue.pop(batch))
+        {
+            if(!batch.empty() && !edgeBatchFn(batch))
             {
-                const auto* rowB = &(*rowBIt);
+                queue.abandon();
+                stopped = true;
+                break;
+            }
+        }
+
+        results.wait();
+
+        return !stopped;
+    }
+
+    template<typename Matrix>
+    static bool streamTopEdges(ThreadPool& threadPool, const Matrix& matrix,
+        const std::vector<CorrelationDataRow>& rows, double minimumThreshold,
+        CorrelationPolarity polarity, size_t maxEdgesPerNode, const EdgeBatchFn& edgeBatchFn,
+        Cancellable* cancellable, Progressable* progressable)
+    {
+        using namespace CorrelationKernel;
+
+        const uint64_t numRows = rows.size();
+        const uint64_t totalCost = std::max(numRows * (numRows - 1) / 2, uint64_t{1});
+        std::atomic<uint64_t> cost(0);
+
+        TopNeighbours topNeighbours(rows.size(), maxEdgesPerNode, polarity);
+
+        struct Candidate
+        {
+            size_t _rowA = 0;
+            size_t _rowB = 0;
+            double _r = 0.0;
+        };
+
+        auto spans = matrix.upperTriangleSpans();
 
-                if constexpr(rowType == RowType::Ranking)
-                    rowB = rowB->ranking();
+        std::vector<std::vector<double>> blocks(threadPool.numThreads(),
+            std::vector<double>(TileSize * TileSize));
+        std::vector<std::vector<Candidate>> threadCandidates(threadPool.numThreads());
 
-                double r = Algorithm::evaluate(numColumns, rowA, rowB);
+        // Each pair is only correlated once, but feeds the neighbours of both its rows,
+        // so the neighbours of each tile's rows are guarded by a lock; these are only
+        // ever taken one at a time, so there is no lock ordering to worry about
+        std::vector<std::mutex> tileMutexes(matrix.numTiles());
 
-                if(!std::isfinite(r))
+        threadPool.concurrent_for(spans.begin(), spans.end(),
+        [&](const CorrelationTileSpan& span, size_t threadIndex)
+        {
+            if(isCancelled(cancellable))
+                return;
+
+            auto& block = blocks.at(threadIndex);
+            auto& candidates = threadCandidates.at(threadIndex);
+
+            for(auto tileB = span._firstTileB; tileB < span._lastTileB; tileB++)
+            {
+                candidates.clear();
+
+                matrix.forEachInTilePair(span._tileA, tileB, block.data(), true,
+                [&](size_t rowA, size_t rowB, double r)
+                {
+                    if(correlationStrength(r, polarity) >= minimumThreshold)
+                        candidates.push_back({rowA, rowB, r});
+                });
+
+                if(candidates.empty())
                     continue;
 
-                bool createEdge = false;
+                {
+                    std::unique_lock<std::mutex> lock(tileMutexes.at(span._tileA));
+                    for(const auto& candidate : candidates)
+                        topNeighbours.add(candidate._rowA, candidate._rowB, candidate._r);
+                }
+
+                {
+                    std::unique_lock<std::mutex> lock(tileMutexes.at(tileB));
+                    for(const auto& candidate : candidates)
+                        topNeighbours.add(candidate._rowB, candidate._rowA, candidate._r);
+                }
+            }
+
+            cost += span._numPairs;
+            updateProgress(progressable, cost, totalCost);
+        });
+
+        if(isCancelled(cancellable))
+            return false;
+
+        for(size_t row = 0; row < rows.size(); row++)
+            topNeighbours.sort(row);
+
+        return topNeighbours.streamEdges(rows, TopEdgesBatchSize, edgeBatchFn);
+    }
+
+    template<typename T>
+    static bool streamApproximateEdges(ThreadPool& threadPool, const CorrelationRowMatrix<T>& matrix,
+        const CorrelationLshParameters& parameters, const std::vector<CorrelationDataRow>& rows,
+        double minimumThreshold, CorrelationPolarity polarity, size_t maxEdgesPerNode,
+        const EdgeBatchFn& edgeBatchFn, Cancellable* cancellable, Progressable* progressable)
+    {
+        const bool positive = polarity != CorrelationPolarity::Negative;
+        const bool negative = polarity != CorrelationPolarity::Positive;
+
+        CorrelationLshIndex<T> index(threadPool, matrix, parameters);
+
+        std::unique_ptr<TopNeighbours> topNeighbours;
+        if(maxEdgesPerNode > 0)
+            topNeighbours = std::make_unique<TopNeighbours>(rows.size(), maxEdgesPerNode, polarity);
+
+        struct Candidate
+        {
+            size_t _rowA = 0;
+            size_t _rowB = 0;
+            double _r = 0.0;
+        };
+
+        std::vector<std::vector<Candidate>> threadCandidates(threadPool.numThreads());
+        std::vector<CorrelationEdge> edges;
 
-                switch(polarity)
+        for(size_t band = 0; band < index.numBands(); band++)
+        {
+            if(isCancelled(cancellable))
+                return false;
+
+            // Exact r is only computed for the candidate pairs
+            index.forEachCandidatePair(threadPool, band, positive, negative,
+            [&](size_t rowA, size_t rowB, size_t threadIndex)
+            {
+                double r = matrix.dotProduct(rowA, rowB);
+
+                if(std::isfinite(r) && correlationStrength(r, polarity) >= minimumThreshold)
+                    threadCandidates[threadIndex].push_back({rowA, rowB, r});
+            });
+
+            for(auto& candidates : threadCandidates)
+            {
+                for(const auto& candidate : candidates)
                 {
-                default:
-                case CorrelationPolarity::Positive: createEdge = (r >= minimumThreshold); break;
-                case CorrelationPolarity::Negative: createEdge = (r <= -minimumThreshold); break;
-                case CorrelationPolarity::Both:     createEdge = (std::abs(r) >= minimumThreshold); break;
+                    if(topNeighbours != nullptr)
+                    {
+                        topNeighbours->add(candidate._rowA, candidate._rowB, candidate._r);
+                        topNeighbours->add(candidate._rowB, candidate._rowA, candidate._r);
+                    }
+                    else
+                    {
+                        edges.push_back({rows[candidate._rowA].nodeId(),
+                            rows[candidate._rowB].nodeId(), candidate._r});
+                    }
                 }
 
-                if(createEdge)
-                    edges.push_back({rowA->nodeId(), rowB->nodeId(), r});
+                candidates.clear();
             }
 
-            cost += rowA->computeCostHint();
+            if(!edges.empty())
+            {
+                // Which thread finds which candidate varies, so put them in a fixed order
+                std::sort(edges.begin(), edges.end(), [](const auto& a, const auto& b)
+                {
+                    return std::tie(a._source, a._target) < std::tie(b._source, b._target);
+                });
 
-            if(progressable != nullptr)
-                progressable->setProgress(static_cast<int>((cost * 100) / totalCost));
+                if(!edgeBatchFn(edges))
+                    return false;
 
-            return edges;
-        });
+                edges.clear();
+            }
+
+            updateProgress(progressable, band + 1, index.numBands());
+        }
+
+        if(topNeighbours == nullptr)
+            return true;
+
+        for(size_t row = 0; row < rows.size(); row++)
+            topNeighbours->sort(row);
+
+        return topNeighbours->streamEdges(rows, TopEdgesBatchSize, edgeBatchFn);
+    }
+
+public:
+    bool streamEdges(const std::vector<CorrelationDataRow>& rows,
+        double minimumThreshold, CorrelationPolarity polarity, size_t maxEdgesPerNode,
+        const EdgeBatchFn& edgeBatchFn, Cancellable* cancellable = nullptr,
+        Progressable* progressable = nullptr) const final
+    {
+        if(rows.empty())
+            return true;
 
         if(progressable != nullptr)
-        {
-            // Returning the results might take time
             progressable->setProgress(-1);
+
+        ThreadPool threadPool(QStringLiteral("Correlation"));
+
+        auto stream = [&](const auto& matrix)
+        {
+            if(approximate())
+            {
+                auto parameters = CorrelationLshParameters::choose(minimumThreshold,
+                    polarity == CorrelationPolarity::Both, matrix.numRows(), matrix.numColumns());
+
+                if(!parameters.exact())
+                {
+                    return streamApproximateEdges(threadPool, matrix, parameters, rows,
+                        minimumThreshold, polarity, maxEdgesPerNode, edgeBatchFn,
+                        cancellable, progressable);
+                }
+            }
+
+            return maxEdgesPerNode > 0 ?
+                streamTopEdges(threadPool, matrix, rows, minimumThreshold, polarity,
+                    maxEdgesPerNode, edgeBatchFn, cancellable, progressable) :
+                streamThresholdedEdges(threadPool, matrix, rows, minimumThreshold, polarity,
+                    edgeBatchFn, cancellable, progressable);
+        };
+
+        bool success = false;
+
+        switch(precision())
+        {
+        default:
+        case CorrelationPrecision::Double:
+            success = stream(normalisedMatrix<double>(threadPool, rows));
+            break;
+
+        case CorrelationPrecision::Single:
+            success = stream(normalisedMatrix<float>(threadPool, rows));
+            break;
+
+        case CorrelationPrecision::Mixed:
+            success = stream(normalisedMatrix<float>(threadPool, rows, true));
+            break;
         }
 
-        std::vector<CorrelationEdge> edges;
-        edges.reserve(std::distance(results.begin(), results.end()));
-        edges.insert(edges.end(), std::make_move_iterator(results.begin()),
-            std::make_move_iterator(results.end()));
+        if(progressable != nullptr)
+            progressable->setProgress(-1);
 
-        return edges;
+        return success && !isCancelled(cancellable);
     }
 };
 
@@ -168,6 +523,30 @@ struct PearsonAlgorithm
 
         return numerator / denominator;
     }
+
+    // Centres and scales a row to unit length, such that the dot product of two
+    // normalised rows is equivalent to evaluate(...) on the original rows
+    template<typename T>
+    static void normalise(const CorrelationDataRow& row, T* output)
+    {
+        double sumSquares = 0.0;
+        for(auto value : row)
+        {
+            auto x = value - row.mean();
+            sumSquares += x * x;
+        }
+
+        if(sumSquares <= 0.0)
+        {
+            // The correlation is undefined when a row has no variance
+            std::fill(output, output + row.numColumns(), std::numeric_limits<T>::quiet_NaN());
+            return;
+        }
+
+        const auto scale = 1.0 / std::sqrt(sumSquares);
+        for(auto value : row)
+            *output++ = static_cast<T>((value - row.mean()) * scale);
+    }
 };
 
 class PearsonCorrelation : public CovarianceCorrelation<PearsonAlgorithm>
@@ -0,0 +1,412 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "correlationkernel.h"
+
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CORRELATION_KERNEL_X86
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define CORRELATION_KERNEL_X86
+#define TARGET_AVX2
+#define TARGET_AVX512
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+using namespace CorrelationKernel;
+
+namespace
+{
+// The number of columns processed in one pass over a tile; this keeps both the A and B
+// panels (TileSize * KBlock * sizeof(double) each) resident in L2
+constexpr size_t KBlock = 256;
+
+static_assert(KBlock % ColumnMultiple == 0);
+
+// Each micro kernel computes an MR x NR block of dot products over length columns,
+// accumulating them into c
+template<typename T>
+using MicroKernelFn = void(*)(const T* a, const T* b,
+    size_t stride, size_t length, double* c);
+
+template<size_t MR, size_t NR, typename T>
+void tileWith(MicroKernelFn<T> microKernel, const T* a, const T* b, size_t stride, double* c)
+{
+    static_assert(TileSize % MR == 0 && TileSize % NR == 0);
+
+    std::fill(c, c + (TileSize * TileSize), 0.0);
+
+    for(size_t k = 0; k < stride; k += KBlock)
+    {
+        auto length = std::min(KBlock, stride - k);
+
+        for(size_t i = 0; i < TileSize; i += MR)
+        {
+            for(size_t j = 0; j < TileSize; j += NR)
+            {
+                microKernel(a + (i * stride) + k, b + (j * stride) + k,
+                    stride, length, c + (i * TileSize) + j);
+            }
+        }
+    }
+}
+
+// Accumulator is the type used to sum the products in, which may be wider than T
+template<typename T, typename Accumulator>
+void microKernelScalar(const T* a, const T* b, size_t stride, size_t length, double* c)
+{
+    const auto* a0 = a;
+    const auto* a1 = a + stride;
+    const auto* b0 = b;
+    const auto* b1 = b + stride;
+
+    Accumulator c00 = 0.0, c01 = 0.0, c10 = 0.0, c11 = 0.0;
+
+    for(size_t k = 0; k < length; k++)
+    {
+        c00 += static_cast<Accumulator>(a0[k]) * static_cast<Accumulator>(b0[k]);
+        c01 += static_cast<Accumulator>(a0[k]) * static_cast<Accumulator>(b1[k]);
+        c10 += static_cast<Accumulator>(a1[k]) * static_cast<Accumulator>(b0[k]);
+        c11 += static_cast<Accumulator>(a1[k]) * static_cast<Accumulator>(b1[k]);
+    }
+
+    c[0] += static_cast<double>(c00);
+    c[1] += static_cast<double>(c01);
+    c[TileSize] += static_cast<double>(c10);
+    c[TileSize + 1] += static_cast<double>(c11);
+}
+
+#ifdef CORRELATION_KERNEL_X86
+TARGET_AVX2 double horizontalSumAvx2(__m256d v)
+{
+    auto sum = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+}
+
+TARGET_AVX2 double horizontalSumAvx2(__m256 v)
+{
+    auto sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return static_cast<double>(_mm_cvtss_f32(sum));
+}
+
+// 2 x 4 uses 8 accumulators and 6 operands, fitting within the 16 ymm registers
+constexpr size_t MRAvx2 = 2;
+constexpr size_t NRAvx2 = 4;
+
+TARGET_AVX2 void microKernelAvx2(const double* a, const double* b, size_t stride, size_t length, double* c)
+{
+    __m256d accumulators[MRAvx2][NRAvx2];
+    for(auto& row : accumulators)
+        for(auto& accumulator : row)
+            accumulator = _mm256_setzero_pd();
+
+    for(size_t k = 0; k < length; k += 4)
+    {
+        __m256d as[MRAvx2];
+        for(size_t i = 0; i < MRAvx2; i++)
+            as[i] = _mm256_load_pd(a + (i * stride) + k);
+
+        for(size_t j = 0; j < NRAvx2; j++)
+        {
+            auto bj = _mm256_load_pd(b + (j * stride) + k);
+
+            for(size_t i = 0; i < MRAvx2; i++)
+                accumulators[i][j] = _mm256_fmadd_pd(as[i], bj, accumulators[i][j]);
+        }
+    }
+
+    for(size_t i = 0; i < MRAvx2; i++)
+        for(size_t j = 0; j < NRAvx2; j++)
+            c[(i * TileSize) + j] += horizontalSumAvx2(accumulators[i][j]);
+}
+
+TARGET_AVX2 void microKernelAvx2(const float* a, const float* b, size_t stride, size_t length, double* c)
+{
+    __m256 accumulators[MRAvx2][NRAvx2];
+    for(auto& row : accumulators)
+        for(auto& accumulator : row)
+            accumulator = _mm256_setzero_ps();
+
+    for(size_t k = 0; k < length; k += 8)
+    {
+        __m256 as[MRAvx2];
+        for(size_t i = 0; i < MRAvx2; i++)
+            as[i] = _mm256_load_ps(a + (i * stride) + k);
+
+        for(size_t j = 0; j < NRAvx2; j++)
+        {
+            auto bj = _mm256_load_ps(b + (j * stride) + k);
+
+            for(size_t i = 0; i < MRAvx2; i++)
+                accumulators[i][j] = _mm256_fmadd_ps(as[i], bj, accumulators[i][j]);
+        }
+    }
+
+    for(size_t i = 0; i < MRAvx2; i++)
+        for(size_t j = 0; j < NRAvx2; j++)
+            c[(i * TileSize) + j] += horizontalSumAvx2(accumulators[i][j]);
+}
+
+// Single precision values are widened to double precision before being multiplied
+TARGET_AVX2 void microKernelMixedAvx2(const float* a, const float* b, size_t stride, size_t length, double* c)
+{
+    __m256d accumulators[MRAvx2][NRAvx2];
+    for(auto& row : accumulators)
+        for(auto& accumulator : row)
+            accumulator = _mm256_setzero_pd();
+
+    for(size_t k = 0; k < length; k += 4)
+    {
+        __m256d as[MRAvx2];
+        for(size_t i = 0; i < MRAvx2; i++)
+            as[i] = _mm256_cvtps_pd(_mm_load_ps(a + (i * stride) + k));
+
+        for(size_t j = 0; j < NRAvx2; j++)
+        {
+            auto bj = _mm256_cvtps_pd(_mm_load_ps(b + (j * stride) + k));
+
+            for(size_t i = 0; i < MRAvx2; i++)
+                accumulators[i][j] = _mm256_fmadd_pd(as[i], bj, accumulators[i][j]);
+        }
+    }
+
+    for(size_t i = 0; i < MRAvx2; i++)
+        for(size_t j = 0; j < NRAvx2; j++)
+            c[(i * TileSize) + j] += horizontalSumAvx2(accumulators[i][j]);
+}
+
+// 4 x 4 uses 16 accumulators and 8 operands, fitting within the 32 zmm registers
+constexpr size_t MRAvx512 = 4;
+constexpr size_t NRAvx512 = 4;
+
+TARGET_AVX512 void microKernelAvx512(const double* a, const double* b, size_t stride, size_t length, double* c)
+{
+    __m512d accumulators[MRAvx512][NRAvx512];
+    for(auto& row : accumulators)
+        for(auto& accumulator : row)
+            accumulator = _mm512_setzero_pd();
+
+    for(size_t k = 0; k < length; k += 8)
+    {
+        __m512d as[MRAvx512];
+        for(size_t i = 0; i < MRAvx512; i++)
+            as[i] = _mm512_load_pd(a + (i * stride) + k);
+
+        for(size_t j = 0; j < NRAvx512; j++)
+        {
+            auto bj = _mm512_load_pd(b + (j * stride) + k);
+
+            for(size_t i = 0; i < MRAvx512; i++)
+                accumulators[i][j] = _mm512_fmadd_pd(as[i], bj, accumulators[i][j]);
+        }
+    }
+
+    for(size_t i = 0; i < MRAvx512; i++)
+        for(size_t j = 0; j < NRAvx512; j++)
+            c[(i * TileSize) + j] += _mm512_reduce_add_pd(accumulators[i][j]);
+}
+
+TARGET_AVX512 void microKernelAvx512(const float* a, const float* b, size_t stride, size_t length, double* c)
+{
+    __m512 accumulators[MRAvx512][NRAvx512];
+    for(auto& row : accumulators)
+        for(auto& accumulator : row)
+            accumulator = _mm512_setzero_ps();
+
+    for(size_t k = 0; k < length; k += 16)
+    {
+        __m512 as[MRAvx512];
+        for(size_t i = 0; i < MRAvx512; i++)
+            as[i] = _mm512_load_ps(a + (i * stride) + k);
+
+        for(size_t j = 0; j < NRAvx512; j++)
+        {
+            auto bj = _mm512_load_ps(b + (j * stride) + k);
+
+            for(size_t i = 0; i < MRAvx512; i++)
+                accumulators[i][j] = _mm512_fmadd_ps(as[i], bj, accumulators[i][j]);
+        }
+    }
+
+    for(size_t i = 0; i < MRAvx512; i++)
+        for(size_t j = 0; j < NRAvx512; j++)
+            c[(i * TileSize) + j] += static_cast<double>(_mm512_reduce_add_ps(accumulators[i][j]));
+}
+
+TARGET_AVX512 void microKernelMixedAvx512(const float* a, const float* b, size_t stride, size_t length, double* c)
+{
+    __m512d accumulators[MRAvx512][NRAvx512];
+    for(auto& row : accumulators)
+        for(auto& accumulator : row)
+            accumulator = _mm512_setzero_pd();
+
+    for(size_t k = 0; k < length; k += 8)
+    {
+        __m512d as[MRAvx512];
+        for(size_t i = 0; i < MRAvx512; i++)
+            as[i] = _mm512_cvtps_pd(_mm256_load_ps(a + (i * stride) + k));
+
+        for(size_t j = 0; j < NRAvx512; j++)
+        {
+            auto bj = _mm512_cvtps_pd(_mm256_load_ps(b + (j * stride) + k));
+
+            for(size_t i = 0; i < MRAvx512; i++)
+                accumulators[i][j] = _mm512_fmadd_pd(as[i], bj, accumulators[i][j]);
+        }
+    }
+
+    for(size_t i = 0; i < MRAvx512; i++)
+        for(size_t j = 0; j < NRAvx512; j++)
+            c[(i * TileSize) + j] += _mm512_reduce_add_pd(accumulators[i][j]);
+}
+
+enum class InstructionSet
+{
+    Scalar,
+    AVX2,
+    AVX512
+};
+
+InstructionSet detectInstructionSet()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    const auto maxLeaf = info[0];
+
+    if(maxLeaf < 7)
+        return InstructionSet::Scalar;
+
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool fma = (info[2] & (1 << 12)) != 0;
+
+    if(!osxsave)
+        return InstructionSet::Scalar;
+
+    const auto xcr0 = _xgetbv(0);
+    const bool osAvx = (xcr0 & 0x6) == 0x6;
+    const bool osAvx512 = (xcr0 & 0xE6) == 0xE6;
+
+    __cpuidex(info, 7, 0);
+    const bool avx2 = (info[1] & (1 << 5)) != 0;
+    const bool avx512f = (info[1] & (1 << 16)) != 0;
+
+    if(avx512f && osAvx512)
+        return InstructionSet::AVX512;
+
+    if(avx2 && fma && osAvx)
+        return InstructionSet::AVX2;
+#else
+    __builtin_cpu_init();
+
+    if(__builtin_cpu_supports("avx512f"))
+        return InstructionSet::AVX512;
+
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return InstructionSet::AVX2;
+#endif
+
+    return InstructionSet::Scalar;
+}
+
+const InstructionSet instructionSetInUse = detectInstructionSet();
+#endif
+} // namespace
+
+void CorrelationKernel::tile(const double* a, const double* b, size_t stride, double* c)
+{
+#ifdef CORRELATION_KERNEL_X86
+    switch(instructionSetInUse)
+    {
+    case InstructionSet::AVX512:
+        tileWith<MRAvx512, NRAvx512, double>(&microKernelAvx512, a, b, stride, c);
+        return;
+
+    case InstructionSet::AVX2:
+        tileWith<MRAvx2, NRAvx2, double>(&microKernelAvx2, a, b, stride, c);
+        return;
+
+    default: break;
+    }
+#endif
+
+    tileWith<2, 2, double>(&microKernelScalar<double, double>, a, b, stride, c);
+}
+
+void CorrelationKernel::tile(const float* a, const float* b, size_t stride, double* c)
+{
+#ifdef CORRELATION_KERNEL_X86
+    switch(instructionSetInUse)
+    {
+    case InstructionSet::AVX512:
+        tileWith<MRAvx512, NRAvx512, float>(&microKernelAvx512, a, b, stride, c);
+        return;
+
+    case InstructionSet::AVX2:
+        tileWith<MRAvx2, NRAvx2, float>(&microKernelAvx2, a, b, stride, c);
+        return;
+
+    default: break;
+    }
+#endif
+
+    tileWith<2, 2, float>(&microKernelScalar<float, float>, a, b, stride, c);
+}
+
+void CorrelationKernel::tileMixed(const float* a, const float* b, size_t stride, double* c)
+{
+#ifdef CORRELATION_KERNEL_X86
+    switch(instructionSetInUse)
+    {
+    case InstructionSet::AVX512:
+        tileWith<MRAvx512, NRAvx512, float>(&microKernelMixedAvx512, a, b, stride, c);
+        return;
+
+    case InstructionSet::AVX2:
+        tileWith<MRAvx2, NRAvx2, float>(&microKernelMixedAvx2, a, b, stride, c);
+        return;
+
+    default: break;
+    }
+#endif
+
+    tileWith<2, 2, float>(&microKernelScalar<float, double>, a, b, stride, c);
+}
+
+const char* CorrelationKernel::instructionSet()
+{
+#ifdef CORRELATION_KERNEL_X86
+    switch(instructionSetInUse)
+    {
+    case InstructionSet::AVX512:    return "AVX-512";
+    case InstructionSet::AVX2:      return "AVX2";
+    default: break;
+    }
+#endif
+
+    return "Scalar";
+}
@@ -0,0 +1,51 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef CORRELATIONKERNEL_H
+#define CORRELATIONKERNEL_H
+
+#include <cstddef>
+
+namespace CorrelationKernel
+{
+// The number of rows in each side of a tile
+constexpr size_t TileSize = 32;
+
+// Row strides must be a multiple of this many elements, and rows must start on
+// an Alignment byte boundary, so that the kernels can use aligned vector loads;
+// 16 floats is 64 bytes, so this holds for both single and double precision
+constexpr size_t ColumnMultiple = 16;
+constexpr size_t Alignment = 64;
+
+// Computes the dot product of each of the TileSize rows starting at a with each of the
+// TileSize rows starting at b, writing the results to the TileSize x TileSize block c,
+// where c[i * TileSize + j] is a[i] · b[j]
+void tile(const double* a, const double* b, size_t stride, double* c);
+
+// As above, but in single precision throughout, which doubles the SIMD width
+void tile(const float* a, const float* b, size_t stride, double* c);
+
+// Single precision values, accumulated in double precision
+void tileMixed(const float* a, const float* b, size_t stride, double* c);
+
+// The name of the instruction set in use, for debugging purposes
+const char* instructionSet();
+} // namespace CorrelationKernel
+
+#endif // CORRELATIONKERNEL_H
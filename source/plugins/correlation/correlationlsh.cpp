@@ -0,0 +1,89 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "correlationlsh.h"
+
+#include "shared/utils/constants.h"
+
+#include <algorithm>
+#include <cmath>
+
+static double hyperplaneCollisionProbability(double strength)
+{
+    return 1.0 - (std::acos(std::clamp(strength, -1.0, 1.0)) / Constants::Pi());
+}
+
+double CorrelationLshParameters::recall(double strength) const
+{
+    if(exact())
+        return 1.0;
+
+    auto p = std::pow(hyperplaneCollisionProbability(strength), _bitsPerBand);
+    return 1.0 - std::pow(1.0 - p, _numBands);
+}
+
+CorrelationLshParameters CorrelationLshParameters::choose(double minimumThreshold,
+    bool bothPolarities, size_t numRows, size_t numColumns, double targetRecall)
+{
+    CorrelationLshParameters best;
+
+    // Below 0, almost every pair is a candidate anyway
+    if(numRows < 2 || minimumThreshold <= 0.0 || minimumThreshold >= 1.0)
+        return best;
+
+    const auto n = static_cast<double>(numRows);
+    const auto m = static_cast<double>(numColumns);
+    const auto numPairs = (n * (n - 1.0)) / 2.0;
+
+    // Candidate pairs are computed individually, rather than in cache friendly tiles
+    const double CandidateCostFactor = 4.0;
+
+    const auto p = hyperplaneCollisionProbability(minimumThreshold);
+    auto bestCost = numPairs * m;
+
+    for(size_t bitsPerBand = 1; bitsPerBand <= MaxBitsPerBand; bitsPerBand++)
+    {
+        auto pBand = std::pow(p, bitsPerBand);
+        auto numBands = static_cast<size_t>(std::ceil(std::log(1.0 - targetRecall) / std::log(1.0 - pBand)));
+        numBands = std::max(numBands, size_t{1});
+
+        if(numBands > MaxBands)
+            continue;
+
+        // Uncorrelated pairs are separated by each hyperplane with a probability of ½,
+        // and with both polarities they have two chances to become a candidate
+        auto falseCandidateRate = 1.0 - std::pow(1.0 - std::pow(0.5, bitsPerBand), numBands);
+        if(bothPolarities)
+            falseCandidateRate = std::min(2.0 * falseCandidateRate, 1.0);
+
+        auto numBandsD = static_cast<double>(numBands);
+        auto hashingCost = n * m * static_cast<double>(bitsPerBand) * numBandsD;
+        auto sortingCost = n * numBandsD * std::log2(n);
+        auto candidateCost = numPairs * falseCandidateRate * m * CandidateCostFactor;
+        auto cost = hashingCost + sortingCost + candidateCost;
+
+        if(cost < bestCost)
+        {
+            bestCost = cost;
+            best._bitsPerBand = bitsPerBand;
+            best._numBands = numBands;
+        }
+    }
+
+    return best;
+}
@@ -0,0 +1,259 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CORRELATIONLSH_H
+#define CORRELATIONLSH_H
+
+#include "correlationkernel.h"
+#include "correlationrowmatrix.h"
+
+#include "shared/utils/threadpool.h"
+
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <numeric>
+
+// Random hyperplane LSH (SimHash) parameters; since the rows of a CorrelationRowMatrix are
+// centred and of unit length, r is their cosine similarity, and the probability that a random
+// hyperplane doesn't separate them is 1 - acos(r)/π. Each band is the signature of _bitsPerBand
+// hyperplanes, and a pair of rows becomes a candidate when any one of its bands match
+struct CorrelationLshParameters
+{
+    static constexpr size_t MaxBitsPerBand = 32;
+    static constexpr size_t MaxBands = 64;
+    static constexpr double DefaultTargetRecall = 0.95;
+
+    size_t _bitsPerBand = 0;
+    size_t _numBands = 0;
+
+    // When there are no bands, every pair is to be computed exactly
+    bool exact() const { return _numBands == 0; }
+
+    size_t numHyperplanes() const { return _bitsPerBand * _numBands; }
+
+    // The probability that a pair of rows whose correlation strength is
+    // strength becomes a candidate, i.e. the expected recall at strength
+    double recall(double strength) const;
+
+    // Picks the parameters that minimise the estimated cost of correlating a matrix of
+    // numRows x numColumns, while achieving targetRecall at minimumThreshold; if the
+    // exact computation is estimated to be cheaper, the exact parameters are returned
+    static CorrelationLshParameters choose(double minimumThreshold, bool bothPolarities,
+        size_t numRows, size_t numColumns, double targetRecall = DefaultTargetRecall);
+};
+
+template<typename T>
+class CorrelationLshIndex
+{
+private:
+    struct Entry
+    {
+        uint32_t _key = 0;
+        bool _flipped = false;
+        size_t _row = 0;
+    };
+
+    struct Bucket
+    {
+        size_t _begin = 0;
+        size_t _end = 0;
+
+        uint64_t computeCostHint() const
+        {
+            auto size = static_cast<uint64_t>(_end - _begin);
+            return size * size;
+        }
+    };
+
+    CorrelationLshParameters _parameters;
+    size_t _numRows = 0;
+    uint32_t _keyMask = 0;
+
+    // The signature of each row, for each band, stored band major
+    std::vector<uint32_t> _keys;
+
+    // Rows with no variance don't correlate with anything; not a std::vector<bool>,
+    // since neighbouring rows are written concurrently
+    std::vector<char> _valid;
+
+    uint32_t key(size_t band, size_t row) const { return _keys[(band * _numRows) + row]; }
+
+    // The signature of the negation of a row is the complement of its signature
+    uint32_t flippedKey(size_t band, size_t row) const { return ~key(band, row) & _keyMask; }
+
+public:
+    CorrelationLshIndex(ThreadPool& threadPool, const CorrelationRowMatrix<T>& matrix,
+        const CorrelationLshParameters& parameters, uint32_t seed = 0) :
+        _parameters(parameters), _numRows(matrix.numRows()),
+        _keyMask(static_cast<uint32_t>((uint64_t{1} << parameters._bitsPerBand) - 1)),
+        _keys(parameters._numBands * matrix.numRows(), 0),
+        _valid(matrix.numRows(), 1)
+    {
+        using namespace CorrelationKernel;
+
+        // The hyperplane normals are themselves just rows of a matrix, so that
+        // the projections can be computed using the tiled correlation kernel
+        CorrelationRowMatrix<T> hyperplanes(parameters.numHyperplanes(),
+            matrix.numColumns(), matrix.doubleAccumulation());
+
+        // Seeded, so that the same network results from the same data
+        std::mt19937 generator(seed);
+        std::normal_distribution<double> distribution;
+        for(size_t hyperplane = 0; hyperplane < hyperplanes.numRows(); hyperplane++)
+        {
+            auto* normal = hyperplanes.row(hyperplane);
+            for(size_t column = 0; column < hyperplanes.numColumns(); column++)
+                normal[column] = static_cast<T>(distribution(generator));
+        }
+
+        std::vector<size_t> tiles(matrix.numTiles());
+        std::iota(tiles.begin(), tiles.end(), 0);
+
+        std::vector<std::vector<double>> blocks(threadPool.numThreads(),
+            std::vector<double>(TileSize * TileSize));
+
+        threadPool.concurrent_for(tiles.begin(), tiles.end(),
+        [&](size_t tileA, size_t threadIndex)
+        {
+            auto& block = blocks.at(threadIndex);
+
+            const auto firstRow = tileA * TileSize;
+            const auto lastRow = std::min(firstRow + TileSize, _numRows);
+
+            for(size_t tileB = 0; tileB < hyperplanes.numTiles(); tileB++)
+            {
+                matrix.tileProducts(tileA, hyperplanes, tileB, block.data());
+
+                const auto firstHyperplane = tileB * TileSize;
+                const auto lastHyperplane = std::min(firstHyperplane + TileSize, hyperplanes.numRows());
+
+                for(auto row = firstRow; row < lastRow; row++)
+                {
+                    const auto* blockRow = block.data() + ((row - firstRow) * TileSize);
+
+                    if(!std::isfinite(blockRow[0]))
+                    {
+                        _valid[row] = 0;
+                        continue;
+                    }
+
+                    for(auto hyperplane = firstHyperplane; hyperplane < lastHyperplane; hyperplane++)
+                    {
+                        if(blockRow[hyperplane - firstHyperplane] < 0.0)
+                            continue;
+
+                        auto band = hyperplane / parameters._bitsPerBand;
+                        auto bit = hyperplane % parameters._bitsPerBand;
+                        _keys[(band * _numRows) + row] |= uint32_t{1} << bit;
+                    }
+                }
+            }
+        });
+    }
+
+    size_t numBands() const { return _parameters._numBands; }
+
+    // Calls fn(rowA, rowB, threadIndex) concurrently, for each pair of rows, rowA < rowB, whose
+    // signatures match in band, but in no earlier band, such that over all the bands each
+    // candidate pair is visited only once; positive and negative determine whether pairs whose
+    // signatures match directly, or whose signatures are complementary, respectively, are visited
+    template<typename Fn>
+    void forEachCandidatePair(ThreadPool& threadPool, size_t band,
+        bool positive, bool negative, Fn&& fn) const
+    {
+        std::vector<Entry> entries;
+        entries.reserve(_numRows * (negative ? 2 : 1));
+
+        for(size_t row = 0; row < _numRows; row++)
+        {
+            if(_valid[row] == 0)
+                continue;
+
+            entries.push_back({key(band, row), false, row});
+
+            if(negative)
+                entries.push_back({flippedKey(band, row), true, row});
+        }
+
+        std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b)
+        {
+            return a._key < b._key || (a._key == b._key && a._row < b._row);
+        });
+
+        std::vector<Bucket> buckets;
+        for(size_t begin = 0; begin < entries.size();)
+        {
+            auto end = begin + 1;
+            while(end < entries.size() && entries[end]._key == entries[begin]._key)
+                end++;
+
+            if(end - begin > 1)
+                buckets.push_back({begin, end});
+
+            begin = end;
+        }
+
+        if(buckets.empty())
+            return;
+
+        auto matchedEarlier = [&](size_t rowA, size_t rowB)
+        {
+            for(size_t earlierBand = 0; earlierBand < band; earlierBand++)
+            {
+                if(positive && key(earlierBand, rowA) == key(earlierBand, rowB))
+                    return true;
+
+                if(negative && key(earlierBand, rowA) == flippedKey(earlierBand, rowB))
+                    return true;
+            }
+
+            return false;
+        };
+
+        threadPool.concurrent_for(buckets.begin(), buckets.end(),
+        [&](const Bucket& bucket, size_t threadIndex)
+        {
+            // Entries are ordered by row within a bucket, and a negative pair is present
+            // in two buckets, so only visiting pairs where the unflipped entry is the lower
+            // row ensures each pair is visited once
+            for(auto a = bucket._begin; a < bucket._end; a++)
+            {
+                const auto& entryA = entries[a];
+                if(entryA._flipped)
+                    continue;
+
+                for(auto b = a + 1; b < bucket._end; b++)
+                {
+                    const auto& entryB = entries[b];
+
+                    if(entryB._flipped ? !negative : !positive)
+                        continue;
+
+                    if(!matchedEarlier(entryA._row, entryB._row))
+                        fn(entryA._row, entryB._row, threadIndex);
+                }
+            }
+        });
+    }
+};
+
+#endif // CORRELATIONLSH_H
@@ -23,6 +23,7 @@
 #include "graphsizeestimateplotitem.h"
 
 #include "shared/graph/grapharray_json.h"
+#include "shared/graph/grapharray_binary.h"
 
 #include "shared/utils/threadpool.h"
 #include "shared/utils/iterator_range.h"
@@ -40,6 +41,8 @@
 #include <json_helper.h>
 
 #include <map>
+#include <utility>
+#include <vector>
 
 CorrelationPluginInstance::CorrelationPluginInstance()
 {
@@ -312,30 +315,35 @@ QStringList CorrelationPluginInstance::sharedValuesAttributeNames() const
     return attributeNames;
 }
 
-std::vector<CorrelationEdge> CorrelationPluginInstance::correlation(double minimumThreshold, IParser& parser)
+bool CorrelationPluginInstance::createEdges(double minimumThreshold, IParser& parser)
 {
-    auto correlation = Correlation::create(static_cast<CorrelationType>(_correlationType));
-    return correlation->process(_dataRows, minimumThreshold,
-        static_cast<CorrelationPolarity>(_correlationPolarity), &parser, &parser);
-}
-
-bool CorrelationPluginInstance::createEdges(const std::vector<CorrelationEdge>& edges, IParser& parser)
-{
-    parser.setProgress(-1);
-    for(auto edgeIt = edges.begin(); edgeIt != edges.end(); ++edgeIt)
+    auto correlation = Correlation::create(_correlationType, _correlationPrecision);
+    correlation->setApproximate(_approximate);
+
+    // The edges are added to the graph as they're produced, so that
+    // they don't all need to be held in memory in the meantime
+    return correlation->streamEdges(_dataRows, minimumThreshold,
+        static_cast<CorrelationPolarity>(_correlationPolarity), _maxEdgesPerNode,
+    [this, &parser, nodeIdPairs = std::vector<std::pair<NodeId, NodeId>>()]
+        (const std::vector<CorrelationEdge>& edges) mutable
     {
         if(parser.cancelled())
             return false;
 
-        parser.setProgress(static_cast<int>(std::distance(edges.begin(), edgeIt)) * 100 /
-            static_cast<int>(edges.size()));
+        nodeIdPairs.clear();
+        nodeIdPairs.reserve(edges.size());
 
-        const auto& edge = *edgeIt;
-        auto edgeId = graphModel()->mutableGraph().addEdge(edge._source, edge._target);
-        _correlationValues->set(edgeId, edge._r);
-    }
+        for(const auto& edge : edges)
+            nodeIdPairs.emplace_back(edge._source, edge._target);
 
-    return true;
+        // Each batch is added in bulk, and so has contiguous EdgeIds
+        auto edgeId = graphModel()->mutableGraph().bulkAddEdges(nodeIdPairs);
+
+        for(const auto& edge : edges)
+            _correlationValues->set(edgeId++, edge._r);
+
+        return true;
+    }, &parser, &parser);
 }
 
 void CorrelationPluginInstance::setDimensions(size_t numColumns, size_t numRows)
@@ -424,6 +432,9 @@ QStringList CorrelationPluginInstance::columnAnnotationNames() const
 
 void CorrelationPluginInstance::onLoadSuccess()
 {
+    _userNodeData.shrinkToFit();
+    _userColumnData.shrinkToFit();
+
     _userNodeData.exposeAsAttributes(*graphModel());
     buildColumnAnnotations();
     _nodeAttributeTableModel.updateColumnNames();
@@ -487,12 +498,18 @@ void CorrelationPluginInstance::applyParameter(const QString& name, const QVaria
         _minimumCorrelationValue = value.toDouble();
     else if(name == QLatin1String("initialThreshold"))
         _initialCorrelationThreshold = value.toDouble();
+    else if(name == QLatin1String("maxEdgesPerNode"))
+        _maxEdgesPerNode = value.toUInt();
+    else if(name == QLatin1String("approximate"))
+        _approximate = (value == QLatin1String("true"));
     else if(name == QLatin1String("transpose"))
         _transpose = (value == QLatin1String("true"));
     else if(name == QLatin1String("correlationType"))
         _correlationType = static_cast<CorrelationType>(value.toInt());
     else if(name == QLatin1String("correlationPolarity"))
         _correlationPolarity = static_cast<CorrelationPolarity>(value.toInt());
+    else if(name == QLatin1String("correlationPrecision"))
+        _correlationPrecision = static_cast<CorrelationPrecision>(value.toInt());
     else if(name == QLatin1String("scaling"))
         _scalingType = static_cast<ScalingType>(value.toInt());
     else if(name == QLatin1String("normalise"))
@@ -618,42 +635,22 @@ QString CorrelationPluginInstance::attributeValueFor(const QString& attributeNam
     return attribute->stringValueOf(nodeId);
 }
 
-QByteArray CorrelationPluginInstance::save(IMutableGraph& graph, Progressable& progressable) const
+QByteArray CorrelationPluginInstance::save(IMutableGraph&, Progressable& progressable) const
 {
     json jsonObject;
 
     jsonObject["numColumns"] = static_cast<int>(_numColumns);
     jsonObject["numRows"] = static_cast<int>(_numRows);
-    jsonObject["userNodeData"] = _userNodeData.save(graph, graph.nodeIds(), progressable);
     jsonObject["userColumnData"] =_userColumnData.save(progressable);
     jsonObject["dataColumnNames"] = jsonArrayFrom(_dataColumnNames, &progressable);
 
-    graph.setPhase(QObject::tr("Data"));
-    jsonObject["data"] = [&]
-    {
-        json array;
-
-        uint64_t i = 0;
-        for(const auto& nodeId : graph.nodeIds())
-        {
-            const auto& dataRow = dataRowForNodeId(nodeId);
-            std::copy(dataRow.begin(), dataRow.end(), std::back_inserter(array));
-
-            progressable.setProgress(static_cast<int>((i++) * 100 / graph.nodeIds().size()));
-        }
-
-        progressable.setProgress(-1);
-
-        return array;
-    }();
-
-    graph.setPhase(QObject::tr("Correlation Values"));
-    jsonObject["correlationValues"] = u::graphArrayAsJson(*_correlationValues, graph.edgeIds(), &progressable);
-
     jsonObject["minimumCorrelationValue"] = _minimumCorrelationValue;
     jsonObject["transpose"] = _transpose;
     jsonObject["correlationType"] = static_cast<int>(_correlationType);
     jsonObject["correlationPolarity"] = static_cast<int>(_correlationPolarity);
+    jsonObject["maxEdgesPerNode"] = _maxEdgesPerNode;
+    jsonObject["approximate"] = _approximate;
+    jsonObject["correlationPrecision"] = static_cast<int>(_correlationPrecision);
     jsonObject["scaling"] = static_cast<int>(_scalingType);
     jsonObject["normalisation"] = static_cast<int>(_normaliseType);
     jsonObject["missingDataType"] = static_cast<int>(_missingDataType);
@@ -679,11 +676,14 @@ bool CorrelationPluginInstance::load(const QByteArray& data, int dataVersion, IM
     _numColumns = static_cast<size_t>(jsonObject["numColumns"].get<int>());
     _numRows = static_cast<size_t>(jsonObject["numRows"].get<int>());
 
-    if(!u::contains(jsonObject, "userNodeData") || !u::contains(jsonObject, "userColumnData"))
+    if(!u::contains(jsonObject, "userColumnData"))
         return false;
 
-    if(!_userNodeData.load(jsonObject["userNodeData"], parser))
-        return false;
+    if(!_dataInSections)
+    {
+        if(!u::contains(jsonObject, "userNodeData") || !_userNodeData.load(jsonObject["userNodeData"], parser))
+            return false;
+    }
 
     if(!_userColumnData.load(jsonObject["userColumnData"], parser))
         return false;
@@ -702,66 +702,78 @@ bool CorrelationPluginInstance::load(const QByteArray& data, int dataVersion, IM
 
     uint64_t i = 0;
 
-    if(!u::contains(jsonObject, "data"))
-        return false;
-
-    graph.setPhase(QObject::tr("Data"));
-    const auto& jsonData = jsonObject["data"];
-    for(const auto& value : jsonData)
+    if(!_dataInSections)
     {
-        _data.emplace_back(value);
-        parser.setProgress(static_cast<int>((i++ * 100) / jsonData.size()));
-    }
+        if(!u::contains(jsonObject, "data"))
+            return false;
 
-    parser.setProgress(-1);
+        graph.setPhase(QObject::tr("Data"));
+        const auto& jsonData = jsonObject["data"];
+        for(const auto& value : jsonData)
+        {
+            _data.emplace_back(value);
+            parser.setProgress(static_cast<int>((i++ * 100) / jsonData.size()));
+        }
+
+        parser.setProgress(-1);
+    }
 
     for(size_t row = 0; row < _numRows; row++)
     {
         auto nodeId = _userNodeData.elementIdForIndex(row);
 
-        if(!nodeId.isNull())
-            _dataRows.emplace_back(_data, row, _numColumns, nodeId);
+        if(nodeId.isNull())
+            continue;
+
+        // Rows for which there's no data can only come from a corrupt file
+        if((row + 1) * _numColumns > _data.size())
+            return false;
+
+        _dataRows.emplace_back(_data, row, _numColumns, nodeId);
 
         parser.setProgress(static_cast<int>((row * 100) / _numRows));
     }
 
     parser.setProgress(-1);
 
-    const char* correlationValuesKey =
-        dataVersion >= 3 ? "correlationValues" : "pearsonValues";
-
-    if(!u::contains(jsonObject, correlationValuesKey))
+    if(!_dataInSections)
     {
-        setFailureReason(tr("Plugin data is missing '%1' key.").arg(correlationValuesKey));
-        return false;
-    }
+        const char* correlationValuesKey =
+            dataVersion >= 3 ? "correlationValues" : "pearsonValues";
 
-    const auto& jsonCorrelationValues = jsonObject[correlationValuesKey];
-    graph.setPhase(QObject::tr("Correlation Values"));
-    i = 0;
+        if(!u::contains(jsonObject, correlationValuesKey))
+        {
+            setFailureReason(tr("Plugin data is missing '%1' key.").arg(correlationValuesKey));
+            return false;
+        }
 
-    if(dataVersion >= 2)
-    {
-        u::forEachJsonGraphArray(jsonCorrelationValues, [&](EdgeId edgeId, double correlationValue)
+        const auto& jsonCorrelationValues = jsonObject[correlationValuesKey];
+        graph.setPhase(QObject::tr("Correlation Values"));
+        i = 0;
+
+        if(dataVersion >= 2)
         {
-            Q_ASSERT(graph.containsEdgeId(edgeId));
-            _correlationValues->set(edgeId, correlationValue);
+            u::forEachJsonGraphArray(jsonCorrelationValues, [&](EdgeId edgeId, double correlationValue)
+            {
+                Q_ASSERT(graph.containsEdgeId(edgeId));
+                _correlationValues->set(edgeId, correlationValue);
 
-            parser.setProgress(static_cast<int>((i++ * 100) / jsonCorrelationValues.size()));
-        });
-    }
-    else
-    {
-        for(const auto& correlationValue : jsonCorrelationValues)
+                parser.setProgress(static_cast<int>((i++ * 100) / jsonCorrelationValues.size()));
+            });
+        }
+        else
         {
-            if(graph.containsEdgeId(i))
-                _correlationValues->set(i, correlationValue);
+            for(const auto& correlationValue : jsonCorrelationValues)
+            {
+                if(graph.containsEdgeId(i))
+                    _correlationValues->set(i, correlationValue);
 
-            parser.setProgress(static_cast<int>((i++ * 100) / jsonCorrelationValues.size()));
+                parser.setProgress(static_cast<int>((i++ * 100) / jsonCorrelationValues.size()));
+            }
         }
-    }
 
-    parser.setProgress(-1);
+        parser.setProgress(-1);
+    }
 
     if(!u::containsAllOf(jsonObject, {"minimumCorrelationValue", "transpose", "scaling",
         "normalisation", "missingDataType", "missingDataReplacementValue"}))
@@ -785,6 +797,16 @@ bool CorrelationPluginInstance::load(const QByteArray& data, int dataVersion, IM
         _correlationPolarity = static_cast<CorrelationPolarity>(jsonObject["correlationPolarity"]);
     }
 
+    if(dataVersion >= 5)
+    {
+        if(!u::containsAllOf(jsonObject, {"maxEdgesPerNode", "approximate", "correlationPrecision"}))
+            return false;
+
+        _maxEdgesPerNode = jsonObject["maxEdgesPerNode"];
+        _approximate = jsonObject["approximate"];
+        _correlationPrecision = static_cast<CorrelationPrecision>(jsonObject["correlationPrecision"]);
+    }
+
     createAttributes();
     makeDataColumnNamesUnique();
     setNodeAttributeTableModelDataColumns();
@@ -792,6 +814,125 @@ bool CorrelationPluginInstance::load(const QByteArray& data, int dataVersion, IM
     return true;
 }
 
+bool CorrelationPluginInstance::saveSections(IMutableGraph& graph, Progressable& progressable,
+                                             const SaveSectionFn& saveSection) const
+{
+    QByteArray userNodeData;
+    QDataStream userNodeDataStream(&userNodeData, QIODevice::WriteOnly);
+    NativeFormat::initialiseStream(userNodeDataStream, QDataStream::DoublePrecision);
+
+    graph.setPhase(QObject::tr("Node Data"));
+    _userNodeData.save(userNodeDataStream, graph.nodeIds(), progressable);
+
+    if(!saveSection(QStringLiteral("userNodeData"), userNodeData))
+        return false;
+
+    // Written, so no need to keep it
+    userNodeData.clear();
+
+    // The rows of the nodes that remain, in the same order as the user node data
+    QByteArray data;
+    QDataStream dataStream(&data, QIODevice::WriteOnly);
+    NativeFormat::initialiseStream(dataStream, QDataStream::DoublePrecision);
+
+    graph.setPhase(QObject::tr("Data"));
+    dataStream << static_cast<qint32>(static_cast<size_t>(graph.numNodes()) * _numColumns);
+
+    uint64_t i = 0;
+    for(const auto& nodeId : graph.nodeIds())
+    {
+        const auto& dataRow = dataRowForNodeId(nodeId);
+        for(auto value : dataRow)
+            dataStream << value;
+
+        progressable.setProgress(static_cast<int>((i++) * 100 / graph.nodeIds().size()));
+    }
+
+    progressable.setProgress(-1);
+
+    if(!saveSection(QStringLiteral("data"), data))
+        return false;
+
+    data.clear();
+
+    graph.setPhase(QObject::tr("Correlation Values"));
+    return saveSection(QStringLiteral("correlationValues"), NativeFormat::graphArrayAsBinary(*_correlationValues,
+        graph.edgeIds(), progressable,
+    [](QDataStream& stream, double correlationValue)
+    {
+        stream << correlationValue;
+    }, QDataStream::DoublePrecision));
+}
+
+bool CorrelationPluginInstance::loadSections(const std::map<QString, QByteArray>& sections, int /*dataVersion*/,
+                                             IMutableGraph& graph, IParser& parser)
+{
+    _dataInSections = false;
+
+    // Older files have everything in the JSON instead
+    if(!u::contains(sections, QStringLiteral("userNodeData")) ||
+        !u::contains(sections, QStringLiteral("data")) ||
+        !u::contains(sections, QStringLiteral("correlationValues")))
+    {
+        return sections.empty();
+    }
+
+    QDataStream userNodeDataStream(sections.at(QStringLiteral("userNodeData")));
+    NativeFormat::initialiseStream(userNodeDataStream, QDataStream::DoublePrecision);
+
+    graph.setPhase(QObject::tr("Node Data"));
+    if(!_userNodeData.load(userNodeDataStream, parser))
+        return false;
+
+    const auto& data = sections.at(QStringLiteral("data"));
+    QDataStream dataStream(data);
+    NativeFormat::initialiseStream(dataStream, QDataStream::DoublePrecision);
+
+    qint32 numValues = 0;
+    dataStream >> numValues;
+
+    // Checked against what's there before anything is allocated for it
+    if(dataStream.status() != QDataStream::Ok || numValues < 0 ||
+        static_cast<qint64>(numValues) > dataStream.device()->bytesAvailable() / static_cast<qint64>(sizeof(double)))
+    {
+        return false;
+    }
+
+    graph.setPhase(QObject::tr("Data"));
+    _data.reserve(static_cast<size_t>(numValues));
+
+    for(qint32 i = 0; i < numValues; i++)
+    {
+        double value = 0.0;
+        dataStream >> value;
+        _data.push_back(value);
+
+        parser.setProgress(static_cast<int>((static_cast<int64_t>(i) * 100) / numValues));
+    }
+
+    parser.setProgress(-1);
+
+    if(dataStream.status() != QDataStream::Ok)
+        return false;
+
+    graph.setPhase(QObject::tr("Correlation Values"));
+    bool success = NativeFormat::forEachBinaryEdgeArray(sections.at(QStringLiteral("correlationValues")),
+        graph, parser,
+    [this](QDataStream& stream, EdgeId edgeId)
+    {
+        double correlationValue = 0.0;
+        stream >> correlationValue;
+        _correlationValues->set(edgeId, correlationValue);
+    }, QDataStream::DoublePrecision);
+
+    if(!success)
+        return false;
+
+    _dataInSections = true;
+
+    return true;
+}
+
 CorrelationPlugin::CorrelationPlugin()
 {
     registerUrlType(QStringLiteral("CorrelationCSV"), QObject::tr("Correlation CSV File"), QObject::tr("Correlation CSV Files"), {"csv"});
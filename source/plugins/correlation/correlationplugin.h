@@ -34,6 +34,7 @@
 #include "correlationdatarow.h"
 #include "correlationnodeattributetablemodel.h"
 
+#include <map>
 #include <vector>
 #include <functional>
 #include <algorithm>
@@ -82,14 +83,20 @@ private:
 
     std::vector<CorrelationDataRow> _dataRows;
 
+    // Otherwise the user node data, the data and the correlation values are in the JSON passed to load
+    bool _dataInSections = false;
+
     std::unique_ptr<EdgeArray<double>> _correlationValues;
     double _minimumCorrelationValue = 0.7;
     double _initialCorrelationThreshold = 0.85;
+    size_t _maxEdgesPerNode = 0;
+    bool _approximate = false;
     bool _transpose = false;
     TabularData _tabularData;
     QRect _dataRect;
     CorrelationType _correlationType = CorrelationType::Pearson;
     CorrelationPolarity _correlationPolarity = CorrelationPolarity::Positive;
+    CorrelationPrecision _correlationPrecision = CorrelationPrecision::Double;
     ScalingType _scalingType = ScalingType::None;
     NormaliseType _normaliseType = NormaliseType::None;
     MissingDataType _missingDataType = MissingDataType::Constant;
@@ -134,12 +141,10 @@ public:
     void finishDataRows();
     void createAttributes();
 
-    std::vector<CorrelationEdge> correlation(double minimumThreshold, IParser& parser);
-
     double minimumCorrelation() const { return _minimumCorrelationValue; }
     bool transpose() const { return _transpose; }
 
-    bool createEdges(const std::vector<CorrelationEdge>& edges, IParser& parser);
+    bool createEdges(double minimumThreshold, IParser& parser);
 
     std::unique_ptr<IParser> parserForUrlTypeName(const QString& urlTypeName) override;
     void applyParameter(const QString& name, const QVariant& value) override;
@@ -159,6 +164,12 @@ public:
     QByteArray save(IMutableGraph& graph, Progressable& progressable) const override;
     bool load(const QByteArray& data, int dataVersion, IMutableGraph& graph, IParser& parser) override;
 
+    // The user node data, the data and the correlation values are saved in binary sections
+    bool saveSections(IMutableGraph& graph, Progressable& progressable,
+        const SaveSectionFn& saveSection) const override;
+    bool loadSections(const std::map<QString, QByteArray>& sections, int dataVersion,
+        IMutableGraph& graph, IParser& parser) override;
+
 private slots:
     void onLoadSuccess();
     void onSelectionChanged(const ISelectionManager* selectionManager);
@@ -187,7 +198,7 @@ public:
 
     QString imageSource() const override { return QStringLiteral("qrc:///plots.svg"); }
 
-    int dataVersion() const override { return 4; }
+    int dataVersion() const override { return 5; }
 
     QStringList identifyUrl(const QUrl& url) const override;
     QString failureReason(const QUrl& url) const override;
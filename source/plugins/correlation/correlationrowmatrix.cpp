@@ -0,0 +1,73 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "correlationrowmatrix.h"
+
+#include <algorithm>
+
+CorrelationTileLayout::CorrelationTileLayout(size_t numRows, size_t numColumns) :
+    _numRows(numRows), _numColumns(numColumns)
+{
+    using namespace CorrelationKernel;
+
+    _numTiles = (_numRows + TileSize - 1) / TileSize;
+    _stride = ((_numColumns + ColumnMultiple - 1) / ColumnMultiple) * ColumnMultiple;
+}
+
+std::vector<CorrelationTileSpan> CorrelationTileLayout::upperTriangleSpans() const
+{
+    using namespace CorrelationKernel;
+
+    // Short enough that there are plenty of spans to go round, but long enough
+    // that the A tile gets some reuse from cache
+    const size_t TilesPerSpan = 8;
+
+    auto rowsInTile = [this](size_t tile)
+    {
+        return static_cast<uint64_t>(std::min(TileSize, _numRows - (tile * TileSize)));
+    };
+
+    std::vector<CorrelationTileSpan> spans;
+    spans.reserve(_numTiles * ((_numTiles / TilesPerSpan) + 1));
+
+    for(size_t tileA = 0; tileA < _numTiles; tileA++)
+    {
+        for(auto firstTileB = tileA; firstTileB < _numTiles; firstTileB += TilesPerSpan)
+        {
+            CorrelationTileSpan span;
+            span._tileA = tileA;
+            span._firstTileB = firstTileB;
+            span._lastTileB = std::min(firstTileB + TilesPerSpan, _numTiles);
+
+            for(auto tileB = span._firstTileB; tileB < span._lastTileB; tileB++)
+            {
+                auto rowsA = rowsInTile(tileA);
+
+                // Only the pairs above the diagonal are considered
+                span._numPairs += tileB == tileA ?
+                    (rowsA * (rowsA - 1)) / 2 :
+                    rowsA * rowsInTile(tileB);
+            }
+
+            spans.push_back(span);
+        }
+    }
+
+    return spans;
+}
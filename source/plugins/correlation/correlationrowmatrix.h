@@ -0,0 +1,175 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef CORRELATIONROWMATRIX_H
+#define CORRELATIONROWMATRIX_H
+
+#include "correlationkernel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include <QtGlobal>
+
+// A horizontal run of tiles, [_firstTileB, _lastTileB), in the row of tiles _tileA
+struct CorrelationTileSpan
+{
+    size_t _tileA = 0;
+    size_t _firstTileB = 0;
+    size_t _lastTileB = 0;
+
+    // The number of distinct row pairs the span covers
+    uint64_t _numPairs = 0;
+
+    uint64_t computeCostHint() const { return _lastTileB - _firstTileB; }
+};
+
+// Describes how a matrix of numRows x numColumns is divided into tiles
+class CorrelationTileLayout
+{
+protected:
+    size_t _numRows = 0;
+    size_t _numColumns = 0;
+    size_t _numTiles = 0;
+    size_t _stride = 0;
+
+public:
+    CorrelationTileLayout(size_t numRows, size_t numColumns);
+
+    size_t numRows() const { return _numRows; }
+    size_t numColumns() const { return _numColumns; }
+    size_t numTiles() const { return _numTiles; }
+    size_t stride() const { return _stride; }
+
+    // Covers the upper triangle of the (symmetric) correlation matrix, in spans of
+    // roughly equal cost, so that the work can be balanced evenly over threads
+    std::vector<CorrelationTileSpan> upperTriangleSpans() const;
+};
+
+// A contiguous, aligned, row major matrix of correlation data, padded in both dimensions
+// such that it can be processed in whole tiles by CorrelationKernel; T may be double, or
+// float, in which case the products may optionally be accumulated in double precision
+template<typename T>
+class CorrelationRowMatrix : public CorrelationTileLayout
+{
+    static_assert(std::is_same_v<T, double> || std::is_same_v<T, float>);
+
+private:
+    struct AlignedDelete
+    {
+        void operator()(T* p) const
+        {
+            ::operator delete[](p, std::align_val_t(CorrelationKernel::Alignment));
+        }
+    };
+
+    bool _doubleAccumulation = false;
+
+    std::unique_ptr<T[], AlignedDelete> _data;
+
+public:
+    CorrelationRowMatrix(size_t numRows, size_t numColumns, bool doubleAccumulation = false) :
+        CorrelationTileLayout(numRows, numColumns),
+        _doubleAccumulation(doubleAccumulation)
+    {
+        using namespace CorrelationKernel;
+
+        // The padding must be zero, so that it doesn't contribute to the dot products
+        const auto size = _numTiles * TileSize * _stride;
+        _data.reset(static_cast<T*>(::operator new[](size * sizeof(T), std::align_val_t(Alignment))));
+        std::fill(_data.get(), _data.get() + size, T{0});
+    }
+
+    T* row(size_t index) { return _data.get() + (index * _stride); }
+    const T* row(size_t index) const { return _data.get() + (index * _stride); }
+
+    const T* tile(size_t index) const { return row(index * CorrelationKernel::TileSize); }
+
+    bool doubleAccumulation() const { return _doubleAccumulation; }
+
+    // Computes the dot products of the rows in tileA with the rows in tileB of other,
+    // which must have the same number of columns, into block, which must have room
+    // for TileSize² values
+    void tileProducts(size_t tileA, const CorrelationRowMatrix& other, size_t tileB, double* block) const
+    {
+        Q_ASSERT(other._stride == _stride);
+
+        if constexpr(std::is_same_v<T, float>)
+        {
+            if(_doubleAccumulation)
+                CorrelationKernel::tileMixed(tile(tileA), other.tile(tileB), _stride, block);
+            else
+                CorrelationKernel::tile(tile(tileA), other.tile(tileB), _stride, block);
+        }
+        else
+            CorrelationKernel::tile(tile(tileA), other.tile(tileB), _stride, block);
+    }
+
+    // The dot product of two individual rows, for when only a few pairs are required
+    double dotProduct(size_t rowA, size_t rowB) const
+    {
+        const auto* a = row(rowA);
+        const auto* b = row(rowB);
+
+        double sum = 0.0;
+        for(size_t column = 0; column < _numColumns; column++)
+            sum += static_cast<double>(a[column]) * static_cast<double>(b[column]);
+
+        return sum;
+    }
+
+    // Computes the tile (tileA, tileB) into block, which must have room for TileSize²
+    // values, then calls fn(rowA, rowB, r) for each of its finite values; if
+    // upperTriangleOnly is set, only values where rowB > rowA are visited
+    template<typename Fn>
+    void forEachInTilePair(size_t tileA, size_t tileB, double* block,
+        bool upperTriangleOnly, Fn&& fn) const
+    {
+        using namespace CorrelationKernel;
+
+        tileProducts(tileA, *this, tileB, block);
+
+        const auto firstRowA = tileA * TileSize;
+        const auto lastRowA = std::min(firstRowA + TileSize, _numRows);
+        const auto firstRowB = tileB * TileSize;
+        const auto lastRowB = std::min(firstRowB + TileSize, _numRows);
+
+        for(auto rowA = firstRowA; rowA < lastRowA; rowA++)
+        {
+            const auto* blockRow = block + ((rowA - firstRowA) * TileSize);
+            auto rowB = upperTriangleOnly ? std::max(firstRowB, rowA + 1) : firstRowB;
+
+            for(; rowB < lastRowB; rowB++)
+            {
+                double r = blockRow[rowB - firstRowB];
+
+                if(std::isfinite(r))
+                    fn(rowA, rowB, r);
+            }
+        }
+    }
+};
+
+#endif // CORRELATIONROWMATRIX_H
@@ -83,6 +83,7 @@ void GraphSizeEstimatePlotItem::setGraphSizeEstimate(const QVariantMap& graphSiz
     _keys = graphSizeEstimate.value(QStringLiteral("keys")).value<QVector<double>>();
     _numNodes = graphSizeEstimate.value(QStringLiteral("numNodes")).value<QVector<double>>();
     _numEdges = graphSizeEstimate.value(QStringLiteral("numEdges")).value<QVector<double>>();
+    _recall = graphSizeEstimate.value(QStringLiteral("recall")).value<QVector<double>>();
 
     buildPlot();
 }
@@ -103,15 +104,24 @@ void GraphSizeEstimatePlotItem::updateThresholdIndicator()
 
     size_t numNodes = 0;
     size_t numEdges = 0;
+    double recall = 1.0;
 
     if(index < _keys.size())
     {
         numNodes = static_cast<size_t>(_numNodes.at(index));
         numEdges = static_cast<size_t>(_numEdges.at(index));
+
+        if(index < _recall.size())
+            recall = _recall.at(index);
     }
 
-    _customPlot.xAxis->setLabel(tr("Estimated Graph Size: %1 Nodes, %2 Edges")
-        .arg(u::formatNumberSIPostfix(numNodes), u::formatNumberSIPostfix(numEdges)));
+    auto label = tr("Estimated Graph Size: %1 Nodes, %2 Edges")
+        .arg(u::formatNumberSIPostfix(numNodes), u::formatNumberSIPostfix(numEdges));
+
+    if(!_recall.isEmpty())
+        label += tr(" (Approximate, %1% Recall)").arg(recall * 100.0, 0, 'f', 1);
+
+    _customPlot.xAxis->setLabel(label);
 }
 
 void GraphSizeEstimatePlotItem::buildPlot()
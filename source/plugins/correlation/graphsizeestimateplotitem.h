@@ -44,6 +44,9 @@ private:
     QVector<double> _numNodes;
     QVector<double> _numEdges;
 
+    // Only present for approximate correlation
+    QVector<double> _recall;
+
     double _threshold = 0.0;
     bool _dragging = false;
 
@@ -344,16 +344,10 @@ bool CorrelationFileParser::parse(const QUrl&, IGraphModel* graphModel)
 
     setProgress(-1);
 
-    graphModel->mutableGraph().setPhase(QObject::tr("Correlation"));
-    auto edges = _plugin->correlation(_plugin->minimumCorrelation(), *this);
-
-    if(cancelled())
-        return false;
-
     _plugin->createAttributes();
 
-    graphModel->mutableGraph().setPhase(QObject::tr("Building Graph"));
-    if(!_plugin->createEdges(edges, *this))
+    graphModel->mutableGraph().setPhase(QObject::tr("Correlation"));
+    if(!_plugin->createEdges(_plugin->minimumCorrelation(), *this))
         return false;
 
     graphModel->mutableGraph().clearPhase();
@@ -606,7 +600,8 @@ void TabularDataParser::estimateGraphSize()
         if(dataRows.empty())
             return QVariantMap();
 
-        auto correlation = Correlation::create(static_cast<CorrelationType>(_correlationType));
+        auto correlation = Correlation::create(static_cast<CorrelationType>(_correlationType),
+            static_cast<CorrelationPrecision>(_correlationPrecision));
         auto sampleEdges = correlation->process(dataRows, _minimumCorrelation,
             static_cast<CorrelationPolarity>(_correlationPolarity), &_graphSizeEstimateCancellable);
 
@@ -668,6 +663,20 @@ void TabularDataParser::estimateGraphSize()
         std::reverse(estimatedNumEdges.begin(), estimatedNumEdges.end());
 
         QVariantMap map;
+
+        // The sampled edges are exact, so the recall that the approximation would achieve
+        // over the whole dataset is estimated from the distribution of their values
+        if(_approximate)
+        {
+            auto recall = Correlation::approximateRecall(sampleEdges,
+                std::vector<double>(keys.begin(), keys.end()), _minimumCorrelation,
+                static_cast<CorrelationPolarity>(_correlationPolarity),
+                _dataPtr->numRows(), static_cast<size_t>(_dataRect.width()));
+
+            map.insert(QStringLiteral("recall"), QVariant::fromValue(
+                QVector<double>(recall.begin(), recall.end())));
+        }
+
         map.insert(QStringLiteral("keys"), QVariant::fromValue(keys));
         map.insert(QStringLiteral("numNodes"), QVariant::fromValue(estimatedNumNodes));
         map.insert(QStringLiteral("numEdges"), QVariant::fromValue(estimatedNumEdges));
@@ -125,6 +125,8 @@ class TabularDataParser : public QObject, public Cancellable
     Q_PROPERTY(double minimumCorrelation MEMBER _minimumCorrelation NOTIFY parameterChanged)
     Q_PROPERTY(int correlationType MEMBER _correlationType NOTIFY parameterChanged)
     Q_PROPERTY(int correlationPolarity MEMBER _correlationPolarity NOTIFY parameterChanged)
+    Q_PROPERTY(int correlationPrecision MEMBER _correlationPrecision NOTIFY parameterChanged)
+    Q_PROPERTY(bool approximate MEMBER _approximate NOTIFY parameterChanged)
     Q_PROPERTY(int scalingType MEMBER _scalingType NOTIFY parameterChanged)
     Q_PROPERTY(int normaliseType MEMBER _normaliseType NOTIFY parameterChanged)
     Q_PROPERTY(int missingDataType MEMBER _missingDataType NOTIFY parameterChanged)
@@ -149,6 +151,8 @@ private:
     double _minimumCorrelation = 0.0;
     int _correlationType = static_cast<int>(CorrelationType::Pearson);
     int _correlationPolarity = static_cast<int>(CorrelationPolarity::Positive);
+    int _correlationPrecision = static_cast<int>(CorrelationPrecision::Double);
+    bool _approximate = false;
     int _scalingType = static_cast<int>(ScalingType::None);
     int _normaliseType = static_cast<int>(NormaliseType::None);
     int _missingDataType = static_cast<int>(MissingDataType::Constant);
@@ -55,6 +55,8 @@ BaseParameterDialog
         minimumCorrelation: minimumCorrelationSpinBox.value
         correlationType: { return algorithm.model.get(algorithm.currentIndex).value; }
         correlationPolarity: { return polarity.model.get(polarity.currentIndex).value; }
+        correlationPrecision: { return precision.model.get(precision.currentIndex).value; }
+        approximate: approximateCheckBox.checked
         scalingType: { return scaling.model.get(scaling.currentIndex).value; }
         normaliseType: { return normalise.model.get(normalise.currentIndex).value; }
         missingDataType: { return missingDataType.model.get(missingDataType.currentIndex).value; }
@@ -644,6 +646,83 @@ BaseParameterDialog
                                            "account of the magnitude of the correlation.")
                             }
                         }
+
+                        Text { text: qsTr("Precision:") }
+
+                        ComboBox
+                        {
+                            id: precision
+
+                            model: ListModel
+                            {
+                                ListElement { text: qsTr("Double");   value: CorrelationPrecision.Double }
+                                ListElement { text: qsTr("Single");   value: CorrelationPrecision.Single }
+                                ListElement { text: qsTr("Mixed");    value: CorrelationPrecision.Mixed }
+                            }
+                            textRole: "text"
+
+                            onCurrentIndexChanged:
+                            {
+                                parameters.correlationPrecision = model.get(currentIndex).value;
+                            }
+
+                            property int value: { return model.get(currentIndex).value; }
+                        }
+
+                        HelpTooltip
+                        {
+                            title: qsTr("Precision")
+                            GridLayout
+                            {
+                                columns: 2
+
+                                Text
+                                {
+                                    text: qsTr("<b>Double:</b>")
+                                    textFormat: Text.StyledText
+                                    Layout.alignment: Qt.AlignTop | Qt.AlignLeft
+                                }
+
+                                Text
+                                {
+                                    text: qsTr("Correlation values are computed using double precision " +
+                                        "arithmetic throughout. This is the most accurate option.");
+                                    wrapMode: Text.WordWrap
+                                    Layout.fillWidth: true
+                                }
+
+                                Text
+                                {
+                                    text: qsTr("<b>Single:</b>")
+                                    textFormat: Text.StyledText
+                                    Layout.alignment: Qt.AlignTop | Qt.AlignLeft
+                                }
+
+                                Text
+                                {
+                                    text: qsTr("Correlation values are computed using single precision " +
+                                        "arithmetic, which halves the memory requirements and is " +
+                                        "considerably faster, at the expense of some accuracy.");
+                                    wrapMode: Text.WordWrap
+                                    Layout.fillWidth: true
+                                }
+
+                                Text
+                                {
+                                    text: qsTr("<b>Mixed:</b>")
+                                    textFormat: Text.StyledText
+                                    Layout.alignment: Qt.AlignTop | Qt.AlignLeft
+                                }
+
+                                Text
+                                {
+                                    text: qsTr("Data is stored in single precision, but the " +
+                                        "computation itself is performed in double precision.");
+                                    wrapMode: Text.WordWrap
+                                    Layout.fillWidth: true
+                                }
+                            }
+                        }
                     }
 
                     RowLayout
@@ -749,6 +828,87 @@ BaseParameterDialog
                         }
                     }
 
+                    RowLayout
+                    {
+                        Layout.fillWidth: true
+
+                        CheckBox
+                        {
+                            id: limitEdgesPerNodeCheckBox
+
+                            text: qsTr("Limit Edges Per Node:")
+
+                            onCheckedChanged:
+                            {
+                                parameters.maxEdgesPerNode = checked ? maxEdgesPerNodeSpinBox.value : 0;
+                            }
+                        }
+
+                        SpinBox
+                        {
+                            id: maxEdgesPerNodeSpinBox
+
+                            implicitWidth: 70
+                            enabled: limitEdgesPerNodeCheckBox.checked
+
+                            minimumValue: 1
+                            maximumValue: 1000
+                            value: 10
+
+                            onValueChanged:
+                            {
+                                if(limitEdgesPerNodeCheckBox.checked)
+                                    parameters.maxEdgesPerNode = value;
+                            }
+                        }
+
+                        HelpTooltip
+                        {
+                            title: qsTr("Limit Edges Per Node")
+                            Text
+                            {
+                                wrapMode: Text.WordWrap
+                                text: qsTr("When enabled, only the strongest correlations of each node " +
+                                           "are used to create edges, up to the given number. An edge " +
+                                           "is kept if it is amongst the strongest of either of its " +
+                                           "nodes. This bounds the compute and memory requirements when " +
+                                           "using a low minimum correlation value on a large dataset.")
+                            }
+                        }
+                    }
+
+                    RowLayout
+                    {
+                        Layout.fillWidth: true
+
+                        CheckBox
+                        {
+                            id: approximateCheckBox
+
+                            text: qsTr("Approximate")
+
+                            onCheckedChanged:
+                            {
+                                parameters.approximate = checked;
+                            }
+                        }
+
+                        HelpTooltip
+                        {
+                            title: qsTr("Approximate")
+                            Text
+                            {
+                                wrapMode: Text.WordWrap
+                                text: qsTr("When enabled, a locality sensitive hash of the rows is used " +
+                                           "to find the pairs of rows that are likely to exceed the " +
+                                           "minimum correlation value, and only these are correlated. " +
+                                           "This is much faster for datasets with very many rows, but some " +
+                                           "edges may be missed; the expected proportion of edges found " +
+                                           "(the recall) is shown on the graph size estimate.")
+                            }
+                        }
+                    }
+
                     GraphSizeEstimatePlot
                     {
                         id: graphSizeEstimatePlot
@@ -1401,9 +1561,16 @@ BaseParameterDialog
 
                         summaryString += qsTr("Correlation Metric: ") + algorithm.currentText + "<br>";
                         summaryString += qsTr("Correlation Polarity: ") + polarity.currentText + "<br>";
+                        summaryString += qsTr("Correlation Precision: ") + precision.currentText + "<br>";
                         summaryString += qsTr("Minimum Correlation Value: ") + minimumCorrelationSpinBox.value + "<br>";
                         summaryString += qsTr("Initial Correlation Threshold: ") + initialCorrelationSpinBox.value + "<br>";
 
+                        if(limitEdgesPerNodeCheckBox.checked)
+                            summaryString += qsTr("Maximum Edges Per Node: ") + maxEdgesPerNodeSpinBox.value + "<br>";
+
+                        if(approximateCheckBox.checked)
+                            summaryString += qsTr("Approximate<br>");
+
                         if(scaling.value !== ScalingType.None)
                             summaryString += qsTr("Scaling: ") + scaling.currentText + "<br>";
 
@@ -1508,15 +1675,18 @@ BaseParameterDialog
                 ((1.0 - DEFAULT_MINIMUM_CORRELATION) * 0.5);
 
         parameters = { minimumCorrelation: DEFAULT_MINIMUM_CORRELATION,
-            initialThreshold: DEFAULT_INITIAL_CORRELATION, transpose: false,
+            initialThreshold: DEFAULT_INITIAL_CORRELATION, maxEdgesPerNode: 0, approximate: false, transpose: false,
             correlationType: CorrelationType.Pearson,
             correlationPolarity: CorrelationPolarity.Positive,
+            correlationPrecision: CorrelationPrecision.Double,
             scaling: ScalingType.None, normalise: NormaliseType.None,
             missingDataType: MissingDataType.Constant };
 
         minimumCorrelationSpinBox.value = DEFAULT_MINIMUM_CORRELATION;
         initialCorrelationSpinBox.value = DEFAULT_INITIAL_CORRELATION;
         transposeCheckBox.checked = false;
+        limitEdgesPerNodeCheckBox.checked = false;
+        approximateCheckBox.checked = false;
     }
 
     onVisibleChanged:
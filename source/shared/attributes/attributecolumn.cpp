@@ -0,0 +1,51 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "attributecolumn.h"
+
+AttributeColumn::AttributeColumn(ElementType elementType, ValueType valueType, size_t size) :
+    _elementType(elementType), _valueType(valueType), _covered(size, false)
+{
+    switch(_valueType)
+    {
+    case ValueType::Int:    _intValues.resize(size); break;
+    case ValueType::Float:  _floatValues.resize(size); break;
+    case ValueType::String: _strings.resize(size); break;
+    default: break;
+    }
+}
+
+void AttributeColumn::setString(size_t index, const QString& value)
+{
+    _strings.set(index, value);
+    cover(index);
+}
+
+void AttributeColumn::setMissing(size_t index)
+{
+    // Most attributes have no missing values, so don't pay for the storage unless necessary
+    if(_missing.empty())
+        _missing.resize(_covered.size(), false);
+
+    _missing[index] = true;
+}
+
+void AttributeColumn::finalise()
+{
+    _strings.shrinkToFit();
+}
@@ -0,0 +1,137 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ATTRIBUTECOLUMN_H
+#define ATTRIBUTECOLUMN_H
+
+#include "shared/graph/elementid.h"
+#include "shared/graph/elementtype.h"
+#include "shared/attributes/valuetype.h"
+#include "shared/utils/stringcolumn.h"
+
+#include <limits>
+#include <vector>
+#include <type_traits>
+
+#include <QString>
+#include <QVariant>
+
+// A dense snapshot of the values of a node or edge attribute, indexed by element id, so that
+// reading a value doesn't require a call through the attribute's value function; strings are
+// dictionary encoded, so that repeated values share the same storage
+class AttributeColumn
+{
+private:
+    ElementType _elementType = ElementType::None;
+    ValueType _valueType = ValueType::Unknown;
+
+    // Elements that didn't exist when the snapshot was taken aren't covered by it
+    std::vector<bool> _covered;
+    std::vector<bool> _missing;
+
+    std::vector<int> _intValues;
+    std::vector<double> _floatValues;
+    StringColumn _strings;
+
+    template<typename E>
+    static size_t indexOf(E elementId) { return static_cast<size_t>(static_cast<int>(elementId)); }
+
+    template<typename E>
+    static constexpr ElementType elementTypeOf()
+    {
+        if constexpr(std::is_same_v<E, NodeId>)
+            return ElementType::Node;
+        else if constexpr(std::is_same_v<E, EdgeId>)
+            return ElementType::Edge;
+        else
+            return ElementType::None;
+    }
+
+    template<typename T>
+    static constexpr ValueType valueTypeOf()
+    {
+        if constexpr(std::is_same_v<T, int>)
+            return ValueType::Int;
+        else if constexpr(std::is_same_v<T, double>)
+            return ValueType::Float;
+        else if constexpr(std::is_same_v<T, QString>)
+            return ValueType::String;
+        else
+            return ValueType::Unknown;
+    }
+
+public:
+    AttributeColumn(ElementType elementType, ValueType valueType, size_t size);
+
+    template<typename E>
+    bool covers(E elementId) const
+    {
+        auto index = indexOf(elementId);
+        return _elementType == elementTypeOf<E>() &&
+            index < _covered.size() && _covered[index];
+    }
+
+    template<typename T, typename E>
+    bool covers(E elementId) const
+    {
+        return _valueType == valueTypeOf<T>() && covers(elementId);
+    }
+
+    template<typename E> int intValueOf(E elementId) const { return _intValues[indexOf(elementId)]; }
+    template<typename E> double floatValueOf(E elementId) const { return _floatValues[indexOf(elementId)]; }
+    template<typename E> const QString& stringValueOf(E elementId) const { return _strings.at(indexOf(elementId)); }
+    template<typename E> bool valueMissingOf(E elementId) const { return !_missing.empty() && _missing[indexOf(elementId)]; }
+
+    template<typename E> double numericValueOf(E elementId) const
+    {
+        switch(_valueType)
+        {
+        case ValueType::Int:    return static_cast<double>(intValueOf(elementId));
+        case ValueType::Float:  return floatValueOf(elementId);
+        default: break;
+        }
+
+        return std::numeric_limits<double>::signaling_NaN();
+    }
+
+    template<typename E> QVariant valueOf(E elementId) const
+    {
+        switch(_valueType)
+        {
+        case ValueType::Int:    return intValueOf(elementId);
+        case ValueType::Float:  return floatValueOf(elementId);
+        case ValueType::String: return stringValueOf(elementId);
+        default:                return {};
+        }
+    }
+
+    template<typename E> void setValue(E elementId, int value) { _intValues[indexOf(elementId)] = value; cover(indexOf(elementId)); }
+    template<typename E> void setValue(E elementId, double value) { _floatValues[indexOf(elementId)] = value; cover(indexOf(elementId)); }
+    template<typename E> void setValue(E elementId, const QString& value) { setString(indexOf(elementId), value); }
+    template<typename E> void setValueMissing(E elementId) { setMissing(indexOf(elementId)); }
+
+    // Discards the state that is only needed while setting values
+    void finalise();
+
+private:
+    void cover(size_t index) { _covered[index] = true; }
+    void setString(size_t index, const QString& value);
+    void setMissing(size_t index);
+};
+
+#endif // ATTRIBUTECOLUMN_H
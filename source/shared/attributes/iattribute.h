@@ -27,12 +27,15 @@
 #include "shared/utils/qmlenum.h"
 
 #include <functional>
+#include <memory>
 #include <vector>
 #include <variant>
 
 #include <QString>
 #include <QVariant>
 
+class AttributeColumn;
+
 DEFINE_QML_ENUM(
     Q_GADGET, AttributeFlag,
     None                    = 0x0,
@@ -101,6 +104,11 @@ public:
     virtual bool valueMissingOf(EdgeId edgeId) const = 0;
     virtual bool valueMissingOf(const IGraphComponent& graphComponent) const = 0;
 
+    // Call before reading the values of many elements; returns a snapshot of the values, or nullptr if
+    // there can't be one, which should be held for the duration of the reads, and read directly for
+    // the elements it covers
+    virtual std::shared_ptr<const AttributeColumn> materialise() const = 0;
+
     virtual IAttribute& setIntValueFn(ValueFn<int, NodeId> valueFn) = 0;
     virtual IAttribute& setIntValueFn(ValueFn<int, EdgeId> valueFn) = 0;
     virtual IAttribute& setIntValueFn(ValueFn<int, const IGraphComponent&> valueFn) = 0;
@@ -0,0 +1,131 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GRAPHARRAY_BINARY_H
+#define GRAPHARRAY_BINARY_H
+
+#include "shared/graph/elementid.h"
+#include "shared/graph/igraph.h"
+#include "shared/utils/progressable.h"
+
+#include <QByteArray>
+#include <QDataStream>
+
+#include <cstdint>
+#include <type_traits>
+
+// The binary encoding of graph arrays in native files, shared with the plugins
+// so that they can store their own graph arrays in the same way
+namespace NativeFormat
+{
+// Floating point values are single precision, unless what's stored needs more
+inline QDataStream& initialiseStream(QDataStream& stream,
+    QDataStream::FloatingPointPrecision precision = QDataStream::SinglePrecision)
+{
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setFloatingPointPrecision(precision);
+
+    return stream;
+}
+
+// The binary equivalent of u::graphArrayAsJson; each element's id is followed by its value
+template<typename GraphArray, typename C, typename WriteFn>
+QByteArray graphArrayAsBinary(const GraphArray& graphArray, const C& elementIds,
+    Progressable& progressable, const WriteFn& writeFn,
+    QDataStream::FloatingPointPrecision precision = QDataStream::SinglePrecision)
+{
+    QByteArray byteArray;
+    QDataStream stream(&byteArray, QIODevice::WriteOnly);
+    initialiseStream(stream, precision);
+
+    stream << static_cast<qint32>(elementIds.size());
+
+    uint64_t i = 0;
+    for(auto elementId : elementIds)
+    {
+        stream << static_cast<qint32>(elementId);
+        writeFn(stream, graphArray.at(elementId));
+
+        progressable.setProgress(static_cast<int>((i++) * 100 / elementIds.size()));
+    }
+
+    progressable.setProgress(-1);
+
+    return byteArray;
+}
+
+// The binary equivalent of u::forEachJsonGraphArray; fails if an element doesn't exist in graph
+template<typename E, typename Fn>
+bool forEachBinaryGraphArray(const QByteArray& byteArray, const IGraph& graph, Progressable& progressable,
+    const Fn& fn, QDataStream::FloatingPointPrecision precision = QDataStream::SinglePrecision)
+{
+    static_assert(std::is_same_v<E, NodeId> || std::is_same_v<E, EdgeId>);
+
+    QDataStream stream(byteArray);
+    initialiseStream(stream, precision);
+
+    qint32 numElements = 0;
+    stream >> numElements;
+
+    if(numElements < 0)
+        return false;
+
+    for(qint32 i = 0; i < numElements; i++)
+    {
+        qint32 elementId = -1;
+        stream >> elementId;
+
+        if(stream.status() != QDataStream::Ok || elementId < 0)
+            return false;
+
+        if constexpr(std::is_same_v<E, NodeId>)
+        {
+            if(!graph.containsNodeId(elementId))
+                return false;
+        }
+        else
+        {
+            if(!graph.containsEdgeId(elementId))
+                return false;
+        }
+
+        fn(stream, E(elementId));
+
+        progressable.setProgress(static_cast<int>((i * 100) / numElements));
+    }
+
+    progressable.setProgress(-1);
+
+    return stream.status() == QDataStream::Ok;
+}
+
+template<typename Fn>
+bool forEachBinaryNodeArray(const QByteArray& byteArray, const IGraph& graph, Progressable& progressable, const Fn& fn)
+{
+    return forEachBinaryGraphArray<NodeId>(byteArray, graph, progressable, fn);
+}
+
+template<typename Fn>
+bool forEachBinaryEdgeArray(const QByteArray& byteArray, const IGraph& graph, Progressable& progressable,
+    const Fn& fn, QDataStream::FloatingPointPrecision precision = QDataStream::SinglePrecision)
+{
+    return forEachBinaryGraphArray<EdgeId>(byteArray, graph, progressable, fn, precision);
+}
+} // namespace NativeFormat
+
+#endif // GRAPHARRAY_BINARY_H
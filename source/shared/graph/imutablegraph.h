@@ -23,6 +23,11 @@
 #include "shared/graph/elementid_containers.h"
 
 #include "shared/graph/igraph.h"
+#include "shared/graph/grapharray.h"
+
+#include <vector>
+#include <utility>
+#include <cstddef>
 
 class IMutableGraph : public virtual IGraph
 {
@@ -95,6 +100,19 @@ public:
         endTransaction();
     }
 
+    // Bulk construction, for when a large number of elements are being added at once, e.g.
+    // when loading; the new elements are given contiguous ids following any existing ones,
+    // the first of which is returned, and no per-element signals are emitted
+    virtual NodeId bulkAddNodes(size_t numNodes) = 0;
+    virtual EdgeId bulkAddEdges(const std::vector<std::pair<NodeId, NodeId>>& edges) = 0;
+
+    // Removes every element that is flagged in removees, along with the edges of any removed
+    // nodes, in a single pass; the result is the same as removing each individually, in order
+    // of id, but is far quicker when a large number of elements are being removed, and the
+    // removals are signalled all at once, rather than per element
+    virtual void bulkRemoveNodes(const NodeArray<bool>& removees) = 0;
+    virtual void bulkRemoveEdges(const EdgeArray<bool>& removees) = 0;
+
     virtual void contractEdge(EdgeId edgeId) = 0;
     virtual void contractEdges(const EdgeIdSet& edgeIds) = 0;
 
@@ -128,12 +128,28 @@ bool BiopaxFileParser::parse(const QUrl& url, IGraphModel* graphModel)
 
     QXmlStreamReader xsr(&file);
 
-    std::map<QString, NodeId> nodes;
     std::stack<std::pair<NodeId, QString>> activeNodes;
     std::stack<QString> activeElements;
 
     std::vector<TempEdge> tempEdges;
 
+    // The nodes, edges and their data are first collected, then added to the graph
+    // in bulk once the whole document has been read; until then, the NodeIds are
+    // indices into nodeNames
+    std::map<QString, NodeId> nodes;
+    std::vector<QString> nodeNames;
+    std::vector<std::pair<NodeId, NodeId>> edgeNodeIds;
+
+    struct Row
+    {
+        int _index;
+        QString _attributeName;
+        QString _value;
+    };
+
+    // In document order, so that the attributes are created in the same order as they appear
+    std::vector<Row> nodeRows;
+
     auto processToken = [&](QXmlStreamReader::TokenType tokenType)
     {
         NodeId activeNodeId;
@@ -163,15 +179,13 @@ bool BiopaxFileParser::parse(const QUrl& url, IGraphModel* graphModel)
 
                 auto rdfId = attributes.value(QStringLiteral("rdf:ID")).toString();
 
-                auto nodeId = graphModel->mutableGraph().addNode();
+                auto nodeId = NodeId(static_cast<int>(nodeNames.size()));
                 nodes.emplace(rdfId, nodeId);
+                nodeNames.emplace_back();
                 activeNodes.emplace(nodeId, rdfId);
 
-                if(_userNodeData != nullptr)
-                {
-                    _userNodeData->setValueBy(nodeId, QObject::tr("ID"), rdfId);
-                    _userNodeData->setValueBy(nodeId, QObject::tr("Class"), elementName);
-                }
+                nodeRows.push_back({static_cast<int>(nodeId), QObject::tr("ID"), rdfId});
+                nodeRows.push_back({static_cast<int>(nodeId), QObject::tr("Class"), elementName});
             }
             else if(isEdgeElementName(elementName))
             {
@@ -213,11 +227,11 @@ bool BiopaxFileParser::parse(const QUrl& url, IGraphModel* graphModel)
 
             if(activeElements.top() == QStringLiteral("displayName"))
             {
-                _userNodeData->setValueBy(activeNodeId, QObject::tr("Node Name"), data);
-                graphModel->setNodeName(activeNodeId, data);
+                nodeRows.push_back({static_cast<int>(activeNodeId), QObject::tr("Node Name"), data});
+                nodeNames.at(static_cast<size_t>(static_cast<int>(activeNodeId))) = data;
             }
             else if(activeElements.top() == QStringLiteral("comment"))
-                _userNodeData->setValueBy(activeNodeId, QObject::tr("Comment"), data);
+                nodeRows.push_back({static_cast<int>(activeNodeId), QObject::tr("Comment"), data});
 
             break;
         }
@@ -241,14 +255,14 @@ bool BiopaxFileParser::parse(const QUrl& url, IGraphModel* graphModel)
 
             activeElements.pop();
 
-            if(isNodeElementName(elementName))
+            if(isNodeElementName(elementName) && !activeNodes.empty())
             {
                 // If the node hasn't been assigned a name, just use its ID
-                if(graphModel->nodeName(activeNodeId).isEmpty())
+                auto& nodeName = nodeNames.at(static_cast<size_t>(static_cast<int>(activeNodeId)));
+                if(nodeName.isEmpty())
                 {
-                    auto nodeIdString = _userNodeData->valueBy(activeNodeId, QObject::tr("ID")).toString();
-                    _userNodeData->setValueBy(activeNodeId, QObject::tr("Node Name"), nodeIdString);
-                    graphModel->setNodeName(activeNodeId, nodeIdString);
+                    nodeRows.push_back({static_cast<int>(activeNodeId), QObject::tr("Node Name"), activeNodeName});
+                    nodeName = activeNodeName;
                 }
 
                 activeNodes.pop();
@@ -281,7 +295,7 @@ bool BiopaxFileParser::parse(const QUrl& url, IGraphModel* graphModel)
                             return false;
                         }
 
-                        graphModel->mutableGraph().addEdge(sourceNodeId->second, targetNodeId->second);
+                        edgeNodeIds.emplace_back(sourceNodeId->second, targetNodeId->second);
                     }
                 }
             }
@@ -318,5 +332,42 @@ bool BiopaxFileParser::parse(const QUrl& url, IGraphModel* graphModel)
         return false;
     }
 
+    auto& mutableGraph = graphModel->mutableGraph();
+    auto firstNodeId = mutableGraph.bulkAddNodes(nodeNames.size());
+
+    for(auto& [sourceId, targetId] : edgeNodeIds)
+    {
+        sourceId = firstNodeId + static_cast<int>(sourceId);
+        targetId = firstNodeId + static_cast<int>(targetId);
+    }
+
+    mutableGraph.bulkAddEdges(edgeNodeIds);
+
+    const auto numRows = static_cast<uint64_t>(nodeNames.size() + nodeRows.size());
+    uint64_t i = 0;
+
+    for(size_t index = 0; index < nodeNames.size(); index++)
+    {
+        setProgress(static_cast<int>((i++ * 100) / numRows));
+        graphModel->setNodeName(firstNodeId + static_cast<int>(index), nodeNames.at(index));
+
+        if(cancelled())
+            return false;
+    }
+
+    if(_userNodeData != nullptr)
+    {
+        for(const auto& row : nodeRows)
+        {
+            setProgress(static_cast<int>((i++ * 100) / numRows));
+            _userNodeData->setValueBy(firstNodeId + row._index, row._attributeName, row._value);
+
+            if(cancelled())
+                return false;
+        }
+    }
+
+    setProgress(-1);
+
     return true;
 }
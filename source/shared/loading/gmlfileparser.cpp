@@ -149,16 +149,10 @@ bool build(GmlFileParser& parser, const List& gml, IGraphModel& graphModel,
         return nullptr;
     };
 
-    std::map<int, NodeId> gmlIdToNodeId;
-
-    auto processNode = [&](const List& node)
+    auto processNode = [&](const List& node, NodeId nodeId)
     {
         const auto* id = findIntValue(node, QStringLiteral("id"));
-        if(id == nullptr)
-            return false;
-
-        auto nodeId = graphModel.mutableGraph().addNode();
-        gmlIdToNodeId[*id] = nodeId;
+        Q_ASSERT(id != nullptr);
 
         auto nodeName = QString::number(*id);
 
@@ -189,25 +183,10 @@ bool build(GmlFileParser& parser, const List& gml, IGraphModel& graphModel,
 
         userNodeData.setValueBy(nodeId, QObject::tr("Node Name"), nodeName);
         graphModel.setNodeName(nodeId, nodeName);
-
-        return true;
     };
 
-    auto processEdge = [&](const List& edge)
+    auto processEdge = [&](const List& edge, EdgeId edgeId)
     {
-        const auto* sourceId = findIntValue(edge, QStringLiteral("source"));
-        const auto* targetId = findIntValue(edge, QStringLiteral("target"));
-
-        if(sourceId == nullptr || targetId == nullptr)
-            return false;
-
-        if(!u::contains(gmlIdToNodeId, *sourceId) || !u::contains(gmlIdToNodeId, *targetId))
-            return false;
-
-        auto sourceNodeId = gmlIdToNodeId[*sourceId];
-        auto targetNodeId = gmlIdToNodeId[*targetId];
-        auto edgeId = graphModel.mutableGraph().addEdge(sourceNodeId, targetNodeId);
-
         for(const auto& attributeWrapper : edge)
         {
             const auto& keyValue = attributeWrapper.get();
@@ -222,10 +201,15 @@ bool build(GmlFileParser& parser, const List& gml, IGraphModel& graphModel,
                 userEdgeData.setValueBy(edgeId, attributeName, attribute._value);
             }
         }
-
-        return true;
     };
 
+    // The nodes and edges are first validated and collected, then added to the
+    // graph in bulk; until then, the NodeIds are indices into nodes
+    std::map<int, NodeId> gmlIdToNodeId;
+    std::vector<const List*> nodes;
+    std::vector<const List*> edges;
+    std::vector<std::pair<NodeId, NodeId>> edgeNodeIds;
+
     for(const auto& keyValue : gml)
     {
         const auto& key = keyValue.get()._key;
@@ -237,30 +221,77 @@ bool build(GmlFileParser& parser, const List& gml, IGraphModel& graphModel,
             if(graph == nullptr)
                 return false;
 
-            uint64_t i = 0;
             for(const auto& element : *graph)
             {
-                parser.setProgress(static_cast<int>((i++ * 100) / graph->size()));
-
                 const auto& type = element.get()._key;
                 const auto* value = std::get_if<List>(&element.get()._value);
 
                 if(value == nullptr)
                     continue;
 
-                bool success = true;
-
                 if(type == QStringLiteral("node"))
-                    success = processNode(*value);
+                {
+                    const auto* id = findIntValue(*value, QStringLiteral("id"));
+                    if(id == nullptr)
+                        return false;
+
+                    gmlIdToNodeId[*id] = NodeId(static_cast<int>(nodes.size()));
+                    nodes.push_back(value);
+                }
                 else if(type == QStringLiteral("edge"))
-                    success = processEdge(*value);
+                {
+                    const auto* sourceId = findIntValue(*value, QStringLiteral("source"));
+                    const auto* targetId = findIntValue(*value, QStringLiteral("target"));
 
-                if(!success || parser.cancelled())
+                    if(sourceId == nullptr || targetId == nullptr)
+                        return false;
+
+                    // Edges may only refer to nodes that precede them
+                    if(!u::contains(gmlIdToNodeId, *sourceId) || !u::contains(gmlIdToNodeId, *targetId))
+                        return false;
+
+                    edgeNodeIds.emplace_back(gmlIdToNodeId[*sourceId], gmlIdToNodeId[*targetId]);
+                    edges.push_back(value);
+                }
+
+                if(parser.cancelled())
                     return false;
             }
         }
     }
 
+    auto& mutableGraph = graphModel.mutableGraph();
+    auto firstNodeId = mutableGraph.bulkAddNodes(nodes.size());
+
+    const auto numElements = static_cast<uint64_t>(nodes.size() + edges.size());
+    uint64_t i = 0;
+
+    for(size_t index = 0; index < nodes.size(); index++)
+    {
+        parser.setProgress(static_cast<int>((i++ * 100) / numElements));
+        processNode(*nodes.at(index), firstNodeId + static_cast<int>(index));
+
+        if(parser.cancelled())
+            return false;
+    }
+
+    for(auto& [sourceId, targetId] : edgeNodeIds)
+    {
+        sourceId = firstNodeId + static_cast<int>(sourceId);
+        targetId = firstNodeId + static_cast<int>(targetId);
+    }
+
+    auto firstEdgeId = mutableGraph.bulkAddEdges(edgeNodeIds);
+
+    for(size_t index = 0; index < edges.size(); index++)
+    {
+        parser.setProgress(static_cast<int>((i++ * 100) / numElements));
+        processEdge(*edges.at(index), firstEdgeId + static_cast<int>(index));
+
+        if(parser.cancelled())
+            return false;
+    }
+
     return true;
 }
 
@@ -30,6 +30,7 @@
 
 #include <stack>
 #include <map>
+#include <vector>
 
 // http://graphml.graphdrawing.org/primer/graphml-primer.html
 
@@ -58,10 +59,27 @@ bool GraphMLParser::parse(const QUrl& url, IGraphModel* graphModel)
 
     QXmlStreamReader xsr(&file);
     std::stack<QString> stack;
-    std::map<QString, NodeId> nodes;
     std::map<QString, QString> nodeAttributes;
     std::map<QString, QString> edgeAttributes;
 
+    // The nodes, edges and their data are first collected, then added to the graph
+    // in bulk once the whole document has been read; until then, the NodeIds and
+    // EdgeIds are indices into nodeNames and edgeNodeIds respectively
+    std::map<QString, NodeId> nodes;
+    std::vector<QString> nodeNames;
+    std::vector<std::pair<NodeId, NodeId>> edgeNodeIds;
+
+    struct Row
+    {
+        int _index;
+        QString _attributeName;
+        QString _value;
+    };
+
+    // In document order, so that the attributes are created in the same order as they appear
+    std::vector<Row> nodeRows;
+    std::vector<Row> edgeRows;
+
     bool graphmlElementFound = false;
     int graphNestLevel = 0;
     NodeId activeNodeId;
@@ -136,11 +154,11 @@ bool GraphMLParser::parse(const QUrl& url, IGraphModel* graphModel)
                     return false;
                 }
 
-                activeNodeId = graphModel->mutableGraph().addNode();
+                activeNodeId = NodeId(static_cast<int>(nodeNames.size()));
                 nodes.emplace(nodeName, activeNodeId);
+                nodeNames.push_back(nodeName);
 
-                _userNodeData->setValueBy(activeNodeId, QObject::tr("Node Name"), nodeName);
-                graphModel->setNodeName(activeNodeId, nodeName);
+                nodeRows.push_back({static_cast<int>(activeNodeId), QObject::tr("Node Name"), nodeName});
             }
             else if(elementName == QStringLiteral("edge"))
             {
@@ -165,15 +183,13 @@ bool GraphMLParser::parse(const QUrl& url, IGraphModel* graphModel)
                     break;
                 }
 
-                auto sourceId = nodes.at(sourceName);
-                auto targetId = nodes.at(targetName);
-
-                activeEdgeId = graphModel->mutableGraph().addEdge(sourceId, targetId);
+                activeEdgeId = EdgeId(static_cast<int>(edgeNodeIds.size()));
+                edgeNodeIds.emplace_back(nodes.at(sourceName), nodes.at(targetName));
 
                 if(attributes.hasAttribute("id"))
                 {
                     auto edgeName = attributes.value("id").toString();
-                    _userEdgeData->setValueBy(activeEdgeId, QObject::tr("Edge Name"), edgeName);
+                    edgeRows.push_back({static_cast<int>(activeEdgeId), QObject::tr("Edge Name"), edgeName});
                 }
             }
             else if(elementName == QStringLiteral("data"))
@@ -198,9 +214,9 @@ bool GraphMLParser::parse(const QUrl& url, IGraphModel* graphModel)
             const auto& data = xsr.text().toString();
 
             if(!activeNodeId.isNull() && u::contains(nodeAttributes, activeKey))
-                _userNodeData->setValueBy(activeNodeId, nodeAttributes.at(activeKey), data);
+                nodeRows.push_back({static_cast<int>(activeNodeId), nodeAttributes.at(activeKey), data});
             else if(!activeEdgeId.isNull() && u::contains(edgeAttributes, activeKey))
-                _userEdgeData->setValueBy(activeEdgeId, edgeAttributes.at(activeKey), data);
+                edgeRows.push_back({static_cast<int>(activeEdgeId), edgeAttributes.at(activeKey), data});
 
             break;
         }
@@ -276,5 +292,48 @@ bool GraphMLParser::parse(const QUrl& url, IGraphModel* graphModel)
         return false;
     }
 
+    auto& mutableGraph = graphModel->mutableGraph();
+    auto firstNodeId = mutableGraph.bulkAddNodes(nodeNames.size());
+
+    for(auto& [sourceId, targetId] : edgeNodeIds)
+    {
+        sourceId = firstNodeId + static_cast<int>(sourceId);
+        targetId = firstNodeId + static_cast<int>(targetId);
+    }
+
+    auto firstEdgeId = mutableGraph.bulkAddEdges(edgeNodeIds);
+
+    const auto numRows = static_cast<uint64_t>(nodeNames.size() + nodeRows.size() + edgeRows.size());
+    uint64_t i = 0;
+
+    for(size_t index = 0; index < nodeNames.size(); index++)
+    {
+        setProgress(static_cast<int>((i++ * 100) / numRows));
+        graphModel->setNodeName(firstNodeId + static_cast<int>(index), nodeNames.at(index));
+
+        if(cancelled())
+            return false;
+    }
+
+    for(const auto& row : nodeRows)
+    {
+        setProgress(static_cast<int>((i++ * 100) / numRows));
+        _userNodeData->setValueBy(firstNodeId + row._index, row._attributeName, row._value);
+
+        if(cancelled())
+            return false;
+    }
+
+    for(const auto& row : edgeRows)
+    {
+        setProgress(static_cast<int>((i++ * 100) / numRows));
+        _userEdgeData->setValueBy(firstEdgeId + row._index, row._attributeName, row._value);
+
+        if(cancelled())
+            return false;
+    }
+
+    setProgress(-1);
+
     return true;
 }
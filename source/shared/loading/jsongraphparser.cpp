@@ -27,6 +27,11 @@
 #include <QFile>
 #include <QUrl>
 
+#include <map>
+#include <optional>
+#include <utility>
+#include <vector>
+
 bool JsonGraphParser::parse(const QUrl &url, IGraphModel *graphModel)
 {
     QFile file(url.toLocalFile());
@@ -99,6 +104,12 @@ bool JsonGraphParser::parseGraphObject(const json& jsonGraphObject, IGraphModel*
 
     graphModel->mutableGraph().setPhase(QObject::tr("Nodes"));
 
+    // Unless the element ids are to be used literally, the nodes
+    // and edges are added in bulk, and so have contiguous ids
+    NodeId nextBulkNodeId;
+    if(!useElementIdsLiterally)
+        nextBulkNodeId = graphModel->mutableGraph().bulkAddNodes(jsonNodes.size());
+
     std::map<std::string, NodeId> stringNodeIdToNodeId;
     for(const auto& jsonNode : jsonNodes)
     {
@@ -112,7 +123,9 @@ bool JsonGraphParser::parseGraphObject(const json& jsonGraphObject, IGraphModel*
 
         NodeId nodeId;
 
-        if(useElementIdsLiterally && u::isNumeric(nodeIdString))
+        if(!useElementIdsLiterally)
+            nodeId = nextBulkNodeId++;
+        else if(u::isNumeric(nodeIdString))
         {
             nodeId = std::stoi(nodeIdString);
             graphModel->mutableGraph().reserveNodeId(nodeId);
@@ -156,16 +169,17 @@ bool JsonGraphParser::parseGraphObject(const json& jsonGraphObject, IGraphModel*
     i = 0;
 
     graphModel->mutableGraph().setPhase(QObject::tr("Edges"));
-    for(const auto& jsonEdge : jsonEdges)
+
+    auto endpointsOf = [&](const json& jsonEdge) -> std::optional<std::pair<NodeId, NodeId>>
     {
         if(!u::contains(jsonEdge, "source") || !u::contains(jsonEdge, "target"))
         {
             parser.setFailureReason(QObject::tr("Edge has no source or target."));
-            return false;
+            return std::nullopt;
         }
 
         if(!jsonEdge["source"].is_string() || !jsonEdge["target"].is_string())
-            return false;
+            return std::nullopt;
 
         auto sourceIdString = jsonEdge["source"].get<std::string>();
         auto targetIdString = jsonEdge["target"].get<std::string>();
@@ -173,22 +187,55 @@ bool JsonGraphParser::parseGraphObject(const json& jsonGraphObject, IGraphModel*
         if(!u::contains(stringNodeIdToNodeId, sourceIdString) ||
             !u::contains(stringNodeIdToNodeId, targetIdString))
         {
-            return false;
+            return std::nullopt;
         }
 
-        EdgeId edgeId;
-        NodeId sourceId = stringNodeIdToNodeId.at(sourceIdString);
-        NodeId targetId = stringNodeIdToNodeId.at(targetIdString);
+        return std::make_pair(stringNodeIdToNodeId.at(sourceIdString),
+            stringNodeIdToNodeId.at(targetIdString));
+    };
+
+    EdgeId nextBulkEdgeId;
+    if(!useElementIdsLiterally)
+    {
+        std::vector<std::pair<NodeId, NodeId>> edges;
+        edges.reserve(jsonEdges.size());
 
-        if(useElementIdsLiterally && u::contains(jsonEdge, "id") && jsonEdge["id"].is_string())
+        for(const auto& jsonEdge : jsonEdges)
         {
-            edgeId = std::stoi(jsonEdge["id"].get<std::string>());
+            auto endpoints = endpointsOf(jsonEdge);
+            if(!endpoints)
+                return false;
 
-            graphModel->mutableGraph().reserveEdgeId(edgeId);
-            edgeId = graphModel->mutableGraph().addEdge(edgeId, sourceId, targetId);
+            edges.push_back(*endpoints);
         }
+
+        nextBulkEdgeId = graphModel->mutableGraph().bulkAddEdges(edges);
+    }
+
+    for(const auto& jsonEdge : jsonEdges)
+    {
+        EdgeId edgeId;
+
+        if(!useElementIdsLiterally)
+            edgeId = nextBulkEdgeId++;
         else
-            edgeId = graphModel->mutableGraph().addEdge(sourceId, targetId);
+        {
+            auto endpoints = endpointsOf(jsonEdge);
+            if(!endpoints)
+                return false;
+
+            auto [sourceId, targetId] = *endpoints;
+
+            if(u::contains(jsonEdge, "id") && jsonEdge["id"].is_string())
+            {
+                edgeId = std::stoi(jsonEdge["id"].get<std::string>());
+
+                graphModel->mutableGraph().reserveEdgeId(edgeId);
+                edgeId = graphModel->mutableGraph().addEdge(edgeId, sourceId, targetId);
+            }
+            else
+                edgeId = graphModel->mutableGraph().addEdge(sourceId, targetId);
+        }
 
         if(u::contains(jsonEdge, "metadata") && userEdgeData != nullptr)
         {
@@ -60,7 +60,21 @@ bool PairwiseTxtFileParser::parse(const QUrl& url, IGraphModel* graphModel)
     file.seekg(0, std::ios::end);
     fileSize = file.tellg() - fileSize;
 
+    // Nodes are identified by the order they're encountered in until the end, when
+    // they and the edges are added in bulk; until then NodeIds are actually indices
     std::unordered_map<std::string, NodeId> nodeIdMap;
+    std::vector<std::string> nodeNames;
+    std::vector<std::pair<NodeId, NodeId>> edges;
+
+    struct NodeValue
+    {
+        NodeId _nodeId;
+        QString _name;
+        QString _value;
+    };
+
+    std::vector<NodeValue> nodeValues;
+    std::vector<std::pair<size_t, double>> edgeWeights;
 
     std::string line;
     std::string token;
@@ -185,7 +199,7 @@ bool PairwiseTxtFileParser::parse(const QUrl& url, IGraphModel* graphModel)
                 }
 
                 if(!nodeId.isNull())
-                    _userNodeData->setValueBy(nodeId, attributeName, value);
+                    nodeValues.push_back({nodeId, attributeName, value});
             }
         }
         else if(tokens.size() >= 2)
@@ -193,40 +207,22 @@ bool PairwiseTxtFileParser::parse(const QUrl& url, IGraphModel* graphModel)
             auto& firstToken = tokens.at(0);
             auto& secondToken = tokens.at(1);
 
-            NodeId firstNodeId;
-            NodeId secondNodeId;
-
-            if(!u::contains(nodeIdMap, firstToken))
+            auto nodeIdFor = [&](const std::string& name)
             {
-                firstNodeId = graphModel->mutableGraph().addNode();
-                nodeIdMap.emplace(firstToken, firstNodeId);
-
-                if(_userNodeData != nullptr)
-                {
-                    auto nodeName = QString::fromStdString(firstToken);
-                    _userNodeData->setValueBy(firstNodeId, QObject::tr("Node Name"), nodeName);
-                    graphModel->setNodeName(firstNodeId, nodeName);
-                }
-            }
-            else
-                firstNodeId = nodeIdMap[firstToken];
+                auto it = nodeIdMap.find(name);
+                if(it != nodeIdMap.end())
+                    return it->second;
 
-            if(!u::contains(nodeIdMap, secondToken))
-            {
-                secondNodeId = graphModel->mutableGraph().addNode();
-                nodeIdMap.emplace(secondToken, secondNodeId);
+                NodeId nodeId(static_cast<int>(nodeNames.size()));
+                nodeIdMap.emplace(name, nodeId);
+                nodeNames.push_back(name);
 
-                if(_userNodeData != nullptr)
-                {
-                    auto nodeName = QString::fromStdString(secondToken);
-                    _userNodeData->setValueBy(secondNodeId, QObject::tr("Node Name"), nodeName);
-                    graphModel->setNodeName(secondNodeId, nodeName);
-                }
-            }
-            else
-                secondNodeId = nodeIdMap[secondToken];
+                return nodeId;
+            };
 
-            auto edgeId = graphModel->mutableGraph().addEdge(firstNodeId, secondNodeId);
+            auto firstNodeId = nodeIdFor(firstToken);
+            auto secondNodeId = nodeIdFor(secondToken);
+            edges.emplace_back(firstNodeId, secondNodeId);
 
             if(tokens.size() >= 3)
             {
@@ -240,7 +236,7 @@ bool PairwiseTxtFileParser::parse(const QUrl& url, IGraphModel* graphModel)
                     if(std::isnan(edgeWeight) || !std::isfinite(edgeWeight))
                         edgeWeight = 1.0;
 
-                    _userEdgeData->setValueBy(edgeId, QObject::tr("Edge Weight"), QString::number(edgeWeight));
+                    edgeWeights.emplace_back(edges.size() - 1, edgeWeight);
                 }
             }
         }
@@ -250,5 +246,40 @@ bool PairwiseTxtFileParser::parse(const QUrl& url, IGraphModel* graphModel)
             setProgress(static_cast<int>(filePosition * 100 / fileSize));
     }
 
+    setProgress(-1);
+
+    auto& graph = graphModel->mutableGraph();
+    auto firstNodeId = graph.bulkAddNodes(nodeNames.size());
+
+    auto toNodeId = [firstNodeId](NodeId index) { return firstNodeId + static_cast<int>(index); };
+
+    if(_userNodeData != nullptr)
+    {
+        for(size_t i = 0; i < nodeNames.size(); i++)
+        {
+            auto nodeId = toNodeId(NodeId(static_cast<int>(i)));
+            auto nodeName = QString::fromStdString(nodeNames.at(i));
+            _userNodeData->setValueBy(nodeId, QObject::tr("Node Name"), nodeName);
+            graphModel->setNodeName(nodeId, nodeName);
+        }
+
+        for(const auto& nodeValue : nodeValues)
+            _userNodeData->setValueBy(toNodeId(nodeValue._nodeId), nodeValue._name, nodeValue._value);
+    }
+
+    for(auto& [sourceId, targetId] : edges)
+    {
+        sourceId = toNodeId(sourceId);
+        targetId = toNodeId(targetId);
+    }
+
+    auto firstEdgeId = graph.bulkAddEdges(edges);
+
+    for(const auto& [index, edgeWeight] : edgeWeights)
+    {
+        _userEdgeData->setValueBy(firstEdgeId + static_cast<int>(index),
+            QObject::tr("Edge Weight"), QString::number(edgeWeight));
+    }
+
     return true;
 }
@@ -87,14 +87,12 @@ void TabularData::setValueAt(size_t column, size_t row, QString&& value, int pro
     {
         _data.resize(newSize);
 
+        // Moving the last cell first means nothing is overwritten before it's been moved,
+        // and every cell that's left behind is emptied
         for(size_t offset = _rows - 1; offset > 0; offset--)
         {
-            auto oldPosition = _data.begin() + (offset * _columns);
-            auto newPosition = _data.begin() + (offset * columns);
-
-            std::move_backward(oldPosition,
-                oldPosition + _columns,
-                newPosition + _columns);
+            for(size_t cell = _columns; cell > 0; cell--)
+                _data.move((offset * _columns) + cell - 1, (offset * columns) + cell - 1);
         }
     }
 
@@ -128,7 +126,7 @@ void TabularData::setValueAt(size_t column, size_t row, QString&& value, int pro
     }
 
     _data.resize(newSize);
-    _data.at(index(column, row)) = value.trimmed();
+    _data.set(index(column, row), value.trimmed());
 }
 
 void TabularData::shrinkToFit()
@@ -149,7 +147,7 @@ void TabularData::shrinkToFit()
         _rows--;
     }
 
-    _data.shrink_to_fit();
+    _data.shrinkToFit();
 }
 
 void TabularData::reset()
@@ -23,6 +23,7 @@
 #include "shared/graph/imutablegraph.h"
 #include "shared/loading/iparser.h"
 #include "shared/utils/string.h"
+#include "shared/utils/stringcolumn.h"
 
 #include <csv/parser.hpp>
 
@@ -40,7 +41,9 @@
 class TabularData
 {
 private:
-    std::vector<QString> _data;
+    // Tables of categorical data have far fewer distinct values than cells, and are stored
+    // as codes into a dictionary of them, while numerical tables end up stored plainly
+    StringColumn _data;
     size_t _columns = 0;
     size_t _rows = 0;
     bool _transposed = false;
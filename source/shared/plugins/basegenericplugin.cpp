@@ -27,11 +27,14 @@
 #include "shared/loading/jsongraphparser.h"
 
 #include "shared/attributes/iattribute.h"
+#include "shared/graph/grapharray_binary.h"
 
 #include "shared/utils/container.h"
 
 #include <json_helper.h>
 
+#include <QDataStream>
+
 BaseGenericPluginInstance::BaseGenericPluginInstance()
 {
     connect(this, SIGNAL(loadSuccess()), this, SLOT(onLoadSuccess()));
@@ -87,16 +90,10 @@ std::unique_ptr<IParser> BaseGenericPluginInstance::parserForUrlTypeName(const Q
     return nullptr;
 }
 
-QByteArray BaseGenericPluginInstance::save(IMutableGraph& graph, Progressable& progressable) const
+QByteArray BaseGenericPluginInstance::save(IMutableGraph&, Progressable&) const
 {
-    json jsonObject;
-
-    progressable.setProgress(-1);
-
-    jsonObject["userNodeData"] = _userNodeData.save(graph, graph.nodeIds(), progressable);
-    jsonObject["userEdgeData"] = _userEdgeData.save(graph, graph.edgeIds(), progressable);
-
-    return QByteArray::fromStdString(jsonObject.dump());
+    // Everything is in the sections
+    return QByteArray::fromStdString(json::object().dump());
 }
 
 bool BaseGenericPluginInstance::load(const QByteArray& data, int /*dataVersion*/,
@@ -112,6 +109,9 @@ bool BaseGenericPluginInstance::load(const QByteArray& data, int /*dataVersion*/
 
     parser.setProgress(-1);
 
+    if(_userDataInSections)
+        return true;
+
     if(!u::contains(jsonObject, "userNodeData") || !jsonObject["userNodeData"].is_object())
         return false;
 
@@ -129,6 +129,63 @@ bool BaseGenericPluginInstance::load(const QByteArray& data, int /*dataVersion*/
     return true;
 }
 
+bool BaseGenericPluginInstance::saveSections(IMutableGraph& graph, Progressable& progressable,
+                                             const SaveSectionFn& saveSection) const
+{
+    QByteArray userNodeData;
+    QDataStream userNodeDataStream(&userNodeData, QIODevice::WriteOnly);
+    NativeFormat::initialiseStream(userNodeDataStream, QDataStream::DoublePrecision);
+
+    graph.setPhase(QObject::tr("Node Data"));
+    _userNodeData.save(userNodeDataStream, graph.nodeIds(), progressable);
+
+    if(!saveSection(QStringLiteral("userNodeData"), userNodeData))
+        return false;
+
+    // Written, so no need to keep it
+    userNodeData.clear();
+
+    QByteArray userEdgeData;
+    QDataStream userEdgeDataStream(&userEdgeData, QIODevice::WriteOnly);
+    NativeFormat::initialiseStream(userEdgeDataStream, QDataStream::DoublePrecision);
+
+    graph.setPhase(QObject::tr("Edge Data"));
+    _userEdgeData.save(userEdgeDataStream, graph.edgeIds(), progressable);
+
+    return saveSection(QStringLiteral("userEdgeData"), userEdgeData);
+}
+
+bool BaseGenericPluginInstance::loadSections(const std::map<QString, QByteArray>& sections, int /*dataVersion*/,
+                                             IMutableGraph& graph, IParser& parser)
+{
+    _userDataInSections = false;
+
+    // Older files have the user data in the JSON instead
+    if(!u::contains(sections, QStringLiteral("userNodeData")) ||
+        !u::contains(sections, QStringLiteral("userEdgeData")))
+    {
+        return sections.empty();
+    }
+
+    QDataStream userNodeDataStream(sections.at(QStringLiteral("userNodeData")));
+    NativeFormat::initialiseStream(userNodeDataStream, QDataStream::DoublePrecision);
+
+    graph.setPhase(QObject::tr("Node Data"));
+    if(!_userNodeData.load(userNodeDataStream, parser))
+        return false;
+
+    QDataStream userEdgeDataStream(sections.at(QStringLiteral("userEdgeData")));
+    NativeFormat::initialiseStream(userEdgeDataStream, QDataStream::DoublePrecision);
+
+    graph.setPhase(QObject::tr("Edge Data"));
+    if(!_userEdgeData.load(userEdgeDataStream, parser))
+        return false;
+
+    _userDataInSections = true;
+
+    return true;
+}
+
 QString BaseGenericPluginInstance::selectedNodeNames() const
 {
     QString s;
@@ -165,6 +222,9 @@ void BaseGenericPluginInstance::setHighlightedRows(const QVector<int>& highlight
 
 void BaseGenericPluginInstance::onLoadSuccess()
 {
+    _userNodeData.shrinkToFit();
+    _userEdgeData.shrinkToFit();
+
     _userNodeData.exposeAsAttributes(*graphModel());
     _userEdgeData.exposeAsAttributes(*graphModel());
     _nodeAttributeTableModel.updateColumnNames();
@@ -45,6 +45,9 @@ private:
     UserNodeData _userNodeData;
     UserEdgeData _userEdgeData;
 
+    // Otherwise it's in the JSON passed to load
+    bool _userDataInSections = false;
+
     NodeAttributeTableModel _nodeAttributeTableModel;
     QAbstractTableModel* nodeAttributeTableModel() { return &_nodeAttributeTableModel; }
 
@@ -56,6 +59,12 @@ public:
     QByteArray save(IMutableGraph&, Progressable&) const override;
     bool load(const QByteArray&, int, IMutableGraph&, IParser& parser) override;
 
+    // The user data is saved in binary sections, rather than as JSON
+    bool saveSections(IMutableGraph& graph, Progressable& progressable,
+        const SaveSectionFn& saveSection) const override;
+    bool loadSections(const std::map<QString, QByteArray>& sections, int,
+        IMutableGraph& graph, IParser& parser) override;
+
 private:
     // The rows that are selected in the table view
     QVector<int> _highlightedRows;
@@ -106,6 +106,8 @@ public:
     // Save and restore no state, by default
     QByteArray save(IMutableGraph&, Progressable&) const override { return {}; }
     bool load(const QByteArray&, int, IMutableGraph&, IParser&) override { return true; }
+    bool saveSections(IMutableGraph&, Progressable&, const SaveSectionFn&) const override { return true; }
+    bool loadSections(const std::map<QString, QByteArray>&, int, IMutableGraph&, IParser&) override { return true; }
 
     void setSaveRequired() const { emit saveRequired(); }
 
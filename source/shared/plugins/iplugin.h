@@ -29,6 +29,8 @@
 #include <QStringList>
 #include <QByteArray>
 
+#include <functional>
+#include <map>
 #include <memory>
 
 class IPlugin;
@@ -55,6 +57,15 @@ public:
     virtual bool load(const QByteArray& data, int dataVersion,
         IMutableGraph& mutableGraph, IParser& parser) = 0;
 
+    // Bulky data may instead be saved as sections of their own, which are compressed and read
+    // as the graph is, rather than in the data passed to load; files that predate sections only
+    // have the latter, otherwise loadSections is called first, with whatever sections were saved
+    using SaveSectionFn = std::function<bool(const QString& name, const QByteArray& data)>;
+    virtual bool saveSections(IMutableGraph& mutableGraph, Progressable& progressable,
+        const SaveSectionFn& saveSection) const = 0;
+    virtual bool loadSections(const std::map<QString, QByteArray>& sections, int dataVersion,
+        IMutableGraph& mutableGraph, IParser& parser) = 0;
+
     virtual const IPlugin* plugin() = 0;
 };
 
@@ -24,6 +24,7 @@
 #include "shared/graph/igraphmodel.h"
 #include "shared/graph/igraph.h"
 #include "shared/attributes/iattribute.h"
+#include "shared/attributes/attributecolumn.h"
 #include "shared/attributes/valuetype.h"
 
 #include "shared/utils/container.h"
@@ -145,6 +146,16 @@ void NodeAttributeTableModel::updateColumn(int role, NodeAttributeTableModel::Co
 {
     column.resize(static_cast<size_t>(rowCount()));
 
+    // Held for the duration, and read directly for the nodes it covers
+    std::shared_ptr<const AttributeColumn> attributeColumn;
+
+    if(role == Qt::DisplayRole)
+    {
+        const auto* attribute = _document->graphModel()->attributeByName(columnName);
+        if(attribute != nullptr && attribute->isValid())
+            attributeColumn = attribute->materialise();
+    }
+
     for(size_t row = 0; row < static_cast<size_t>(rowCount()); row++)
     {
         NodeId nodeId = _userNodeData->elementIdForIndex(row);
@@ -159,6 +170,11 @@ void NodeAttributeTableModel::updateColumn(int role, NodeAttributeTableModel::Co
             column[row] = static_cast<int>(nodeId);
         else if(role == Roles::NodeSelectedRole)
             column[row] = _document->selectionManager()->nodeIsSelected(nodeId);
+        else if(attributeColumn != nullptr && attributeColumn->covers(nodeId))
+        {
+            column[row] = !attributeColumn->valueMissingOf(nodeId) ?
+                attributeColumn->valueOf(nodeId) : QVariant();
+        }
         else
             column[row] = dataValue(row, columnName);
     }
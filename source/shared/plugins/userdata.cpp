@@ -75,6 +75,12 @@ void UserData::setValue(size_t index, const QString& name, const QString& value)
     _numValues = std::max(_numValues, userDataVector.numValues());
 }
 
+void UserData::shrinkToFit()
+{
+    for(auto& userDataVector : _userDataVectors)
+        userDataVector.second.shrinkToFit();
+}
+
 QVariant UserData::value(size_t index, const QString& name) const
 {
     auto it = std::find_if(_userDataVectors.begin(), _userDataVectors.end(),
@@ -83,20 +89,19 @@ QVariant UserData::value(size_t index, const QString& name) const
     if(it != _userDataVectors.end())
     {
         const auto& userDataVector = it->second;
-        const auto& stringValue = userDataVector.get(index);
 
         switch(userDataVector.type())
         {
         default:
         case UserDataVector::Type::Unknown:
         case UserDataVector::Type::String:
-            return stringValue;
+            return userDataVector.get(index);
 
         case UserDataVector::Type::Float:
-            return stringValue.toFloat();
+            return userDataVector.floatValueAt(index);
 
         case UserDataVector::Type::Int:
-            return stringValue.toInt();
+            return userDataVector.intValueAt(index);
         }
     }
 
@@ -152,7 +157,7 @@ bool UserData::load(const json& jsonObject, Progressable& progressable)
             return false;
 
         _vectorNames.emplace_back(name);
-        _userDataVectors.emplace_back(std::make_pair(name, userDataVector));
+        _userDataVectors.emplace_back(std::make_pair(name, std::move(userDataVector)));
 
         progressable.setProgress(static_cast<int>((i++ * 100) / vectorsObject.size()));
     }
@@ -164,3 +169,60 @@ bool UserData::load(const json& jsonObject, Progressable& progressable)
 
     return true;
 }
+
+void UserData::save(QDataStream& stream, Progressable& progressable, const std::vector<size_t>& indexes) const
+{
+    int i = 0;
+
+    stream << static_cast<quint32>(_userDataVectors.size());
+    for(const auto& [name, userDataVector] : _userDataVectors)
+    {
+        stream << name;
+        userDataVector.save(stream, indexes);
+        progressable.setProgress((i++ * 100) / static_cast<int>(_userDataVectors.size()));
+    }
+
+    progressable.setProgress(-1);
+}
+
+bool UserData::load(QDataStream& stream, Progressable& progressable)
+{
+    quint32 numVectors = 0;
+    stream >> numVectors;
+
+    // Each vector is at least a name and its header
+    if(stream.status() != QDataStream::Ok ||
+        static_cast<qint64>(numVectors) > stream.device()->bytesAvailable() / 4)
+    {
+        return false;
+    }
+
+    _userDataVectors.clear();
+    _vectorNames.clear();
+    _numValues = 0;
+
+    for(quint32 i = 0; i < numVectors; i++)
+    {
+        QString name;
+        stream >> name;
+
+        if(stream.status() != QDataStream::Ok)
+            return false;
+
+        UserDataVector userDataVector;
+        if(!userDataVector.load(name, stream))
+            return false;
+
+        _vectorNames.emplace_back(name);
+        _userDataVectors.emplace_back(std::make_pair(name, std::move(userDataVector)));
+
+        progressable.setProgress(static_cast<int>((i * 100) / numVectors));
+    }
+
+    progressable.setProgress(-1);
+
+    for(const auto& userDataVector : _userDataVectors)
+        _numValues = std::max(_numValues, userDataVector.second.numValues());
+
+    return true;
+}
@@ -27,6 +27,7 @@
 #include <QString>
 #include <QVariant>
 #include <QSet>
+#include <QDataStream>
 
 #include <json_helper.h>
 
@@ -57,8 +58,14 @@ public:
     void setValue(size_t index, const QString& name, const QString& value);
     QVariant value(size_t index, const QString& name) const;
 
+    // Call once all the values have been set
+    void shrinkToFit();
+
     json save(Progressable& progressable, const std::vector<size_t>& indexes = {}) const;
     bool load(const json& jsonObject, Progressable& progressable);
+
+    void save(QDataStream& stream, Progressable& progressable, const std::vector<size_t>& indexes = {}) const;
+    bool load(QDataStream& stream, Progressable& progressable);
 };
 
 #endif // USERDATA_H
@@ -20,6 +20,48 @@
 
 #include "shared/utils/container.h"
 
+namespace
+{
+// The values are written, in a binary stream, as...
+enum class Encoding : quint8
+{
+    Plain,      // ...strings
+    Dictionary  // ...codes into a table of strings
+};
+
+quint8 typeToByte(UserDataVector::Type type)
+{
+    switch(type)
+    {
+    default:
+    case UserDataVector::Type::Unknown: return 0;
+    case UserDataVector::Type::String:  return 1;
+    case UserDataVector::Type::Int:     return 2;
+    case UserDataVector::Type::Float:   return 3;
+    }
+}
+
+UserDataVector::Type typeFromByte(quint8 byte)
+{
+    switch(byte)
+    {
+    default:
+    case 0: return UserDataVector::Type::Unknown;
+    case 1: return UserDataVector::Type::String;
+    case 2: return UserDataVector::Type::Int;
+    case 3: return UserDataVector::Type::Float;
+    }
+}
+
+// Every count is followed by at least this many bytes per item, so a count that exceeds
+// what remains of the stream is corrupt, and mustn't be used to reserve anything
+bool validCount(QDataStream& stream, quint32 count, qint64 minItemSize = 4)
+{
+    return stream.status() == QDataStream::Ok &&
+        static_cast<qint64>(count) <= stream.device()->bytesAvailable() / minItemSize;
+}
+} // namespace
+
 QStringList UserDataVector::toStringList() const
 {
     QStringList list;
@@ -31,39 +73,67 @@ QStringList UserDataVector::toStringList() const
     return list;
 }
 
-int UserDataVector::numUniqueValues() const
+StringColumn::Code UserDataVector::setValue(size_t index, const QString& value)
 {
-    auto v = _values;
-    std::sort(v.begin(), v.end());
-    auto last = std::unique(v.begin(), v.end());
-    v.erase(last, v.end());
+    auto code = _values.set(index, value);
 
-    return static_cast<int>(v.size());
-}
-
-void UserDataVector::set(size_t index, const QString& value)
-{
-    if(index >= _values.size())
-        _values.resize(index + 1);
+    if(code == StringColumn::NoCode)
+        _conversions = {};
+    else if(code >= _conversions.size())
+    {
+        Conversions conversions;
+        conversions._int = value.toInt();
+        conversions._float = value.toFloat();
+        conversions._double = value.toDouble();
 
-    _values.at(index) = value;
+        _conversions.push_back(conversions);
+    }
 
-    updateType(value);
+    return code;
+}
 
+void UserDataVector::updateRange(int intValue, double floatValue)
+{
     if(type() == Type::Int)
     {
-        int intValue = value.toInt();
         _intMin = std::min(_intMin, intValue);
         _intMax = std::max(_intMax, intValue);
     }
     else if(type() == Type::Float)
     {
-        double floatValue = value.toDouble();
         _floatMin = std::min(_floatMin, floatValue);
         _floatMax = std::max(_floatMax, floatValue);
     }
 }
 
+void UserDataVector::set(size_t index, const QString& value)
+{
+    auto code = setValue(index, value);
+
+    if(code == StringColumn::NoCode)
+    {
+        updateType(value);
+
+        if(type() == Type::Int)
+            updateRange(value.toInt(), 0.0);
+        else if(type() == Type::Float)
+            updateRange(0, value.toDouble());
+
+        return;
+    }
+
+    auto& conversions = _conversions.at(code);
+
+    // Seeing the same value again can't change the type
+    if(!conversions._typed)
+    {
+        updateType(value);
+        conversions._typed = true;
+    }
+
+    updateRange(conversions._int, conversions._double);
+}
+
 QString UserDataVector::get(size_t index) const
 {
     if(index >= _values.size())
@@ -72,6 +142,38 @@ QString UserDataVector::get(size_t index) const
     return _values.at(index);
 }
 
+int UserDataVector::intValueAt(size_t index) const
+{
+    if(index >= _values.size())
+        return 0;
+
+    if(_values.plain())
+        return _values.at(index).toInt();
+
+    return _conversions.at(_values.codeAt(index))._int;
+}
+
+float UserDataVector::floatValueAt(size_t index) const
+{
+    if(index >= _values.size())
+        return 0.0f;
+
+    if(_values.plain())
+        return _values.at(index).toFloat();
+
+    return _conversions.at(_values.codeAt(index))._float;
+}
+
+void UserDataVector::shrinkToFit()
+{
+    _values.shrinkToFit();
+
+    if(_values.plain())
+        _conversions = {};
+    else
+        _conversions.shrink_to_fit();
+}
+
 json UserDataVector::save(const std::vector<size_t>& indexes) const
 {
     json jsonObject;
@@ -112,7 +214,14 @@ json UserDataVector::save(const std::vector<size_t>& indexes) const
         jsonObject["values"] = jsonValues;
     }
     else
-        jsonObject["values"] = _values;
+    {
+        json jsonValues = json::array();
+
+        for(const auto& value : _values)
+            jsonValues.push_back(value);
+
+        jsonObject["values"] = jsonValues;
+    }
 
     return jsonObject;
 }
@@ -155,11 +264,179 @@ bool UserDataVector::load(const QString& name, const json& jsonObject)
         return false;
 
     _values.clear();
-    for(const auto& value : jsonObject["values"])
+    _conversions = {Conversions()};
+
+    const auto& jsonValues = jsonObject["values"];
+    _values.reserve(jsonValues.size());
+
+    // The type and ranges are those that were saved, so the values mustn't alter them
+    size_t index = 0;
+    for(const auto& value : jsonValues)
+        setValue(index++, value.get<QString>());
+
+    shrinkToFit();
+
+    return true;
+}
+
+void UserDataVector::save(QDataStream& stream, const std::vector<size_t>& indexes) const
+{
+    stream << typeToByte(type());
+
+    bool hasIntRange = _intMin != std::numeric_limits<int>::max() && _intMax != std::numeric_limits<int>::lowest();
+    stream << hasIntRange;
+    if(hasIntRange)
+        stream << static_cast<qint32>(_intMin) << static_cast<qint32>(_intMax);
+
+    bool hasFloatRange = _floatMin != std::numeric_limits<double>::max() && _floatMax != std::numeric_limits<double>::lowest();
+    stream << hasFloatRange;
+    if(hasFloatRange)
+        stream << _floatMin << _floatMax;
+
+    auto numValues = !indexes.empty() ? indexes.size() : _values.size();
+
+    if(!_values.plain())
+    {
+        const auto& dictionary = _values.dictionary();
+
+        stream << static_cast<quint8>(Encoding::Dictionary);
+        stream << static_cast<quint32>(dictionary.size());
+        for(const auto& value : dictionary)
+            stream << value;
+
+        stream << static_cast<quint32>(numValues);
+
+        if(!indexes.empty())
+        {
+            for(auto index : indexes)
+            {
+                stream << static_cast<quint32>(index < _values.size() ?
+                    _values.codeAt(index) : StringDictionary::EmptyCode);
+            }
+        }
+        else
+        {
+            for(auto code : _values.codes())
+                stream << static_cast<quint32>(code);
+        }
+    }
+    else
+    {
+        stream << static_cast<quint8>(Encoding::Plain);
+        stream << static_cast<quint32>(numValues);
+
+        if(!indexes.empty())
+        {
+            for(auto index : indexes)
+                stream << (index < _values.size() ? _values.at(index) : QString());
+        }
+        else
+        {
+            for(const auto& value : _values)
+                stream << value;
+        }
+    }
+}
+
+bool UserDataVector::load(const QString& name, QDataStream& stream)
+{
+    _name = name;
+
+    quint8 typeByte = 0;
+    stream >> typeByte;
+    setType(typeFromByte(typeByte));
+
+    bool hasIntRange = false;
+    stream >> hasIntRange;
+    if(hasIntRange)
+    {
+        qint32 intMin = 0;
+        qint32 intMax = 0;
+        stream >> intMin >> intMax;
+
+        _intMin = intMin;
+        _intMax = intMax;
+    }
+
+    bool hasFloatRange = false;
+    stream >> hasFloatRange;
+    if(hasFloatRange)
+        stream >> _floatMin >> _floatMax;
+
+    quint8 encoding = 0;
+    stream >> encoding;
+
+    if(stream.status() != QDataStream::Ok)
+        return false;
+
+    _values.clear();
+    _conversions = {Conversions()};
+
+    // The type and ranges are those that were saved, so the values mustn't alter them
+    switch(static_cast<Encoding>(encoding))
+    {
+    case Encoding::Dictionary:
     {
-        // cppcheck-suppress useStlAlgorithm
-        _values.push_back(value);
+        quint32 tableSize = 0;
+        stream >> tableSize;
+
+        if(!validCount(stream, tableSize))
+            return false;
+
+        std::vector<QString> table(tableSize);
+        for(auto& value : table)
+            stream >> value;
+
+        quint32 numValues = 0;
+        stream >> numValues;
+
+        if(!validCount(stream, numValues))
+            return false;
+
+        _values.reserve(numValues);
+
+        for(quint32 index = 0; index < numValues; index++)
+        {
+            quint32 code = 0;
+            stream >> code;
+
+            if(code >= tableSize)
+                return false;
+
+            setValue(index, table[code]);
+        }
+
+        break;
     }
 
+    case Encoding::Plain:
+    {
+        quint32 numValues = 0;
+        stream >> numValues;
+
+        if(!validCount(stream, numValues))
+            return false;
+
+        _values.reserve(numValues);
+
+        for(quint32 index = 0; index < numValues; index++)
+        {
+            QString value;
+            stream >> value;
+            setValue(index, value);
+        }
+
+        break;
+    }
+
+    default:
+        return false;
+    }
+
+    if(stream.status() != QDataStream::Ok)
+        return false;
+
+    shrinkToFit();
+
     return true;
 }
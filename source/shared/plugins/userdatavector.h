@@ -22,9 +22,12 @@
 #include <QString>
 
 #include "shared/utils/typeidentity.h"
+#include "shared/utils/stringcolumn.h"
 
 #include <json_helper.h>
 
+#include <QDataStream>
+
 #include <vector>
 #include <limits>
 #include <utility>
@@ -36,13 +39,31 @@ class UserDataVector : public TypeIdentity
 private:
     QString _name;
 
-    std::vector<QString> _values;
+    StringColumn _values;
+
+    // The conversions of each distinct value, indexed by its code, so
+    // that the same string isn't reparsed every time it's set or read;
+    // when the values are stored plainly they're converted as needed instead
+    struct Conversions
+    {
+        int _int = 0;
+        float _float = 0.0f;
+        double _double = 0.0;
+
+        // Whether or not the value has been taken into account by updateType
+        bool _typed = false;
+    };
+
+    std::vector<Conversions> _conversions = {Conversions()};
 
     int _intMin = std::numeric_limits<int>::max();
     int _intMax = std::numeric_limits<int>::lowest();
     double _floatMin = std::numeric_limits<double>::max();
     double _floatMax = std::numeric_limits<double>::lowest();
 
+    StringColumn::Code setValue(size_t index, const QString& value);
+    void updateRange(int intValue, double floatValue);
+
 public:
     UserDataVector() = default;
     UserDataVector(const UserDataVector&) = default;
@@ -59,8 +80,9 @@ public:
 
     const QString& name() const { return _name; }
     int numValues() const { return static_cast<int>(_values.size()); }
-    int numUniqueValues() const;
-    void reserve(int size) { _values.reserve(size); }
+    int numUniqueValues() const { return static_cast<int>(_values.numUniqueValues()); }
+    bool hasEmptyValues() const { return _values.hasEmptyValues(); }
+    void reserve(int size) { _values.reserve(static_cast<size_t>(size)); }
 
     int intMin() const { return _intMin; }
     int intMax() const { return _intMax; }
@@ -69,9 +91,19 @@ public:
 
     void set(size_t index, const QString& value);
     QString get(size_t index) const;
+    int intValueAt(size_t index) const;
+    float floatValueAt(size_t index) const;
+
+    // Frees any memory that was only needed while values were being set
+    void shrinkToFit();
 
     json save(const std::vector<size_t>& indexes = {}) const;
     bool load(const QString& name, const json& jsonObject);
+
+    // Values are written as codes into a table of the distinct values, unless they're stored
+    // plainly; stream must use double precision, so that the ranges are preserved
+    void save(QDataStream& stream, const std::vector<size_t>& indexes = {}) const;
+    bool load(const QString& name, QDataStream& stream);
 };
 
 #endif // USERDATAVECTOR_H
@@ -28,8 +28,11 @@
 #include "shared/utils/container.h"
 #include "shared/utils/progressable.h"
 
+#include <QDataStream>
+
 #include <map>
 #include <memory>
+#include <vector>
 
 template<typename E>
 class UserElementData : public UserData
@@ -140,10 +143,7 @@ public:
             default: break;
             }
 
-            bool hasMissingValues = std::any_of(userDataVector.begin(), userDataVector.end(),
-                                                [](const auto& v) { return v.isEmpty(); });
-
-            if(hasMissingValues)
+            if(userDataVector.hasEmptyValues())
             {
                 attribute.setValueMissingFn([this, userDataVectorName](E elementId)
                 {
@@ -204,6 +204,66 @@ public:
 
         return true;
     }
+
+    void save(QDataStream& stream, const std::vector<E>& elementIds, Progressable& progressable) const
+    {
+        std::vector<size_t> indexes;
+        std::vector<E> ids;
+
+        for(auto elementId : elementIds)
+        {
+            auto index = _indexes->at(elementId);
+            if(index._set)
+            {
+                ids.push_back(elementId);
+                indexes.push_back(index._value);
+            }
+        }
+
+        stream << static_cast<quint32>(ids.size());
+        for(auto id : ids)
+            stream << static_cast<qint32>(id);
+
+        UserData::save(stream, progressable, indexes);
+    }
+
+    bool load(QDataStream& stream, Progressable& progressable)
+    {
+        quint32 numIds = 0;
+        stream >> numIds;
+
+        if(stream.status() != QDataStream::Ok ||
+            static_cast<qint64>(numIds) > stream.device()->bytesAvailable() / 4)
+        {
+            return false;
+        }
+
+        std::vector<E> ids;
+        ids.reserve(numIds);
+
+        for(quint32 i = 0; i < numIds; i++)
+        {
+            qint32 id = -1;
+            stream >> id;
+
+            if(stream.status() != QDataStream::Ok || id < 0 || id >= _indexes->size())
+                return false;
+
+            ids.emplace_back(id);
+        }
+
+        if(!UserData::load(stream, progressable))
+            return false;
+
+        _indexes->resetElements();
+        _indexToElementIdMap.clear();
+
+        size_t index = 0;
+        for(auto id : ids)
+            setElementIdForIndex(id, index++);
+
+        return true;
+    }
 };
 
 using UserNodeData = UserElementData<NodeId>;
@@ -0,0 +1,174 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <condition_variable>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <queue>
+
+// A multiple producer, multiple consumer queue of limited capacity; producers block
+// when it is full, consumers block while it is empty, until it is closed
+template<typename T> class BoundedQueue
+{
+private:
+    std::mutex _mutex;
+    std::condition_variable _notFull;
+    std::condition_variable _notEmpty;
+    std::queue<T> _queue;
+    size_t _capacity;
+    bool _closed = false;
+    bool _abandoned = false;
+
+public:
+    explicit BoundedQueue(size_t capacity) :
+        _capacity(capacity > 0 ? capacity : 1)
+    {}
+
+    // Returns false if the queue has been abandoned, in which case value is discarded
+    bool push(T&& value)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _notFull.wait(lock, [this] { return _queue.size() < _capacity || _abandoned; });
+
+        if(_abandoned)
+            return false;
+
+        _queue.push(std::move(value));
+        lock.unlock();
+
+        _notEmpty.notify_one();
+        return true;
+    }
+
+    // Returns false once the queue is closed and has been drained
+    bool pop(T& value)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _notEmpty.wait(lock, [this] { return !_queue.empty() || _closed; });
+
+        if(_queue.empty())
+            return false;
+
+        value = std::move(_queue.front());
+        _queue.pop();
+        lock.unlock();
+
+        _notFull.notify_one();
+        return true;
+    }
+
+    // No more values will be pushed
+    void close()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _closed = true;
+        lock.unlock();
+
+        _notEmpty.notify_all();
+    }
+
+    // The consumer is no longer interested; any queued or future values are discarded
+    void abandon()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _abandoned = true;
+        _queue = {};
+        lock.unlock();
+
+        _notFull.notify_all();
+    }
+};
+
+// A queue of a known number of values, each pushed with its index, that are popped in index
+// order, whatever order they're pushed in; producers block while their index is capacity or more
+// beyond the next to be popped, so the producer of that value must never be waiting to push another
+template<typename T> class OrderedBoundedQueue
+{
+private:
+    std::mutex _mutex;
+    std::condition_variable _canPush;
+    std::condition_variable _canPop;
+    std::map<size_t, T> _values;
+    size_t _size;
+    size_t _capacity;
+    size_t _next = 0;
+    bool _abandoned = false;
+
+public:
+    OrderedBoundedQueue(size_t size, size_t capacity) :
+        _size(size), _capacity(capacity > 0 ? capacity : 1)
+    {}
+
+    // Returns false if the queue has been abandoned, in which case value is discarded
+    bool push(size_t index, T&& value)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _canPush.wait(lock, [this, index] { return index < _next + _capacity || _abandoned; });
+
+        if(_abandoned)
+            return false;
+
+        _values.emplace(index, std::move(value));
+        bool isNext = index == _next;
+        lock.unlock();
+
+        if(isNext)
+            _canPop.notify_one();
+
+        return true;
+    }
+
+    // Returns false once all size values have been popped
+    bool pop(T& value)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        if(_next >= _size)
+            return false;
+
+        _canPop.wait(lock, [this] { return _values.count(_next) > 0; });
+
+        auto it = _values.find(_next);
+        value = std::move(it->second);
+        _values.erase(it);
+        _next++;
+        lock.unlock();
+
+        // Each producer is waiting for a different index
+        _canPush.notify_all();
+        return true;
+    }
+
+    // The consumer is no longer interested; any queued or future values are discarded
+    void abandon()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _abandoned = true;
+        _values.clear();
+        lock.unlock();
+
+        _canPush.notify_all();
+    }
+};
+
+#endif // BOUNDEDQUEUE_H
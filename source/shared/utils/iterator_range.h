@@ -21,6 +21,7 @@
 
 #include <type_traits>
 #include <utility>
+#include <iterator>
 
 template<typename Iterator>
 struct is_const_iterator
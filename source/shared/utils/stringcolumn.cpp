@@ -0,0 +1,158 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "stringcolumn.h"
+
+#include <QSet>
+
+#include <algorithm>
+
+void StringColumn::storePlainly()
+{
+    std::vector<QString> values;
+    values.reserve(_codes.capacity());
+
+    // The copies share their data with the dictionary's, so this costs a pointer per value
+    for(auto code : _codes)
+        values.push_back(_dictionary.valueOf(code));
+
+    _values = std::move(values);
+    _codes = {};
+    _dictionary.clear();
+    _dictionary.compact();
+    _plain = true;
+}
+
+void StringColumn::reserve(size_t size)
+{
+    if(!_plain)
+        _codes.reserve(size);
+    else
+        _values.reserve(size);
+}
+
+void StringColumn::resize(size_t size)
+{
+    if(!_plain)
+        _codes.resize(size, StringDictionary::EmptyCode);
+    else
+        _values.resize(size);
+}
+
+StringColumn::Code StringColumn::set(size_t index, const QString& value)
+{
+    if(index >= size())
+        resize(index + 1);
+
+    _numSets++;
+
+    if(_plain)
+    {
+        _values[index] = value;
+        return NoCode;
+    }
+
+    auto code = _dictionary.add(value);
+    _codes[index] = code;
+
+    // Each time the dictionary doubles in size, check whether most of what's been set is distinct
+    auto dictionarySize = _dictionary.size();
+    if(code + 1 == dictionarySize && dictionarySize >= MinimumPlainValues &&
+        (dictionarySize & (dictionarySize - 1)) == 0 && dictionarySize * 2 > _numSets)
+    {
+        storePlainly();
+        return NoCode;
+    }
+
+    return code;
+}
+
+void StringColumn::move(size_t from, size_t to)
+{
+    if(from == to)
+        return;
+
+    if(!_plain)
+    {
+        _codes.at(to) = _codes.at(from);
+        _codes.at(from) = StringDictionary::EmptyCode;
+    }
+    else
+    {
+        _values.at(to) = std::move(_values.at(from));
+        _values.at(from) = QString();
+    }
+}
+
+size_t StringColumn::numUniqueValues() const
+{
+    if(_plain)
+    {
+        QSet<QString> values;
+        for(const auto& value : _values)
+            values.insert(value);
+
+        return static_cast<size_t>(values.size());
+    }
+
+    // Values that have since been overwritten may remain in the dictionary, so only count those in use
+    std::vector<bool> used(_dictionary.size(), false);
+    size_t numUsed = 0;
+
+    for(auto code : _codes)
+    {
+        if(!used[code])
+        {
+            used[code] = true;
+            numUsed++;
+        }
+    }
+
+    return numUsed;
+}
+
+bool StringColumn::hasEmptyValues() const
+{
+    if(_plain)
+        return std::any_of(_values.begin(), _values.end(), [](const auto& value) { return value.isEmpty(); });
+
+    return std::find(_codes.begin(), _codes.end(), StringDictionary::EmptyCode) != _codes.end();
+}
+
+void StringColumn::shrinkToFit()
+{
+    if(!_plain)
+    {
+        auto numValues = numUniqueValues();
+        if(numValues >= MinimumPlainValues && numValues * 2 > _codes.size())
+            storePlainly();
+    }
+
+    _codes.shrink_to_fit();
+    _values.shrink_to_fit();
+    _dictionary.compact();
+}
+
+void StringColumn::clear()
+{
+    _codes.clear();
+    _dictionary.clear();
+    _values.clear();
+    _plain = false;
+    _numSets = 0;
+}
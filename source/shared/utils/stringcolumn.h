@@ -0,0 +1,121 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STRINGCOLUMN_H
+#define STRINGCOLUMN_H
+
+#include "shared/utils/stringdictionary.h"
+
+#include <QString>
+
+#include <vector>
+#include <iterator>
+#include <cstddef>
+#include <limits>
+
+// A sequence of strings, stored as codes into a dictionary of the distinct values, so that
+// columns of categorical data take a few bytes per value, regardless of how long the values are;
+// once most of the values are distinct the dictionary costs more than it saves, so from then
+// on the values are stored plainly instead
+class StringColumn
+{
+public:
+    using Code = StringDictionary::Code;
+
+    // Returned by set when the values are stored plainly, and so have no codes
+    static constexpr Code NoCode = std::numeric_limits<Code>::max();
+
+    class Iterator
+    {
+    private:
+        const StringColumn* _column = nullptr;
+        size_t _index = 0;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = QString;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const QString*;
+        using reference = const QString&;
+
+        Iterator() = default;
+        Iterator(const StringColumn* column, size_t index) :
+            _column(column), _index(index)
+        {}
+
+        reference operator*() const { return _column->at(_index); }
+        pointer operator->() const { return &_column->at(_index); }
+
+        Iterator& operator++() { ++_index; return *this; }
+        Iterator operator++(int) { auto copy = *this; ++_index; return copy; }
+
+        bool operator==(const Iterator& other) const { return _index == other._index; }
+        bool operator!=(const Iterator& other) const { return _index != other._index; }
+    };
+
+private:
+    // Fewer distinct values than this aren't worth storing plainly, however few repeats there are
+    static constexpr size_t MinimumPlainValues = 4096;
+
+    StringDictionary _dictionary;
+    std::vector<Code> _codes;
+
+    bool _plain = false;
+    std::vector<QString> _values;
+
+    size_t _numSets = 0;
+
+    void storePlainly();
+
+public:
+    Iterator begin() const { return {this, 0}; }
+    Iterator end() const { return {this, size()}; }
+
+    size_t size() const { return !_plain ? _codes.size() : _values.size(); }
+    bool empty() const { return size() == 0; }
+    size_t capacity() const { return !_plain ? _codes.capacity() : _values.capacity(); }
+
+    void reserve(size_t size);
+    void resize(size_t size);
+
+    // Sets the value at index, growing the column if necessary, and returns its code
+    Code set(size_t index, const QString& value);
+
+    // Moves the value at from to to, leaving an empty value behind
+    void move(size_t from, size_t to);
+
+    const QString& at(size_t index) const
+    {
+        return !_plain ? _dictionary.valueOf(_codes.at(index)) : _values.at(index);
+    }
+
+    bool plain() const { return _plain; }
+
+    // The codes and dictionary are empty once the values are stored plainly
+    Code codeAt(size_t index) const { return _codes.at(index); }
+    const StringDictionary& dictionary() const { return _dictionary; }
+    const std::vector<Code>& codes() const { return _codes; }
+
+    size_t numUniqueValues() const;
+    bool hasEmptyValues() const;
+
+    void shrinkToFit();
+    void clear();
+};
+
+#endif // STRINGCOLUMN_H
@@ -0,0 +1,57 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "stringdictionary.h"
+
+StringDictionary::StringDictionary()
+{
+    clear();
+}
+
+StringDictionary::Code StringDictionary::add(const QString& value)
+{
+    if(static_cast<size_t>(_codes.size()) != _values.size())
+    {
+        _codes.reserve(static_cast<int>(_values.size()));
+
+        for(size_t code = 0; code < _values.size(); code++)
+            _codes.insert(_values[code], static_cast<Code>(code));
+    }
+
+    auto it = _codes.find(value);
+    if(it != _codes.end())
+        return it.value();
+
+    auto code = static_cast<Code>(_values.size());
+    _codes.insert(value, code);
+    _values.push_back(value);
+
+    return code;
+}
+
+void StringDictionary::compact()
+{
+    _codes = {};
+    _values.shrink_to_fit();
+}
+
+void StringDictionary::clear()
+{
+    _values = {QString()};
+    _codes = {{QString(), EmptyCode}};
+}
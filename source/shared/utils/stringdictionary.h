@@ -0,0 +1,60 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STRINGDICTIONARY_H
+#define STRINGDICTIONARY_H
+
+#include <QString>
+#include <QHash>
+
+#include <vector>
+#include <cstdint>
+
+// A table of distinct strings, each of which is identified by a code, so that a collection
+// of strings with many repeats can be stored as codes, and two strings from the same
+// dictionary are equal if and only if their codes are
+class StringDictionary
+{
+public:
+    using Code = uint32_t;
+
+    // The empty string is always present, so that zero initialised codes refer to it
+    static constexpr Code EmptyCode = 0;
+
+private:
+    std::vector<QString> _values;
+    QHash<QString, Code> _codes;
+
+public:
+    StringDictionary();
+
+    // Returns the code of value, adding it if it isn't already present
+    Code add(const QString& value);
+
+    const QString& valueOf(Code code) const { return _values[code]; }
+    size_t size() const { return _values.size(); }
+
+    auto begin() const { return _values.begin(); }
+    auto end() const { return _values.end(); }
+
+    // Frees the memory used to look up codes, which is rebuilt if anything is added later
+    void compact();
+    void clear();
+};
+
+#endif // STRINGDICTIONARY_H
@@ -20,9 +20,15 @@
 
 #include "thread.h"
 
+thread_local const ThreadPool* ThreadPool::_inlineNestingPool = nullptr;
+thread_local size_t ThreadPool::_inlineNestingIndex = 0;
+
 ThreadPool::ThreadPool(const QString& threadNamePrefix, unsigned int numThreads) :
     _stop(false), _activeThreads(0)
 {
+    // hardware_concurrency() may be 0 if it can't be determined
+    numThreads = std::max(numThreads, 1u);
+
     for(unsigned int i = 0U; i < numThreads; i++)
     {
         _threads.emplace_back([threadNamePrefix, i, this]
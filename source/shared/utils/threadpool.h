@@ -49,6 +49,35 @@ private:
     std::atomic<bool> _stop;
     std::atomic<int> _activeThreads;
 
+    // Set on a worker thread while it executes part of a concurrent_for that allows
+    // nested calls to run inline, along with the index it was given by that call
+    static thread_local const ThreadPool* _inlineNestingPool;
+    static thread_local size_t _inlineNestingIndex;
+
+    class InlineNestingScope
+    {
+    private:
+        const ThreadPool* _previousPool;
+        size_t _previousIndex;
+
+    public:
+        InlineNestingScope(const ThreadPool* threadPool, size_t index) :
+            _previousPool(_inlineNestingPool), _previousIndex(_inlineNestingIndex)
+        {
+            _inlineNestingPool = threadPool;
+            _inlineNestingIndex = index;
+        }
+
+        ~InlineNestingScope()
+        {
+            _inlineNestingPool = _previousPool;
+            _inlineNestingIndex = _previousIndex;
+        }
+
+        InlineNestingScope(const InlineNestingScope&) = delete;
+        InlineNestingScope& operator=(const InlineNestingScope&) = delete;
+    };
+
 public:
     explicit ThreadPool(const QString& threadNamePrefix = QStringLiteral("Worker"),
         unsigned int numThreads = std::thread::hardware_concurrency());
@@ -60,6 +89,9 @@ public:
     ThreadPool& operator=(ThreadPool&& other) = delete;
 
     bool saturated() const { return _activeThreads >= static_cast<int>(_threads.size()); }
+
+    // The thread indexes concurrent_for passes to its function are always less than this
+    size_t numThreads() const { return _threads.size(); }
     bool idle() const { return _activeThreads == 0; }
 
     template<typename Fn, typename... Args> using ReturnType = typename std::invoke_result_t<Fn, Args...>;
@@ -100,6 +132,9 @@ private:
     {
     protected:
         mutable std::vector<ResultsVectorOrVoid> _values;
+
+        // The workers write their results here, one entry per chunk, in iteration order
+        mutable std::shared_ptr<std::vector<ResultsVectorOrVoid>> _chunkValues;
     };
 
     template<typename ResultsVectorOrVoid> class ResultsType : public ResultMember<ResultsVectorOrVoid>
@@ -107,9 +142,9 @@ private:
         friend class ThreadPool;
 
     private:
-        mutable std::vector<std::future<ResultsVectorOrVoid>> _futures;
+        mutable std::vector<std::future<void>> _futures;
 
-        explicit ResultsType(std::vector<std::future<ResultsVectorOrVoid>>&& futures) :
+        explicit ResultsType(std::vector<std::future<void>>&& futures) :
             _futures(std::move(futures))
         {}
 
@@ -118,10 +153,22 @@ private:
         {
             for(auto& future : _futures)
             {
-                future.wait();
+                if(!future.valid())
+                    continue;
 
                 if constexpr(!std::is_void_v<ResultsVectorOrVoid>)
-                    this->_values.emplace_back(std::move(future.get()));
+                    future.get();
+                else
+                    future.wait();
+            }
+
+            if constexpr(!std::is_void_v<ResultsVectorOrVoid>)
+            {
+                if(this->_chunkValues != nullptr)
+                {
+                    this->_values = std::move(*this->_chunkValues);
+                    this->_chunkValues.reset();
+                }
             }
         }
 
@@ -467,6 +514,103 @@ private:
         }
     };
 
+    // Each worker owns a contiguous range of chunk indices; the owner pops from the front
+    // of its range, whereas idle workers steal the back half of another worker's range
+    // The range is packed into a single word so that both operations are a single CAS
+    class alignas(64) ChunkDeque
+    {
+    private:
+        std::atomic<uint64_t> _range{0};
+
+        static uint64_t pack(uint32_t front, uint32_t back)
+        {
+            return (static_cast<uint64_t>(front) << 32) | back;
+        }
+
+        static uint32_t front(uint64_t range) { return static_cast<uint32_t>(range >> 32); }
+        static uint32_t back(uint64_t range) { return static_cast<uint32_t>(range); }
+
+    public:
+        void reset(size_t front, size_t back)
+        {
+            _range = pack(static_cast<uint32_t>(front), static_cast<uint32_t>(back));
+        }
+
+        bool pop(size_t& chunk)
+        {
+            auto range = _range.load();
+            while(front(range) < back(range))
+            {
+                if(_range.compare_exchange_weak(range, pack(front(range) + 1, back(range))))
+                {
+                    chunk = front(range);
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        // On success, chunk is the first of the stolen chunks and [chunk + 1, stolenBack)
+        // are the remaining stolen chunks, which the thief should adopt as its own range
+        bool steal(size_t& chunk, size_t& stolenBack)
+        {
+            auto range = _range.load();
+            while(front(range) < back(range))
+            {
+                auto remaining = back(range) - front(range);
+                auto newBack = back(range) - ((remaining + 1) / 2);
+
+                if(_range.compare_exchange_weak(range, pack(front(range), newBack)))
+                {
+                    chunk = newBack;
+                    stolenBack = back(range);
+                    return true;
+                }
+            }
+
+            return false;
+        }
+    };
+
+    template<typename It, typename ResultsVectorOrVoid>
+    struct ConcurrentForState
+    {
+        // Chunk i covers [_boundaries[i], _boundaries[i + 1])
+        std::vector<It> _boundaries;
+        std::vector<ChunkDeque> _deques;
+
+        size_t numChunks() const { return _boundaries.size() - 1; }
+
+        bool nextChunk(size_t workerIndex, size_t& chunk)
+        {
+            if(_deques[workerIndex].pop(chunk))
+                return true;
+
+            const auto numWorkers = _deques.size();
+            for(size_t offset = 1; offset < numWorkers; offset++)
+            {
+                auto& victim = _deques[(workerIndex + offset) % numWorkers];
+
+                size_t stolenBack = 0;
+                if(victim.steal(chunk, stolenBack))
+                {
+                    // Our own deque is empty at this point, so it's safe to refill it
+                    _deques[workerIndex].reset(chunk + 1, stolenBack);
+                    return true;
+                }
+            }
+
+            return false;
+        }
+    };
+
+    // Elements are grouped into chunks of roughly equal cost; more chunks allow finer grained
+    // balancing when the cost of elements is skewed, but each chunk has some scheduling
+    // overhead, so cheap ranges are split into fewer chunks, down to one per thread
+    static constexpr uint64_t MaxChunksPerThread = 16;
+    static constexpr uint64_t MinimumChunkCost = 64;
+
 public:
     template<typename It, typename Fn> using Results =
         ResultsType<typename Executor<It, Fn>::ResultsVectorOrVoid>;
@@ -477,15 +621,21 @@ public:
         NonBlocking
     };
 
-    template<typename It, typename Fn>
-    auto concurrent_for(It first, It last, Fn f, ResultsPolicy resultsPolicy = Blocking)
+    // Determines what happens when f itself calls concurrent_for on the same pool;
+    // NestedInline runs the nested call inline, passing it the thread index of the
+    // enclosing call, which avoids the workers blocking on tasks queued behind them
+    enum NestingPolicy
     {
-        Coster<It> coster(first, last);
+        NestedDispatch,
+        NestedInline
+    };
 
-        const auto totalCost = coster.total(); Q_ASSERT(totalCost > 0);
-        const auto numThreads = static_cast<int>(_threads.size());
-        const auto costPerThread = totalCost / numThreads +
-                ((totalCost % numThreads) ? 1 : 0);
+    template<typename It, typename Fn>
+    auto concurrent_for(It first, It last, Fn f, ResultsPolicy resultsPolicy = Blocking,
+        NestingPolicy nestingPolicy = NestedDispatch)
+    {
+        using ResultsVectorOrVoid = typename Executor<It, Fn>::ResultsVectorOrVoid;
+        using State = ConcurrentForState<It, ResultsVectorOrVoid>;
 
         static_assert(std::is_convertible_v<FirstArgumentType<Fn>, It> ||
             std::is_convertible_v<FirstArgumentType<Fn>, typename It::value_type>,
@@ -494,35 +644,93 @@ public:
         static_assert(function_traits<Fn>::arity == 1 || HasThreadIndexArgument<Fn>,
             "Fn's (optional) second index argument must be size_t");
 
-        Executor<It, Fn> executor;
-        std::vector<std::future<typename Executor<It, Fn>::ResultsVectorOrVoid>> futures;
-        size_t threadIndex = 0;
+        if(_inlineNestingPool == this)
+        {
+            Executor<It, Fn> executor;
+            executor.setIndex(_inlineNestingIndex);
+            auto results = Results<It, Fn>(std::vector<std::future<void>>{});
+
+            if constexpr(!std::is_void_v<ResultsVectorOrVoid>)
+                results._values.emplace_back(executor(first, last, f));
+            else
+                executor(first, last, f);
+
+            return results;
+        }
+
+        Coster<It> coster(first, last);
+
+        const auto totalCost = coster.total(); Q_ASSERT(totalCost > 0);
+        const auto numThreads = static_cast<uint64_t>(_threads.size());
+        const auto targetNumChunks = std::clamp(totalCost / MinimumChunkCost,
+            numThreads, numThreads * MaxChunksPerThread);
+        const auto costPerChunk = totalCost / targetNumChunks +
+                ((totalCost % targetNumChunks) ? 1 : 0);
+
+        auto state = std::make_shared<State>();
+        state->_boundaries.emplace_back(first);
 
         for(It it = first; it != last;)
         {
-            It threadLast = it;
             uint64_t cost = 0;
             do
             {
-                cost += coster(threadLast);
-                ++threadLast;
+                cost += coster(it);
+                ++it;
             }
-            while(threadLast != last && cost < costPerThread);
+            while(it != last && cost < costPerChunk);
 
-            Q_ASSERT(threadIndex < _threads.size());
+            state->_boundaries.emplace_back(it);
+        }
 
-            futures.emplace_back(makeFuture([executor, it, threadLast, f, threadIndex]() mutable
+        const auto numChunks = state->numChunks();
+        const auto numWorkers = std::min(static_cast<size_t>(numThreads), numChunks);
+
+        // Initially give each worker an equal share of contiguous chunks
+        state->_deques = std::vector<ChunkDeque>(numWorkers);
+        for(size_t workerIndex = 0; workerIndex < numWorkers; workerIndex++)
+        {
+            state->_deques[workerIndex].reset(
+                (workerIndex * numChunks) / numWorkers,
+                ((workerIndex + 1) * numChunks) / numWorkers);
+        }
+
+        std::shared_ptr<std::vector<ResultsVectorOrVoid>> chunkValues;
+        if constexpr(!std::is_void_v<ResultsVectorOrVoid>)
+            chunkValues = std::make_shared<std::vector<ResultsVectorOrVoid>>(numChunks);
+
+        Executor<It, Fn> executor;
+        std::vector<std::future<void>> futures;
+
+        for(size_t workerIndex = 0; workerIndex < numWorkers; workerIndex++)
+        {
+            // Each worker gets its own copy of f, as before
+            futures.emplace_back(makeFuture([this, executor, state, chunkValues, f,
+                workerIndex, nestingPolicy]() mutable
             {
-                executor.setIndex(threadIndex);
-                return executor(it, threadLast, f);
-            }));
+                executor.setIndex(workerIndex);
+                InlineNestingScope inlineNestingScope(
+                    nestingPolicy == NestedInline ? this : nullptr, workerIndex);
 
-            it = threadLast;
-            threadIndex++;
+                size_t chunk = 0;
+                while(state->nextChunk(workerIndex, chunk))
+                {
+                    const auto& chunkFirst = state->_boundaries[chunk];
+                    const auto& chunkLast = state->_boundaries[chunk + 1];
+
+                    if constexpr(!std::is_void_v<ResultsVectorOrVoid>)
+                        (*chunkValues)[chunk] = executor(chunkFirst, chunkLast, f);
+                    else
+                        executor(chunkFirst, chunkLast, f);
+                }
+            }));
         }
 
         auto results = Results<It, Fn>(std::move(futures));
 
+        if constexpr(!std::is_void_v<ResultsVectorOrVoid>)
+            results._chunkValues = std::move(chunkValues);
+
         if(resultsPolicy == Blocking)
             results.wait();
 
@@ -539,9 +747,16 @@ auto execute_on_threadpool(Fn&& f, Args&&... args)
 }
 
 template<typename It, typename Fn>
-auto concurrent_for(It first, It last, Fn&& f, ThreadPool::ResultsPolicy resultsPolicy = ThreadPool::Blocking)
+auto concurrent_for(It first, It last, Fn&& f, ThreadPool::ResultsPolicy resultsPolicy = ThreadPool::Blocking,
+    ThreadPool::NestingPolicy nestingPolicy = ThreadPool::NestedDispatch)
+{
+    return S(ThreadPoolSingleton)->concurrent_for(first, last, std::forward<Fn>(f),
+        resultsPolicy, nestingPolicy);
+}
+
+inline size_t concurrent_for_num_threads()
 {
-    return S(ThreadPoolSingleton)->concurrent_for(first, last, std::forward<Fn>(f), resultsPolicy);
+    return S(ThreadPoolSingleton)->numThreads();
 }
 
 #endif // THREADPOOL_H
@@ -20,6 +20,15 @@
 
 #include <QCoreApplication>
 
+#if defined(__linux__)
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <sys/types.h>
+#include <sys/sysctl.h>
+#endif
+
 int u::smallestPowerOf2GreaterThan(int x)
 {
     if(x < 0)
@@ -53,3 +62,28 @@ static void initQtResources()
 }
 
 Q_COREAPP_STARTUP_FUNCTION(initQtResources)
+
+uint64_t u::physicalMemory()
+{
+#if defined(__linux__)
+    auto numPages = sysconf(_SC_PHYS_PAGES);
+    auto pageSize = sysconf(_SC_PAGE_SIZE);
+
+    if(numPages > 0 && pageSize > 0)
+        return static_cast<uint64_t>(numPages) * static_cast<uint64_t>(pageSize);
+#elif defined(_WIN32)
+    MEMORYSTATUSEX memoryStatus;
+    memoryStatus.dwLength = sizeof(memoryStatus);
+
+    if(GlobalMemoryStatusEx(&memoryStatus))
+        return static_cast<uint64_t>(memoryStatus.ullTotalPhys);
+#elif defined(__APPLE__)
+    uint64_t memSize = 0;
+    size_t length = sizeof(memSize);
+
+    if(sysctlbyname("hw.memsize", &memSize, &length, nullptr, 0) == 0)
+        return memSize;
+#endif
+
+    return 0;
+}
@@ -22,6 +22,7 @@
 #include "constants.h"
 
 #include <cmath>
+#include <cstdint>
 #include <QString>
 
 namespace u
@@ -56,6 +57,9 @@ namespace u
     }
 
     float normaliseAngle(float radians);
+
+    // In bytes, or 0 if it can't be determined
+    uint64_t physicalMemory();
 } // namespace u
 
 #endif // UTILS_H
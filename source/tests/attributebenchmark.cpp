@@ -0,0 +1,141 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "attributes/attribute.h"
+#include "graph/mutablegraph.h"
+
+#include "shared/attributes/attributecolumn.h"
+#include "shared/utils/threadpool.h"
+
+#include <QtTest>
+
+#include <vector>
+
+// Times reading the value of every node concurrently, through the value function, as
+// before there were snapshots, and through a snapshot, read per call, held by a copy of
+// the attribute, as condition functions do, and held by the reader itself
+class AttributeBenchmark : public QObject
+{
+    Q_OBJECT
+
+private:
+    ThreadPoolSingleton _threadPool;
+
+private slots:
+    void read_data();
+    void read();
+};
+
+namespace
+{
+enum class ReadBy
+{
+    ValueFunction,
+    PerCall,
+    HeldCopy,
+    Column
+};
+} // namespace
+
+Q_DECLARE_METATYPE(ReadBy)
+
+void AttributeBenchmark::read_data()
+{
+    QTest::addColumn<int>("numNodes");
+    QTest::addColumn<ReadBy>("readBy");
+
+    for(auto [numNodes, name] : {std::make_pair(100000, "100k"), std::make_pair(1000000, "1M")})
+    {
+        auto rowName = [name = name](const char* description)
+        {
+            return QByteArray(name) + ", " + description;
+        };
+
+        QTest::newRow(rowName("value function").constData()) << numNodes << ReadBy::ValueFunction;
+        QTest::newRow(rowName("per call").constData()) << numNodes << ReadBy::PerCall;
+        QTest::newRow(rowName("held copy").constData()) << numNodes << ReadBy::HeldCopy;
+        QTest::newRow(rowName("column").constData()) << numNodes << ReadBy::Column;
+    }
+}
+
+void AttributeBenchmark::read()
+{
+    QFETCH(int, numNodes);
+    QFETCH(ReadBy, readBy);
+
+    MutableGraph graph;
+    graph.bulkAddNodes(static_cast<size_t>(numNodes));
+
+    std::vector<double> values(static_cast<size_t>(numNodes));
+    for(size_t i = 0; i < values.size(); i++)
+        values[i] = static_cast<double>(i) * 0.5;
+
+    Attribute attribute;
+    attribute.setFloatValueFn([&values](NodeId nodeId) { return values[static_cast<size_t>(static_cast<int>(nodeId))]; });
+
+    if(readBy != ReadBy::ValueFunction)
+        attribute.setMaterialisable(graph);
+
+    std::vector<double> read(values.size());
+    const auto& nodeIds = graph.nodeIds();
+
+    QBENCHMARK
+    {
+        switch(readBy)
+        {
+        case ReadBy::ValueFunction:
+        case ReadBy::PerCall:
+            attribute.materialise();
+            concurrent_for(nodeIds.begin(), nodeIds.end(), [&](NodeId nodeId)
+            {
+                read[static_cast<size_t>(static_cast<int>(nodeId))] = attribute.floatValueOf(nodeId);
+            });
+            break;
+
+        case ReadBy::HeldCopy:
+        {
+            Attribute copy(attribute);
+            copy.holdColumn();
+
+            concurrent_for(nodeIds.begin(), nodeIds.end(), [&](NodeId nodeId)
+            {
+                read[static_cast<size_t>(static_cast<int>(nodeId))] = copy.floatValueOf(nodeId);
+            });
+            break;
+        }
+
+        case ReadBy::Column:
+        {
+            auto column = attribute.materialise();
+            QVERIFY(column != nullptr);
+
+            concurrent_for(nodeIds.begin(), nodeIds.end(), [&](NodeId nodeId)
+            {
+                read[static_cast<size_t>(static_cast<int>(nodeId))] = column->floatValueOf(nodeId);
+            });
+            break;
+        }
+        }
+    }
+
+    QVERIFY(attribute.isMaterialised() == (readBy != ReadBy::ValueFunction));
+    QVERIFY(read == values);
+}
+
+QTEST_APPLESS_MAIN(AttributeBenchmark)
+#include "attributebenchmark.moc"
@@ -0,0 +1,214 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "attributes/attribute.h"
+#include "shared/attributes/attributecolumn.h"
+#include "graph/mutablegraph.h"
+
+#include "shared/utils/threadpool.h"
+
+#include <QtTest>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+class AttributeColumnTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    ThreadPoolSingleton _threadPool;
+
+private slots:
+    void values();
+    void snapshot();
+    void concurrentDematerialise();
+};
+
+void AttributeColumnTest::values()
+{
+    AttributeColumn intColumn(ElementType::Node, ValueType::Int, 4);
+    intColumn.setValue(NodeId(0), 7);
+    intColumn.setValue(NodeId(2), -3);
+    intColumn.setValueMissing(NodeId(2));
+    intColumn.finalise();
+
+    QVERIFY(intColumn.covers<int>(NodeId(0)));
+    QVERIFY(!intColumn.covers<int>(NodeId(1)));
+    QVERIFY(!intColumn.covers<int>(NodeId(4)));
+    QVERIFY(!intColumn.covers<double>(NodeId(0)));
+    QVERIFY(!intColumn.covers<int>(EdgeId(0)));
+    QCOMPARE(intColumn.intValueOf(NodeId(0)), 7);
+    QCOMPARE(intColumn.intValueOf(NodeId(2)), -3);
+    QVERIFY(!intColumn.valueMissingOf(NodeId(0)));
+    QVERIFY(intColumn.valueMissingOf(NodeId(2)));
+
+    AttributeColumn floatColumn(ElementType::Edge, ValueType::Float, 2);
+    floatColumn.setValue(EdgeId(1), 0.5);
+    floatColumn.finalise();
+
+    QVERIFY(floatColumn.covers<double>(EdgeId(1)));
+    QVERIFY(!floatColumn.covers<double>(NodeId(1)));
+    QCOMPARE(floatColumn.floatValueOf(EdgeId(1)), 0.5);
+    QVERIFY(!floatColumn.valueMissingOf(EdgeId(1)));
+
+    AttributeColumn stringColumn(ElementType::Node, ValueType::String, 3);
+    stringColumn.setValue(NodeId(0), QStringLiteral("alpha"));
+    stringColumn.setValue(NodeId(1), QStringLiteral("beta"));
+    stringColumn.setValue(NodeId(2), QStringLiteral("alpha"));
+    stringColumn.finalise();
+
+    QVERIFY(stringColumn.covers<QString>(NodeId(1)));
+    QCOMPARE(stringColumn.stringValueOf(NodeId(0)), QStringLiteral("alpha"));
+    QCOMPARE(stringColumn.stringValueOf(NodeId(1)), QStringLiteral("beta"));
+
+    // Repeated values are stored once
+    QCOMPARE(&stringColumn.stringValueOf(NodeId(0)), &stringColumn.stringValueOf(NodeId(2)));
+}
+
+void AttributeColumnTest::snapshot()
+{
+    MutableGraph graph;
+    graph.performTransaction([](IMutableGraph& mutableGraph)
+    {
+        for(int i = 0; i < 100; i++)
+            mutableGraph.addNode();
+    });
+
+    std::vector<int> values;
+    for(int i = 0; i < 100; i++)
+        values.push_back(i * 2);
+
+    Attribute attribute;
+    attribute.setIntValueFn([&values](NodeId nodeId) { return values.at(static_cast<size_t>(static_cast<int>(nodeId))); });
+    attribute.setMaterialisable(graph);
+
+    // The snapshot isn't taken until it's asked for
+    QVERIFY(!attribute.isMaterialised());
+    attribute.materialise();
+    QVERIFY(attribute.isMaterialised());
+
+    // Once taken, the snapshot is read instead of the value function...
+    values.at(5) = -1;
+    QCOMPARE(attribute.intValueOf(NodeId(5)), 10);
+
+    // ...and is shared with copies of the attribute
+    Attribute copy(attribute);
+    QVERIFY(copy.isMaterialised());
+    QCOMPARE(copy.intValueOf(NodeId(5)), 10);
+
+    // Elements added since the snapshot was taken aren't covered by it
+    auto nodeId = graph.addNode();
+    values.push_back(7);
+    QCOMPARE(attribute.intValueOf(nodeId), 7);
+
+    // GraphModel discards the snapshot whenever the graph changes, after which the values are live
+    attribute.dematerialise();
+    QVERIFY(!attribute.isMaterialised());
+    QCOMPARE(attribute.intValueOf(NodeId(5)), -1);
+
+    // A new snapshot covers the graph as it is now
+    attribute.setMaterialisable(graph);
+    attribute.materialise();
+    values.at(5) = 5;
+    values.at(static_cast<size_t>(static_cast<int>(nodeId))) = 8;
+    QCOMPARE(attribute.intValueOf(NodeId(5)), -1);
+    QCOMPARE(attribute.intValueOf(nodeId), 7);
+
+    // A copy that holds the snapshot keeps reading it, once the original has discarded it
+    Attribute holder(attribute);
+    holder.holdColumn();
+    attribute.dematerialise();
+    QCOMPARE(holder.intValueOf(NodeId(5)), -1);
+    QCOMPARE(attribute.intValueOf(NodeId(5)), 5);
+
+    // Bulk readers are given the snapshot, and read it directly
+    attribute.setMaterialisable(graph);
+    auto column = attribute.materialise();
+    QVERIFY(column != nullptr);
+    QVERIFY(column->covers<int>(nodeId));
+    QCOMPARE(column->intValueOf(NodeId(5)), 5);
+    QCOMPARE(column->valueOf(nodeId), QVariant(8));
+
+    // Changing the value function discards the snapshot
+    attribute.setIntValueFn([](NodeId) { return 1; });
+    QVERIFY(!attribute.isMaterialised());
+    QCOMPARE(attribute.intValueOf(NodeId(5)), 1);
+}
+
+void AttributeColumnTest::concurrentDematerialise()
+{
+    MutableGraph graph;
+    graph.performTransaction([](IMutableGraph& mutableGraph)
+    {
+        for(int i = 0; i < 10000; i++)
+            mutableGraph.addNode();
+    });
+
+    Attribute attribute;
+    attribute.setFloatValueFn([](NodeId nodeId) { return static_cast<double>(static_cast<int>(nodeId)) / 2.0; });
+    attribute.setMaterialisable(graph);
+
+    // Repeatedly discard and retake the snapshot, while it's being read from elsewhere
+    std::atomic<bool> done(false);
+    std::thread invalidator([&]
+    {
+        while(!done)
+        {
+            attribute.dematerialise();
+            attribute.setMaterialisable(graph);
+            attribute.materialise();
+        }
+    });
+
+    // Readers hold the snapshot for the duration of each pass, either directly or in a copy, or
+    // take it for each value they read
+    std::atomic<int> mismatches(0);
+    for(int i = 0; i < 20; i++)
+    {
+        auto column = attribute.materialise();
+
+        Attribute holder(attribute);
+        holder.holdColumn();
+
+        concurrent_for(graph.nodeIds().begin(), graph.nodeIds().end(),
+        [&](NodeId nodeId)
+        {
+            auto expectedValue = static_cast<double>(static_cast<int>(nodeId)) / 2.0;
+
+            if(column != nullptr && column->floatValueOf(nodeId) != expectedValue)
+                mismatches++;
+
+            if(holder.floatValueOf(nodeId) != expectedValue)
+                mismatches++;
+
+            // A read that doesn't hold the snapshot owns it for as long as the read takes
+            if(attribute.floatValueOf(nodeId) != expectedValue)
+                mismatches++;
+        });
+    }
+
+    done = true;
+    invalidator.join();
+
+    QCOMPARE(mismatches.load(), 0);
+}
+
+QTEST_APPLESS_MAIN(AttributeColumnTest)
+#include "attributecolumntest.moc"
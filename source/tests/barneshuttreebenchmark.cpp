@@ -0,0 +1,156 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "graph/mutablegraph.h"
+#include "layout/barneshuttree.h"
+#include "layout/nodepositions.h"
+#include "referencebarneshuttree.h"
+
+#include "shared/graph/igraphcomponent.h"
+#include "shared/utils/threadpool.h"
+
+#include <QtTest>
+#include <QVector3D>
+
+#include <random>
+#include <vector>
+
+// Times one layout iteration's worth of Barnes-Hut work: building the tree, then
+// evaluating the repulsive force on every position; each case is also timed using
+// the tree that the current one replaced, as ForceDirectedLayout used to use it
+class BarnesHutTreeBenchmark : public QObject
+{
+    Q_OBJECT
+
+private:
+    ThreadPoolSingleton _threadPool;
+
+private slots:
+    void iteration_data();
+    void iteration();
+};
+
+namespace
+{
+class WholeGraphComponent : public IGraphComponent
+{
+private:
+    const IGraph* _graph;
+
+public:
+    explicit WholeGraphComponent(const IGraph& graph) : _graph(&graph) {}
+
+    const std::vector<NodeId>& nodeIds() const override { return _graph->nodeIds(); }
+    const std::vector<EdgeId>& edgeIds() const override { return _graph->edgeIds(); }
+    const IGraph& graph() const override { return *_graph; }
+};
+} // namespace
+
+void BarnesHutTreeBenchmark::iteration_data()
+{
+    QTest::addColumn<int>("numNodes");
+    QTest::addColumn<int>("numCoincident");
+    QTest::addColumn<bool>("reference");
+
+    for(bool reference : {false, true})
+    {
+        auto name = [reference](const char* description)
+        {
+            return QByteArray(description) + (reference ? ", reference" : "");
+        };
+
+        QTest::newRow(name("100k").constData()) << 100000 << 0 << reference;
+        QTest::newRow(name("300k").constData()) << 300000 << 0 << reference;
+        QTest::newRow(name("1M").constData()) << 1000000 << 0 << reference;
+
+        // As when a layout starts from positions that haven't yet been separated
+        QTest::newRow(name("100k, 1% coincident").constData()) << 100000 << 1000 << reference;
+    }
+}
+
+void BarnesHutTreeBenchmark::iteration()
+{
+    QFETCH(int, numNodes);
+    QFETCH(int, numCoincident);
+    QFETCH(bool, reference);
+
+    MutableGraph graph;
+    graph.bulkAddNodes(static_cast<size_t>(numNodes));
+
+    // Normally distributed positions, on the scale of ForceDirectedLayout's
+    std::mt19937 generator(1);
+    std::normal_distribution<float> distribution(0.0f, 100.0f);
+
+    NodeLayoutPositions positions(graph);
+    for(auto nodeId : graph.nodeIds())
+    {
+        if(static_cast<int>(nodeId) < numCoincident)
+            positions.set(nodeId, QVector3D());
+        else
+        {
+            positions.set(nodeId, QVector3D(distribution(generator),
+                distribution(generator), distribution(generator)));
+        }
+    }
+
+    // ForceDirectedLayout's repulsive force, with its default settings
+    auto kernel = [](float distanceSq)
+    {
+        const float shortRange = 1000000.0f;
+        const float longRange = 10.01f;
+
+        return ((distanceSq * distanceSq * longRange) + shortRange) /
+            ((distanceSq * distanceSq * distanceSq) + 0.0001f);
+    };
+
+    WholeGraphComponent component(graph);
+    NodeArray<QVector3D> results(graph);
+
+    if(reference)
+    {
+        QBENCHMARK
+        {
+            // It can't be rebuilt, so ForceDirectedLayout created a new one every iteration
+            Reference::BarnesHutTree3D tree;
+            tree.build(component, positions);
+
+            concurrent_for(graph.nodeIds().begin(), graph.nodeIds().end(),
+            [&](NodeId nodeId)
+            {
+                results[nodeId] = tree.evaluateKernel(positions, nodeId,
+                [&kernel](int mass, const QVector3D& difference, float distanceSq)
+                {
+                    return difference * (static_cast<float>(mass) * kernel(distanceSq));
+                });
+            });
+        }
+    }
+    else
+    {
+        BarnesHutTree3D tree;
+
+        QBENCHMARK
+        {
+            tree.build(component, positions);
+            tree.evaluateKernel(kernel, [&results](NodeId nodeId, const QVector3D& result) { results[nodeId] = result; });
+        }
+    }
+}
+
+QTEST_APPLESS_MAIN(BarnesHutTreeBenchmark)
+#include "barneshuttreebenchmark.moc"
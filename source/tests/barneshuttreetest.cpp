@@ -0,0 +1,145 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "graph/mutablegraph.h"
+#include "layout/barneshuttree.h"
+#include "layout/nodepositions.h"
+
+#include "shared/graph/igraphcomponent.h"
+#include "shared/utils/threadpool.h"
+
+#include <QtTest>
+#include <QVector3D>
+
+#include <cmath>
+#include <vector>
+
+// Checks that exactly coincident positions are counted, and no others
+class BarnesHutTreeTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    ThreadPoolSingleton _threadPool;
+
+private slots:
+    void coincidentPositions_data();
+    void coincidentPositions();
+};
+
+namespace
+{
+class WholeGraphComponent : public IGraphComponent
+{
+private:
+    const IGraph* _graph;
+
+public:
+    explicit WholeGraphComponent(const IGraph& graph) : _graph(&graph) {}
+
+    const std::vector<NodeId>& nodeIds() const override { return _graph->nodeIds(); }
+    const std::vector<EdgeId>& edgeIds() const override { return _graph->edgeIds(); }
+    const IGraph& graph() const override { return *_graph; }
+};
+} // namespace
+
+void BarnesHutTreeTest::coincidentPositions_data()
+{
+    QTest::addColumn<int>("numClusters");
+    QTest::addColumn<int>("clusterSize");
+
+    QTest::newRow("Pairs") << 500 << 2;
+    QTest::newRow("Small") << 200 << 5;
+    QTest::newRow("Large") << 10 << 500;
+}
+
+// Clusters of exactly coincident positions are placed so close to other clusters that
+// they likely share a Morton code with them, and their positions are interleaved, so
+// that those of a cluster aren't adjacent once sorted by code
+void BarnesHutTreeTest::coincidentPositions()
+{
+    QFETCH(int, numClusters);
+    QFETCH(int, clusterSize);
+
+    // The kernel's nudge between coincident positions has this length
+    const float epsilon = 0.0001f;
+    const float separation = 3.0f * epsilon;
+    const std::vector<QVector3D> offsets =
+    {
+        {0.0f, 0.0f, 0.0f},
+        {separation, 0.0f, 0.0f},
+        {0.0f, separation, 0.0f},
+        {0.0f, 0.0f, separation},
+        {separation, separation, separation},
+    };
+
+    // Each group of clusters has one singleton, which should see no coincident positions
+    const auto clustersPerGroup = static_cast<int>(offsets.size());
+    const auto numGroups = (numClusters + clustersPerGroup - 1) / clustersPerGroup;
+
+    MutableGraph graph;
+    NodeLayoutPositions positions(graph);
+    NodeArray<int> expectedCoincident(graph);
+
+    graph.performTransaction([&](IMutableGraph&)
+    {
+        for(int group = 0; group < numGroups; group++)
+        {
+            // A large spacing makes the quantisation of positions coarse
+            QVector3D base(static_cast<float>(group % 10) * 100.0f,
+                static_cast<float>(group / 10) * 100.0f, 0.0f);
+
+            for(int member = 0; member < clusterSize; member++)
+            {
+                for(int cluster = 0; cluster < clustersPerGroup; cluster++)
+                {
+                    bool singleton = cluster == clustersPerGroup - 1;
+                    if(singleton && member > 0)
+                        continue;
+
+                    auto nodeId = graph.addNode();
+                    positions.set(nodeId, base + offsets.at(static_cast<size_t>(cluster)));
+
+                    expectedCoincident[nodeId] = singleton ? 0 : clusterSize - 1;
+                }
+            }
+        }
+    });
+
+    WholeGraphComponent component(graph);
+    BarnesHutTree3D tree;
+
+    // Never approximate, so that each position only interacts with the others themselves
+    tree.setTheta(0.0f);
+    tree.build(component, positions);
+
+    // Only positions closer than the cluster separation contribute
+    auto kernel = [epsilon](float distanceSq) { return distanceSq < 2.0f * epsilon * epsilon ? 1.0f : 0.0f; };
+
+    NodeArray<QVector3D> results(graph);
+    tree.evaluateKernel(kernel, [&results](NodeId nodeId, const QVector3D& result) { results[nodeId] = result; });
+
+    for(auto nodeId : graph.nodeIds())
+    {
+        auto numCoincident = static_cast<int>(std::round(results[nodeId].length() / epsilon));
+        QCOMPARE(numCoincident, expectedCoincident[nodeId]);
+    }
+}
+
+QTEST_APPLESS_MAIN(BarnesHutTreeTest)
+#include "barneshuttreetest.moc"
@@ -0,0 +1,231 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "graph/mutablegraph.h"
+#include "graph/adjacencysnapshot.h"
+#include "transform/transforms/betweenness.h"
+
+#include "shared/utils/cancellable.h"
+#include "shared/utils/threadpool.h"
+
+#include <QtTest>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+// Checks exact betweenness against a count of the shortest paths between every pair of nodes,
+// and that values sampled from some of the nodes are within the reported error bound
+class BetweennessTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    ThreadPoolSingleton _threadPool;
+
+private slots:
+    void betweenness_data();
+    void betweenness();
+};
+
+namespace
+{
+using Edges = std::vector<std::pair<int, int>>;
+
+// A random tree, so that the graph is connected, plus enough other edges to make numEdges
+Edges randomEdges(int numNodes, int numEdges, unsigned int seed)
+{
+    std::mt19937 generator(seed);
+    std::set<std::pair<int, int>> edges;
+
+    for(int i = 1; i < numNodes; i++)
+        edges.emplace(std::uniform_int_distribution<int>(0, i - 1)(generator), i);
+
+    std::uniform_int_distribution<int> distribution(0, numNodes - 1);
+    while(static_cast<int>(edges.size()) < numEdges)
+    {
+        auto a = distribution(generator);
+        auto b = distribution(generator);
+
+        if(a != b && edges.count({a, b}) == 0 && edges.count({b, a}) == 0)
+            edges.emplace(a, b);
+    }
+
+    return {edges.begin(), edges.end()};
+}
+
+struct Reference
+{
+    std::vector<double> _nodeBetweenness;
+    std::vector<double> _edgeBetweenness;
+};
+
+// For every ordered pair of nodes s and t, the fraction of the shortest paths from s to t that
+// pass through each node v, σ(s, v)σ(v, t) / σ(s, t), and through each edge (a, b) likewise
+Reference referenceBetweenness(int numNodes, const Edges& edges)
+{
+    const auto n = static_cast<size_t>(numNodes);
+
+    std::vector<std::vector<size_t>> neighbours(n);
+    for(const auto& [a, b] : edges)
+    {
+        neighbours[static_cast<size_t>(a)].push_back(static_cast<size_t>(b));
+        neighbours[static_cast<size_t>(b)].push_back(static_cast<size_t>(a));
+    }
+
+    std::vector<std::vector<int>> distance(n, std::vector<int>(n, -1));
+    std::vector<std::vector<double>> sigma(n, std::vector<double>(n, 0.0));
+
+    for(size_t s = 0; s < n; s++)
+    {
+        std::vector<size_t> queue = {s};
+        distance[s][s] = 0;
+        sigma[s][s] = 1.0;
+
+        for(size_t head = 0; head < queue.size(); head++)
+        {
+            auto v = queue[head];
+            for(auto w : neighbours[v])
+            {
+                if(distance[s][w] < 0)
+                {
+                    distance[s][w] = distance[s][v] + 1;
+                    queue.push_back(w);
+                }
+
+                if(distance[s][w] == distance[s][v] + 1)
+                    sigma[s][w] += sigma[s][v];
+            }
+        }
+    }
+
+    Reference reference;
+    reference._nodeBetweenness.assign(n, 0.0);
+    reference._edgeBetweenness.assign(edges.size(), 0.0);
+
+    for(size_t s = 0; s < n; s++)
+    {
+        for(size_t t = 0; t < n; t++)
+        {
+            if(s == t || distance[s][t] < 0)
+                continue;
+
+            for(size_t v = 0; v < n; v++)
+            {
+                if(v != s && v != t && distance[s][v] >= 0 &&
+                    distance[s][v] + distance[v][t] == distance[s][t])
+                {
+                    reference._nodeBetweenness[v] += (sigma[s][v] * sigma[v][t]) / sigma[s][t];
+                }
+            }
+
+            for(size_t e = 0; e < edges.size(); e++)
+            {
+                auto a = static_cast<size_t>(edges[e].first);
+                auto b = static_cast<size_t>(edges[e].second);
+
+                for(auto [from, to] : {std::make_pair(a, b), std::make_pair(b, a)})
+                {
+                    if(distance[s][from] >= 0 && distance[s][from] + 1 + distance[to][t] == distance[s][t])
+                        reference._edgeBetweenness[e] += (sigma[s][from] * sigma[to][t]) / sigma[s][t];
+                }
+            }
+        }
+    }
+
+    return reference;
+}
+} // namespace
+
+void BetweennessTest::betweenness_data()
+{
+    QTest::addColumn<int>("numNodes");
+    QTest::addColumn<int>("numEdges");
+    QTest::addColumn<int>("sampleSize");
+
+    QTest::newRow("60 nodes, exact") << 60 << 150 << 0;
+    QTest::newRow("60 nodes, 20 sampled") << 60 << 150 << 20;
+    QTest::newRow("60 nodes, 40 sampled") << 60 << 150 << 40;
+    QTest::newRow("100 nodes, 30 sampled") << 100 << 300 << 30;
+}
+
+void BetweennessTest::betweenness()
+{
+    QFETCH(int, numNodes);
+    QFETCH(int, numEdges);
+    QFETCH(int, sampleSize);
+
+    auto edges = randomEdges(numNodes, numEdges, 1);
+
+    MutableGraph graph;
+    auto firstNodeId = graph.bulkAddNodes(static_cast<size_t>(numNodes));
+
+    std::vector<std::pair<NodeId, NodeId>> edgeNodeIds;
+    for(const auto& [a, b] : edges)
+        edgeNodeIds.emplace_back(firstNodeId + a, firstNodeId + b);
+
+    auto firstEdgeId = graph.bulkAddEdges(edgeNodeIds);
+
+    auto adjacency = graph.adjacencySnapshot();
+    const auto numEdgeIds = static_cast<size_t>(static_cast<int>(graph.nextEdgeId()));
+
+    Cancellable cancellable;
+    auto result = computeBetweenness(*adjacency, numEdgeIds, static_cast<size_t>(sampleSize), cancellable);
+    QCOMPARE(result._sampled, sampleSize > 0);
+
+    auto reference = referenceBetweenness(numNodes, edges);
+
+    const auto n = static_cast<double>(numNodes);
+    const double maxNodeBetweenness = (n - 1.0) * (n - 2.0);
+    const double maxEdgeBetweenness = n * (n - 1.0);
+
+    // Exact values only differ by rounding
+    auto tolerance = 1e-9;
+    if(result._sampled)
+    {
+        tolerance = betweennessErrorBound(static_cast<size_t>(numNodes),
+            static_cast<size_t>(numEdges), static_cast<size_t>(sampleSize), 0.9);
+        QVERIFY(tolerance > 0.0 && tolerance < 1.0);
+    }
+
+    double maxError = 0.0;
+
+    for(int i = 0; i < numNodes; i++)
+    {
+        auto index = adjacency->indexOf(firstNodeId + i);
+        auto error = std::abs(result._nodeBetweenness[index] - reference._nodeBetweenness[static_cast<size_t>(i)]);
+        maxError = std::max(maxError, error / maxNodeBetweenness);
+    }
+
+    for(size_t e = 0; e < edges.size(); e++)
+    {
+        auto edgeId = static_cast<size_t>(static_cast<int>(firstEdgeId + static_cast<int>(e)));
+        auto error = std::abs(result._edgeBetweenness[edgeId] - reference._edgeBetweenness[e]);
+        maxError = std::max(maxError, error / maxEdgeBetweenness);
+    }
+
+    QVERIFY2(maxError <= tolerance, qPrintable(QStringLiteral("Values differ from the exact "
+        "betweenness by up to %1 of the largest possible, beyond the bound of %2")
+        .arg(maxError).arg(tolerance)));
+}
+
+QTEST_APPLESS_MAIN(BetweennessTest)
+#include "betweennesstest.moc"
@@ -0,0 +1,407 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "graph/mutablegraph.h"
+#include "graph/componentmanager.h"
+#include "graph/graphcomponent.h"
+
+#include "shared/utils/threadpool.h"
+
+#include <QtTest>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Checks the incremental component update against the full traversal, under random changes
+class ComponentManagerTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    ThreadPoolSingleton _threadPool;
+
+private slots:
+    void randomChanges_data();
+    void randomChanges();
+};
+
+namespace
+{
+template<typename C>
+std::string idsToString(const C& ids)
+{
+    std::vector<int> sortedIds;
+    for(auto id : ids)
+        sortedIds.push_back(static_cast<int>(id));
+
+    std::sort(sortedIds.begin(), sortedIds.end());
+
+    std::string s;
+    for(auto id : sortedIds)
+        s += (s.empty() ? "" : ",") + std::to_string(id);
+
+    return s;
+}
+
+// Everything a ComponentManager notifies during an update; the order in which signals
+// of the same kind are emitted isn't significant, so they are compared sorted
+class NotificationRecorder
+{
+private:
+    std::vector<std::string> _notifications;
+
+    template<typename T>
+    void record(const std::string& what, T id, ComponentId componentId)
+    {
+        _notifications.emplace_back(what + " " + std::to_string(static_cast<int>(id)) +
+            " " + std::to_string(static_cast<int>(componentId)));
+    }
+
+public:
+    explicit NotificationRecorder(const ComponentManager& componentManager)
+    {
+        QObject::connect(&componentManager, &ComponentManager::componentAdded,
+        [this](const Graph*, ComponentId componentId, bool hasSplit)
+        {
+            record("componentAdded", componentId, hasSplit ? 1 : 0);
+        });
+
+        QObject::connect(&componentManager, &ComponentManager::componentWillBeRemoved,
+        [this](const Graph*, ComponentId componentId, bool hasMerged)
+        {
+            record("componentWillBeRemoved", componentId, hasMerged ? 1 : 0);
+        });
+
+        QObject::connect(&componentManager, &ComponentManager::componentSplit,
+        [this](const Graph*, const ComponentSplitSet& componentSplitSet)
+        {
+            _notifications.emplace_back("componentSplit " +
+                std::to_string(static_cast<int>(componentSplitSet.oldComponentId())) +
+                " " + idsToString(componentSplitSet.splitters()));
+        });
+
+        QObject::connect(&componentManager, &ComponentManager::componentsWillMerge,
+        [this](const Graph*, const ComponentMergeSet& componentMergeSet)
+        {
+            _notifications.emplace_back("componentsWillMerge " + idsToString(componentMergeSet.mergers()) +
+                " " + std::to_string(static_cast<int>(componentMergeSet.newComponentId())));
+        });
+
+        QObject::connect(&componentManager, &ComponentManager::nodeAddedToComponent,
+        [this](const Graph*, NodeId nodeId, ComponentId componentId) { record("nodeAdded", nodeId, componentId); });
+        QObject::connect(&componentManager, &ComponentManager::nodeRemovedFromComponent,
+        [this](const Graph*, NodeId nodeId, ComponentId componentId) { record("nodeRemoved", nodeId, componentId); });
+        QObject::connect(&componentManager, &ComponentManager::edgeAddedToComponent,
+        [this](const Graph*, EdgeId edgeId, ComponentId componentId) { record("edgeAdded", edgeId, componentId); });
+        QObject::connect(&componentManager, &ComponentManager::edgeRemovedFromComponent,
+        [this](const Graph*, EdgeId edgeId, ComponentId componentId) { record("edgeRemoved", edgeId, componentId); });
+    }
+
+    std::vector<std::string> take()
+    {
+        auto notifications = std::move(_notifications);
+        _notifications.clear();
+
+        std::sort(notifications.begin(), notifications.end());
+        return notifications;
+    }
+};
+
+// Returns a description of the first difference between the two, or an empty string if they agree
+std::string difference(const MutableGraph& graph, const ComponentManager& a, const ComponentManager& b)
+{
+    if(a.componentIds() != b.componentIds())
+        return "component ids " + idsToString(a.componentIds()) + " vs " + idsToString(b.componentIds());
+
+    for(auto componentId : a.componentIds())
+    {
+        const auto* componentA = a.componentById(componentId);
+        const auto* componentB = b.componentById(componentId);
+
+        if(idsToString(componentA->nodeIds()) != idsToString(componentB->nodeIds()))
+            return "nodes of component " + std::to_string(static_cast<int>(componentId));
+
+        if(idsToString(componentA->edgeIds()) != idsToString(componentB->edgeIds()))
+            return "edges of component " + std::to_string(static_cast<int>(componentId));
+    }
+
+    for(auto nodeId : graph.nodeIds())
+    {
+        if(a.componentIdOfNode(nodeId) != b.componentIdOfNode(nodeId))
+            return "component of node " + std::to_string(static_cast<int>(nodeId));
+    }
+
+    for(auto edgeId : graph.edgeIds())
+    {
+        if(a.componentIdOfEdge(edgeId) != b.componentIdOfEdge(edgeId))
+            return "component of edge " + std::to_string(static_cast<int>(edgeId));
+    }
+
+    return {};
+}
+} // namespace
+
+void ComponentManagerTest::randomChanges_data()
+{
+    QTest::addColumn<unsigned int>("seed");
+    QTest::addColumn<int>("numNodes");
+    QTest::addColumn<int>("edgesPerNode");
+
+    // Sparse graphs have many small components that frequently split and merge,
+    // whereas dense ones mostly exercise changes within a single large component
+    QTest::newRow("Sparse") << 1u << 200 << 1;
+    QTest::newRow("Dense") << 2u << 100 << 4;
+    QTest::newRow("Small") << 3u << 20 << 2;
+}
+
+void ComponentManagerTest::randomChanges()
+{
+    QFETCH(unsigned int, seed);
+    QFETCH(int, numNodes);
+    QFETCH(int, edgesPerNode);
+
+    const int numSteps = 500;
+
+    std::mt19937 generator(seed);
+    auto random = [&generator](int max) { return std::uniform_int_distribution<int>(0, max - 1)(generator); };
+
+    MutableGraph graph;
+
+    // Without filters, a ComponentManager updates incrementally; the (null) edge filter
+    // here is only present to force the reference to traverse the whole graph each time
+    ComponentManager incremental(graph);
+    ComponentManager full(graph, nullptr, [](EdgeId) { return false; });
+
+    NotificationRecorder incrementalNotifications(incremental);
+    NotificationRecorder fullNotifications(full);
+
+    std::unique_ptr<MutableGraph> snapshot;
+
+    // Ids are picked at random from those that have been used, as the graph's
+    // own lists of ids aren't updated until the outermost transaction ends
+    int nodeIdsEnd = 0;
+    int edgeIdsEnd = 0;
+
+    auto noteNodeId = [&nodeIdsEnd](NodeId nodeId) { nodeIdsEnd = std::max(nodeIdsEnd, static_cast<int>(nodeId) + 1); };
+    auto noteEdgeId = [&edgeIdsEnd](EdgeId edgeId) { edgeIdsEnd = std::max(edgeIdsEnd, static_cast<int>(edgeId) + 1); };
+
+    auto randomNodeId = [&](bool headsOnly) -> NodeId
+    {
+        for(int attempt = 0; nodeIdsEnd > 0 && attempt < 20; attempt++)
+        {
+            NodeId nodeId(random(nodeIdsEnd));
+            if(graph.containsNodeId(nodeId) && (!headsOnly || graph.typeOf(nodeId) != MultiElementType::Tail))
+                return nodeId;
+        }
+
+        return {};
+    };
+
+    auto randomEdgeId = [&]() -> EdgeId
+    {
+        for(int attempt = 0; edgeIdsEnd > 0 && attempt < 20; attempt++)
+        {
+            EdgeId edgeId(random(edgeIdsEnd));
+            if(graph.containsEdgeId(edgeId))
+                return edgeId;
+        }
+
+        return {};
+    };
+
+    auto addEdge = [&]
+    {
+        auto sourceId = randomNodeId(true);
+        if(sourceId.isNull())
+            return;
+
+        auto targetId = random(10) == 0 ? sourceId : randomNodeId(true);
+        auto parallelEdgeId = randomEdgeId();
+
+        // Parallel edges become multi-elements
+        if(random(5) == 0 && !parallelEdgeId.isNull() &&
+            graph.typeOf(graph.edgeById(parallelEdgeId).sourceId()) != MultiElementType::Tail &&
+            graph.typeOf(graph.edgeById(parallelEdgeId).targetId()) != MultiElementType::Tail)
+        {
+            const auto& edge = graph.edgeById(parallelEdgeId);
+            sourceId = edge.sourceId();
+            targetId = edge.targetId();
+        }
+
+        if(!targetId.isNull())
+            noteEdgeId(graph.addEdge(sourceId, targetId));
+    };
+
+    auto contractableEdgeId = [&]() -> EdgeId
+    {
+        auto edgeId = randomEdgeId();
+        if(edgeId.isNull())
+            return {};
+
+        const auto& edge = graph.edgeById(edgeId);
+        if(edge.isLoop() ||
+            graph.typeOf(edge.sourceId()) == MultiElementType::Tail ||
+            graph.typeOf(edge.targetId()) == MultiElementType::Tail)
+        {
+            return {};
+        }
+
+        return edgeId;
+    };
+
+    auto change = [&]
+    {
+        bool growing = graph.numNodes() < numNodes;
+
+        switch(random(12))
+        {
+        case 0:
+        case 1:
+            if(growing || random(3) == 0)
+                noteNodeId(graph.addNode());
+            break;
+
+        case 2:
+            if(!growing || random(3) == 0)
+            {
+                auto nodeId = randomNodeId(false);
+                if(!nodeId.isNull())
+                    graph.removeNode(nodeId);
+            }
+            break;
+
+        case 3:
+        case 4:
+        case 5:
+            if(graph.numEdges() < numNodes * edgesPerNode || random(3) == 0)
+                addEdge();
+            break;
+
+        case 6:
+        case 7:
+        {
+            auto edgeId = randomEdgeId();
+            if(!edgeId.isNull())
+                graph.removeEdge(edgeId);
+            break;
+        }
+
+        case 8:
+        {
+            auto numNewNodes = 1 + random(5);
+            auto firstNodeId = graph.bulkAddNodes(numNewNodes);
+            noteNodeId(firstNodeId + (numNewNodes - 1));
+
+            std::vector<std::pair<NodeId, NodeId>> edges;
+            for(int i = 0; i < numNewNodes; i++)
+            {
+                auto otherNodeId = random(2) == 0 ? randomNodeId(true) : NodeId(firstNodeId + random(numNewNodes));
+                if(!otherNodeId.isNull())
+                    edges.emplace_back(firstNodeId + i, otherNodeId);
+            }
+
+            if(!edges.empty())
+                noteEdgeId(graph.bulkAddEdges(edges) + (static_cast<int>(edges.size()) - 1));
+            break;
+        }
+
+        case 9:
+        {
+            NodeArray<bool> nodeRemovees(graph, false);
+            EdgeArray<bool> edgeRemovees(graph, false);
+
+            for(int i = 0; i < 3; i++)
+            {
+                auto nodeId = randomNodeId(false);
+                if(!nodeId.isNull())
+                    nodeRemovees.set(nodeId, true);
+
+                auto edgeId = randomEdgeId();
+                if(!edgeId.isNull())
+                    edgeRemovees.set(edgeId, true);
+            }
+
+            if(random(2) == 0)
+                graph.bulkRemoveEdges(edgeRemovees);
+            else
+                graph.bulkRemoveNodes(nodeRemovees);
+            break;
+        }
+
+        case 10:
+        {
+            if(random(2) == 0)
+            {
+                auto edgeId = contractableEdgeId();
+                if(!edgeId.isNull())
+                    graph.contractEdge(edgeId);
+            }
+            else
+            {
+                EdgeIdSet edgeIds;
+                for(int i = 0; i < 3; i++)
+                {
+                    auto edgeId = contractableEdgeId();
+                    if(!edgeId.isNull())
+                        edgeIds.insert(edgeId);
+                }
+
+                graph.contractEdges(edgeIds);
+            }
+            break;
+        }
+
+        case 11:
+            // Reverting to an earlier graph is how transforms are rebuilt
+            if(snapshot != nullptr)
+                graph = *snapshot;
+            break;
+
+        default:
+            break;
+        }
+    };
+
+    for(int step = 0; step < numSteps; step++)
+    {
+        if(step % 50 == 0)
+            snapshot = std::make_unique<MutableGraph>(graph);
+
+        if(random(4) == 0)
+        {
+            graph.performTransaction([&](IMutableGraph&)
+            {
+                auto numChanges = 1 + random(8);
+                for(int i = 0; i < numChanges; i++)
+                    change();
+            });
+        }
+        else
+            change();
+
+        auto description = difference(graph, incremental, full);
+        QVERIFY2(description.empty(), ("Step " + std::to_string(step) + ": " + description).c_str());
+        QCOMPARE(incrementalNotifications.take(), fullNotifications.take());
+    }
+}
+
+QTEST_APPLESS_MAIN(ComponentManagerTest)
+#include "componentmanagertest.moc"
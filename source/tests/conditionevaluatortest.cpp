@@ -0,0 +1,316 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "attributes/attribute.h"
+#include "attributes/conditionevaluator.h"
+#include "attributes/conditionfncreator.h"
+#include "attributes/iattributeprovider.h"
+#include "graph/mutablegraph.h"
+#include "transform/graphtransformconfigparser.h"
+
+#include "shared/utils/threadpool.h"
+
+#include <QtTest>
+
+#include <map>
+#include <random>
+#include <vector>
+
+// Checks that the column at a time evaluation of conditions selects the same
+// elements as the per-element functions made by CreateConditionFnFor
+class ConditionEvaluatorTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    ThreadPoolSingleton _threadPool;
+
+private slots:
+    void nodeConditions_data();
+    void nodeConditions();
+    void edgeConditions_data();
+    void edgeConditions();
+    void valueOnLeft_data();
+    void valueOnLeft();
+};
+
+namespace
+{
+const std::vector<QString> words = {"alpha", "beta", "gamma", "delta", "alphabet", "Beta", "1", "10"};
+
+// The attributes of a random graph, looked up in the same way as GraphModel does
+class TestAttributeProvider : public IAttributeProvider
+{
+private:
+    MutableGraph _graph;
+    std::map<QString, Attribute> _attributes;
+
+    std::vector<int> _intValues;
+    std::vector<double> _floatValues;
+    std::vector<QString> _stringValues;
+    std::vector<bool> _missing;
+
+    std::vector<int> _edgeIntValues;
+    std::vector<double> _edgeFloatValues;
+
+public:
+    explicit TestAttributeProvider(unsigned int seed)
+    {
+        const int numNodes = 5000;
+        const int numEdges = 15000;
+
+        std::mt19937 generator(seed);
+        auto random = [&generator](int max) { return std::uniform_int_distribution<int>(0, max - 1)(generator); };
+
+        _graph.performTransaction([&](IMutableGraph&)
+        {
+            for(int i = 0; i < numNodes; i++)
+                _graph.addNode();
+
+            for(int i = 0; i < numEdges; i++)
+                _graph.addEdge(NodeId(random(numNodes)), NodeId(random(numNodes)));
+
+            // Leave gaps in the ids, so that element positions and ids differ
+            for(int i = 0; i < numNodes / 10; i++)
+            {
+                NodeId nodeId(random(numNodes));
+                if(_graph.containsNodeId(nodeId))
+                    _graph.removeNode(nodeId);
+            }
+        });
+
+        for(int i = 0; i < numNodes; i++)
+        {
+            _intValues.push_back(random(10));
+            _floatValues.push_back(random(100) / 10.0);
+            _stringValues.push_back(words.at(static_cast<size_t>(random(static_cast<int>(words.size())))));
+            _missing.push_back(random(5) == 0);
+        }
+
+        for(int i = 0; i < numEdges; i++)
+        {
+            _edgeIntValues.push_back(random(10));
+            _edgeFloatValues.push_back(random(100) / 10.0);
+        }
+
+        _attributes["Int"].setIntValueFn([this](NodeId nodeId)
+            { return _intValues.at(static_cast<size_t>(static_cast<int>(nodeId))); });
+        _attributes["Float"].setFloatValueFn([this](NodeId nodeId)
+            { return _floatValues.at(static_cast<size_t>(static_cast<int>(nodeId))); });
+        _attributes["String"].setStringValueFn([this](NodeId nodeId)
+            { return _stringValues.at(static_cast<size_t>(static_cast<int>(nodeId))); })
+            .setValueMissingFn([this](NodeId nodeId)
+            { return static_cast<bool>(_missing.at(static_cast<size_t>(static_cast<int>(nodeId)))); });
+
+        _attributes["Edge Int"].setIntValueFn([this](EdgeId edgeId)
+            { return _edgeIntValues.at(static_cast<size_t>(static_cast<int>(edgeId))); });
+        _attributes["Edge Float"].setFloatValueFn([this](EdgeId edgeId)
+            { return _edgeFloatValues.at(static_cast<size_t>(static_cast<int>(edgeId))); });
+    }
+
+    const MutableGraph& graph() const { return _graph; }
+
+    // From then on, the evaluator gathers values from the attributes' snapshots
+    void setMaterialisable()
+    {
+        for(auto& attribute : _attributes)
+            attribute.second.setMaterialisable(_graph);
+    }
+
+    int intValueOf(NodeId nodeId) const { return _intValues.at(static_cast<size_t>(static_cast<int>(nodeId))); }
+
+    const Attribute* attributeByName(const QString& name) const override
+    {
+        auto attributeName = Attribute::parseAttributeName(name);
+
+        auto it = _attributes.find(attributeName._name);
+        if(it == _attributes.end())
+            return nullptr;
+
+        return &it->second;
+    }
+
+    Attribute attributeValueByName(const QString& name) const override
+    {
+        auto attributeName = Attribute::parseAttributeName(name);
+
+        auto it = _attributes.find(attributeName._name);
+        if(it == _attributes.end())
+            return {};
+
+        if(attributeName._type != Attribute::EdgeNodeType::None)
+            return Attribute::edgeNodesAttribute(_graph, it->second, attributeName._type);
+
+        return it->second;
+    }
+};
+
+GraphTransformConfig::Condition parseCondition(const QString& condition)
+{
+    GraphTransformConfigParser parser;
+    if(!parser.parse(QStringLiteral("\"Remove Elements\" where %1").arg(condition)))
+        return GraphTransformConfig::NoCondition{};
+
+    return parser.result()._condition;
+}
+
+// Returns the number of elements for which the two evaluations differ, or -1 if only one is valid
+template<typename E>
+int numDifferences(const TestAttributeProvider& attributeProvider,
+    const std::vector<E>& elementIds, const QString& conditionText)
+{
+    auto condition = parseCondition(conditionText);
+
+    auto conditionFn = CreateConditionFnFor::elementType<E>(attributeProvider, condition);
+    ConditionEvaluator<E> conditionEvaluator(attributeProvider, attributeProvider.graph(), elementIds);
+
+    if(conditionEvaluator.evaluate(condition) != (conditionFn != nullptr))
+        return -1;
+
+    if(conditionFn == nullptr)
+        return 0;
+
+    int differences = 0;
+
+    for(size_t i = 0; i < elementIds.size(); i++)
+    {
+        if(conditionEvaluator.selected(i) != conditionFn(elementIds.at(i)))
+            differences++;
+    }
+
+    return differences;
+}
+} // namespace
+
+void ConditionEvaluatorTest::nodeConditions_data()
+{
+    QTest::addColumn<QString>("condition");
+    QTest::addColumn<bool>("valid");
+
+    QTest::newRow("Int less than") << QStringLiteral("$Int < 5") << true;
+    QTest::newRow("Int less than float") << QStringLiteral("$Int <= 4.7") << true;
+    QTest::newRow("Int equals string") << QStringLiteral("$Int == \"3\"") << true;
+    QTest::newRow("Int not equal") << QStringLiteral("$Int != 3") << true;
+    QTest::newRow("Int includes") << QStringLiteral("$Int includes \"3\"") << true;
+    QTest::newRow("Float greater than int") << QStringLiteral("$Float > 3") << true;
+    QTest::newRow("Float equals") << QStringLiteral("$Float == 3.0") << true;
+    QTest::newRow("Value on left") << QStringLiteral("5 < $Int") << true;
+    QTest::newRow("Float value on left") << QStringLiteral("4.5 >= $Int") << true;
+    QTest::newRow("Int less than Float") << QStringLiteral("$Int < $Float") << true;
+    QTest::newRow("String equals") << QStringLiteral("$String == \"beta\"") << true;
+    QTest::newRow("String equals absent") << QStringLiteral("$String == \"zeta\"") << true;
+    QTest::newRow("String not equal absent") << QStringLiteral("$String != \"zeta\"") << true;
+    QTest::newRow("String includes") << QStringLiteral("$String includes \"alpha\"") << true;
+    QTest::newRow("String excludes") << QStringLiteral("$String excludes \"et\"") << true;
+    QTest::newRow("String starts") << QStringLiteral("$String starts \"g\"") << true;
+    QTest::newRow("String ends") << QStringLiteral("$String ends \"a\"") << true;
+    QTest::newRow("String matches") << QStringLiteral("$String matches \"^b.*a$\"") << true;
+    QTest::newRow("String matches case insensitive") << QStringLiteral("$String matchesCaseInsensitive \"^b\"") << true;
+    QTest::newRow("String has value") << QStringLiteral("$String hasValue") << true;
+    QTest::newRow("String less than") << QStringLiteral("$String < 5") << false;
+    QTest::newRow("Compound") << QStringLiteral("$Int < 5 or ($String hasValue and $String starts \"g\")") << true;
+    QTest::newRow("Unknown attribute") << QStringLiteral("$Unknown == 1") << false;
+    QTest::newRow("Edge attribute") << QStringLiteral("$\"Edge Int\" == 1") << false;
+}
+
+void ConditionEvaluatorTest::nodeConditions()
+{
+    QFETCH(QString, condition);
+    QFETCH(bool, valid);
+
+    TestAttributeProvider attributeProvider(1);
+    const auto& nodeIds = attributeProvider.graph().nodeIds();
+
+    QCOMPARE(CreateConditionFnFor::node(attributeProvider, parseCondition(condition)) != nullptr, valid);
+    QCOMPARE(numDifferences(attributeProvider, nodeIds, condition), 0);
+
+    attributeProvider.setMaterialisable();
+    QCOMPARE(numDifferences(attributeProvider, nodeIds, condition), 0);
+}
+
+void ConditionEvaluatorTest::edgeConditions_data()
+{
+    QTest::addColumn<QString>("condition");
+    QTest::addColumn<bool>("valid");
+
+    QTest::newRow("Source equals target") << QStringLiteral("$source.String == $target.String") << true;
+    QTest::newRow("Source not equal target") << QStringLiteral("$source.String != $target.String") << true;
+    QTest::newRow("Source int equals target") << QStringLiteral("$source.Int == $target.Int") << true;
+    QTest::newRow("Source greater than edge") << QStringLiteral("$source.Int > $\"Edge Float\"") << true;
+    QTest::newRow("Edge equals target") << QStringLiteral("$\"Edge Int\" == $target.Int") << true;
+    QTest::newRow("Target less than") << QStringLiteral("$target.Float < 2.5") << true;
+    QTest::newRow("Value on left") << QStringLiteral("3 <= $\"Edge Int\"") << true;
+    QTest::newRow("Source has value") << QStringLiteral("$source.String hasValue") << true;
+    QTest::newRow("Compound") << QStringLiteral("$\"Edge Int\" < 3 and $source.String includes \"et\"") << true;
+    QTest::newRow("Node attribute") << QStringLiteral("$Int < 5") << false;
+}
+
+void ConditionEvaluatorTest::edgeConditions()
+{
+    QFETCH(QString, condition);
+    QFETCH(bool, valid);
+
+    TestAttributeProvider attributeProvider(2);
+    const auto& edgeIds = attributeProvider.graph().edgeIds();
+
+    QCOMPARE(CreateConditionFnFor::edge(attributeProvider, parseCondition(condition)) != nullptr, valid);
+    QCOMPARE(numDifferences(attributeProvider, edgeIds, condition), 0);
+
+    attributeProvider.setMaterialisable();
+    QCOMPARE(numDifferences(attributeProvider, edgeIds, condition), 0);
+}
+
+void ConditionEvaluatorTest::valueOnLeft_data()
+{
+    QTest::addColumn<QString>("condition");
+    QTest::addColumn<QString>("mirror");
+
+    QTest::newRow("Less than") << QStringLiteral("5 < $Int") << QStringLiteral("$Int > 5");
+    QTest::newRow("Greater than") << QStringLiteral("5 > $Int") << QStringLiteral("$Int < 5");
+    QTest::newRow("Less than or equal") << QStringLiteral("5 <= $Int") << QStringLiteral("$Int >= 5");
+    QTest::newRow("Greater than or equal") << QStringLiteral("5 >= $Int") << QStringLiteral("$Int <= 5");
+}
+
+void ConditionEvaluatorTest::valueOnLeft()
+{
+    QFETCH(QString, condition);
+    QFETCH(QString, mirror);
+
+    TestAttributeProvider attributeProvider(3);
+    const auto& nodeIds = attributeProvider.graph().nodeIds();
+
+    auto conditionFn = CreateConditionFnFor::node(attributeProvider, parseCondition(condition));
+    auto mirrorFn = CreateConditionFnFor::node(attributeProvider, parseCondition(mirror));
+    QVERIFY(conditionFn != nullptr && mirrorFn != nullptr);
+
+    // Both sides of the boundary must be present for the comparison to mean anything
+    int numOnBoundary = 0;
+
+    for(auto nodeId : nodeIds)
+    {
+        QCOMPARE(conditionFn(nodeId), mirrorFn(nodeId));
+
+        if(attributeProvider.intValueOf(nodeId) == 5)
+            numOnBoundary++;
+    }
+
+    QVERIFY(numOnBoundary > 0);
+}
+
+QTEST_APPLESS_MAIN(ConditionEvaluatorTest)
+#include "conditionevaluatortest.moc"
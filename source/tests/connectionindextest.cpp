@@ -0,0 +1,184 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "graph/connectionindex.h"
+
+#include "shared/utils/threadpool.h"
+
+#include <QtTest>
+
+#include <map>
+#include <random>
+#include <vector>
+
+// Checks ConnectionIndex against a std::map holding the same keys
+class ConnectionIndexTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    ThreadPoolSingleton _threadPool;
+
+private slots:
+    void randomChurn_data();
+    void randomChurn();
+    void concurrentInsert();
+};
+
+namespace
+{
+// Both the index and the reference must agree on every key in the range, present or not
+bool matches(const ConnectionIndex& index, const std::map<ConnectionIndex::Key, EdgeId>& reference, int numNodes)
+{
+    if(index.size() != reference.size())
+        return false;
+
+    for(NodeId a(0); a < numNodes; ++a)
+    {
+        for(NodeId b = a; b < numNodes; ++b)
+        {
+            auto key = ConnectionIndex::keyFor(a, b);
+            auto it = reference.find(key);
+            auto expected = it != reference.end() ? it->second : EdgeId();
+
+            if(index.find(key) != expected)
+                return false;
+        }
+    }
+
+    return true;
+}
+} // namespace
+
+void ConnectionIndexTest::randomChurn_data()
+{
+    QTest::addColumn<int>("numNodes");
+    QTest::addColumn<int>("numOperations");
+
+    // Few nodes means a small, densely occupied table, so long clusters and much shifting back
+    QTest::newRow("Dense") << 12 << 20000;
+    QTest::newRow("Sparse") << 200 << 50000;
+}
+
+void ConnectionIndexTest::randomChurn()
+{
+    QFETCH(int, numNodes);
+    QFETCH(int, numOperations);
+
+    std::mt19937 generator(static_cast<std::mt19937::result_type>(numNodes));
+    std::uniform_int_distribution<int> nodeDistribution(0, numNodes - 1);
+    std::uniform_int_distribution<int> operationDistribution(0, 2);
+
+    ConnectionIndex index;
+    std::map<ConnectionIndex::Key, EdgeId> reference;
+    int nextEdgeId = 0;
+
+    for(int i = 0; i < numOperations; i++)
+    {
+        auto key = ConnectionIndex::keyFor(NodeId(nodeDistribution(generator)),
+            NodeId(nodeDistribution(generator)));
+
+        switch(operationDistribution(generator))
+        {
+        case 0:
+        {
+            index.reserve(1);
+            auto slot = index.insert(key);
+
+            // Inserting a key that is already present must find its existing slot
+            auto it = reference.find(key);
+            if(it != reference.end())
+                QCOMPARE(index.head(slot), it->second);
+            else
+            {
+                QVERIFY(index.head(slot).isNull());
+                EdgeId edgeId(nextEdgeId++);
+                index.head(slot) = edgeId;
+                reference.emplace(key, edgeId);
+            }
+            break;
+        }
+
+        case 1:
+            index.erase(key);
+            reference.erase(key);
+            break;
+
+        default:
+        {
+            auto it = reference.find(key);
+            QCOMPARE(index.find(key), it != reference.end() ? it->second : EdgeId());
+            break;
+        }
+        }
+
+        if(i % 1000 == 0)
+            QVERIFY(matches(index, reference, numNodes));
+    }
+
+    QVERIFY(matches(index, reference, numNodes));
+
+    // Copies must be independent of the original
+    auto copy = index;
+    for(const auto& [key, edgeId] : reference)
+        index.erase(key);
+
+    QCOMPARE(index.size(), static_cast<size_t>(0));
+    QVERIFY(matches(copy, reference, numNodes));
+}
+
+void ConnectionIndexTest::concurrentInsert()
+{
+    const int numNodes = 600;
+    const size_t numKeys = 200000;
+
+    // Plenty of duplicates, so that threads race to insert the same key
+    std::mt19937 generator(1);
+    std::uniform_int_distribution<int> nodeDistribution(0, numNodes - 1);
+    std::vector<ConnectionIndex::Key> keys(numKeys);
+    for(auto& key : keys)
+        key = ConnectionIndex::keyFor(NodeId(nodeDistribution(generator)), NodeId(nodeDistribution(generator)));
+
+    ConnectionIndex index;
+    index.reserve(numKeys);
+
+    std::vector<size_t> slotIndices(numKeys);
+    concurrent_for(slotIndices.begin(), slotIndices.end(),
+    [&](std::vector<size_t>::iterator it)
+    {
+        auto i = static_cast<size_t>(std::distance(slotIndices.begin(), it));
+        *it = index.insert(keys[i]);
+    });
+
+    std::map<ConnectionIndex::Key, EdgeId> reference;
+    for(size_t i = 0; i < numKeys; i++)
+    {
+        auto [it, inserted] = reference.emplace(keys[i], EdgeId(static_cast<int>(reference.size())));
+
+        // Every insertion of the same key must have been given the same slot
+        if(inserted)
+            index.head(slotIndices[i]) = it->second;
+        else
+            QCOMPARE(index.head(slotIndices[i]), it->second);
+    }
+
+    QVERIFY(matches(index, reference, numNodes));
+}
+
+QTEST_APPLESS_MAIN(ConnectionIndexTest)
+
+#include "connectionindextest.moc"
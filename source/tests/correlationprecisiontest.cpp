@@ -0,0 +1,234 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "plugins/correlation/correlation.h"
+
+#include <QtTest>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <tuple>
+#include <vector>
+
+// Checks that the single and mixed precision correlation paths stay close to double precision
+class CorrelationPrecisionTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void maximumDeviation_data();
+    void maximumDeviation();
+    void edgeOrder_data();
+    void edgeOrder();
+};
+
+namespace
+{
+enum class Dataset
+{
+    Gaussian,   // Uncorrelated noise
+    Profiles,   // Noisy copies of a few profiles, so many values are close to ±1
+    LogNormal,  // Values spanning several orders of magnitude
+    Offset      // A small signal on top of a large constant
+};
+
+std::vector<CorrelationDataRow> sampleDataRows(Dataset dataset, size_t numRows, size_t numColumns)
+{
+    std::mt19937 generator(static_cast<std::mt19937::result_type>(dataset) + 1);
+    std::normal_distribution<double> normal;
+
+    const size_t numProfiles = 5;
+    std::vector<double> profiles(numProfiles * numColumns);
+    for(auto& value : profiles)
+        value = normal(generator);
+
+    std::vector<double> data(numRows * numColumns);
+
+    for(size_t row = 0; row < numRows; row++)
+    {
+        for(size_t column = 0; column < numColumns; column++)
+        {
+            auto& value = data[(row * numColumns) + column];
+
+            switch(dataset)
+            {
+            case Dataset::Gaussian:
+                value = normal(generator);
+                break;
+
+            case Dataset::Profiles:
+            {
+                auto profile = profiles[((row % numProfiles) * numColumns) + column];
+                value = (row % 2 == 0 ? profile : -profile) + (0.05 * normal(generator));
+                break;
+            }
+
+            case Dataset::LogNormal:
+                value = std::exp(4.0 * normal(generator));
+                break;
+
+            case Dataset::Offset:
+                value = 1.0e6 + normal(generator);
+                break;
+            }
+        }
+    }
+
+    std::vector<CorrelationDataRow> dataRows;
+    dataRows.reserve(numRows);
+
+    for(size_t row = 0; row < numRows; row++)
+        dataRows.emplace_back(data, row, numColumns, NodeId(static_cast<int>(row)));
+
+    return dataRows;
+}
+
+std::vector<CorrelationEdge> allEdges(const std::vector<CorrelationDataRow>& dataRows,
+    CorrelationType correlationType, CorrelationPrecision precision)
+{
+    // With a threshold of 0, every (finite) pair is produced
+    auto correlation = Correlation::create(correlationType, precision);
+    auto edges = correlation->process(dataRows, 0.0, CorrelationPolarity::Both);
+
+    // Compared pairwise, regardless of the order in which each path produces them
+    std::sort(edges.begin(), edges.end(), [](const auto& a, const auto& b)
+    {
+        return std::tie(a._source, a._target) < std::tie(b._source, b._target);
+    });
+
+    return edges;
+}
+} // namespace
+
+void CorrelationPrecisionTest::maximumDeviation_data()
+{
+    QTest::addColumn<int>("dataset");
+    QTest::addColumn<int>("correlationType");
+    QTest::addColumn<int>("precision");
+    QTest::addColumn<double>("tolerance");
+
+    const std::vector<std::tuple<Dataset, const char*>> datasets =
+    {
+        {Dataset::Gaussian,     "Gaussian"},
+        {Dataset::Profiles,     "Profiles"},
+        {Dataset::LogNormal,    "LogNormal"},
+        {Dataset::Offset,       "Offset"}
+    };
+
+    const std::vector<std::tuple<CorrelationType, const char*>> correlationTypes =
+    {
+        {CorrelationType::Pearson,      "Pearson"},
+        {CorrelationType::SpearmanRank, "SpearmanRank"}
+    };
+
+    // Rows are normalised in double precision before they're packed, so the error
+    // is only that of accumulating the dot products of unit vectors
+    const std::vector<std::tuple<CorrelationPrecision, const char*, double>> precisions =
+    {
+        {CorrelationPrecision::Single,  "Single",   1.0e-5},
+        {CorrelationPrecision::Mixed,   "Mixed",    1.0e-6}
+    };
+
+    for(const auto& [dataset, datasetName] : datasets)
+    {
+        for(const auto& [correlationType, correlationTypeName] : correlationTypes)
+        {
+            for(const auto& [precision, precisionName, tolerance] : precisions)
+            {
+                QTest::newRow(qPrintable(QStringLiteral("%1 %2 %3")
+                    .arg(datasetName, correlationTypeName, precisionName)))
+                    << static_cast<int>(dataset) << static_cast<int>(correlationType)
+                    << static_cast<int>(precision) << tolerance;
+            }
+        }
+    }
+}
+
+void CorrelationPrecisionTest::maximumDeviation()
+{
+    QFETCH(int, dataset);
+    QFETCH(int, correlationType);
+    QFETCH(int, precision);
+    QFETCH(double, tolerance);
+
+    auto dataRows = sampleDataRows(static_cast<Dataset>(dataset), 500, 200);
+
+    auto referenceEdges = allEdges(dataRows, static_cast<CorrelationType>(correlationType),
+        CorrelationPrecision::Double);
+    auto edges = allEdges(dataRows, static_cast<CorrelationType>(correlationType),
+        static_cast<CorrelationPrecision>(precision));
+
+    QCOMPARE(edges.size(), referenceEdges.size());
+
+    double maximumDeviation = 0.0;
+
+    for(size_t i = 0; i < edges.size(); i++)
+    {
+        QVERIFY(edges[i]._source == referenceEdges[i]._source);
+        QVERIFY(edges[i]._target == referenceEdges[i]._target);
+
+        maximumDeviation = std::max(maximumDeviation, std::abs(edges[i]._r - referenceEdges[i]._r));
+    }
+
+    QVERIFY2(maximumDeviation <= tolerance, qPrintable(QStringLiteral("Values deviate from "
+        "double precision by up to %1, beyond the tolerance of %2").arg(maximumDeviation).arg(tolerance)));
+}
+
+void CorrelationPrecisionTest::edgeOrder_data()
+{
+    QTest::addColumn<bool>("approximate");
+
+    QTest::newRow("Exact") << false;
+    QTest::newRow("Approximate") << true;
+}
+
+// Edges are added to the graph in the order they're produced, which determines their ids,
+// so every run over the same data must produce them in the same order
+void CorrelationPrecisionTest::edgeOrder()
+{
+    QFETCH(bool, approximate);
+
+    auto dataRows = sampleDataRows(Dataset::Profiles, 2000, 50);
+
+    auto edges = [&]
+    {
+        auto correlation = Correlation::create(CorrelationType::Pearson);
+        correlation->setApproximate(approximate);
+
+        return correlation->process(dataRows, 0.7, CorrelationPolarity::Both);
+    };
+
+    auto first = edges();
+    QVERIFY(!first.empty());
+
+    for(int run = 0; run < 3; run++)
+    {
+        auto next = edges();
+        QCOMPARE(next.size(), first.size());
+
+        for(size_t i = 0; i < first.size(); i++)
+        {
+            QVERIFY2(next[i]._source == first[i]._source && next[i]._target == first[i]._target,
+                qPrintable(QStringLiteral("Edge %1 differs on run %2").arg(i).arg(run + 2)));
+        }
+    }
+}
+
+QTEST_APPLESS_MAIN(CorrelationPrecisionTest)
+
+#include "correlationprecisiontest.moc"
@@ -0,0 +1,142 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "transform/transforms/louvain.h"
+
+#include "shared/utils/cancellable.h"
+#include "shared/utils/threadpool.h"
+
+#include <QtTest>
+
+#include <cmath>
+#include <tuple>
+#include <vector>
+
+// Pins the clusters found for small graphs, which are moved one node at a time; these are the
+// partitions the implementation that preceded the flat CSR levels found, including where moves
+// tie, so any change to the order in which moves are considered shows up here
+class LouvainTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    ThreadPoolSingleton _threadPool;
+
+private slots:
+    void clusters_data();
+    void clusters();
+};
+
+namespace
+{
+using Edge = std::tuple<LouvainGraph::Index, LouvainGraph::Index, double>;
+using Edges = std::vector<Edge>;
+using Clusters = std::vector<size_t>;
+
+// The rows are built as LouvainTransform builds them from the adjacency snapshot; each node's
+// in edges, then its out edges, so that loops appear twice in the row of their node
+LouvainGraph louvainGraph(size_t numNodes, const Edges& edges)
+{
+    LouvainGraph graph;
+
+    for(LouvainGraph::Index node = 0; node < numNodes; node++)
+    {
+        for(const auto& [source, target, weight] : edges)
+        {
+            if(target == node)
+            {
+                graph._neighbours.push_back(source);
+                graph._weights.push_back(weight);
+            }
+        }
+
+        for(const auto& [source, target, weight] : edges)
+        {
+            if(source == node)
+            {
+                graph._neighbours.push_back(target);
+                graph._weights.push_back(weight);
+            }
+        }
+
+        graph._offsets.push_back(graph._neighbours.size());
+    }
+
+    return graph;
+}
+
+// The resolution LouvainTransform uses for the default granularity of 0.5
+double defaultResolution()
+{
+    const auto logMin = std::log10(0.5);
+    const auto logMax = std::log10(30.0);
+
+    return std::pow(10.0f, logMin + (0.5 * (logMax - logMin)));
+}
+} // namespace
+
+Q_DECLARE_METATYPE(Edges)
+Q_DECLARE_METATYPE(Clusters)
+
+void LouvainTest::clusters_data()
+{
+    QTest::addColumn<int>("numNodes");
+    QTest::addColumn<Edges>("edges");
+    QTest::addColumn<Clusters>("expectedClusters");
+
+    // Once the pairs {0, 1}, {2, 3} and {4, 5} are coarsened and {0, 1} has joined {4, 5}, the latter
+    // gains as much by staying put as by joining {2, 3}; the lower community wins
+    QTest::newRow("path") << 6 <<
+        Edges{{1, 0, 1.0}, {4, 5, 1.0}, {4, 2, 1.0}, {1, 5, 1.0}, {2, 3, 1.0}} <<
+        Clusters{1, 1, 0, 0, 0, 0};
+
+    QTest::newRow("bridged cliques") << 8 <<
+        Edges{{0, 1, 1.0}, {0, 2, 1.0}, {0, 3, 1.0}, {1, 2, 1.0}, {1, 3, 1.0}, {2, 3, 1.0},
+            {4, 5, 1.0}, {4, 6, 1.0}, {4, 7, 1.0}, {5, 6, 1.0}, {5, 7, 1.0}, {6, 7, 1.0},
+            {3, 4, 1.0}} <<
+        Clusters{0, 0, 0, 0, 1, 1, 1, 1};
+
+    QTest::newRow("weighted triangles") << 6 <<
+        Edges{{0, 1, 5.0}, {1, 2, 5.0}, {2, 0, 5.0}, {2, 3, 1.0},
+            {3, 4, 5.0}, {4, 5, 5.0}, {5, 3, 5.0}, {0, 5, 4.0}} <<
+        Clusters{0, 0, 0, 1, 1, 1};
+
+    QTest::newRow("loops") << 5 <<
+        Edges{{0, 0, 1.0}, {0, 1, 1.0}, {1, 2, 1.0}, {2, 3, 1.0}, {3, 4, 1.0}, {4, 4, 1.0}, {1, 1, 1.0}} <<
+        Clusters{1, 1, 0, 0, 0};
+}
+
+void LouvainTest::clusters()
+{
+    QFETCH(int, numNodes);
+    QFETCH(Edges, edges);
+    QFETCH(Clusters, expectedClusters);
+
+    double totalWeight = 0.0;
+    for(const auto& edge : edges)
+        totalWeight += std::get<2>(edge);
+
+    Cancellable cancellable;
+    auto clusters = computeLouvain(louvainGraph(static_cast<size_t>(numNodes), edges),
+        totalWeight, defaultResolution(), cancellable);
+
+    QCOMPARE(clusters, expectedClusters);
+}
+
+QTEST_APPLESS_MAIN(LouvainTest)
+#include "louvaintest.moc"
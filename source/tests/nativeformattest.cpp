@@ -0,0 +1,549 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "loading/nativeformat.h"
+#include "graph/mutablegraph.h"
+
+#include "shared/graph/grapharray.h"
+#include "shared/utils/container.h"
+#include "shared/utils/threadpool.h"
+
+#include <QtTest>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtEndian>
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+class NativeFormatTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    ThreadPoolSingleton _threadPool;
+
+private slots:
+    void roundTrip();
+    void gappedIds();
+    void emptyGraph();
+    void corruptFile();
+    void corruptHeader();
+    void corruptGraph();
+};
+
+namespace
+{
+class TestParser : public IParser
+{
+public:
+    bool parse(const QUrl&, IGraphModel*) override { return false; }
+};
+
+void makeRandomGraph(MutableGraph& graph, int numNodes, int numEdges, unsigned int seed)
+{
+    std::mt19937 generator(seed);
+    auto random = [&generator](int max) { return std::uniform_int_distribution<int>(0, max - 1)(generator); };
+
+    graph.performTransaction([&](IMutableGraph&)
+    {
+        for(int i = 0; i < numNodes; i++)
+            graph.addNode();
+
+        for(int i = 0; i < numEdges; i++)
+            graph.addEdge(NodeId(random(numNodes)), NodeId(random(numNodes)));
+    });
+}
+
+QByteArray randomBytes(int size, unsigned int seed)
+{
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> distribution(0, 15);
+
+    // Only a few distinct values, so that the data compresses
+    QByteArray byteArray(size, '\0');
+    for(auto& byte : byteArray)
+        byte = static_cast<char>('a' + distribution(generator));
+
+    return byteArray;
+}
+
+std::vector<NodeId> sortedNodeIds(const IGraph& graph)
+{
+    auto nodeIds = graph.nodeIds();
+    std::sort(nodeIds.begin(), nodeIds.end());
+    return nodeIds;
+}
+
+std::vector<EdgeId> sortedEdgeIds(const IGraph& graph)
+{
+    auto edgeIds = graph.edgeIds();
+    std::sort(edgeIds.begin(), edgeIds.end());
+    return edgeIds;
+}
+
+void compareGraphs(const IGraph& a, const IGraph& b)
+{
+    QCOMPARE(a.numNodes(), b.numNodes());
+    QCOMPARE(a.numEdges(), b.numEdges());
+    QVERIFY(sortedNodeIds(a) == sortedNodeIds(b));
+    QVERIFY(sortedEdgeIds(a) == sortedEdgeIds(b));
+
+    for(auto edgeId : a.edgeIds())
+    {
+        const auto& edgeA = a.edgeById(edgeId);
+        const auto& edgeB = b.edgeById(edgeId);
+
+        QCOMPARE(edgeA.sourceId(), edgeB.sourceId());
+        QCOMPARE(edgeA.targetId(), edgeB.targetId());
+    }
+}
+
+QByteArray nodeNamesAsBinary(const MutableGraph& graph, const NodeArray<QString>& nodeNames)
+{
+    Progressable progressable;
+
+    return NativeFormat::graphArrayAsBinary(nodeNames, graph.nodeIds(), progressable,
+    [](QDataStream& stream, const QString& nodeName)
+    {
+        stream << nodeName;
+    });
+}
+
+// Writes the graph, the names of its nodes and some opaque data, then reads them all back
+void checkRoundTrip(const MutableGraph& graph, const QByteArray& opaqueData)
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    auto filePath = dir.filePath(QStringLiteral("roundtrip"));
+
+    NodeArray<QString> nodeNames(graph);
+    for(auto nodeId : graph.nodeIds())
+        nodeNames[nodeId] = QStringLiteral("Node %1").arg(static_cast<int>(nodeId));
+
+    // Values that single precision can't represent exactly
+    EdgeArray<double> edgeValues(graph);
+    for(auto edgeId : graph.edgeIds())
+        edgeValues[edgeId] = 1.0 / (static_cast<int>(edgeId) + 3);
+
+    Progressable progressable;
+
+    json header;
+    header["version"] = 6;
+
+    std::vector<NativeFormat::Section> sections;
+    sections.push_back({"graph", NativeFormat::graphAsBinary(graph, progressable)});
+    sections.push_back({"nodeNames", nodeNamesAsBinary(graph, nodeNames)});
+    sections.push_back({"edgeValues", NativeFormat::graphArrayAsBinary(edgeValues, graph.edgeIds(), progressable,
+        [](QDataStream& stream, double value) { stream << value; }, QDataStream::DoublePrecision)});
+    sections.push_back({"empty", {}});
+    sections.push_back({"opaque", opaqueData});
+
+    QVERIFY(NativeFormat::write(filePath, header, sections, progressable));
+
+    qint64 dataOffset = 0;
+    auto readHeader = NativeFormat::readHeader(filePath, dataOffset);
+    QVERIFY(readHeader.is_object());
+    QCOMPARE(readHeader["version"].get<int>(), 6);
+    QVERIFY(dataOffset > NativeFormat::Magic.size());
+
+    NativeFormat::Sections readSections;
+    QVERIFY(NativeFormat::readSections(filePath, readHeader, dataOffset, readSections, progressable));
+    QCOMPARE(readSections.size(), sections.size());
+
+    for(const auto& section : sections)
+    {
+        QVERIFY(u::contains(readSections, section._name));
+        QVERIFY(readSections.at(section._name) == section._data);
+    }
+
+    MutableGraph loadedGraph;
+    TestParser parser;
+    QVERIFY(NativeFormat::parseGraph(readSections.at("graph"), loadedGraph, parser));
+    compareGraphs(graph, loadedGraph);
+
+    int numNodeNames = 0;
+    QVERIFY(NativeFormat::forEachBinaryNodeArray(readSections.at("nodeNames"), loadedGraph, progressable,
+    [&](QDataStream& stream, NodeId nodeId)
+    {
+        QString nodeName;
+        stream >> nodeName;
+
+        QCOMPARE(nodeName, nodeNames.get(nodeId));
+        numNodeNames++;
+    }));
+
+    QCOMPARE(numNodeNames, graph.numNodes());
+
+    int numEdgeValues = 0;
+    QVERIFY(NativeFormat::forEachBinaryEdgeArray(readSections.at("edgeValues"), loadedGraph, progressable,
+    [&](QDataStream& stream, EdgeId edgeId)
+    {
+        double value = 0.0;
+        stream >> value;
+
+        QCOMPARE(value, edgeValues.get(edgeId));
+        numEdgeValues++;
+    }, QDataStream::DoublePrecision));
+
+    QCOMPARE(numEdgeValues, graph.numEdges());
+}
+
+// Returns the path of a copy of a valid file, for corrupting
+QString writeValidFile(const QTemporaryDir& dir)
+{
+    MutableGraph graph;
+    makeRandomGraph(graph, 100, 300, 4);
+
+    // Values that single precision can't represent exactly
+    EdgeArray<double> edgeValues(graph);
+    for(auto edgeId : graph.edgeIds())
+        edgeValues[edgeId] = 1.0 / (static_cast<int>(edgeId) + 3);
+
+    Progressable progressable;
+
+    json header;
+    header["version"] = 6;
+
+    std::vector<NativeFormat::Section> sections;
+    sections.push_back({"graph", NativeFormat::graphAsBinary(graph, progressable)});
+    sections.push_back({"opaque", randomBytes(NativeFormat::ChunkSize + 1000, 5)});
+
+    auto filePath = dir.filePath(QStringLiteral("valid"));
+    if(!NativeFormat::write(filePath, header, sections, progressable))
+        return {};
+
+    return filePath;
+}
+
+QByteArray readFile(const QString& filePath)
+{
+    QFile file(filePath);
+    if(!file.open(QIODevice::ReadOnly))
+        return {};
+
+    return file.readAll();
+}
+
+bool writeFile(const QString& filePath, const QByteArray& byteArray)
+{
+    QFile file(filePath);
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+
+    return file.write(byteArray) == byteArray.size();
+}
+
+// Whether or not all of the sections of a file can be read
+bool readable(const QString& filePath)
+{
+    qint64 dataOffset = 0;
+    auto header = NativeFormat::readHeader(filePath, dataOffset);
+    if(!header.is_object())
+        return false;
+
+    Progressable progressable;
+    NativeFormat::Sections sections;
+    return NativeFormat::readSections(filePath, header, dataOffset, sections, progressable);
+}
+
+template<typename Fn>
+QByteArray graphBinary(const Fn& fn)
+{
+    QByteArray byteArray;
+    QDataStream stream(&byteArray, QIODevice::WriteOnly);
+    NativeFormat::initialiseStream(stream);
+
+    fn(stream);
+
+    return byteArray;
+}
+
+bool parseGraph(const QByteArray& byteArray)
+{
+    MutableGraph graph;
+    TestParser parser;
+
+    return NativeFormat::parseGraph(byteArray, graph, parser);
+}
+} // namespace
+
+void NativeFormatTest::roundTrip()
+{
+    MutableGraph graph;
+    makeRandomGraph(graph, 1000, 5000, 1);
+
+    // More than a single chunk
+    checkRoundTrip(graph, randomBytes((NativeFormat::ChunkSize * 2) + 1000, 2));
+}
+
+void NativeFormatTest::gappedIds()
+{
+    MutableGraph graph;
+    makeRandomGraph(graph, 1000, 5000, 3);
+
+    std::mt19937 generator(3);
+    std::uniform_int_distribution<int> distribution(0, 999);
+
+    graph.performTransaction([&](IMutableGraph&)
+    {
+        for(int i = 0; i < 100; i++)
+        {
+            NodeId nodeId(distribution(generator));
+            if(graph.containsNodeId(nodeId))
+                graph.removeNode(nodeId);
+
+            EdgeId edgeId(distribution(generator));
+            if(graph.containsEdgeId(edgeId))
+                graph.removeEdge(edgeId);
+        }
+    });
+
+    QVERIFY(graph.numNodes() < 1000);
+    QVERIFY(graph.numEdges() < 5000);
+
+    checkRoundTrip(graph, randomBytes(1000, 4));
+}
+
+void NativeFormatTest::emptyGraph()
+{
+    MutableGraph graph;
+    checkRoundTrip(graph, {});
+}
+
+void NativeFormatTest::corruptFile()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    auto validFilePath = writeValidFile(dir);
+    QVERIFY(readable(validFilePath));
+
+    auto valid = readFile(validFilePath);
+    auto filePath = dir.filePath(QStringLiteral("corrupt"));
+
+    // Not a chunked file at all
+    QVERIFY(writeFile(filePath, QByteArrayLiteral("[{\"version\":5}]")));
+    QVERIFY(!readable(filePath));
+
+    // Truncated in the magic string, the header offset, the data and the header
+    for(auto size : {4, NativeFormat::Magic.size() + 2, NativeFormat::Magic.size() + 10,
+        valid.size() / 2, valid.size() - 1})
+    {
+        QVERIFY(writeFile(filePath, valid.left(size)));
+        QVERIFY2(!readable(filePath), qPrintable(QStringLiteral("Truncated to %1").arg(size)));
+    }
+
+    // A header offset that is beyond the end of the file
+    auto corrupt = valid;
+    corrupt[NativeFormat::Magic.size() + 7] = static_cast<char>(0x7f);
+    QVERIFY(writeFile(filePath, corrupt));
+    QVERIFY(!readable(filePath));
+
+    qint64 dataOffset = 0;
+    QVERIFY(NativeFormat::readHeader(validFilePath, dataOffset).is_object());
+
+    auto headerOffset = static_cast<int>(qFromLittleEndian<quint64>(valid.constData() + NativeFormat::Magic.size()));
+    QVERIFY(headerOffset > dataOffset && headerOffset < valid.size());
+
+    // A header offset that is within the data
+    corrupt = valid;
+    qToLittleEndian<quint64>(static_cast<quint64>(dataOffset), corrupt.data() + NativeFormat::Magic.size());
+    QVERIFY(writeFile(filePath, corrupt));
+    QVERIFY(!readable(filePath));
+
+    // Damaged compressed data, at the start of the data and at the very end
+    for(auto position : {static_cast<int>(dataOffset) + 1, headerOffset - 1})
+    {
+        corrupt = valid;
+        corrupt[position] = static_cast<char>(~corrupt.at(position));
+
+        QVERIFY(writeFile(filePath, corrupt));
+        QVERIFY2(!readable(filePath), qPrintable(QStringLiteral("Corrupted at %1").arg(position)));
+    }
+}
+
+void NativeFormatTest::corruptHeader()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    auto filePath = writeValidFile(dir);
+
+    qint64 dataOffset = 0;
+    const auto validHeader = NativeFormat::readHeader(filePath, dataOffset);
+    QVERIFY(validHeader.is_object());
+
+    auto readSections = [&](const json& header)
+    {
+        Progressable progressable;
+        NativeFormat::Sections sections;
+        return NativeFormat::readSections(filePath, header, dataOffset, sections, progressable);
+    };
+
+    QVERIFY(readSections(validHeader));
+
+    auto header = validHeader;
+    header["compression"] = "zstd";
+    QVERIFY(!readSections(header));
+
+    header = validHeader;
+    header["chunkSize"] = 0;
+    QVERIFY(!readSections(header));
+
+    header = validHeader;
+    header.erase("sections");
+    QVERIFY(!readSections(header));
+
+    // The number of chunks doesn't match the size
+    header = validHeader;
+    header["sections"][1]["chunks"].erase(0);
+    QVERIFY(!readSections(header));
+
+    header = validHeader;
+    header["sections"][0]["size"] = -1;
+    QVERIFY(!readSections(header));
+
+    // A size that would overflow when rounded up to a whole number of chunks
+    header = validHeader;
+    header["sections"][0]["size"] = std::numeric_limits<int>::max();
+    QVERIFY(!readSections(header));
+
+    header = validHeader;
+    header["sections"][1]["name"] = header["sections"][0]["name"];
+    QVERIFY(!readSections(header));
+
+    // A size that its compressed chunk couldn't possibly hold
+    header = validHeader;
+    header["sections"][0]["size"] = NativeFormat::ChunkSize;
+    QVERIFY(!readSections(header));
+
+    // Compressed sizes that don't account for all of the data
+    header = validHeader;
+    header["sections"].erase(1);
+    QVERIFY(!readSections(header));
+
+    // Compressed sizes that run beyond the end of the data
+    header = validHeader;
+    header["sections"][1]["chunks"][0] = std::numeric_limits<int>::max();
+    QVERIFY(!readSections(header));
+
+    // Compressed sizes that are shifted, so that each chunk is misaligned
+    header = validHeader;
+    auto firstCompressedSize = header["sections"][0]["chunks"][0].get<int>();
+    header["sections"][0]["chunks"][0] = firstCompressedSize - 1;
+    header["sections"][1]["chunks"][0] = header["sections"][1]["chunks"][0].get<int>() + 1;
+    QVERIFY(!readSections(header));
+}
+
+void NativeFormatTest::corruptGraph()
+{
+    MutableGraph graph;
+    makeRandomGraph(graph, 100, 300, 6);
+
+    Progressable progressable;
+    auto valid = NativeFormat::graphAsBinary(graph, progressable);
+    QVERIFY(parseGraph(valid));
+
+    QVERIFY(!parseGraph(valid.left(valid.size() - 1)));
+    QVERIFY(!parseGraph(valid.left(valid.size() / 2)));
+    QVERIFY(!parseGraph({}));
+
+    QVERIFY(!parseGraph(graphBinary([](QDataStream& stream)
+    {
+        stream << qint32(0) << qint32(-1);
+    })));
+
+    // More nodes than there could possibly be data for
+    QVERIFY(!parseGraph(graphBinary([](QDataStream& stream)
+    {
+        stream << std::numeric_limits<qint32>::max() << std::numeric_limits<qint32>::max() << qint32(0);
+    })));
+
+    // More nodes than there are ids
+    QVERIFY(!parseGraph(graphBinary([](QDataStream& stream)
+    {
+        stream << qint32(1) << qint32(2) << qint32(0) << qint32(1) << qint32(0) << qint32(0);
+    })));
+
+    // More ids than a section of this size could account for, and an id beyond those declared;
+    // neither is allocated for before being rejected
+    QVERIFY(!parseGraph(graphBinary([](QDataStream& stream)
+    {
+        stream << std::numeric_limits<qint32>::max() << qint32(1) << qint32(0) << qint32(0) << qint32(0);
+    })));
+
+    QVERIFY(!parseGraph(graphBinary([](QDataStream& stream)
+    {
+        stream << qint32(2) << qint32(1) << std::numeric_limits<qint32>::max() << qint32(0) << qint32(0);
+    })));
+
+    QVERIFY(!parseGraph(graphBinary([](QDataStream& stream)
+    {
+        stream << qint32(1) << qint32(1) << qint32(0) <<
+            qint32(1) << qint32(1) << std::numeric_limits<qint32>::max() << qint32(0) << qint32(0);
+    })));
+
+    QVERIFY(!parseGraph(graphBinary([](QDataStream& stream)
+    {
+        stream << qint32(2) << qint32(2) << qint32(0) << qint32(0) << qint32(0) << qint32(0);
+    })));
+
+    QVERIFY(!parseGraph(graphBinary([](QDataStream& stream)
+    {
+        stream << qint32(2) << qint32(2) << qint32(0) << qint32(-5) << qint32(0) << qint32(0);
+    })));
+
+    // An edge whose target doesn't exist
+    QVERIFY(!parseGraph(graphBinary([](QDataStream& stream)
+    {
+        stream << qint32(3) << qint32(2) << qint32(0) << qint32(1) <<
+            qint32(1) << qint32(1) << qint32(0) << qint32(0) << qint32(2);
+    })));
+
+    // Duplicate edge ids
+    QVERIFY(!parseGraph(graphBinary([](QDataStream& stream)
+    {
+        stream << qint32(2) << qint32(2) << qint32(0) << qint32(1) <<
+            qint32(2) << qint32(2) << qint32(0) << qint32(0) << qint32(1) << qint32(0) << qint32(1) << qint32(0);
+    })));
+
+    // Ids with gaps, where the deleted elements' ids are still declared
+    QVERIFY(parseGraph(graphBinary([](QDataStream& stream)
+    {
+        stream << qint32(3) << qint32(2) << qint32(0) << qint32(2) <<
+            qint32(4) << qint32(2) << qint32(0) << qint32(0) << qint32(2) << qint32(3) << qint32(2) << qint32(0);
+    })));
+
+    // A node array that refers to a node that doesn't exist
+    auto nodeArray = graphBinary([](QDataStream& stream)
+    {
+        stream << qint32(1) << qint32(100) << 1.0f;
+    });
+
+    TestParser parser;
+    QVERIFY(!NativeFormat::forEachBinaryNodeArray(nodeArray, graph, parser, [](QDataStream& stream, NodeId)
+    {
+        float value = 0.0f;
+        stream >> value;
+    }));
+}
+
+QTEST_APPLESS_MAIN(NativeFormatTest)
+#include "nativeformattest.moc"
@@ -0,0 +1,335 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "loading/nativeloader.h"
+#include "loading/nativeformat.h"
+#include "attributes/attribute.h"
+#include "graph/mutablegraph.h"
+
+#include "shared/graph/igraphmodel.h"
+#include "shared/plugins/iplugin.h"
+#include "shared/utils/container.h"
+#include "shared/ui/visualisations/ielementvisual.h"
+#include "shared/utils/threadpool.h"
+
+#include <QtTest>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QUrl>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <zlib.h>
+
+// Loads files that were saved in each of the formats that have been written, through the loader,
+// checking that the graph, the content and the plugin's data all arrive where they should
+class NativeLoaderTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    ThreadPoolSingleton _threadPool;
+
+private slots:
+    void load_data();
+    void load();
+};
+
+namespace
+{
+class NullElementVisual : public IElementVisual
+{
+public:
+    float size() const override { return 0.0f; }
+    QColor outerColor() const override { return {}; }
+    QColor innerColor() const override { return {}; }
+    QString text() const override { return {}; }
+    Flags<VisualFlags> state() const override { return VisualFlags::None; }
+};
+
+class TestGraphModel : public IGraphModel
+{
+private:
+    MutableGraph _graph;
+    std::map<NodeId, QString> _nodeNames;
+    std::map<QString, Attribute> _attributes;
+    NullElementVisual _visual;
+
+protected:
+    IMutableGraph& mutableGraphImpl() override { return _graph; }
+    const IMutableGraph& mutableGraphImpl() const override { return _graph; }
+    const IGraph& graphImpl() const override { return _graph; }
+
+    const IElementVisual& nodeVisualImpl(NodeId) const override { return _visual; }
+    const IElementVisual& edgeVisualImpl(EdgeId) const override { return _visual; }
+
+public:
+    QString nodeName(NodeId nodeId) const override
+    {
+        return u::contains(_nodeNames, nodeId) ? _nodeNames.at(nodeId) : QString();
+    }
+
+    void setNodeName(NodeId nodeId, const QString& name) override { _nodeNames[nodeId] = name; }
+
+    IAttribute& createAttribute(QString name) override { return _attributes[name]; }
+
+    const IAttribute* attributeByName(const QString& name) const override
+    {
+        return u::contains(_attributes, name) ? &_attributes.at(name) : nullptr;
+    }
+
+    bool attributeExists(const QString& name) const override { return u::contains(_attributes, name); }
+
+    std::vector<QString> attributeNames(ElementType) const override
+    {
+        std::vector<QString> names;
+        for(const auto& attribute : _attributes)
+            names.push_back(attribute.first);
+
+        return names;
+    }
+};
+
+class TestPlugin : public IPlugin
+{
+public:
+    QStringList loadableUrlTypeNames() const override { return {}; }
+    QString individualDescriptionForUrlTypeName(const QString&) const override { return {}; }
+    QString collectiveDescriptionForUrlTypeName(const QString&) const override { return {}; }
+    QStringList extensionsForUrlTypeName(const QString&) const override { return {}; }
+
+    std::unique_ptr<IPluginInstance> createInstance() override { return nullptr; }
+
+    QString name() const override { return QStringLiteral("Test"); }
+    QString description() const override { return {}; }
+    QString imageSource() const override { return {}; }
+
+    int dataVersion() const override { return 1; }
+
+    QStringList identifyUrl(const QUrl&) const override { return {}; }
+    QString failureReason(const QUrl&) const override { return {}; }
+
+    bool editable() const override { return false; }
+    bool directed() const override { return true; }
+
+    QString parametersQmlPath() const override { return {}; }
+    QString qmlPath() const override { return {}; }
+};
+
+// Keeps whatever the loader gives it
+class TestPluginInstance : public IPluginInstance
+{
+private:
+    TestPlugin _plugin;
+
+public:
+    QByteArray _data;
+    std::map<QString, QByteArray> _sections;
+    bool _sectionsLoaded = false;
+
+    void initialise(const IPlugin*, IDocument*, const IParserThread*) override {}
+    std::unique_ptr<IParser> parserForUrlTypeName(const QString&) override { return nullptr; }
+
+    void applyParameter(const QString&, const QVariant&) override {}
+
+    QStringList defaultTransforms() const override { return {}; }
+    QStringList defaultVisualisations() const override { return {}; }
+
+    QByteArray save(IMutableGraph&, Progressable&) const override { return {}; }
+    bool load(const QByteArray& data, int, IMutableGraph&, IParser&) override
+    {
+        _data = data;
+        return true;
+    }
+
+    bool saveSections(IMutableGraph&, Progressable&, const SaveSectionFn&) const override { return true; }
+    bool loadSections(const std::map<QString, QByteArray>& sections, int, IMutableGraph&, IParser&) override
+    {
+        _sections = sections;
+        _sectionsLoaded = true;
+        return true;
+    }
+
+    const IPlugin* plugin() override { return &_plugin; }
+};
+
+enum class Format
+{
+    Json,
+    GzippedJson,
+    Chunked
+};
+
+const json TestHeader = {{"pluginName", "Test"}, {"pluginDataVersion", 1}};
+const json TestPluginData = {{"userNodeData", {{"vectors", json::array()}, {"ids", json::array()}}}};
+
+// Three nodes in a line, whose ids have a gap, as if one had been deleted before saving
+json legacyBody()
+{
+    json body;
+
+    body["graph"]["nodes"] = {{{"id", "0"}}, {{"id", "2"}}, {{"id", "3"}}};
+    body["graph"]["edges"] = {{{"id", "0"}, {"source", "0"}, {"target", "2"}},
+        {{"id", "1"}, {"source", "2"}, {"target", "3"}}};
+    body["nodeNames"] = {{{"id", 0}, {"value", "a"}}, {{"id", 2}, {"value", "b"}}, {{"id", 3}, {"value", "c"}}};
+    body["transforms"] = {"Remove Leaves"};
+    body["pluginData"] = TestPluginData;
+
+    return body;
+}
+
+QByteArray gzip(const QByteArray& byteArray)
+{
+    z_stream stream = {};
+
+    // 16 more window bits write a gzip header, rather than a zlib one
+    if(deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return {};
+
+    QByteArray compressed(static_cast<int>(deflateBound(&stream, static_cast<uLong>(byteArray.size()))) + 32, '\0');
+
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(byteArray.constData())); // NOLINT
+    stream.avail_in = static_cast<uInt>(byteArray.size());
+    stream.next_out = reinterpret_cast<Bytef*>(compressed.data()); // NOLINT
+    stream.avail_out = static_cast<uInt>(compressed.size());
+
+    auto ret = deflate(&stream, Z_FINISH);
+    compressed.resize(static_cast<int>(stream.total_out));
+    deflateEnd(&stream);
+
+    return ret == Z_STREAM_END ? compressed : QByteArray();
+}
+
+bool writeFile(const QString& filePath, const QByteArray& byteArray)
+{
+    QFile file(filePath);
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+
+    return file.write(byteArray) == byteArray.size();
+}
+
+bool writeChunkedFile(const QString& filePath, const QByteArray& userNodeData)
+{
+    MutableGraph graph;
+    auto firstNodeId = graph.bulkAddNodes(4);
+    graph.addEdge(firstNodeId, firstNodeId + 2);
+    graph.addEdge(firstNodeId + 2, firstNodeId + 3);
+    graph.removeNode(firstNodeId + 1);
+
+    Progressable progressable;
+
+    json content;
+    content["transforms"] = {"Remove Leaves"};
+
+    std::vector<NativeFormat::Section> sections;
+    sections.push_back({"graph", NativeFormat::graphAsBinary(graph, progressable)});
+    sections.push_back({"content", QByteArray::fromStdString(content.dump())});
+    sections.push_back({NativeFormat::PluginSectionPrefix + "userNodeData", userNodeData});
+    sections.push_back({"pluginData", QByteArray::fromStdString(json::object().dump())});
+
+    auto header = TestHeader;
+    header["version"] = 6;
+
+    return NativeFormat::write(filePath, header, sections, progressable);
+}
+} // namespace
+
+Q_DECLARE_METATYPE(Format)
+
+void NativeLoaderTest::load_data()
+{
+    QTest::addColumn<Format>("format");
+    QTest::addColumn<int>("version");
+
+    QTest::newRow("version 4") << Format::Json << 4;
+    QTest::newRow("version 5") << Format::Json << 5;
+    QTest::newRow("version 5, gzipped") << Format::GzippedJson << 5;
+    QTest::newRow("version 6") << Format::Chunked << 6;
+}
+
+void NativeLoaderTest::load()
+{
+    QFETCH(Format, format);
+    QFETCH(int, version);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    auto filePath = dir.filePath(QStringLiteral("file.graphia"));
+    const auto userNodeData = QByteArrayLiteral("binary user data");
+
+    if(format == Format::Chunked)
+        QVERIFY(writeChunkedFile(filePath, userNodeData));
+    else
+    {
+        auto header = TestHeader;
+        header["version"] = version;
+
+        auto byteArray = QByteArray::fromStdString(json::array({header, legacyBody()}).dump());
+
+        if(format == Format::GzippedJson)
+            byteArray = gzip(byteArray);
+
+        QVERIFY(writeFile(filePath, byteArray));
+    }
+
+    auto url = QUrl::fromLocalFile(filePath);
+    QVERIFY(Loader::canOpen(url));
+    QCOMPARE(Loader::pluginNameFor(url), QStringLiteral("Test"));
+
+    TestGraphModel graphModel;
+    TestPluginInstance pluginInstance;
+
+    Loader loader;
+    loader.setPluginInstance(&pluginInstance);
+    QVERIFY(loader.parse(url, &graphModel));
+
+    const auto& graph = graphModel.mutableGraph();
+    QCOMPARE(graph.numNodes(), 3);
+    QCOMPARE(graph.numEdges(), 2);
+    QVERIFY(!graph.containsNodeId(1));
+    QVERIFY(graph.containsNodeId(3));
+
+    QCOMPARE(loader.transforms(), QStringList{QStringLiteral("Remove Leaves")});
+
+    auto pluginData = json::parse(pluginInstance._data.begin(), pluginInstance._data.end(), nullptr, false);
+    QVERIFY(pluginData.is_object());
+
+    if(format == Format::Chunked)
+    {
+        // The plugin's own sections are passed to it, without their prefix
+        QVERIFY(pluginInstance._sectionsLoaded);
+        QCOMPARE(pluginInstance._sections.size(), static_cast<size_t>(1));
+        QCOMPARE(pluginInstance._sections.at(QStringLiteral("userNodeData")), userNodeData);
+        QVERIFY(pluginData.empty());
+    }
+    else
+    {
+        QVERIFY(!pluginInstance._sectionsLoaded);
+        QVERIFY(pluginData == TestPluginData);
+
+        QCOMPARE(graphModel.nodeName(0), QStringLiteral("a"));
+        QCOMPARE(graphModel.nodeName(3), QStringLiteral("c"));
+    }
+}
+
+QTEST_APPLESS_MAIN(NativeLoaderTest)
+#include "nativeloadertest.moc"
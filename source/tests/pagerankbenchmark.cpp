@@ -0,0 +1,154 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "graph/mutablegraph.h"
+#include "graph/adjacencysnapshot.h"
+#include "transform/transforms/pagerank.h"
+#include "referencepagerank.h"
+
+#include "shared/utils/cancellable.h"
+#include "shared/utils/threadpool.h"
+
+#include <QtTest>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Times the PageRank iterations, given the adjacency snapshot; each case is also timed
+// using the implementation that the current one replaced, and their ranks compared
+class PageRankBenchmark : public QObject
+{
+    Q_OBJECT
+
+private:
+    ThreadPoolSingleton _threadPool;
+
+private slots:
+    void iterations_data();
+    void iterations();
+};
+
+void PageRankBenchmark::iterations_data()
+{
+    QTest::addColumn<int>("numNodes");
+    QTest::addColumn<int>("edgesPerNode");
+    QTest::addColumn<int>("numPaths");
+    QTest::addColumn<bool>("reference");
+
+    for(bool reference : {false, true})
+    {
+        auto name = [reference](const char* description)
+        {
+            return QByteArray(description) + (reference ? ", reference" : "");
+        };
+
+        QTest::newRow(name("100k").constData()) << 100000 << 4 << 0 << reference;
+        QTest::newRow(name("300k").constData()) << 300000 << 4 << 0 << reference;
+        QTest::newRow(name("1M").constData()) << 1000000 << 4 << 0 << reference;
+
+        // Many small components, which are batched rather than computed individually
+        QTest::newRow(name("100k, 25k paths").constData()) << 100000 << 4 << 25000 << reference;
+    }
+}
+
+void PageRankBenchmark::iterations()
+{
+    QFETCH(int, numNodes);
+    QFETCH(int, edgesPerNode);
+    QFETCH(int, numPaths);
+    QFETCH(bool, reference);
+
+    const int PathLength = 4;
+
+    MutableGraph graph;
+    auto firstNodeId = graph.bulkAddNodes(static_cast<size_t>(numNodes + (numPaths * PathLength)));
+
+    // Preferential attachment; each node connects to edgesPerNode earlier nodes, chosen
+    // in proportion to their degree, by picking an endpoint of a random existing edge
+    std::mt19937 generator(1);
+    std::vector<std::pair<NodeId, NodeId>> edges;
+    edges.reserve(static_cast<size_t>((numNodes * edgesPerNode) + (numPaths * (PathLength - 1))));
+
+    for(int i = 1; i < numNodes; i++)
+    {
+        for(int j = 0; j < edgesPerNode; j++)
+        {
+            NodeId targetId = firstNodeId;
+
+            if(!edges.empty())
+            {
+                std::uniform_int_distribution<size_t> distribution(0, (edges.size() * 2) - 1);
+                auto endpoint = distribution(generator);
+                const auto& edge = edges.at(endpoint / 2);
+                targetId = (endpoint % 2) == 0 ? edge.first : edge.second;
+            }
+
+            edges.emplace_back(firstNodeId + i, targetId);
+        }
+    }
+
+    for(int path = 0; path < numPaths; path++)
+    {
+        auto pathNodeId = firstNodeId + numNodes + (path * PathLength);
+
+        for(int i = 1; i < PathLength; i++)
+            edges.emplace_back(pathNodeId + (i - 1), pathNodeId + i);
+    }
+
+    graph.bulkAddEdges(edges);
+
+    auto adjacency = graph.adjacencySnapshot();
+    Cancellable cancellable;
+
+    if(reference)
+    {
+        NodeArray<float> referenceRanks(graph);
+        QBENCHMARK
+        {
+            referenceRanks = Reference::computePageRank(graph);
+        }
+
+        auto result = computePageRank(*adjacency, cancellable);
+        QCOMPARE(result._ranks.size(), adjacency->numNodes());
+
+        float maxDifference = 0.0f;
+        for(size_t index = 0; index < result._ranks.size(); index++)
+        {
+            auto difference = std::abs(result._ranks[index] - referenceRanks[adjacency->nodeIdAt(index)]);
+            maxDifference = std::max(maxDifference, difference);
+        }
+
+        QVERIFY2(maxDifference < 1e-4f, qPrintable(QStringLiteral("Ranks differ by up to %1").arg(maxDifference)));
+    }
+    else
+    {
+        PageRankResult result;
+        QBENCHMARK
+        {
+            result = computePageRank(*adjacency, cancellable);
+        }
+
+        QCOMPARE(result._ranks.size(), adjacency->numNodes());
+    }
+}
+
+QTEST_APPLESS_MAIN(PageRankBenchmark)
+#include "pagerankbenchmark.moc"
@@ -0,0 +1,137 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REFERENCEPAGERANK_H
+#define REFERENCEPAGERANK_H
+
+#include "graph/graph.h"
+#include "graph/componentmanager.h"
+
+#include "shared/graph/grapharray.h"
+#include "shared/graph/igraphcomponent.h"
+
+#include <blaze/Blaze.h>
+
+#include <map>
+#include <deque>
+#include <limits>
+#include <cmath>
+
+// The per component PageRank that the one over the adjacency snapshot replaced, kept as
+// PageRankTransform had it, less its progress reporting, so that the two can be compared
+namespace Reference
+{
+inline NodeArray<float> computePageRank(Graph& graph)
+{
+    const float PAGERANK_DAMPING = 0.8f;
+    const float PAGERANK_EPSILON = 1e-6f;
+    const float PAGERANK_ACCELERATION_MINIMUM = 1e-10f;
+    const int PAGERANK_ITERATION_LIMIT = 1000;
+    const int AVG_COUNT = 10;
+
+    using VectorType = blaze::DynamicVector<float>;
+
+    NodeArray<float> pageRankScores(graph);
+
+    ComponentManager componentManager(graph);
+
+    for(auto componentId : componentManager.componentIds())
+    {
+        const IGraphComponent* component = componentManager.componentById(componentId);
+        auto componentNodeCount = static_cast<int>(component->nodeIds().size());
+
+        // Map NodeIds to Matrix index
+        std::map<NodeId, int> nodeToIndexMap;
+        for(auto nodeId : component->nodeIds())
+        {
+            auto index = static_cast<int>(nodeToIndexMap.size());
+            nodeToIndexMap[nodeId] = index;
+        }
+
+        VectorType pageRankVector(componentNodeCount, 1.0f / componentNodeCount);
+        VectorType newPageRankVector(componentNodeCount);
+        VectorType delta(componentNodeCount);
+        float change = std::numeric_limits<float>::max();
+        int iterationCount = 0;
+        std::deque<float> changeBuffer;
+        float previousBufferChangeAverage = 0.0f;
+        float pagerankAcceleration = std::numeric_limits<float>::max();
+        while(change > PAGERANK_EPSILON &&
+              iterationCount < PAGERANK_ITERATION_LIMIT &&
+              pagerankAcceleration > PAGERANK_ACCELERATION_MINIMUM)
+        {
+            // Calculate pagerank
+            for(auto nodeId : component->nodeIds())
+            {
+                auto matrixId = nodeToIndexMap[nodeId];
+                float prSum = 0.0f;
+                for(auto edgeId : graph.edgeIdsForNodeId(nodeId))
+                {
+                    auto oppositeNodeId = graph.edgeById(edgeId).oppositeId(nodeId);
+                    prSum += pageRankVector[nodeToIndexMap[oppositeNodeId]] /
+                        static_cast<float>(graph.nodeById(oppositeNodeId).degree());
+                }
+                newPageRankVector[matrixId] = (prSum * PAGERANK_DAMPING) +
+                    ((1.0f - PAGERANK_DAMPING) / componentNodeCount);
+            }
+
+            // Normalise result
+            float sum = 0.0f;
+            for(auto value : newPageRankVector)
+                sum += value;
+            newPageRankVector = newPageRankVector / sum;
+
+            // Detect PR Change
+            change = 0.0f;
+            delta = blaze::abs(newPageRankVector - pageRankVector);
+            for(size_t i = 0UL; i < newPageRankVector.size(); ++i)
+                change += delta[i];
+
+            // Oscillation detection (delta avg)
+            changeBuffer.push_front(change);
+            if(changeBuffer.size() >= static_cast<size_t>(AVG_COUNT))
+                changeBuffer.pop_back();
+
+            // Average the last 10 steps
+            float bufferChangeAverage = 0.0f;
+            for(auto changes : changeBuffer)
+                bufferChangeAverage += changes;
+            bufferChangeAverage /= static_cast<float>(AVG_COUNT);
+
+            pagerankAcceleration = std::abs(previousBufferChangeAverage - bufferChangeAverage);
+
+            // Only update the previousAvg after AVG_COUNT steps
+            if(iterationCount % AVG_COUNT == 0)
+                previousBufferChangeAverage = bufferChangeAverage;
+
+            pageRankVector = newPageRankVector;
+            iterationCount++;
+        }
+
+        float maxValue = blaze::max(blaze::abs(pageRankVector));
+        pageRankVector = pageRankVector / maxValue;
+
+        for(auto nodeId : component->nodeIds())
+            pageRankScores[nodeId] = pageRankVector[nodeToIndexMap[nodeId]];
+    }
+
+    return pageRankScores;
+}
+} // namespace Reference
+
+#endif // REFERENCEPAGERANK_H
@@ -0,0 +1,627 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "shared/utils/stringcolumn.h"
+#include "shared/utils/typeidentity.h"
+#include "shared/plugins/userdatavector.h"
+#include "shared/loading/tabulardata.h"
+
+#include "shared/utils/container.h"
+
+#include <json_helper.h>
+
+#include <QtTest>
+#include <QDataStream>
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Checks that the dictionary encoded storage of strings behaves exactly as plain vectors of
+// QString did, by comparing against reference models of the previous implementations, including
+// once most values are distinct and they're stored plainly
+class StringColumnTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void stringColumn();
+    void userDataVector();
+    void tabularData();
+    void plainStorage();
+};
+
+namespace
+{
+const int numIterations = 200;
+
+const std::vector<QString> testValues =
+{
+    {}, QStringLiteral("0"), QStringLiteral("1"), QStringLiteral("-3"), QStringLiteral("42"),
+    QStringLiteral("2.5"), QStringLiteral("-0.125"), QStringLiteral("1e3"),
+    QStringLiteral("99999999999"), QStringLiteral("3.5e39"), QStringLiteral("abc"),
+    QStringLiteral("Abc"), QStringLiteral(" 7 "), QStringLiteral("  ")
+};
+
+class Random
+{
+private:
+    std::mt19937 _generator;
+
+public:
+    explicit Random(unsigned int seed) : _generator(seed) {}
+
+    size_t operator()(size_t max)
+    {
+        return std::uniform_int_distribution<size_t>(0, max - 1)(_generator);
+    }
+
+    // One of the first numChoices test values
+    const QString& value(size_t numChoices)
+    {
+        return testValues.at((*this)(std::min(numChoices, testValues.size())));
+    }
+
+    // A value that's unlikely to have been seen before
+    QString distinctValue()
+    {
+        return QString::number(static_cast<int>((*this)(2000000000)) - 1000000000);
+    }
+};
+
+// UserDataVector as it was when it held its values as a vector of QString
+class ReferenceUserDataVector : public TypeIdentity
+{
+private:
+    std::vector<QString> _values;
+
+    int _intMin = std::numeric_limits<int>::max();
+    int _intMax = std::numeric_limits<int>::lowest();
+    double _floatMin = std::numeric_limits<double>::max();
+    double _floatMax = std::numeric_limits<double>::lowest();
+
+public:
+    const std::vector<QString>& values() const { return _values; }
+
+    int numUniqueValues() const
+    {
+        auto v = _values;
+        std::sort(v.begin(), v.end());
+        auto last = std::unique(v.begin(), v.end());
+        v.erase(last, v.end());
+
+        return static_cast<int>(v.size());
+    }
+
+    bool hasEmptyValues() const
+    {
+        return std::any_of(_values.begin(), _values.end(), [](const auto& value) { return value.isEmpty(); });
+    }
+
+    int intMin() const { return _intMin; }
+    int intMax() const { return _intMax; }
+    double floatMin() const { return _floatMin; }
+    double floatMax() const { return _floatMax; }
+
+    void set(size_t index, const QString& value)
+    {
+        if(index >= _values.size())
+            _values.resize(index + 1);
+
+        _values.at(index) = value;
+
+        updateType(value);
+
+        if(type() == Type::Int)
+        {
+            int intValue = value.toInt();
+            _intMin = std::min(_intMin, intValue);
+            _intMax = std::max(_intMax, intValue);
+        }
+        else if(type() == Type::Float)
+        {
+            double floatValue = value.toDouble();
+            _floatMin = std::min(_floatMin, floatValue);
+            _floatMax = std::max(_floatMax, floatValue);
+        }
+    }
+
+    QString get(size_t index) const
+    {
+        if(index >= _values.size())
+            return {};
+
+        return _values.at(index);
+    }
+
+    json save(const std::vector<size_t>& indexes = {}) const
+    {
+        json jsonObject;
+
+        switch(type())
+        {
+        default:
+        case Type::Unknown: jsonObject["type"] = "Unknown"; break;
+        case Type::String:  jsonObject["type"] = "String"; break;
+        case Type::Int:     jsonObject["type"] = "Int"; break;
+        case Type::Float:   jsonObject["type"] = "Float"; break;
+        }
+
+        if(_intMin != std::numeric_limits<int>::max() && _intMax != std::numeric_limits<int>::lowest())
+        {
+            jsonObject["intMin"] = _intMin;
+            jsonObject["intMax"] = _intMax;
+        }
+
+        if(_floatMin != std::numeric_limits<double>::max() && _floatMax != std::numeric_limits<double>::lowest())
+        {
+            jsonObject["floatMin"] = _floatMin;
+            jsonObject["floatMax"] = _floatMax;
+        }
+
+        json jsonValues = json::array();
+
+        if(!indexes.empty())
+        {
+            for(auto index : indexes)
+                jsonValues.push_back(get(index));
+        }
+        else
+        {
+            for(const auto& value : _values)
+                jsonValues.push_back(value);
+        }
+
+        jsonObject["values"] = jsonValues;
+
+        return jsonObject;
+    }
+
+    void load(const json& jsonObject)
+    {
+        if(jsonObject["type"] == "String")
+            setType(Type::String);
+        else if(jsonObject["type"] == "Int")
+            setType(Type::Int);
+        else if(jsonObject["type"] == "Float")
+            setType(Type::Float);
+        else
+            setType(Type::Unknown);
+
+        if(u::contains(jsonObject, "intMin") && u::contains(jsonObject, "intMax"))
+        {
+            _intMin = jsonObject["intMin"];
+            _intMax = jsonObject["intMax"];
+        }
+
+        if(u::contains(jsonObject, "floatMin") && u::contains(jsonObject, "floatMax"))
+        {
+            _floatMin = jsonObject["floatMin"];
+            _floatMax = jsonObject["floatMax"];
+        }
+
+        _values.clear();
+        for(const auto& value : jsonObject["values"])
+            _values.push_back(value.get<QString>());
+    }
+};
+
+void compare(const UserDataVector& userDataVector, const ReferenceUserDataVector& reference)
+{
+    const auto& values = reference.values();
+
+    QCOMPARE(userDataVector.numValues(), static_cast<int>(values.size()));
+    QCOMPARE(userDataVector.type(), reference.type());
+    QCOMPARE(userDataVector.numUniqueValues(), reference.numUniqueValues());
+    QCOMPARE(userDataVector.hasEmptyValues(), reference.hasEmptyValues());
+    QCOMPARE(userDataVector.intMin(), reference.intMin());
+    QCOMPARE(userDataVector.intMax(), reference.intMax());
+    QCOMPARE(userDataVector.floatMin(), reference.floatMin());
+    QCOMPARE(userDataVector.floatMax(), reference.floatMax());
+
+    QStringList referenceList;
+    for(const auto& value : values)
+        referenceList.append(value);
+
+    QCOMPARE(userDataVector.toStringList(), referenceList);
+
+    // Including an index beyond the end
+    for(size_t i = 0; i <= values.size(); i++)
+    {
+        auto value = reference.get(i);
+
+        QCOMPARE(userDataVector.get(i), value);
+        QCOMPARE(userDataVector.intValueAt(i), value.toInt());
+        QCOMPARE(userDataVector.floatValueAt(i), value.toFloat());
+    }
+
+    QVERIFY(userDataVector.save() == reference.save());
+}
+
+// Saves and loads as the generic plugins do, in their user data sections
+QByteArray saveBinary(const UserDataVector& userDataVector, const std::vector<size_t>& indexes = {})
+{
+    QByteArray byteArray;
+    QDataStream stream(&byteArray, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    userDataVector.save(stream, indexes);
+
+    return byteArray;
+}
+
+bool loadBinary(UserDataVector& userDataVector, const QByteArray& byteArray)
+{
+    QDataStream stream(byteArray);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    return userDataVector.load(QStringLiteral("Loaded"), stream) && stream.atEnd();
+}
+
+// TabularData, as a map of the cells that have been set
+class ReferenceTabularData
+{
+private:
+    std::map<std::pair<size_t, size_t>, QString> _cells;
+    size_t _columns = 0;
+    size_t _rows = 0;
+
+public:
+    size_t numColumns() const { return _columns; }
+    size_t numRows() const { return _rows; }
+
+    QString valueAt(size_t column, size_t row) const
+    {
+        auto it = _cells.find({column, row});
+        if(it == _cells.end())
+            return {};
+
+        return it->second;
+    }
+
+    void setValueAt(size_t column, size_t row, const QString& value)
+    {
+        _columns = std::max(_columns, column + 1);
+        _rows = std::max(_rows, row + 1);
+        _cells[{column, row}] = value.trimmed();
+    }
+
+    void shrinkToFit()
+    {
+        auto lastRowIsEmpty = [this]
+        {
+            for(size_t column = 0; column < _columns; column++)
+            {
+                if(!valueAt(column, _rows - 1).isEmpty())
+                    return false;
+            }
+
+            return true;
+        };
+
+        while(_rows > 0 && lastRowIsEmpty())
+            _rows--;
+
+        for(auto it = _cells.begin(); it != _cells.end();)
+        {
+            if(it->first.second >= _rows)
+                it = _cells.erase(it);
+            else
+                ++it;
+        }
+    }
+};
+
+void compare(const TabularData& tabularData, const ReferenceTabularData& reference)
+{
+    QVERIFY(!tabularData.transposed());
+    QCOMPARE(tabularData.numColumns(), reference.numColumns());
+    QCOMPARE(tabularData.numRows(), reference.numRows());
+
+    for(size_t row = 0; row < reference.numRows(); row++)
+    {
+        for(size_t column = 0; column < reference.numColumns(); column++)
+            QCOMPARE(tabularData.valueAt(column, row), reference.valueAt(column, row));
+    }
+}
+} // namespace
+
+void StringColumnTest::stringColumn()
+{
+    Random random(1);
+
+    for(int i = 0; i < numIterations; i++)
+    {
+        StringColumn stringColumn;
+        std::vector<QString> reference;
+
+        auto numSets = random(100);
+
+        for(size_t j = 0; j < numSets; j++)
+        {
+            auto index = random(50);
+            const auto& value = random.value(testValues.size());
+
+            if(index >= reference.size())
+                reference.resize(index + 1);
+
+            reference.at(index) = value;
+            auto code = stringColumn.set(index, value);
+            QCOMPARE(stringColumn.dictionary().valueOf(code), value);
+
+            // Values added after the lookup has been freed must still find their existing codes
+            if(random(20) == 0)
+                stringColumn.shrinkToFit();
+        }
+
+        QCOMPARE(stringColumn.size(), reference.size());
+        QVERIFY(std::equal(stringColumn.begin(), stringColumn.end(), reference.begin(), reference.end()));
+
+        for(size_t a = 0; a < reference.size(); a++)
+        {
+            QCOMPARE(stringColumn.at(a), reference.at(a));
+            QCOMPARE(stringColumn.codeAt(a) == StringDictionary::EmptyCode, reference.at(a).isEmpty());
+
+            for(size_t b = 0; b < reference.size(); b++)
+                QCOMPARE(stringColumn.codeAt(a) == stringColumn.codeAt(b), reference.at(a) == reference.at(b));
+        }
+
+        auto sorted = reference;
+        std::sort(sorted.begin(), sorted.end());
+        sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+        QCOMPARE(stringColumn.numUniqueValues(), sorted.size());
+        QCOMPARE(stringColumn.hasEmptyValues(), std::any_of(reference.begin(), reference.end(),
+            [](const auto& value) { return value.isEmpty(); }));
+
+        stringColumn.clear();
+        QVERIFY(stringColumn.empty());
+        QCOMPARE(stringColumn.dictionary().size(), static_cast<size_t>(1));
+        QCOMPARE(stringColumn.set(0, {}), StringDictionary::EmptyCode);
+    }
+}
+
+void StringColumnTest::userDataVector()
+{
+    Random random(2);
+
+    for(int i = 0; i < numIterations; i++)
+    {
+        UserDataVector userDataVector(QStringLiteral("Test"));
+        ReferenceUserDataVector reference;
+
+        // Restricting the choice of values makes for Int and Float vectors, as well as String ones
+        auto numChoices = 3 + random(testValues.size());
+        auto numSets = random(100);
+
+        for(size_t j = 0; j < numSets; j++)
+        {
+            auto index = random(60);
+            const auto& value = random.value(numChoices);
+
+            userDataVector.set(index, value);
+            reference.set(index, value);
+        }
+
+        compare(userDataVector, reference);
+
+        // Save a subset, including indexes beyond the end
+        std::vector<size_t> indexes;
+        auto numIndexes = 1 + random(20);
+        for(size_t j = 0; j < numIndexes; j++)
+            indexes.push_back(random(70));
+
+        auto jsonObject = userDataVector.save(indexes);
+        QVERIFY(jsonObject == reference.save(indexes));
+
+        // Loading takes the saved type and ranges, whatever the loaded values are
+        UserDataVector loaded;
+        ReferenceUserDataVector loadedReference;
+        QVERIFY(loaded.load(QStringLiteral("Loaded"), jsonObject));
+        loadedReference.load(jsonObject);
+
+        QCOMPARE(loaded.name(), QStringLiteral("Loaded"));
+        compare(loaded, loadedReference);
+
+        // The binary form loads as the JSON does, unless it's truncated
+        auto binary = saveBinary(userDataVector, indexes);
+        UserDataVector binaryLoaded;
+        QVERIFY(loadBinary(binaryLoaded, binary));
+        compare(binaryLoaded, loadedReference);
+        QVERIFY(!loadBinary(binaryLoaded, binary.left(binary.size() - 1)));
+
+        // Setting values after loading continues from the loaded state
+        for(size_t j = 0; j < 20; j++)
+        {
+            auto index = random(40);
+            const auto& value = random.value(testValues.size());
+
+            loaded.set(index, value);
+            loadedReference.set(index, value);
+        }
+
+        compare(loaded, loadedReference);
+    }
+}
+
+void StringColumnTest::tabularData()
+{
+    Random random(3);
+
+    for(int i = 0; i < numIterations; i++)
+    {
+        TabularData tabularData;
+        ReferenceTabularData reference;
+
+        auto maxColumns = 1 + random(12);
+        auto maxRows = 1 + random(20);
+        auto numSets = random(maxColumns * maxRows * 2);
+
+        // Setting cells out of order widens rows that already exist
+        for(size_t j = 0; j < numSets; j++)
+        {
+            auto column = random(maxColumns);
+            auto row = random(maxRows);
+            auto value = random.value(testValues.size());
+
+            reference.setValueAt(column, row, value);
+            tabularData.setValueAt(column, row, std::move(value), static_cast<int>((j * 100) / numSets));
+        }
+
+        compare(tabularData, reference);
+
+        tabularData.shrinkToFit();
+        reference.shrinkToFit();
+        compare(tabularData, reference);
+
+        // The table survives being moved
+        TabularData moved(std::move(tabularData));
+        QVERIFY(tabularData.empty());
+        compare(moved, reference);
+
+        moved.setTransposed(true);
+        QCOMPARE(moved.numColumns(), reference.numRows());
+        QCOMPARE(moved.numRows(), reference.numColumns());
+
+        for(size_t row = 0; row < moved.numRows(); row++)
+        {
+            for(size_t column = 0; column < moved.numColumns(); column++)
+                QCOMPARE(moved.valueAt(column, row), reference.valueAt(row, column));
+        }
+
+        moved.reset();
+        QVERIFY(moved.empty());
+        QCOMPARE(moved.numColumns(), static_cast<size_t>(0));
+    }
+}
+
+void StringColumnTest::plainStorage()
+{
+    Random random(4);
+
+    // Mostly distinct values are stored plainly as soon as there are enough of them...
+    StringColumn stringColumn;
+    std::vector<QString> reference;
+
+    for(size_t i = 0; i < 6000; i++)
+    {
+        auto value = random(10) == 0 ? random.value(testValues.size()) : random.distinctValue();
+
+        reference.push_back(value);
+        auto code = stringColumn.set(i, value);
+        QCOMPARE(code == StringColumn::NoCode, stringColumn.plain());
+    }
+
+    QVERIFY(stringColumn.plain());
+
+    // ...and moving values around leaves empty ones behind
+    stringColumn.resize(reference.size() + 10);
+    reference.resize(reference.size() + 10);
+    for(size_t i = 0; i < 10; i++)
+    {
+        stringColumn.move(i, reference.size() - 1 - i);
+        reference.at(reference.size() - 1 - i) = reference.at(i);
+        reference.at(i).clear();
+    }
+
+    QCOMPARE(stringColumn.size(), reference.size());
+    QVERIFY(std::equal(stringColumn.begin(), stringColumn.end(), reference.begin(), reference.end()));
+
+    auto sorted = reference;
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    QCOMPARE(stringColumn.numUniqueValues(), sorted.size());
+    QVERIFY(stringColumn.hasEmptyValues());
+
+    stringColumn.clear();
+    QVERIFY(!stringColumn.plain());
+
+    // Values that only become mostly distinct once others have been overwritten are stored plainly when shrunk
+    for(size_t i = 0; i < 5000; i++)
+        stringColumn.set(i % 4200, testValues.at(1));
+
+    for(size_t i = 0; i < 4200; i++)
+        stringColumn.set(i, QString::number(i));
+
+    QVERIFY(!stringColumn.plain());
+    stringColumn.shrinkToFit();
+    QVERIFY(stringColumn.plain());
+    QCOMPARE(stringColumn.numUniqueValues(), static_cast<size_t>(4200));
+
+    for(size_t i = 0; i < 4200; i++)
+        QCOMPARE(stringColumn.at(i), QString::number(i));
+
+    // The conversions of plainly stored values are made as they're needed
+    for(const auto& numChoices : {5, 9, static_cast<int>(testValues.size())})
+    {
+        UserDataVector userDataVector(QStringLiteral("Test"));
+        ReferenceUserDataVector userDataVectorReference;
+
+        for(size_t i = 0; i < 6000; i++)
+        {
+            auto index = random(5000);
+            auto value = random(10) == 0 ? random.value(static_cast<size_t>(numChoices)) : random.distinctValue();
+
+            userDataVector.set(index, value);
+            userDataVectorReference.set(index, value);
+        }
+
+        compare(userDataVector, userDataVectorReference);
+
+        userDataVector.shrinkToFit();
+        compare(userDataVector, userDataVectorReference);
+
+        UserDataVector loaded;
+        ReferenceUserDataVector loadedReference;
+        QVERIFY(loaded.load(QStringLiteral("Loaded"), userDataVector.save()));
+        loadedReference.load(userDataVectorReference.save());
+        compare(loaded, loadedReference);
+
+        UserDataVector binaryLoaded;
+        QVERIFY(loadBinary(binaryLoaded, saveBinary(userDataVector)));
+        compare(binaryLoaded, loadedReference);
+    }
+
+    // Numerical tables are stored plainly, including when a row is widened afterwards
+    TabularData tabularData;
+    ReferenceTabularData tabularDataReference;
+
+    for(size_t row = 0; row < 80; row++)
+    {
+        for(size_t column = 0; column < 60; column++)
+        {
+            auto value = random.distinctValue();
+
+            tabularDataReference.setValueAt(column, row, value);
+            tabularData.setValueAt(column, row, std::move(value));
+        }
+    }
+
+    tabularDataReference.setValueAt(70, 40, testValues.at(4));
+    tabularData.setValueAt(70, 40, QString(testValues.at(4)));
+    compare(tabularData, tabularDataReference);
+
+    tabularData.shrinkToFit();
+    tabularDataReference.shrinkToFit();
+    compare(tabularData, tabularDataReference);
+}
+
+QTEST_APPLESS_MAIN(StringColumnTest)
+#include "stringcolumntest.moc"
@@ -0,0 +1,113 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "shared/utils/threadpool.h"
+
+#include <QtTest>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+class ThreadPoolTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void nestedInlineThreadIndex();
+    void noThreadsRequested();
+};
+
+// With NestedInline, a concurrent_for made from within another runs inline on the same
+// thread, and is passed the index of the enclosing worker, so that nested loops running
+// on different workers never share an index
+void ThreadPoolTest::nestedInlineThreadIndex()
+{
+    const size_t numThreads = 4;
+    ThreadPool threadPool(QStringLiteral("Test"), numThreads);
+
+    std::vector<int> outer(64);
+    std::vector<int> inner(16);
+    std::iota(outer.begin(), outer.end(), 0);
+    std::iota(inner.begin(), inner.end(), 0);
+
+    std::mutex mutex;
+    std::map<size_t, std::vector<std::thread::id>> workerThreads;
+    std::atomic<size_t> numMismatches(0);
+
+    threadPool.concurrent_for(outer.begin(), outer.end(),
+    [&](int, size_t outerIndex)
+    {
+        // Give the other workers a chance to take part
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        const auto outerThread = std::this_thread::get_id();
+
+        threadPool.concurrent_for(inner.begin(), inner.end(),
+        [&](int, size_t innerIndex)
+        {
+            if(innerIndex != outerIndex || std::this_thread::get_id() != outerThread)
+                numMismatches++;
+
+            std::unique_lock<std::mutex> lock(mutex);
+            workerThreads[innerIndex].push_back(std::this_thread::get_id());
+        });
+    }, ThreadPool::Blocking, ThreadPool::NestedInline);
+
+    QCOMPARE(numMismatches.load(), static_cast<size_t>(0));
+
+    std::vector<std::thread::id> threadsSeen;
+    for(const auto& [index, threads] : workerThreads)
+    {
+        QVERIFY(index < numThreads);
+
+        // Each index is only ever used by one thread, and each thread only uses one index
+        auto thread = threads.front();
+        QVERIFY(std::all_of(threads.begin(), threads.end(), [thread](auto t) { return t == thread; }));
+        QVERIFY(std::find(threadsSeen.begin(), threadsSeen.end(), thread) == threadsSeen.end());
+        threadsSeen.push_back(thread);
+    }
+}
+
+// hardware_concurrency() may return 0, in which case the pool still needs a worker, and
+// callers sizing per thread scratch space by numThreads() need an index to be valid
+void ThreadPoolTest::noThreadsRequested()
+{
+    ThreadPool threadPool(QStringLiteral("Test"), 0);
+    QCOMPARE(threadPool.numThreads(), static_cast<size_t>(1));
+
+    std::vector<int> values(100);
+    std::iota(values.begin(), values.end(), 0);
+
+    std::vector<int> sums(threadPool.numThreads(), 0);
+    threadPool.concurrent_for(values.begin(), values.end(),
+    [&](int value, size_t threadIndex)
+    {
+        sums.at(threadIndex) += value;
+    });
+
+    QCOMPARE(sums.at(0), 4950);
+}
+
+QTEST_APPLESS_MAIN(ThreadPoolTest)
+#include "threadpooltest.moc"